@@ -79,6 +79,34 @@ Module Name:
 
 #define REGULAR_EXPRESSION_INITIAL_STRING_SIZE 16
 
+//
+// Define the initial number of automaton instructions and character sets.
+//
+
+#define REGEX_AUTOMATON_INITIAL_CAPACITY 32
+
+//
+// Define the maximum number of instructions in an automaton program. Large
+// bounded repeats are expanded into copies, so past this size the expression
+// is left to the backtracking matcher instead.
+//
+
+#define REGEX_AUTOMATON_MAX_INSTRUCTIONS 10000
+
+//
+// This macro sets the given character in an automaton character set.
+//
+
+#define REGEX_SET_ADD(_Set, _Character) \
+    ((_Set)[(_Character) >> 3] |= (UCHAR)(1 << ((_Character) & 0x7)))
+
+//
+// This macro determines whether the given character is in a character set.
+//
+
+#define REGEX_SET_CONTAINS(_Set, _Character) \
+    (((_Set)[(_Character) >> 3] & (1 << ((_Character) & 0x7))) != 0)
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -221,6 +249,82 @@ ClpAppendRegularExpressionString (
     ULONG Size
     );
 
+VOID
+ClpFindRequiredLiteral (
+    PREGULAR_EXPRESSION Expression
+    );
+
+BOOL
+ClpScanRequiredLiteral (
+    PREGULAR_EXPRESSION Expression,
+    PLIST_ENTRY ListHead,
+    PREGULAR_EXPRESSION_STRING Run
+    );
+
+BOOL
+ClpFinishRequiredLiteralRun (
+    PREGULAR_EXPRESSION Expression,
+    PREGULAR_EXPRESSION_STRING Run
+    );
+
+VOID
+ClpCompileRegularExpressionAutomaton (
+    PREGULAR_EXPRESSION Expression
+    );
+
+VOID
+ClpDestroyRegularExpressionAutomaton (
+    PREGEX_AUTOMATON Automaton
+    );
+
+BOOL
+ClpCompileAutomatonList (
+    PREGEX_AUTOMATON Automaton,
+    PREGULAR_EXPRESSION Expression,
+    PLIST_ENTRY ListHead,
+    ULONG Next,
+    PULONG Start
+    );
+
+BOOL
+ClpCompileAutomatonEntry (
+    PREGEX_AUTOMATON Automaton,
+    PREGULAR_EXPRESSION Expression,
+    PREGULAR_EXPRESSION_ENTRY Entry,
+    ULONG Next,
+    PULONG Start
+    );
+
+BOOL
+ClpCompileAutomatonSingleEntry (
+    PREGEX_AUTOMATON Automaton,
+    PREGULAR_EXPRESSION Expression,
+    PREGULAR_EXPRESSION_ENTRY Entry,
+    ULONG Next,
+    PULONG Start
+    );
+
+BOOL
+ClpAddAutomatonInstruction (
+    PREGEX_AUTOMATON Automaton,
+    REGEX_OPCODE Opcode,
+    ULONG Next,
+    ULONG Alternate,
+    PULONG Index
+    );
+
+PUCHAR
+ClpAddAutomatonCharacterSet (
+    PREGEX_AUTOMATON Automaton,
+    PULONG Index
+    );
+
+VOID
+ClpComputeAutomatonByteClasses (
+    PREGEX_AUTOMATON Automaton,
+    PREGULAR_EXPRESSION Expression
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -531,6 +635,21 @@ Return Value:
         goto CompileRegularExpressionEnd;
     }
 
+    //
+    // Try to build the automaton form of the expression too, which gives
+    // linear time matching. If this doesn't work out, execution just falls
+    // back to the backtracking matcher.
+    //
+
+    ClpCompileRegularExpressionAutomaton(Result);
+
+    //
+    // Find a literal string that must appear in every match, which lets
+    // execution skip input that cannot possibly match.
+    //
+
+    ClpFindRequiredLiteral(Result);
+
 CompileRegularExpressionEnd:
     if (Status != RegexStatusSuccess) {
         if (Result != NULL) {
@@ -582,6 +701,14 @@ Return Value:
         ClpDestroyRegularExpressionEntry(Entry);
     }
 
+    if (Expression->Automaton != NULL) {
+        ClpDestroyRegularExpressionAutomaton(Expression->Automaton);
+    }
+
+    if (Expression->RequiredLiteral.Data != NULL) {
+        free(Expression->RequiredLiteral.Data);
+    }
+
     free(Expression);
     return;
 }
@@ -2582,3 +2709,1165 @@ Return Value:
     return TRUE;
 }
 
+VOID
+ClpFindRequiredLiteral (
+    PREGULAR_EXPRESSION Expression
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the longest run of ordinary characters that every match
+    of the given expression must contain, and saves it in the expression.
+
+Arguments:
+
+    Expression - Supplies a pointer to the parsed regular expression.
+
+Return Value:
+
+    None. Failure is not fatal, as the required literal is only an
+    optimization.
+
+--*/
+
+{
+
+    BOOL Result;
+    REGULAR_EXPRESSION_STRING Run;
+
+    memset(&Run, 0, sizeof(REGULAR_EXPRESSION_STRING));
+    Result = ClpScanRequiredLiteral(Expression,
+                                    &(Expression->BaseEntry.ChildList),
+                                    &Run);
+
+    if (Result != FALSE) {
+        Result = ClpFinishRequiredLiteralRun(Expression, &Run);
+    }
+
+    if (Run.Data != NULL) {
+        free(Run.Data);
+    }
+
+    if (Result == FALSE) {
+        Expression->RequiredLiteral.Size = 0;
+    }
+
+    return;
+}
+
+BOOL
+ClpScanRequiredLiteral (
+    PREGULAR_EXPRESSION Expression,
+    PLIST_ENTRY ListHead,
+    PREGULAR_EXPRESSION_STRING Run
+    )
+
+/*++
+
+Routine Description:
+
+    This routine scans a sequence of regular expression entries for literal
+    characters that must match one right after another.
+
+Arguments:
+
+    Expression - Supplies a pointer to the regular expression.
+
+    ListHead - Supplies a pointer to the head of the list of entries.
+
+    Run - Supplies a pointer to the current run of required characters. This
+        may be added to, or finished and restarted.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on allocation failure.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PREGULAR_EXPRESSION_ENTRY Entry;
+    ULONG Index;
+    ULONG OldSize;
+
+    CurrentEntry = ListHead->Next;
+    while (CurrentEntry != ListHead) {
+        Entry = LIST_VALUE(CurrentEntry, REGULAR_EXPRESSION_ENTRY, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+
+        //
+        // Optional entries might not be there at all, so they break the run.
+        //
+
+        if (Entry->DuplicateMin == 0) {
+            if (ClpFinishRequiredLiteralRun(Expression, Run) == FALSE) {
+                return FALSE;
+            }
+
+            continue;
+        }
+
+        switch (Entry->Type) {
+        case RegexEntryOrdinaryCharacters:
+            OldSize = Run->Size;
+            if (ClpAppendRegularExpressionString(Run,
+                                                 Entry->U.String.Data,
+                                                 Entry->U.String.Size) ==
+                FALSE) {
+
+                return FALSE;
+            }
+
+            if ((Expression->Flags & REG_ICASE) != 0) {
+                for (Index = OldSize; Index < Run->Size; Index += 1) {
+                    Run->Data[Index] = tolower(Run->Data[Index]);
+                }
+            }
+
+            //
+            // If the characters repeat, whatever comes next follows the last
+            // repetition, so the run restarts with just one copy.
+            //
+
+            if (Entry->DuplicateMax != 1) {
+                if (ClpFinishRequiredLiteralRun(Expression, Run) == FALSE) {
+                    return FALSE;
+                }
+
+                memmove(Run->Data,
+                        Run->Data + OldSize,
+                        Entry->U.String.Size);
+
+                Run->Size = Entry->U.String.Size;
+            }
+
+            break;
+
+        //
+        // A subexpression that appears exactly once just continues the run.
+        // One that repeats still contains its own required literals.
+        //
+
+        case RegexEntrySubexpression:
+            if (Entry->DuplicateMax != 1) {
+                if (ClpFinishRequiredLiteralRun(Expression, Run) == FALSE) {
+                    return FALSE;
+                }
+            }
+
+            if (ClpScanRequiredLiteral(Expression,
+                                       &(Entry->ChildList),
+                                       Run) == FALSE) {
+
+                return FALSE;
+            }
+
+            if (Entry->DuplicateMax != 1) {
+                if (ClpFinishRequiredLiteralRun(Expression, Run) == FALSE) {
+                    return FALSE;
+                }
+            }
+
+            break;
+
+        //
+        // Assertions don't consume anything, so they don't break the run.
+        //
+
+        case RegexEntryStringBegin:
+        case RegexEntryStringEnd:
+        case RegexEntryStartOfWord:
+        case RegexEntryEndOfWord:
+            break;
+
+        //
+        // Anything else matches characters that aren't known ahead of time.
+        //
+
+        default:
+            if (ClpFinishRequiredLiteralRun(Expression, Run) == FALSE) {
+                return FALSE;
+            }
+
+            break;
+        }
+    }
+
+    return TRUE;
+}
+
+BOOL
+ClpFinishRequiredLiteralRun (
+    PREGULAR_EXPRESSION Expression,
+    PREGULAR_EXPRESSION_STRING Run
+    )
+
+/*++
+
+Routine Description:
+
+    This routine ends the current run of required characters, saving it as the
+    required literal if it is the longest seen so far.
+
+Arguments:
+
+    Expression - Supplies a pointer to the regular expression.
+
+    Run - Supplies a pointer to the run to finish. Its size is reset to zero.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on allocation failure.
+
+--*/
+
+{
+
+    PREGULAR_EXPRESSION_STRING Literal;
+    BOOL Result;
+
+    Result = TRUE;
+    if (Run->Size > Expression->RequiredLiteral.Size) {
+        Literal = &(Expression->RequiredLiteral);
+        Literal->Size = 0;
+        Result = ClpAppendRegularExpressionString(Literal,
+                                                  Run->Data,
+                                                  Run->Size);
+    }
+
+    Run->Size = 0;
+    return Result;
+}
+
+VOID
+ClpCompileRegularExpressionAutomaton (
+    PREGULAR_EXPRESSION Expression
+    )
+
+/*++
+
+Routine Description:
+
+    This routine attempts to compile a parsed regular expression into an
+    automaton program (a Thompson NFA), which is later run as a lazily built
+    DFA or as a Pike VM. Save instructions mark where the whole match and
+    each subexpression begin and end. Expressions containing back
+    references cannot be expressed by the automaton, and are left without
+    one.
+
+Arguments:
+
+    Expression - Supplies a pointer to the parsed regular expression. On
+        success, the automaton pointer will be filled in.
+
+Return Value:
+
+    None. Failure is not fatal, as execution falls back to backtracking.
+
+--*/
+
+{
+
+    PREGEX_AUTOMATON Automaton;
+    ULONG Anchors;
+    ULONG AnyCharacter;
+    ULONG Current;
+    BOOL Result;
+    PUCHAR Set;
+    ULONG SetIndex;
+    ULONG Split;
+
+    Result = FALSE;
+    Automaton = malloc(sizeof(REGEX_AUTOMATON));
+    if (Automaton == NULL) {
+        return;
+    }
+
+    memset(Automaton, 0, sizeof(REGEX_AUTOMATON));
+
+    //
+    // The program is built backwards, starting from the match instruction,
+    // so that every fragment already knows where it goes next.
+    //
+
+    Anchors = Expression->BaseEntry.Flags;
+    if (ClpAddAutomatonInstruction(Automaton,
+                                   RegexOpMatch,
+                                   0,
+                                   0,
+                                   &Current) == FALSE) {
+
+        goto CompileRegularExpressionAutomatonEnd;
+    }
+
+    if (ClpAddAutomatonInstruction(Automaton,
+                                   RegexOpSave,
+                                   Current,
+                                   1,
+                                   &Current) == FALSE) {
+
+        goto CompileRegularExpressionAutomatonEnd;
+    }
+
+    if ((Anchors & REGULAR_EXPRESSION_ANCHORED_RIGHT) != 0) {
+        if (ClpAddAutomatonInstruction(Automaton,
+                                       RegexOpLineEnd,
+                                       Current,
+                                       0,
+                                       &Current) == FALSE) {
+
+            goto CompileRegularExpressionAutomatonEnd;
+        }
+    }
+
+    Result = ClpCompileAutomatonList(Automaton,
+                                     Expression,
+                                     &(Expression->BaseEntry.ChildList),
+                                     Current,
+                                     &Current);
+
+    if (Result == FALSE) {
+        goto CompileRegularExpressionAutomatonEnd;
+    }
+
+    Result = FALSE;
+    if ((Anchors & REGULAR_EXPRESSION_ANCHORED_LEFT) != 0) {
+        if (ClpAddAutomatonInstruction(Automaton,
+                                       RegexOpLineBegin,
+                                       Current,
+                                       0,
+                                       &Current) == FALSE) {
+
+            goto CompileRegularExpressionAutomatonEnd;
+        }
+    }
+
+    if (ClpAddAutomatonInstruction(Automaton,
+                                   RegexOpSave,
+                                   Current,
+                                   0,
+                                   &Current) == FALSE) {
+
+        goto CompileRegularExpressionAutomatonEnd;
+    }
+
+    //
+    // Unless the expression can only ever start at the very beginning of the
+    // input, add a loop on the front that consumes any character. This lets
+    // a single pass search for a match starting anywhere.
+    //
+
+    if (((Anchors & REGULAR_EXPRESSION_ANCHORED_LEFT) == 0) ||
+        ((Expression->Flags & REG_NEWLINE) != 0)) {
+
+        Set = ClpAddAutomatonCharacterSet(Automaton, &SetIndex);
+        if (Set == NULL) {
+            goto CompileRegularExpressionAutomatonEnd;
+        }
+
+        memset(Set, 0xFF, REGEX_CHARACTER_SET_SIZE);
+        Set[0] &= ~0x1;
+        if (ClpAddAutomatonInstruction(Automaton,
+                                       RegexOpSplit,
+                                       Current,
+                                       0,
+                                       &Split) == FALSE) {
+
+            goto CompileRegularExpressionAutomatonEnd;
+        }
+
+        if (ClpAddAutomatonInstruction(Automaton,
+                                       RegexOpCharacterSet,
+                                       Split,
+                                       SetIndex,
+                                       &AnyCharacter) == FALSE) {
+
+            goto CompileRegularExpressionAutomatonEnd;
+        }
+
+        Automaton->Program[Split].Alternate = AnyCharacter;
+        Current = Split;
+    }
+
+    Automaton->Start = Current;
+    ClpComputeAutomatonByteClasses(Automaton, Expression);
+
+    //
+    // Allocate the scratch space used when building states: the closure
+    // stack, the visit marks, and two instruction lists.
+    //
+
+    Automaton->Stack = malloc(Automaton->ProgramSize * sizeof(ULONG) * 4);
+    if (Automaton->Stack == NULL) {
+        goto CompileRegularExpressionAutomatonEnd;
+    }
+
+    Automaton->Mark = Automaton->Stack + Automaton->ProgramSize;
+    Automaton->List[0] = Automaton->Mark + Automaton->ProgramSize;
+    Automaton->List[1] = Automaton->List[0] + Automaton->ProgramSize;
+    memset(Automaton->Mark, 0, Automaton->ProgramSize * sizeof(ULONG));
+    Result = TRUE;
+
+CompileRegularExpressionAutomatonEnd:
+    if (Result == FALSE) {
+        ClpDestroyRegularExpressionAutomaton(Automaton);
+        Automaton = NULL;
+    }
+
+    Expression->Automaton = Automaton;
+    return;
+}
+
+VOID
+ClpDestroyRegularExpressionAutomaton (
+    PREGEX_AUTOMATON Automaton
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys a regular expression automaton, including any
+    states that were built during execution.
+
+Arguments:
+
+    Automaton - Supplies a pointer to the automaton to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Bucket;
+    PREGEX_DFA_STATE State;
+
+    for (Bucket = 0; Bucket < REGEX_DFA_HASH_SIZE; Bucket += 1) {
+        while (Automaton->Hash[Bucket] != NULL) {
+            State = Automaton->Hash[Bucket];
+            Automaton->Hash[Bucket] = State->HashNext;
+            free(State);
+        }
+    }
+
+    if (Automaton->Program != NULL) {
+        free(Automaton->Program);
+    }
+
+    if (Automaton->Sets != NULL) {
+        free(Automaton->Sets);
+    }
+
+    if (Automaton->Stack != NULL) {
+        free(Automaton->Stack);
+    }
+
+    free(Automaton);
+    return;
+}
+
+BOOL
+ClpCompileAutomatonList (
+    PREGEX_AUTOMATON Automaton,
+    PREGULAR_EXPRESSION Expression,
+    PLIST_ENTRY ListHead,
+    ULONG Next,
+    PULONG Start
+    )
+
+/*++
+
+Routine Description:
+
+    This routine compiles a list of regular expression entries that match in
+    sequence into automaton instructions.
+
+Arguments:
+
+    Automaton - Supplies a pointer to the automaton being built.
+
+    Expression - Supplies a pointer to the regular expression.
+
+    ListHead - Supplies a pointer to the head of the list of entries.
+
+    Next - Supplies the index of the instruction to go to after the whole
+        sequence matches.
+
+    Start - Supplies a pointer where the index of the first instruction of the
+        sequence will be returned.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE if the automaton cannot be built.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PREGULAR_EXPRESSION_ENTRY Entry;
+
+    //
+    // Work backwards from the end of the list, since each entry needs to know
+    // its successor.
+    //
+
+    CurrentEntry = ListHead->Previous;
+    while (CurrentEntry != ListHead) {
+        Entry = LIST_VALUE(CurrentEntry, REGULAR_EXPRESSION_ENTRY, ListEntry);
+        CurrentEntry = CurrentEntry->Previous;
+        if (ClpCompileAutomatonEntry(Automaton,
+                                     Expression,
+                                     Entry,
+                                     Next,
+                                     &Next) == FALSE) {
+
+            return FALSE;
+        }
+    }
+
+    *Start = Next;
+    return TRUE;
+}
+
+BOOL
+ClpCompileAutomatonEntry (
+    PREGEX_AUTOMATON Automaton,
+    PREGULAR_EXPRESSION Expression,
+    PREGULAR_EXPRESSION_ENTRY Entry,
+    ULONG Next,
+    PULONG Start
+    )
+
+/*++
+
+Routine Description:
+
+    This routine compiles a regular expression entry, including its
+    duplication, into automaton instructions.
+
+Arguments:
+
+    Automaton - Supplies a pointer to the automaton being built.
+
+    Expression - Supplies a pointer to the regular expression.
+
+    Entry - Supplies a pointer to the entry to compile.
+
+    Next - Supplies the index of the instruction to go to after the entry
+        matches.
+
+    Start - Supplies a pointer where the index of the first instruction of the
+        entry will be returned.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE if the automaton cannot be built.
+
+--*/
+
+{
+
+    ULONG BodyStart;
+    ULONG Current;
+    ULONG Iteration;
+    ULONG Split;
+
+    //
+    // An unbounded repeat loops back to a split that either goes around
+    // again or moves on. The split entering the loop is a separate
+    // instruction from the one looping back, so that the Pike VM can record
+    // a last iteration that matched nothing, as the backtracking matcher
+    // does.
+    //
+
+    if (Entry->DuplicateMax == (ULONG)-1) {
+        if (ClpAddAutomatonInstruction(Automaton,
+                                       RegexOpSplit,
+                                       0,
+                                       Next,
+                                       &Split) == FALSE) {
+
+            return FALSE;
+        }
+
+        if (ClpCompileAutomatonSingleEntry(Automaton,
+                                           Expression,
+                                           Entry,
+                                           Split,
+                                           &BodyStart) == FALSE) {
+
+            return FALSE;
+        }
+
+        Automaton->Program[Split].Next = BodyStart;
+        if (ClpAddAutomatonInstruction(Automaton,
+                                       RegexOpSplit,
+                                       BodyStart,
+                                       Next,
+                                       &Current) == FALSE) {
+
+            return FALSE;
+        }
+
+    //
+    // A bounded repeat becomes a chain of optional copies, any of which can
+    // bail out to the next entry.
+    //
+
+    } else {
+
+        assert(Entry->DuplicateMax >= Entry->DuplicateMin);
+
+        Current = Next;
+        for (Iteration = Entry->DuplicateMin;
+             Iteration < Entry->DuplicateMax;
+             Iteration += 1) {
+
+            if (ClpCompileAutomatonSingleEntry(Automaton,
+                                               Expression,
+                                               Entry,
+                                               Current,
+                                               &BodyStart) == FALSE) {
+
+                return FALSE;
+            }
+
+            if (ClpAddAutomatonInstruction(Automaton,
+                                           RegexOpSplit,
+                                           BodyStart,
+                                           Next,
+                                           &Current) == FALSE) {
+
+                return FALSE;
+            }
+        }
+    }
+
+    //
+    // Add the required copies in front.
+    //
+
+    for (Iteration = 0; Iteration < Entry->DuplicateMin; Iteration += 1) {
+        if (ClpCompileAutomatonSingleEntry(Automaton,
+                                           Expression,
+                                           Entry,
+                                           Current,
+                                           &Current) == FALSE) {
+
+            return FALSE;
+        }
+    }
+
+    *Start = Current;
+    return TRUE;
+}
+
+BOOL
+ClpCompileAutomatonSingleEntry (
+    PREGEX_AUTOMATON Automaton,
+    PREGULAR_EXPRESSION Expression,
+    PREGULAR_EXPRESSION_ENTRY Entry,
+    ULONG Next,
+    PULONG Start
+    )
+
+/*++
+
+Routine Description:
+
+    This routine compiles one occurrence of a regular expression entry into
+    automaton instructions, ignoring its duplication.
+
+Arguments:
+
+    Automaton - Supplies a pointer to the automaton being built.
+
+    Expression - Supplies a pointer to the regular expression.
+
+    Entry - Supplies a pointer to the entry to compile.
+
+    Next - Supplies the index of the instruction to go to after the entry
+        matches.
+
+    Start - Supplies a pointer where the index of the first instruction of the
+        entry will be returned.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE if the automaton cannot be built.
+
+--*/
+
+{
+
+    INT Character;
+    PSTR Data;
+    PLIST_ENTRY CurrentEntry;
+    BOOL IgnoreCase;
+    LONG Index;
+    REGEX_OPCODE Opcode;
+    ULONG OptionStart;
+    PREGULAR_EXPRESSION_ENTRY Option;
+    PUCHAR Set;
+    ULONG SetIndex;
+
+    IgnoreCase = FALSE;
+    if ((Expression->Flags & REG_ICASE) != 0) {
+        IgnoreCase = TRUE;
+    }
+
+    switch (Entry->Type) {
+    case RegexEntryOrdinaryCharacters:
+        Data = Entry->U.String.Data;
+        for (Index = Entry->U.String.Size - 1; Index >= 0; Index -= 1) {
+            Set = ClpAddAutomatonCharacterSet(Automaton, &SetIndex);
+            if (Set == NULL) {
+                return FALSE;
+            }
+
+            for (Character = 1; Character < 256; Character += 1) {
+                if (((CHAR)Character == Data[Index]) ||
+                    ((IgnoreCase != FALSE) &&
+                     (tolower((CHAR)Character) == tolower(Data[Index])))) {
+
+                    REGEX_SET_ADD(Set, Character);
+                }
+            }
+
+            if (ClpAddAutomatonInstruction(Automaton,
+                                           RegexOpCharacterSet,
+                                           Next,
+                                           SetIndex,
+                                           &Next) == FALSE) {
+
+                return FALSE;
+            }
+        }
+
+        break;
+
+    case RegexEntryAnyCharacter:
+    case RegexEntryBracketExpression:
+        Set = ClpAddAutomatonCharacterSet(Automaton, &SetIndex);
+        if (Set == NULL) {
+            return FALSE;
+        }
+
+        for (Character = 1; Character < 256; Character += 1) {
+            if (Entry->Type == RegexEntryAnyCharacter) {
+                if ((Character != '\n') ||
+                    ((Expression->Flags & REG_NEWLINE) == 0)) {
+
+                    REGEX_SET_ADD(Set, Character);
+                }
+
+            } else if (ClpRegularExpressionMatchBracketCharacter(
+                                                  Expression,
+                                                  Entry,
+                                                  (CHAR)Character) != FALSE) {
+
+                REGEX_SET_ADD(Set, Character);
+            }
+        }
+
+        if (ClpAddAutomatonInstruction(Automaton,
+                                       RegexOpCharacterSet,
+                                       Next,
+                                       SetIndex,
+                                       &Next) == FALSE) {
+
+            return FALSE;
+        }
+
+        break;
+
+    case RegexEntrySubexpression:
+        if (ClpAddAutomatonInstruction(Automaton,
+                                       RegexOpSave,
+                                       Next,
+                                       (Entry->U.SubexpressionNumber * 2) + 1,
+                                       &Next) == FALSE) {
+
+            return FALSE;
+        }
+
+        if (ClpCompileAutomatonList(Automaton,
+                                    Expression,
+                                    &(Entry->ChildList),
+                                    Next,
+                                    &Next) == FALSE) {
+
+            return FALSE;
+        }
+
+        if (ClpAddAutomatonInstruction(Automaton,
+                                       RegexOpSave,
+                                       Next,
+                                       Entry->U.SubexpressionNumber * 2,
+                                       &Next) == FALSE) {
+
+            return FALSE;
+        }
+
+        break;
+
+    //
+    // A branch becomes a chain of splits, one for each option. The
+    // backtracking matcher only settles for an empty option once every other
+    // option has failed, so any empty options go last, as one option.
+    //
+
+    case RegexEntryBranch:
+        Index = 0;
+        CurrentEntry = Entry->ChildList.Next;
+        while (CurrentEntry != &(Entry->ChildList)) {
+            Option = LIST_VALUE(CurrentEntry,
+                                REGULAR_EXPRESSION_ENTRY,
+                                ListEntry);
+
+            CurrentEntry = CurrentEntry->Next;
+            if (LIST_EMPTY(&(Option->ChildList)) != FALSE) {
+                *Start = Next;
+                Index = 1;
+                break;
+            }
+        }
+
+        CurrentEntry = Entry->ChildList.Previous;
+        while (CurrentEntry != &(Entry->ChildList)) {
+            Option = LIST_VALUE(CurrentEntry,
+                                REGULAR_EXPRESSION_ENTRY,
+                                ListEntry);
+
+            CurrentEntry = CurrentEntry->Previous;
+
+            assert(Option->Type == RegexEntryBranchOption);
+
+            if (LIST_EMPTY(&(Option->ChildList)) != FALSE) {
+                continue;
+            }
+
+            if (ClpCompileAutomatonList(Automaton,
+                                        Expression,
+                                        &(Option->ChildList),
+                                        Next,
+                                        &OptionStart) == FALSE) {
+
+                return FALSE;
+            }
+
+            if (Index == 0) {
+                *Start = OptionStart;
+
+            } else if (ClpAddAutomatonInstruction(Automaton,
+                                                  RegexOpSplit,
+                                                  OptionStart,
+                                                  *Start,
+                                                  Start) == FALSE) {
+
+                return FALSE;
+            }
+
+            Index += 1;
+        }
+
+        if (Index == 0) {
+            *Start = Next;
+        }
+
+        return TRUE;
+
+    case RegexEntryStringBegin:
+        if (ClpAddAutomatonInstruction(Automaton,
+                                       RegexOpLineBegin,
+                                       Next,
+                                       0,
+                                       &Next) == FALSE) {
+
+            return FALSE;
+        }
+
+        break;
+
+    case RegexEntryStringEnd:
+        if (ClpAddAutomatonInstruction(Automaton,
+                                       RegexOpLineEnd,
+                                       Next,
+                                       0,
+                                       &Next) == FALSE) {
+
+            return FALSE;
+        }
+
+        break;
+
+    //
+    // Word boundaries need to look at both sides of the input, which the DFA
+    // cannot do, so a program containing them is only run by the Pike VM.
+    //
+
+    case RegexEntryStartOfWord:
+    case RegexEntryEndOfWord:
+        Opcode = RegexOpWordBegin;
+        if (Entry->Type == RegexEntryEndOfWord) {
+            Opcode = RegexOpWordEnd;
+        }
+
+        if (ClpAddAutomatonInstruction(Automaton,
+                                       Opcode,
+                                       Next,
+                                       0,
+                                       &Next) == FALSE) {
+
+            return FALSE;
+        }
+
+        Automaton->Flags |= REGEX_AUTOMATON_NO_DFA;
+        break;
+
+    //
+    // Back references need to remember what was matched, so they are not
+    // supported by the automaton.
+    //
+
+    case RegexEntryBackReference:
+    default:
+        return FALSE;
+    }
+
+    *Start = Next;
+    return TRUE;
+}
+
+BOOL
+ClpAddAutomatonInstruction (
+    PREGEX_AUTOMATON Automaton,
+    REGEX_OPCODE Opcode,
+    ULONG Next,
+    ULONG Alternate,
+    PULONG Index
+    )
+
+/*++
+
+Routine Description:
+
+    This routine appends an instruction to the automaton program.
+
+Arguments:
+
+    Automaton - Supplies a pointer to the automaton being built.
+
+    Opcode - Supplies the instruction type.
+
+    Next - Supplies the index of the next instruction.
+
+    Alternate - Supplies the alternate target or character set index.
+
+    Index - Supplies a pointer where the index of the new instruction will be
+        returned.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on allocation failure or if the program is too large.
+
+--*/
+
+{
+
+    ULONG NewCapacity;
+    PREGEX_INSTRUCTION NewProgram;
+
+    if (Automaton->ProgramSize >= Automaton->ProgramCapacity) {
+        NewCapacity = Automaton->ProgramCapacity * 2;
+        if (NewCapacity == 0) {
+            NewCapacity = REGEX_AUTOMATON_INITIAL_CAPACITY;
+        }
+
+        if (NewCapacity > REGEX_AUTOMATON_MAX_INSTRUCTIONS) {
+            NewCapacity = REGEX_AUTOMATON_MAX_INSTRUCTIONS;
+            if (Automaton->ProgramSize >= NewCapacity) {
+                return FALSE;
+            }
+        }
+
+        NewProgram = realloc(Automaton->Program,
+                             NewCapacity * sizeof(REGEX_INSTRUCTION));
+
+        if (NewProgram == NULL) {
+            return FALSE;
+        }
+
+        Automaton->Program = NewProgram;
+        Automaton->ProgramCapacity = NewCapacity;
+    }
+
+    *Index = Automaton->ProgramSize;
+    Automaton->Program[*Index].Opcode = Opcode;
+    Automaton->Program[*Index].Next = Next;
+    Automaton->Program[*Index].Alternate = Alternate;
+    Automaton->ProgramSize += 1;
+    return TRUE;
+}
+
+PUCHAR
+ClpAddAutomatonCharacterSet (
+    PREGEX_AUTOMATON Automaton,
+    PULONG Index
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a new empty character set bitmap in the automaton.
+
+Arguments:
+
+    Automaton - Supplies a pointer to the automaton being built.
+
+    Index - Supplies a pointer where the index of the new set will be
+        returned.
+
+Return Value:
+
+    Returns a pointer to the zeroed set bitmap on success. This pointer is
+    only valid until the next set is added.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    ULONG NewCapacity;
+    PUCHAR NewSets;
+    PUCHAR Set;
+
+    if (Automaton->SetCount >= Automaton->SetCapacity) {
+        NewCapacity = Automaton->SetCapacity * 2;
+        if (NewCapacity == 0) {
+            NewCapacity = REGEX_AUTOMATON_INITIAL_CAPACITY;
+        }
+
+        NewSets = realloc(Automaton->Sets,
+                          NewCapacity * REGEX_CHARACTER_SET_SIZE);
+
+        if (NewSets == NULL) {
+            return NULL;
+        }
+
+        Automaton->Sets = NewSets;
+        Automaton->SetCapacity = NewCapacity;
+    }
+
+    *Index = Automaton->SetCount;
+    Set = Automaton->Sets + (*Index * REGEX_CHARACTER_SET_SIZE);
+    memset(Set, 0, REGEX_CHARACTER_SET_SIZE);
+    Automaton->SetCount += 1;
+    return Set;
+}
+
+VOID
+ClpComputeAutomatonByteClasses (
+    PREGEX_AUTOMATON Automaton,
+    PREGULAR_EXPRESSION Expression
+    )
+
+/*++
+
+Routine Description:
+
+    This routine splits the 256 byte values into classes, where every byte
+    in a class is treated identically by every instruction. States then only
+    need one transition per class rather than one per byte.
+
+Arguments:
+
+    Automaton - Supplies a pointer to the automaton.
+
+    Expression - Supplies a pointer to the regular expression.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    INT Character;
+    ULONG ClassCount;
+    BOOL Member;
+    UCHAR NewlineSet[REGEX_CHARACTER_SET_SIZE];
+    USHORT Remap[256 * 2];
+    PUCHAR Set;
+    ULONG SetIndex;
+    ULONG Slot;
+
+    //
+    // Newlines affect line anchors when the newline flag is set, so they
+    // get a class of their own.
+    //
+
+    memset(NewlineSet, 0, sizeof(NewlineSet));
+    if ((Expression->Flags & REG_NEWLINE) != 0) {
+        REGEX_SET_ADD(NewlineSet, '\n');
+    }
+
+    //
+    // Start with everything in one class, and refine the classes by each
+    // set in turn.
+    //
+
+    memset(Automaton->ByteClass, 0, sizeof(Automaton->ByteClass));
+    ClassCount = 1;
+    for (SetIndex = 0; SetIndex <= Automaton->SetCount; SetIndex += 1) {
+        if (SetIndex == Automaton->SetCount) {
+            Set = NewlineSet;
+
+        } else {
+            Set = Automaton->Sets + (SetIndex * REGEX_CHARACTER_SET_SIZE);
+        }
+
+        memset(Remap, 0xFF, ClassCount * 2 * sizeof(USHORT));
+        ClassCount = 0;
+        for (Character = 0; Character < 256; Character += 1) {
+            Member = REGEX_SET_CONTAINS(Set, Character);
+            Slot = (Automaton->ByteClass[Character] * 2) + Member;
+            if (Remap[Slot] == MAX_USHORT) {
+                Remap[Slot] = ClassCount;
+                ClassCount += 1;
+            }
+
+            Automaton->ByteClass[Character] = Remap[Slot];
+        }
+    }
+
+    Automaton->ClassCount = ClassCount;
+    for (Character = 255; Character >= 0; Character -= 1) {
+        Automaton->ClassCharacter[Automaton->ByteClass[Character]] = Character;
+    }
+
+    return;
+}
+
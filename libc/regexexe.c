@@ -53,6 +53,14 @@ Module Name:
 
 #define REGEX_INTERNAL_MATCH_COUNT 11
 
+//
+// Define the maximum number of bytes of automaton states to keep cached. If
+// the cache grows beyond this, all states are thrown away and rebuilt as
+// needed.
+//
+
+#define REGEX_DFA_CACHE_LIMIT (1024 * 1024)
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -170,6 +178,90 @@ typedef struct _REGULAR_EXPRESSION_EXECUTION {
     regmatch_t InternalMatch[REGEX_INTERNAL_MATCH_COUNT];
 } REGULAR_EXPRESSION_EXECUTION, *PREGULAR_EXPRESSION_EXECUTION;
 
+/*++
+
+Structure Description:
+
+    This structure defines an entry on the stack used by the Pike VM when
+    following the instructions that do not consume input.
+
+Members:
+
+    Instruction - Stores the index of the instruction to follow, or
+        MAX_ULONG if this entry restores a match slot instead.
+
+    Slot - Stores the index of the match slot to restore.
+
+    Value - Stores the value to restore the slot to.
+
+--*/
+
+typedef struct _REGEX_PIKE_STACK_ENTRY {
+    ULONG Instruction;
+    ULONG Slot;
+    regoff_t Value;
+} REGEX_PIKE_STACK_ENTRY, *PREGEX_PIKE_STACK_ENTRY;
+
+/*++
+
+Structure Description:
+
+    This structure defines a list of Pike VM threads, in priority order.
+
+Members:
+
+    Count - Stores the number of threads in the list.
+
+    Instruction - Stores the array of instructions each thread is waiting on.
+
+    Slots - Stores the match slots of each thread, one group of slots per
+        thread.
+
+--*/
+
+typedef struct _REGEX_PIKE_THREAD_LIST {
+    ULONG Count;
+    PULONG Instruction;
+    regoff_t *Slots;
+} REGEX_PIKE_THREAD_LIST, *PREGEX_PIKE_THREAD_LIST;
+
+/*++
+
+Structure Description:
+
+    This structure defines the state of one Pike VM execution. All of it is
+    private to the execution, so the compiled expression is never modified.
+
+Members:
+
+    Expression - Stores a pointer to the regular expression being run.
+
+    Input - Stores a pointer to the input string.
+
+    Flags - Stores the execution flags (REG_NOTBOL and REG_NOTEOL).
+
+    SlotCount - Stores the number of match slots tracked per thread.
+
+    Mark - Stores the generation at which each instruction was last added to
+        a thread list.
+
+    Stack - Stores the stack used to follow instructions that do not consume
+        input.
+
+    Slots - Stores the working match slots while following instructions.
+
+--*/
+
+typedef struct _REGEX_PIKE_EXECUTION {
+    PREGULAR_EXPRESSION Expression;
+    PUCHAR Input;
+    int Flags;
+    ULONG SlotCount;
+    PULONG Mark;
+    PREGEX_PIKE_STACK_ENTRY Stack;
+    regoff_t *Slots;
+} REGEX_PIKE_EXECUTION, *PREGEX_PIKE_EXECUTION;
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
@@ -229,6 +321,80 @@ ClpRegularExpressionDestroyChoice (
     PREGULAR_EXPRESSION_CHOICE Choice
     );
 
+BOOL
+ClpSearchRequiredLiteral (
+    PREGULAR_EXPRESSION RegularExpression,
+    PSTR String,
+    size_t Length
+    );
+
+REGULAR_EXPRESSION_STATUS
+ClpExecuteRegularExpressionAutomaton (
+    PREGULAR_EXPRESSION RegularExpression,
+    PSTR String,
+    int Flags
+    );
+
+REGULAR_EXPRESSION_STATUS
+ClpExecuteRegularExpressionPikeVm (
+    PREGULAR_EXPRESSION RegularExpression,
+    PSTR String,
+    regmatch_t Match[],
+    size_t MatchArraySize,
+    int Flags
+    );
+
+VOID
+ClpAddPikeThread (
+    PREGEX_PIKE_EXECUTION Context,
+    PREGEX_PIKE_THREAD_LIST List,
+    ULONG Instruction,
+    ULONG Position,
+    regoff_t *Slots
+    );
+
+PREGEX_DFA_STATE
+ClpComputeAutomatonTransition (
+    PREGULAR_EXPRESSION RegularExpression,
+    PREGEX_DFA_STATE State,
+    UCHAR Character
+    );
+
+BOOL
+ClpAutomatonMatchesAtEnd (
+    PREGEX_AUTOMATON Automaton,
+    PREGEX_DFA_STATE State,
+    int Flags
+    );
+
+ULONG
+ClpComputeAutomatonClosure (
+    PREGEX_AUTOMATON Automaton,
+    PULONG Seeds,
+    ULONG SeedCount,
+    ULONG Flags,
+    PULONG Output
+    );
+
+PREGEX_DFA_STATE
+ClpGetAutomatonState (
+    PREGEX_AUTOMATON Automaton,
+    PULONG Seeds,
+    ULONG SeedCount,
+    ULONG Flags
+    );
+
+VOID
+ClpFlushAutomatonStates (
+    PREGEX_AUTOMATON Automaton
+    );
+
+int
+ClpCompareAutomatonInstructions (
+    const void *LeftPointer,
+    const void *RightPointer
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -339,6 +505,7 @@ Return Value:
 
 {
 
+    PREGEX_AUTOMATON Automaton;
     REGULAR_EXPRESSION_EXECUTION Context;
     PLIST_ENTRY FreeEntry;
     size_t MatchIndex;
@@ -361,6 +528,60 @@ Return Value:
         }
     }
 
+    //
+    // Every match has to contain the required literal, so if it's not there
+    // then skip all the real work.
+    //
+
+    if ((RegularExpression->RequiredLiteral.Size != 0) &&
+        (ClpSearchRequiredLiteral(RegularExpression,
+                                  String,
+                                  Context.InputSize - 1) == FALSE)) {
+
+        return RegexStatusNoMatch;
+    }
+
+    //
+    // If the expression has an automaton, use its DFA to find out quickly
+    // whether there is a match at all. The DFA state cache is shared, so skip
+    // this if another thread is using it right now. If the caller wants to
+    // know where the match is, run the Pike VM to find it. The backtracking
+    // matcher is only used for back references, or if memory runs out.
+    //
+
+    Automaton = RegularExpression->Automaton;
+    if (Automaton != NULL) {
+        if (((Automaton->Flags & REGEX_AUTOMATON_NO_DFA) == 0) &&
+            (__sync_bool_compare_and_swap(&(Automaton->Lock), 0, 1))) {
+
+            Status = ClpExecuteRegularExpressionAutomaton(RegularExpression,
+                                                          String,
+                                                          Flags);
+
+            __sync_lock_release(&(Automaton->Lock));
+            if (Status == RegexStatusNoMatch) {
+                return Status;
+            }
+
+            if ((Status == RegexStatusSuccess) &&
+                (((RegularExpression->Flags & REG_NOSUB) != 0) ||
+                 (MatchArraySize == 0))) {
+
+                return Status;
+            }
+        }
+
+        Status = ClpExecuteRegularExpressionPikeVm(RegularExpression,
+                                                   String,
+                                                   Match,
+                                                   MatchArraySize,
+                                                   Flags);
+
+        if (Status != RegexStatusNoMemory) {
+            return Status;
+        }
+    }
+
     for (MatchIndex = 0;
          MatchIndex < REGEX_INTERNAL_MATCH_COUNT;
          MatchIndex += 1) {
@@ -1426,14 +1647,8 @@ Return Value:
 
 {
 
-    PREGULAR_BRACKET_ENTRY BracketEntry;
-    PREGULAR_BRACKET_EXPRESSION BracketExpression;
     CHAR Character;
-    ULONG CharacterCount;
-    ULONG CharacterIndex;
-    PLIST_ENTRY CurrentEntry;
-    PSTR RegularCharacters;
-    REGULAR_EXPRESSION_STATUS Status;
+    BOOL Match;
 
     assert(Entry->Type == RegexEntryBracketExpression);
 
@@ -1446,7 +1661,62 @@ Return Value:
         return RegexStatusNoMatch;
     }
 
-    Status = RegexStatusNoMatch;
+    Match = ClpRegularExpressionMatchBracketCharacter(Context->Expression,
+                                                      Entry,
+                                                      Character);
+
+    if (Match == FALSE) {
+        return RegexStatusNoMatch;
+    }
+
+    Context->NextInput += 1;
+    return RegexStatusSuccess;
+}
+
+BOOL
+ClpRegularExpressionMatchBracketCharacter (
+    PREGULAR_EXPRESSION Expression,
+    PREGULAR_EXPRESSION_ENTRY Entry,
+    CHAR Character
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines if the given character matches a bracket
+    expression.
+
+Arguments:
+
+    Expression - Supplies a pointer to the regular expression.
+
+    Entry - Supplies a pointer to the bracket expression entry.
+
+    Character - Supplies the character to test.
+
+Return Value:
+
+    TRUE if the character matches the bracket expression (taking negation into
+    account).
+
+    FALSE if the character does not match.
+
+--*/
+
+{
+
+    PREGULAR_BRACKET_ENTRY BracketEntry;
+    PREGULAR_BRACKET_EXPRESSION BracketExpression;
+    ULONG CharacterCount;
+    ULONG CharacterIndex;
+    PLIST_ENTRY CurrentEntry;
+    BOOL Match;
+    PSTR RegularCharacters;
+
+    assert(Entry->Type == RegexEntryBracketExpression);
+
+    Match = FALSE;
     BracketExpression = &(Entry->U.BracketExpression);
     CharacterCount = BracketExpression->RegularCharacters.Size;
     RegularCharacters = BracketExpression->RegularCharacters.Data;
@@ -1460,12 +1730,12 @@ Return Value:
          CharacterIndex += 1) {
 
         if ((Character == RegularCharacters[CharacterIndex]) ||
-            (((Context->Expression->Flags & REG_ICASE) != 0) &&
+            (((Expression->Flags & REG_ICASE) != 0) &&
               (tolower(Character) ==
                tolower(RegularCharacters[CharacterIndex])))) {
 
-            Status = RegexStatusSuccess;
-            goto RegularExpressionMatchBracketExpressionEnd;
+            Match = TRUE;
+            goto RegularExpressionMatchBracketCharacterEnd;
         }
     }
 
@@ -1485,104 +1755,104 @@ Return Value:
             if ((Character >= BracketEntry->U.Range.Minimum) &&
                 (Character <= BracketEntry->U.Range.Maximum)) {
 
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassAlphanumeric:
             if (isalnum(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassAlphabetic:
             if (isalpha(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassBlank:
             if (isblank(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassControl:
             if (iscntrl(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassDigit:
             if (isdigit(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassGraph:
             if (isgraph(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassLowercase:
             if ((islower(Character)) ||
-                (((Context->Expression->Flags & REG_ICASE) != 0) &&
+                (((Expression->Flags & REG_ICASE) != 0) &&
                  (isupper(Character)))) {
 
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassPrintable:
             if (isprint(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassPunctuation:
             if (ispunct(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassSpace:
             if (isspace(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassUppercase:
             if ((isupper(Character)) ||
-                (((Context->Expression->Flags & REG_ICASE) != 0) &&
+                (((Expression->Flags & REG_ICASE) != 0) &&
                  (islower(Character)))) {
 
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassHexDigit:
             if (isxdigit(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
 
         case BracketExpressionCharacterClassName:
             if (REGULAR_EXPRESSION_IS_NAME(Character)) {
-                Status = RegexStatusSuccess;
+                Match = TRUE;
             }
 
             break;
@@ -1591,29 +1861,20 @@ Return Value:
 
             assert(FALSE);
 
-            goto RegularExpressionMatchBracketExpressionEnd;
+            goto RegularExpressionMatchBracketCharacterEnd;
         }
 
-        if (Status == RegexStatusSuccess) {
+        if (Match != FALSE) {
             break;
         }
     }
 
-RegularExpressionMatchBracketExpressionEnd:
+RegularExpressionMatchBracketCharacterEnd:
     if ((Entry->Flags & REGULAR_EXPRESSION_NEGATED) != 0) {
-        if (Status == RegexStatusNoMatch) {
-            Status = RegexStatusSuccess;
-
-        } else if (Status == RegexStatusSuccess) {
-            Status = RegexStatusNoMatch;
-        }
-    }
-
-    if (Status == RegexStatusSuccess) {
-        Context->NextInput += 1;
+        Match = !Match;
     }
 
-    return Status;
+    return Match;
 }
 
 PREGULAR_EXPRESSION_CHOICE
@@ -1814,3 +2075,1090 @@ Return Value:
     return;
 }
 
+BOOL
+ClpSearchRequiredLiteral (
+    PREGULAR_EXPRESSION RegularExpression,
+    PSTR String,
+    size_t Length
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether the required literal of a regular
+    expression appears in the given string.
+
+Arguments:
+
+    RegularExpression - Supplies a pointer to the compiled regular expression.
+
+    String - Supplies a pointer to the string to search.
+
+    Length - Supplies the length of the string in bytes, not including the
+        null terminator.
+
+Return Value:
+
+    TRUE if the literal was found, meaning the expression might match.
+
+    FALSE if the literal is not in the string, meaning the expression cannot
+    match.
+
+--*/
+
+{
+
+    PSTR Candidate;
+    PSTR End;
+    CHAR First;
+    CHAR FirstUppercase;
+    size_t Index;
+    PSTR Literal;
+    size_t LiteralSize;
+
+    Literal = RegularExpression->RequiredLiteral.Data;
+    LiteralSize = RegularExpression->RequiredLiteral.Size;
+    if (Length < LiteralSize) {
+        return FALSE;
+    }
+
+    End = String + Length - LiteralSize + 1;
+
+    //
+    // For case sensitive expressions, let memchr race to each occurrence of
+    // the first character, then check the rest.
+    //
+
+    if ((RegularExpression->Flags & REG_ICASE) == 0) {
+        while (String < End) {
+            Candidate = memchr(String, Literal[0], End - String);
+            if (Candidate == NULL) {
+                break;
+            }
+
+            if (memcmp(Candidate + 1, Literal + 1, LiteralSize - 1) == 0) {
+                return TRUE;
+            }
+
+            String = Candidate + 1;
+        }
+
+        return FALSE;
+    }
+
+    //
+    // The literal was saved in lowercase, so compare against the lowercase
+    // form of the input.
+    //
+
+    First = Literal[0];
+    FirstUppercase = toupper(First);
+    while (String < End) {
+        if ((*String == First) || (*String == FirstUppercase)) {
+            for (Index = 1; Index < LiteralSize; Index += 1) {
+                if (tolower(String[Index]) != Literal[Index]) {
+                    break;
+                }
+            }
+
+            if (Index == LiteralSize) {
+                return TRUE;
+            }
+        }
+
+        String += 1;
+    }
+
+    return FALSE;
+}
+
+REGULAR_EXPRESSION_STATUS
+ClpExecuteRegularExpressionAutomaton (
+    PREGULAR_EXPRESSION RegularExpression,
+    PSTR String,
+    int Flags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether a regular expression matches anywhere in
+    the given string by running its automaton as a lazily built DFA. This
+    takes time linear in the length of the input.
+
+Arguments:
+
+    RegularExpression - Supplies a pointer to the compiled regular expression,
+        which must have an automaton.
+
+    String - Supplies a pointer to the string to check for a match.
+
+    Flags - Supplies a bitfield of flags governing the search. See some REG_*
+        definitions (specifically REG_NOTBOL and REG_NOTEOL).
+
+Return Value:
+
+    Success if there was a match.
+
+    No match if there was no match.
+
+    No memory if a state could not be allocated.
+
+--*/
+
+{
+
+    PREGEX_AUTOMATON Automaton;
+    PUCHAR Input;
+    PREGEX_DFA_STATE NextState;
+    ULONG SeedFlags;
+    ULONG StartIndex;
+    PREGEX_DFA_STATE State;
+
+    Automaton = RegularExpression->Automaton;
+    StartIndex = 0;
+    SeedFlags = REGEX_DFA_STATE_LINE_BEGIN;
+    if ((Flags & REG_NOTBOL) != 0) {
+        StartIndex = 1;
+        SeedFlags = 0;
+    }
+
+    State = Automaton->StartState[StartIndex];
+    if (State == NULL) {
+        State = ClpGetAutomatonState(Automaton,
+                                     &(Automaton->Start),
+                                     1,
+                                     SeedFlags);
+
+        if (State == NULL) {
+            return RegexStatusNoMemory;
+        }
+
+        Automaton->StartState[StartIndex] = State;
+    }
+
+    //
+    // Run the input through the automaton, building states as needed. Stop
+    // as soon as a match has been seen or no match is possible.
+    //
+
+    Input = (PUCHAR)String;
+    while (*Input != '\0') {
+        if ((State->Flags &
+             (REGEX_DFA_STATE_MATCHED | REGEX_DFA_STATE_DEAD)) != 0) {
+
+            break;
+        }
+
+        NextState = State->Transition[Automaton->ByteClass[*Input]];
+        if (NextState == NULL) {
+            NextState = ClpComputeAutomatonTransition(RegularExpression,
+                                                      State,
+                                                      *Input);
+
+            if (NextState == NULL) {
+                return RegexStatusNoMemory;
+            }
+        }
+
+        State = NextState;
+        Input += 1;
+    }
+
+    if ((State->Flags & REGEX_DFA_STATE_MATCHED) != 0) {
+        return RegexStatusSuccess;
+    }
+
+    if ((State->Flags & REGEX_DFA_STATE_DEAD) != 0) {
+        return RegexStatusNoMatch;
+    }
+
+    //
+    // Check for a match that ends at the end of the input.
+    //
+
+    if (ClpAutomatonMatchesAtEnd(Automaton, State, Flags) != FALSE) {
+        return RegexStatusSuccess;
+    }
+
+    return RegexStatusNoMatch;
+}
+
+REGULAR_EXPRESSION_STATUS
+ClpExecuteRegularExpressionPikeVm (
+    PREGULAR_EXPRESSION RegularExpression,
+    PSTR String,
+    regmatch_t Match[],
+    size_t MatchArraySize,
+    int Flags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine runs a regular expression's automaton program as a Pike VM,
+    which steps every possible thread through the input in lockstep and
+    tracks the match slots of each. Threads are kept in priority order, with
+    earlier alternatives and longer repeats first, so the match found is the
+    same one the backtracking matcher would find. This takes time linear in
+    the length of the input times the size of the program.
+
+Arguments:
+
+    RegularExpression - Supplies a pointer to the compiled regular expression,
+        which must have an automaton.
+
+    String - Supplies a pointer to the string to check for a match.
+
+    Match - Supplies an optional pointer to an array where the string indices of
+        the match and its subexpressions will be returned. Elements are only
+        written on success, and the caller must have initialized them to -1.
+
+    MatchArraySize - Supplies the number of elements in the match array.
+
+    Flags - Supplies a bitfield of flags governing the search. See some REG_*
+        definitions (specifically REG_NOTBOL and REG_NOTEOL).
+
+Return Value:
+
+    Success if there was a match.
+
+    No match if there was no match.
+
+    No memory if the scratch space could not be allocated.
+
+--*/
+
+{
+
+    size_t AllocationSize;
+    PVOID Allocation;
+    PREGEX_AUTOMATON Automaton;
+    regoff_t *BestSlots;
+    UCHAR Character;
+    REGEX_PIKE_EXECUTION Context;
+    PREGEX_PIKE_THREAD_LIST Current;
+    PREGEX_INSTRUCTION Instruction;
+    REGEX_PIKE_THREAD_LIST Lists[2];
+    size_t MatchCount;
+    size_t MatchIndex;
+    BOOL Matched;
+    PREGEX_PIKE_THREAD_LIST Next;
+    ULONG Position;
+    ULONG ProgramSize;
+    PUCHAR Set;
+    PREGEX_PIKE_THREAD_LIST Swap;
+    ULONG ThreadIndex;
+    regoff_t *ThreadSlots;
+
+    Automaton = RegularExpression->Automaton;
+    ProgramSize = Automaton->ProgramSize;
+    MatchCount = 0;
+    if ((RegularExpression->Flags & REG_NOSUB) == 0) {
+        MatchCount = RegularExpression->SubexpressionCount + 1;
+        if (MatchCount > MatchArraySize) {
+            MatchCount = MatchArraySize;
+        }
+    }
+
+    Context.Expression = RegularExpression;
+    Context.Input = (PUCHAR)String;
+    Context.Flags = Flags;
+    Context.SlotCount = MatchCount * 2;
+
+    //
+    // Each instruction is followed at most once per position, and pushes at
+    // most two stack entries when it is. Carve everything out of a single
+    // allocation.
+    //
+
+    AllocationSize = (((ProgramSize * 2) + 1) *
+                      sizeof(REGEX_PIKE_STACK_ENTRY)) +
+                     (ProgramSize * sizeof(ULONG) * 3) +
+                     (((ProgramSize * 2) + 2) * Context.SlotCount *
+                      sizeof(regoff_t));
+
+    Allocation = malloc(AllocationSize);
+    if (Allocation == NULL) {
+        return RegexStatusNoMemory;
+    }
+
+    Context.Stack = Allocation;
+    Context.Mark = (PULONG)(Context.Stack + (ProgramSize * 2) + 1);
+    Lists[0].Instruction = Context.Mark + ProgramSize;
+    Lists[1].Instruction = Lists[0].Instruction + ProgramSize;
+    Lists[0].Slots = (regoff_t *)(Lists[1].Instruction + ProgramSize);
+    Lists[1].Slots = Lists[0].Slots + (ProgramSize * Context.SlotCount);
+    Context.Slots = Lists[1].Slots + (ProgramSize * Context.SlotCount);
+    BestSlots = Context.Slots + Context.SlotCount;
+    memset(Context.Mark, 0, ProgramSize * sizeof(ULONG));
+    for (MatchIndex = 0; MatchIndex < Context.SlotCount; MatchIndex += 1) {
+        BestSlots[MatchIndex] = -1;
+    }
+
+    Current = &(Lists[0]);
+    Next = &(Lists[1]);
+    Current->Count = 0;
+    ClpAddPikeThread(&Context, Current, Automaton->Start, 0, BestSlots);
+    Matched = FALSE;
+    Position = 0;
+    while (TRUE) {
+        Character = Context.Input[Position];
+        Next->Count = 0;
+        for (ThreadIndex = 0; ThreadIndex < Current->Count; ThreadIndex += 1) {
+            Instruction = &(Automaton->Program[
+                                       Current->Instruction[ThreadIndex]]);
+
+            ThreadSlots = Current->Slots + (ThreadIndex * Context.SlotCount);
+
+            //
+            // A thread reaching the end is the best match so far. The threads
+            // after it have lower priority, so drop them.
+            //
+
+            if (Instruction->Opcode == RegexOpMatch) {
+                Matched = TRUE;
+                memcpy(BestSlots,
+                       ThreadSlots,
+                       Context.SlotCount * sizeof(regoff_t));
+
+                break;
+            }
+
+            assert(Instruction->Opcode == RegexOpCharacterSet);
+
+            if (Character == '\0') {
+                continue;
+            }
+
+            Set = Automaton->Sets +
+                  (Instruction->Alternate * REGEX_CHARACTER_SET_SIZE);
+
+            if ((Set[Character >> 3] & (1 << (Character & 0x7))) != 0) {
+                ClpAddPikeThread(&Context,
+                                 Next,
+                                 Instruction->Next,
+                                 Position + 1,
+                                 ThreadSlots);
+            }
+        }
+
+        if ((Character == '\0') || (Next->Count == 0)) {
+            break;
+        }
+
+        Swap = Current;
+        Current = Next;
+        Next = Swap;
+        Position += 1;
+    }
+
+    if (Matched != FALSE) {
+        for (MatchIndex = 0; MatchIndex < MatchCount; MatchIndex += 1) {
+            if ((BestSlots[MatchIndex * 2] != -1) &&
+                (BestSlots[(MatchIndex * 2) + 1] != -1)) {
+
+                Match[MatchIndex].rm_so = BestSlots[MatchIndex * 2];
+                Match[MatchIndex].rm_eo = BestSlots[(MatchIndex * 2) + 1];
+            }
+        }
+    }
+
+    free(Allocation);
+    if (Matched != FALSE) {
+        return RegexStatusSuccess;
+    }
+
+    return RegexStatusNoMatch;
+}
+
+VOID
+ClpAddPikeThread (
+    PREGEX_PIKE_EXECUTION Context,
+    PREGEX_PIKE_THREAD_LIST List,
+    ULONG Instruction,
+    ULONG Position,
+    regoff_t *Slots
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds a Pike VM thread to a list, following every instruction
+    that does not consume input. Threads are added in priority order, and an
+    instruction already added at this position by a higher priority thread
+    is not added again.
+
+Arguments:
+
+    Context - Supplies a pointer to the Pike VM execution context.
+
+    List - Supplies a pointer to the list to add threads to.
+
+    Instruction - Supplies the index of the instruction the thread starts at.
+
+    Position - Supplies the input position the thread is at.
+
+    Slots - Supplies the match slots of the thread.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PREGEX_AUTOMATON Automaton;
+    BOOL Follow;
+    ULONG Depth;
+    ULONG Generation;
+    PREGEX_INSTRUCTION Entry;
+    ULONG Index;
+    PUCHAR Input;
+    PREGEX_PIKE_STACK_ENTRY Stack;
+    ULONG Slot;
+    ULONG ThreadIndex;
+
+    Automaton = Context->Expression->Automaton;
+    Generation = Position + 1;
+    Input = Context->Input;
+    Stack = Context->Stack;
+    memcpy(Context->Slots, Slots, Context->SlotCount * sizeof(regoff_t));
+    Stack[0].Instruction = Instruction;
+    Depth = 1;
+    while (Depth != 0) {
+        Depth -= 1;
+        Index = Stack[Depth].Instruction;
+        if (Index == MAX_ULONG) {
+            Context->Slots[Stack[Depth].Slot] = Stack[Depth].Value;
+            continue;
+        }
+
+        if (Context->Mark[Index] == Generation) {
+            continue;
+        }
+
+        Context->Mark[Index] = Generation;
+        Entry = &(Automaton->Program[Index]);
+        Follow = FALSE;
+        switch (Entry->Opcode) {
+
+        //
+        // Push the alternate first so that the preferred target and
+        // everything it leads to is added before it.
+        //
+
+        case RegexOpSplit:
+            Stack[Depth].Instruction = Entry->Alternate;
+            Depth += 1;
+            Follow = TRUE;
+            break;
+
+        //
+        // Record the position in the slot, and arrange for the old value to
+        // come back once everything after the save has been added.
+        //
+
+        case RegexOpSave:
+            Slot = Entry->Alternate;
+            if (Slot < Context->SlotCount) {
+                Stack[Depth].Instruction = MAX_ULONG;
+                Stack[Depth].Slot = Slot;
+                Stack[Depth].Value = Context->Slots[Slot];
+                Depth += 1;
+                Context->Slots[Slot] = Position;
+            }
+
+            Follow = TRUE;
+            break;
+
+        case RegexOpLineBegin:
+            if ((((Context->Flags & REG_NOTBOL) == 0) && (Position == 0)) ||
+                (((Context->Expression->Flags & REG_NEWLINE) != 0) &&
+                 (Position != 0) && (Input[Position - 1] == '\n'))) {
+
+                Follow = TRUE;
+            }
+
+            break;
+
+        case RegexOpLineEnd:
+            if ((((Context->Flags & REG_NOTEOL) == 0) &&
+                 (Input[Position] == '\0')) ||
+                (((Context->Expression->Flags & REG_NEWLINE) != 0) &&
+                 (Input[Position] == '\n'))) {
+
+                Follow = TRUE;
+            }
+
+            break;
+
+        case RegexOpWordBegin:
+            if ((REGULAR_EXPRESSION_IS_NAME(Input[Position])) &&
+                ((Position == 0) ||
+                 (!REGULAR_EXPRESSION_IS_NAME(Input[Position - 1])))) {
+
+                Follow = TRUE;
+            }
+
+            break;
+
+        case RegexOpWordEnd:
+            if ((Position != 0) &&
+                (REGULAR_EXPRESSION_IS_NAME(Input[Position - 1])) &&
+                (!REGULAR_EXPRESSION_IS_NAME(Input[Position]))) {
+
+                Follow = TRUE;
+            }
+
+            break;
+
+        case RegexOpCharacterSet:
+        case RegexOpMatch:
+            ThreadIndex = List->Count;
+            List->Instruction[ThreadIndex] = Index;
+            memcpy(List->Slots + (ThreadIndex * Context->SlotCount),
+                   Context->Slots,
+                   Context->SlotCount * sizeof(regoff_t));
+
+            List->Count += 1;
+            break;
+
+        default:
+
+            assert(FALSE);
+
+            break;
+        }
+
+        if (Follow != FALSE) {
+            Stack[Depth].Instruction = Entry->Next;
+            Depth += 1;
+        }
+    }
+
+    return;
+}
+
+PREGEX_DFA_STATE
+ClpComputeAutomatonTransition (
+    PREGULAR_EXPRESSION RegularExpression,
+    PREGEX_DFA_STATE State,
+    UCHAR Character
+    )
+
+/*++
+
+Routine Description:
+
+    This routine computes the state an automaton moves to from the given
+    state on the given character, and caches it in the state's transition
+    table.
+
+Arguments:
+
+    RegularExpression - Supplies a pointer to the compiled regular expression.
+
+    State - Supplies a pointer to the current state. This state may be
+        destroyed if the state cache is flushed.
+
+    Character - Supplies the next input character.
+
+Return Value:
+
+    Returns a pointer to the next state on success.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    PREGEX_AUTOMATON Automaton;
+    ULONG Class;
+    ULONG Count;
+    ULONG Flags;
+    ULONG FlushCount;
+    ULONG Index;
+    PREGEX_INSTRUCTION Instruction;
+    PULONG List;
+    BOOL LineBoundary;
+    PREGEX_DFA_STATE NextState;
+    PUCHAR Set;
+    ULONG SeedCount;
+    PULONG Seeds;
+
+    Automaton = RegularExpression->Automaton;
+    Class = Automaton->ByteClass[Character];
+
+    //
+    // A newline ends the line if the newline flag is set, so any line end
+    // assertions waiting in the state can now be followed.
+    //
+
+    LineBoundary = FALSE;
+    if ((Character == '\n') &&
+        ((RegularExpression->Flags & REG_NEWLINE) != 0)) {
+
+        LineBoundary = TRUE;
+    }
+
+    List = State->Instructions;
+    Count = State->InstructionCount;
+    if (LineBoundary != FALSE) {
+        Flags = (State->Flags & REGEX_DFA_STATE_LINE_BEGIN) |
+                REGEX_DFA_STATE_LINE_END;
+
+        Count = ClpComputeAutomatonClosure(Automaton,
+                                           List,
+                                           Count,
+                                           Flags,
+                                           Automaton->List[0]);
+
+        List = Automaton->List[0];
+    }
+
+    //
+    // Note whether the expression matched before this character, and step
+    // every character set containing this character.
+    //
+
+    Flags = 0;
+    Seeds = Automaton->List[1];
+    SeedCount = 0;
+    for (Index = 0; Index < Count; Index += 1) {
+        Instruction = &(Automaton->Program[List[Index]]);
+        if (Instruction->Opcode == RegexOpMatch) {
+            Flags |= REGEX_DFA_STATE_MATCHED;
+
+        } else if (Instruction->Opcode == RegexOpCharacterSet) {
+            Set = Automaton->Sets +
+                  (Instruction->Alternate * REGEX_CHARACTER_SET_SIZE);
+
+            if ((Set[Character >> 3] & (1 << (Character & 0x7))) != 0) {
+                Seeds[SeedCount] = Instruction->Next;
+                SeedCount += 1;
+            }
+        }
+    }
+
+    if (LineBoundary != FALSE) {
+        Flags |= REGEX_DFA_STATE_LINE_BEGIN;
+    }
+
+    //
+    // Getting the next state may flush the cache, destroying the current
+    // state. Only save the transition if the current state survived.
+    //
+
+    FlushCount = Automaton->FlushCount;
+    NextState = ClpGetAutomatonState(Automaton, Seeds, SeedCount, Flags);
+    if ((NextState != NULL) && (Automaton->FlushCount == FlushCount)) {
+        State->Transition[Class] = NextState;
+    }
+
+    return NextState;
+}
+
+BOOL
+ClpAutomatonMatchesAtEnd (
+    PREGEX_AUTOMATON Automaton,
+    PREGEX_DFA_STATE State,
+    int Flags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether the given automaton state matches at the
+    end of the input.
+
+Arguments:
+
+    Automaton - Supplies a pointer to the automaton.
+
+    State - Supplies a pointer to the final state.
+
+    Flags - Supplies the execution flags. If REG_NOTEOL is set, then line
+        end assertions are not satisfied at the end of the input.
+
+Return Value:
+
+    TRUE if the expression matches.
+
+    FALSE if the expression does not match.
+
+--*/
+
+{
+
+    ULONG ClosureFlags;
+    ULONG Count;
+    ULONG Index;
+    PULONG List;
+
+    List = State->Instructions;
+    Count = State->InstructionCount;
+    if ((Flags & REG_NOTEOL) == 0) {
+        ClosureFlags = (State->Flags & REGEX_DFA_STATE_LINE_BEGIN) |
+                       REGEX_DFA_STATE_LINE_END;
+
+        Count = ClpComputeAutomatonClosure(Automaton,
+                                           List,
+                                           Count,
+                                           ClosureFlags,
+                                           Automaton->List[0]);
+
+        List = Automaton->List[0];
+    }
+
+    for (Index = 0; Index < Count; Index += 1) {
+        if (Automaton->Program[List[Index]].Opcode == RegexOpMatch) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+ULONG
+ClpComputeAutomatonClosure (
+    PREGEX_AUTOMATON Automaton,
+    PULONG Seeds,
+    ULONG SeedCount,
+    ULONG Flags,
+    PULONG Output
+    )
+
+/*++
+
+Routine Description:
+
+    This routine follows every instruction that does not consume input
+    starting from the given seed instructions, collecting the set of
+    instructions that remain.
+
+Arguments:
+
+    Automaton - Supplies a pointer to the automaton.
+
+    Seeds - Supplies the array of instructions to start from.
+
+    SeedCount - Supplies the number of elements in the seed array.
+
+    Flags - Supplies the context for assertions. If the line begin state flag
+        is set, line begin assertions are followed. If the line end flag is
+        set, line end assertions are followed, otherwise they are kept in the
+        output so they can be followed once the next character is known.
+
+    Output - Supplies a pointer where the sorted instruction list will be
+        returned. This may not be the same buffer as the seeds.
+
+Return Value:
+
+    Returns the number of instructions in the output list.
+
+--*/
+
+{
+
+    ULONG Count;
+    ULONG Depth;
+    ULONG Generation;
+    ULONG Index;
+    PREGEX_INSTRUCTION Instruction;
+    PULONG Mark;
+    ULONG Next;
+    PULONG Stack;
+
+    Automaton->Generation += 1;
+    if (Automaton->Generation == 0) {
+        memset(Automaton->Mark, 0, Automaton->ProgramSize * sizeof(ULONG));
+        Automaton->Generation = 1;
+    }
+
+    Generation = Automaton->Generation;
+    Mark = Automaton->Mark;
+    Stack = Automaton->Stack;
+    Depth = 0;
+    for (Index = 0; Index < SeedCount; Index += 1) {
+        if (Mark[Seeds[Index]] != Generation) {
+            Mark[Seeds[Index]] = Generation;
+            Stack[Depth] = Seeds[Index];
+            Depth += 1;
+        }
+    }
+
+    //
+    // Each instruction is pushed at most once, so the stack can never hold
+    // more than the number of instructions.
+    //
+
+    Count = 0;
+    while (Depth != 0) {
+        Depth -= 1;
+        Index = Stack[Depth];
+        Instruction = &(Automaton->Program[Index]);
+        Next = MAX_ULONG;
+        switch (Instruction->Opcode) {
+        case RegexOpSplit:
+            if (Mark[Instruction->Alternate] != Generation) {
+                Mark[Instruction->Alternate] = Generation;
+                Stack[Depth] = Instruction->Alternate;
+                Depth += 1;
+            }
+
+            Next = Instruction->Next;
+            break;
+
+        case RegexOpSave:
+            Next = Instruction->Next;
+            break;
+
+        case RegexOpLineBegin:
+            if ((Flags & REGEX_DFA_STATE_LINE_BEGIN) != 0) {
+                Next = Instruction->Next;
+            }
+
+            break;
+
+        case RegexOpLineEnd:
+            if ((Flags & REGEX_DFA_STATE_LINE_END) != 0) {
+                Next = Instruction->Next;
+
+            } else {
+                Output[Count] = Index;
+                Count += 1;
+            }
+
+            break;
+
+        case RegexOpCharacterSet:
+        case RegexOpMatch:
+            Output[Count] = Index;
+            Count += 1;
+            break;
+
+        default:
+
+            assert(FALSE);
+
+            break;
+        }
+
+        if ((Next != MAX_ULONG) && (Mark[Next] != Generation)) {
+            Mark[Next] = Generation;
+            Stack[Depth] = Next;
+            Depth += 1;
+        }
+    }
+
+    //
+    // Sort the list so that the same set of instructions always finds the
+    // same state.
+    //
+
+    qsort(Output, Count, sizeof(ULONG), ClpCompareAutomatonInstructions);
+    return Count;
+}
+
+PREGEX_DFA_STATE
+ClpGetAutomatonState (
+    PREGEX_AUTOMATON Automaton,
+    PULONG Seeds,
+    ULONG SeedCount,
+    ULONG Flags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds or creates the automaton state for the closure of the
+    given seed instructions. If the state cache is too large, it is flushed
+    before a new state is created.
+
+Arguments:
+
+    Automaton - Supplies a pointer to the automaton.
+
+    Seeds - Supplies the array of instructions the state starts from.
+
+    SeedCount - Supplies the number of elements in the seed array.
+
+    Flags - Supplies the state flags. Only the line begin flag affects the
+        closure.
+
+Return Value:
+
+    Returns a pointer to the state on success.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    size_t AllocationSize;
+    ULONG Bucket;
+    ULONG Count;
+    ULONG Hash;
+    ULONG Index;
+    PULONG List;
+    PREGEX_DFA_STATE State;
+
+    List = Automaton->List[0];
+    assert(Seeds != List);
+
+    Count = ClpComputeAutomatonClosure(Automaton,
+                                       Seeds,
+                                       SeedCount,
+                                       Flags & REGEX_DFA_STATE_LINE_BEGIN,
+                                       List);
+
+    if ((Count == 0) && ((Flags & REGEX_DFA_STATE_MATCHED) == 0)) {
+        Flags |= REGEX_DFA_STATE_DEAD;
+    }
+
+    Hash = Flags;
+    for (Index = 0; Index < Count; Index += 1) {
+        Hash = (Hash * 31) + List[Index];
+    }
+
+    Bucket = Hash % REGEX_DFA_HASH_SIZE;
+    State = Automaton->Hash[Bucket];
+    while (State != NULL) {
+        if ((State->Hash == Hash) &&
+            (State->Flags == Flags) &&
+            (State->InstructionCount == Count) &&
+            (memcmp(State->Instructions, List, Count * sizeof(ULONG)) == 0)) {
+
+            return State;
+        }
+
+        State = State->HashNext;
+    }
+
+    //
+    // Create a new state, throwing all the old ones away first if there are
+    // too many.
+    //
+
+    AllocationSize = sizeof(REGEX_DFA_STATE) +
+                     (Automaton->ClassCount * sizeof(PREGEX_DFA_STATE)) +
+                     (Count * sizeof(ULONG));
+
+    if (Automaton->CacheSize + AllocationSize > REGEX_DFA_CACHE_LIMIT) {
+        ClpFlushAutomatonStates(Automaton);
+    }
+
+    State = malloc(AllocationSize);
+    if (State == NULL) {
+        return NULL;
+    }
+
+    memset(State, 0, AllocationSize);
+    State->Hash = Hash;
+    State->Flags = Flags;
+    State->InstructionCount = Count;
+    State->Instructions = (PULONG)(&(State->Transition[Automaton->ClassCount]));
+    memcpy(State->Instructions, List, Count * sizeof(ULONG));
+    State->HashNext = Automaton->Hash[Bucket];
+    Automaton->Hash[Bucket] = State;
+    Automaton->CacheSize += AllocationSize;
+    return State;
+}
+
+VOID
+ClpFlushAutomatonStates (
+    PREGEX_AUTOMATON Automaton
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys all cached automaton states.
+
+Arguments:
+
+    Automaton - Supplies a pointer to the automaton.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Bucket;
+    PREGEX_DFA_STATE State;
+
+    for (Bucket = 0; Bucket < REGEX_DFA_HASH_SIZE; Bucket += 1) {
+        while (Automaton->Hash[Bucket] != NULL) {
+            State = Automaton->Hash[Bucket];
+            Automaton->Hash[Bucket] = State->HashNext;
+            free(State);
+        }
+    }
+
+    Automaton->StartState[0] = NULL;
+    Automaton->StartState[1] = NULL;
+    Automaton->CacheSize = 0;
+    Automaton->FlushCount += 1;
+    return;
+}
+
+int
+ClpCompareAutomatonInstructions (
+    const void *LeftPointer,
+    const void *RightPointer
+    )
+
+/*++
+
+Routine Description:
+
+    This routine compares two instruction indices, for use with qsort.
+
+Arguments:
+
+    LeftPointer - Supplies a pointer to the left instruction index.
+
+    RightPointer - Supplies a pointer to the right instruction index.
+
+Return Value:
+
+    Less than zero if the left index is smaller.
+
+    Zero if the indices are equal.
+
+    Greater than zero if the left index is larger.
+
+--*/
+
+{
+
+    ULONG Left;
+    ULONG Right;
+
+    Left = *((PULONG)LeftPointer);
+    Right = *((PULONG)RightPointer);
+    if (Left < Right) {
+        return -1;
+    }
+
+    if (Left > Right) {
+        return 1;
+    }
+
+    return 0;
+}
+
@@ -14,7 +14,8 @@ Module Name:
 Abstract:
 
     This header contains private definitions for implementing support for
-    Regular Expressions.
+    Regular Expressions. Swiss only builds this library for Windows, which
+    has no regex support of its own; other builds use the system C library.
 
 Author:
 
@@ -51,6 +52,62 @@ Module Name:
 #define REGULAR_EXPRESSION_ANCHORED_RIGHT 0x00000002
 #define REGULAR_EXPRESSION_NEGATED 0x00000004
 
+//
+// Define the number of bytes in an automaton character set bitmap.
+//
+
+#define REGEX_CHARACTER_SET_SIZE (256 / 8)
+
+//
+// Define the number of hash buckets used to look up automaton states.
+//
+
+#define REGEX_DFA_HASH_SIZE 1024
+
+//
+// Define the automaton state flags.
+//
+
+//
+// This flag is set if the state was entered right after the beginning of a
+// line, so line begin assertions are satisfied.
+//
+
+#define REGEX_DFA_STATE_LINE_BEGIN 0x00000001
+
+//
+// This flag is set if the expression matched right before the character that
+// led to this state.
+//
+
+#define REGEX_DFA_STATE_MATCHED 0x00000002
+
+//
+// This flag is set if the state has no threads left, meaning no match is
+// possible from here.
+//
+
+#define REGEX_DFA_STATE_DEAD 0x00000004
+
+//
+// This flag is never stored in a state. It is passed when computing a closure
+// to indicate that line end assertions are satisfied.
+//
+
+#define REGEX_DFA_STATE_LINE_END 0x00000008
+
+//
+// Define the automaton flags.
+//
+
+//
+// This flag is set if the program contains instructions that the lazily
+// built DFA cannot follow, such as word boundaries. Only the Pike VM can run
+// such a program.
+//
+
+#define REGEX_AUTOMATON_NO_DFA 0x00000001
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -255,6 +312,169 @@ struct _REGULAR_EXPRESSION_ENTRY {
 
 };
 
+typedef enum _REGEX_OPCODE {
+    RegexOpInvalid,
+    RegexOpCharacterSet,
+    RegexOpSplit,
+    RegexOpLineBegin,
+    RegexOpLineEnd,
+    RegexOpSave,
+    RegexOpWordBegin,
+    RegexOpWordEnd,
+    RegexOpMatch
+} REGEX_OPCODE, *PREGEX_OPCODE;
+
+/*++
+
+Structure Description:
+
+    This structure defines a single instruction in the automaton program,
+    which is a Thompson NFA built from the expression tree.
+
+Members:
+
+    Opcode - Stores the type of instruction.
+
+    Next - Stores the index of the instruction to go to next (after consuming
+        a character for character sets).
+
+    Alternate - Stores the second target for split instructions, the
+        index of the character set bitmap for character set instructions, or
+        the match slot for save instructions. Slot 2N is the start of
+        subexpression N, and slot 2N + 1 is its end.
+
+--*/
+
+typedef struct _REGEX_INSTRUCTION {
+    REGEX_OPCODE Opcode;
+    ULONG Next;
+    ULONG Alternate;
+} REGEX_INSTRUCTION, *PREGEX_INSTRUCTION;
+
+typedef struct _REGEX_DFA_STATE REGEX_DFA_STATE, *PREGEX_DFA_STATE;
+
+/*++
+
+Structure Description:
+
+    This structure defines a lazily built DFA state, which represents the set
+    of NFA instructions active at a point in the input.
+
+Members:
+
+    HashNext - Stores a pointer to the next state in the same hash bucket.
+
+    Hash - Stores the hash of the flags and instruction list.
+
+    Flags - Stores a bitfield of flags. See REGEX_DFA_STATE_* definitions.
+
+    InstructionCount - Stores the number of elements in the instruction list.
+
+    Instructions - Stores a pointer to the sorted list of active instruction
+        indices. Only character sets, unexpanded line end assertions, and
+        match instructions are kept.
+
+    Transition - Stores the array of next states, indexed by byte class. A
+        null entry has not been computed yet.
+
+--*/
+
+struct _REGEX_DFA_STATE {
+    PREGEX_DFA_STATE HashNext;
+    ULONG Hash;
+    ULONG Flags;
+    ULONG InstructionCount;
+    PULONG Instructions;
+    PREGEX_DFA_STATE Transition[ANYSIZE_ARRAY];
+};
+
+/*++
+
+Structure Description:
+
+    This structure defines the automaton form of a regular expression, used
+    for expressions that contain no back references. The program is run
+    either as a lazily built DFA, which only answers whether there is a
+    match, or as a Pike VM, which also finds the match offsets. DFA states
+    are built on demand during execution and cached, with the cache thrown
+    away entirely if it grows too large. The cache and the scratch space
+    used to build it are guarded by the lock, which execution only ever
+    tries to acquire. An execution that finds the lock taken skips the DFA
+    and runs the Pike VM, which keeps all its state on the side, so a
+    compiled expression can be executed on several threads at once.
+
+Members:
+
+    Flags - Stores a bitfield of flags. See REGEX_AUTOMATON_* definitions.
+
+    Lock - Stores the lock guarding the DFA state cache and scratch space.
+        This is zero when free and one when held.
+
+    Program - Stores the array of NFA instructions.
+
+    ProgramSize - Stores the number of valid instructions.
+
+    ProgramCapacity - Stores the number of instructions allocated.
+
+    Start - Stores the index of the first instruction.
+
+    Sets - Stores the array of character set bitmaps.
+
+    SetCount - Stores the number of valid character sets.
+
+    SetCapacity - Stores the number of character sets allocated.
+
+    ByteClass - Stores the class of each byte. Bytes in the same class
+        behave identically in every instruction.
+
+    ClassCharacter - Stores a representative byte for each class.
+
+    ClassCount - Stores the number of byte classes.
+
+    Stack - Stores a scratch stack used when computing closures.
+
+    Mark - Stores the generation number at which each instruction was last
+        visited during a closure.
+
+    Generation - Stores the current closure generation number.
+
+    List - Stores two scratch instruction lists.
+
+    Hash - Stores the hash table of cached states.
+
+    StartState - Stores the cached start states, one for normal execution and
+        one for REG_NOTBOL.
+
+    CacheSize - Stores the number of bytes currently allocated for states.
+
+    FlushCount - Stores the number of times the state cache has been thrown
+        away.
+
+--*/
+
+typedef struct _REGEX_AUTOMATON {
+    ULONG Flags;
+    volatile ULONG Lock;
+    PREGEX_INSTRUCTION Program;
+    ULONG ProgramSize;
+    ULONG ProgramCapacity;
+    ULONG Start;
+    PUCHAR Sets;
+    ULONG SetCount;
+    ULONG SetCapacity;
+    UCHAR ByteClass[256];
+    UCHAR ClassCharacter[256];
+    ULONG ClassCount;
+    PULONG Stack;
+    PULONG Mark;
+    ULONG Generation;
+    PULONG List[2];
+    PREGEX_DFA_STATE Hash[REGEX_DFA_HASH_SIZE];
+    PREGEX_DFA_STATE StartState[2];
+    size_t CacheSize;
+    ULONG FlushCount;
+} REGEX_AUTOMATON, *PREGEX_AUTOMATON;
+
 /*++
 
 Structure Description:
@@ -270,12 +490,23 @@ Structure Description:
     BaseEntry - Stores the initial subexpression entry, a slightly modified
         subexpression.
 
+    Automaton - Stores an optional pointer to the automaton form of the
+        expression. This is null if the expression uses features the
+        automaton cannot express, such as back references.
+
+    RequiredLiteral - Stores the longest literal string that every match must
+        contain, used to quickly reject input. The size is zero if there is
+        no such string. For case insensitive expressions this is stored in
+        lowercase.
+
 --*/
 
 typedef struct _REGULAR_EXPRESSION {
     ULONG SubexpressionCount;
     ULONG Flags;
     REGULAR_EXPRESSION_ENTRY BaseEntry;
+    PREGEX_AUTOMATON Automaton;
+    REGULAR_EXPRESSION_STRING RequiredLiteral;
 } REGULAR_EXPRESSION, *PREGULAR_EXPRESSION;
 
 //
@@ -285,3 +516,34 @@ typedef struct _REGULAR_EXPRESSION {
 //
 // -------------------------------------------------------- Function Prototypes
 //
+
+BOOL
+ClpRegularExpressionMatchBracketCharacter (
+    PREGULAR_EXPRESSION Expression,
+    PREGULAR_EXPRESSION_ENTRY Entry,
+    CHAR Character
+    );
+
+/*++
+
+Routine Description:
+
+    This routine determines if the given character matches a bracket
+    expression.
+
+Arguments:
+
+    Expression - Supplies a pointer to the regular expression.
+
+    Entry - Supplies a pointer to the bracket expression entry.
+
+    Character - Supplies the character to test.
+
+Return Value:
+
+    TRUE if the character matches the bracket expression (taking negation into
+    account).
+
+    FALSE if the character does not match.
+
+--*/
@@ -164,6 +164,11 @@ Return Value:
         if (ArgumentIndex + 1 < ArgumentCount) {
             Suffix = Arguments[ArgumentIndex + 1];
         }
+
+        if (ArgumentIndex + 2 < ArgumentCount) {
+            fprintf(stderr, BASENAME_USAGE);
+            return 1;
+        }
     }
 
     if (Name == NULL) {
@@ -180,10 +185,11 @@ Return Value:
     //
     // If there's a suffix, determine if the result ends in the given suffix.
     // Don't do this if the result length is less than or equal to the suffix
-    // length.
+    // length. An empty suffix would leave the result alone anyway, and the
+    // result may be a constant string like "." that can't be written.
     //
 
-    if (Suffix != NULL) {
+    if ((Suffix != NULL) && (*Suffix != '\0')) {
         ResultLength = strlen(Result);
         SuffixLength = strlen(Suffix);
         if (ResultLength > SuffixLength) {
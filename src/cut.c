@@ -35,9 +35,11 @@ Module Name:
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "swlib.h"
 
@@ -83,8 +85,6 @@ Module Name:
 
 #define CUT_OPTIONS_STRING "b:c:d:f:ns"
 
-#define CUT_INITIAL_LINE_SIZE 512
-
 //
 // Define cut options.
 //
@@ -125,6 +125,17 @@ Module Name:
 
 #define CUT_OPTION_FIELD_OPTION_SPECIFIED 0x00000020
 
+//
+// This macro determines whether the given zero-based byte, character, or
+// field number is selected.
+//
+
+#define CUT_IS_SELECTED(_Selection, _Element)                                 \
+    (((_Element) < (_Selection)->Limit) ?                                      \
+     (((_Selection)->Bitmap[(_Element) >> 3] &                                 \
+       (1 << ((_Element) & 0x7))) != 0) :                                      \
+     (_Selection)->SelectRest)
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -148,36 +159,102 @@ typedef struct _CUT_RANGE {
     LONG End;
 } CUT_RANGE, *PCUT_RANGE;
 
+/*++
+
+Structure Description:
+
+    This structure defines the compiled set of selected bytes, characters,
+    or fields.
+
+Members:
+
+    Bitmap - Stores a bitmap with a bit set for each selected element below
+        the limit. Complementing has already been applied.
+
+    Limit - Stores the number of elements covered by the bitmap.
+
+    SelectRest - Stores a boolean indicating whether every element at or
+        beyond the limit is selected.
+
+    Spans - Stores the array of runs of selected elements, in order. The
+        last run may have an end of -1, meaning it runs to the end of the
+        line.
+
+    SpanCount - Stores the number of elements in the spans array.
+
+--*/
+
+typedef struct _CUT_SELECTION {
+    PUCHAR Bitmap;
+    LONG Limit;
+    BOOL SelectRest;
+    PCUT_RANGE Spans;
+    UINTN SpanCount;
+} CUT_SELECTION, *PCUT_SELECTION;
+
+/*++
+
+Structure Description:
+
+    This structure defines a pending piece of a line to output. Adjacent
+    pieces are merged so that they go out in a single write.
+
+Members:
+
+    Start - Stores a pointer to the start of the piece, or NULL if nothing is
+        pending.
+
+    End - Stores a pointer one beyond the end of the piece.
+
+--*/
+
+typedef struct _CUT_OUTPUT_SPAN {
+    PSTR Start;
+    PSTR End;
+} CUT_OUTPUT_SPAN, *PCUT_OUTPUT_SPAN;
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
 
 INT
 CutFile (
-    FILE *Input,
+    PSWISS_LINE_READER Reader,
     INT Options,
     CHAR Delimiter,
     PSTR OutputDelimiter,
-    PCUT_RANGE Range,
-    UINTN RangeSize,
-    PSTR *LineBuffer,
-    PUINTN LineBufferSize
+    PCUT_SELECTION Selection
     );
 
-INT
-CutReadLine (
-    FILE *Input,
-    PSTR *LineBuffer,
-    PUINTN LineBufferSize,
-    PBOOL LastLine
+VOID
+CutAddOutput (
+    PCUT_OUTPUT_SPAN Pending,
+    PSTR Start,
+    PSTR End
     );
 
-BOOL
-CutIsElementInRange (
-    LONG Element,
-    INT Options,
+VOID
+CutFlushOutput (
+    PCUT_OUTPUT_SPAN Pending
+    );
+
+VOID
+CutFinishLine (
+    PCUT_OUTPUT_SPAN Pending,
+    PSTR LineEnd
+    );
+
+INT
+CutCreateSelection (
     PCUT_RANGE RangeArray,
-    UINTN RangeArraySize
+    UINTN RangeArraySize,
+    INT Options,
+    PCUT_SELECTION Selection
+    );
+
+VOID
+CutDestroySelection (
+    PCUT_SELECTION Selection
     );
 
 INT
@@ -247,24 +324,24 @@ Return Value:
     PCUT_RANGE Array;
     UINTN ArraySize;
     CHAR Delimiter;
-    FILE *Input;
-    PSTR LineBuffer;
-    UINTN LineBufferSize;
+    int Descriptor;
     PSTR ListString;
     INT Option;
     ULONG Options;
     PSTR OutputDelimiter;
+    PSWISS_LINE_READER Reader;
+    CUT_SELECTION Selection;
     int Status;
     int TotalStatus;
 
     ActionsSpecified = 0;
     Array = NULL;
     Delimiter = '\t';
-    LineBuffer = NULL;
-    LineBufferSize = 0;
     ListString = NULL;
     Options = 0;
     OutputDelimiter = NULL;
+    Reader = NULL;
+    memset(&Selection, 0, sizeof(CUT_SELECTION));
     TotalStatus = 0;
 
     //
@@ -374,6 +451,21 @@ Return Value:
         goto MainEnd;
     }
 
+    Status = CutCreateSelection(Array, ArraySize, Options, &Selection);
+    if (Status != 0) {
+        goto MainEnd;
+    }
+
+    //
+    // Create a single line reader whose buffer is shared across all inputs.
+    //
+
+    Reader = SwCreateLineReader(STDIN_FILENO);
+    if (Reader == NULL) {
+        Status = ENOMEM;
+        goto MainEnd;
+    }
+
     ArgumentIndex = optind;
     if (ArgumentIndex > ArgumentCount) {
         ArgumentIndex = ArgumentCount;
@@ -384,14 +476,15 @@ Return Value:
     //
 
     if (ArgumentIndex == ArgumentCount) {
-        Status = CutFile(stdin,
+        Status = CutFile(Reader,
                          Options,
                          Delimiter,
                          OutputDelimiter,
-                         Array,
-                         ArraySize,
-                         &LineBuffer,
-                         &LineBufferSize);
+                         &Selection);
+
+        if (Status != 0) {
+            TotalStatus = Status;
+        }
     }
 
     //
@@ -402,31 +495,30 @@ Return Value:
         Argument = Arguments[ArgumentIndex];
         ArgumentIndex += 1;
         if (strcmp(Argument, "-") == 0) {
-            Input = stdin;
+            Descriptor = STDIN_FILENO;
 
         } else {
-            Input = fopen(Argument, "r");
-        }
-
-        if (Input == NULL) {
-            TotalStatus = errno;
-            SwPrintError(Status, Argument, "Unable to open");
+            Descriptor = open(Argument, O_RDONLY | O_BINARY);
+            if (Descriptor < 0) {
+                TotalStatus = errno;
+                SwPrintError(TotalStatus, Argument, "Unable to open");
+                continue;
+            }
         }
 
-        Status = CutFile(Input,
+        SwResetLineReader(Reader, Descriptor);
+        Status = CutFile(Reader,
                          Options,
                          Delimiter,
                          OutputDelimiter,
-                         Array,
-                         ArraySize,
-                         &LineBuffer,
-                         &LineBufferSize);
+                         &Selection);
 
-        if (Input != stdin) {
-            fclose(Input);
+        if (Descriptor != STDIN_FILENO) {
+            close(Descriptor);
         }
 
         if (Status != 0) {
+            SwPrintError(Status, Argument, "Failed to read");
             TotalStatus = Status;
         }
     }
@@ -434,6 +526,11 @@ Return Value:
     Status = 0;
 
 MainEnd:
+    if (Reader != NULL) {
+        SwDestroyLineReader(Reader);
+    }
+
+    CutDestroySelection(&Selection);
     if (Array != NULL) {
         free(Array);
     }
@@ -451,14 +548,11 @@ Return Value:
 
 INT
 CutFile (
-    FILE *Input,
+    PSWISS_LINE_READER Reader,
     INT Options,
     CHAR Delimiter,
     PSTR OutputDelimiter,
-    PCUT_RANGE Range,
-    UINTN RangeSize,
-    PSTR *LineBuffer,
-    PUINTN LineBufferSize
+    PCUT_SELECTION Selection
     )
 
 /*++
@@ -469,7 +563,7 @@ Routine Description:
 
 Arguments:
 
-    Input - Supplies a pointer to the input file to read.
+    Reader - Supplies a pointer to the line reader to read the input from.
 
     Options - Supplies the CUT_OPTION_* flags governing behavior.
 
@@ -478,16 +572,7 @@ Routine Description:
     OutputDelimiter - Supplies an optional pointer to the output delimiter
         string for field cutting.
 
-    Range - Supplies a pointer to the cut range array.
-
-    RangeSize - Supplies the size of the cut range array in elements.
-
-    LineBuffer - Supplies a pointer to the buffer used to hold lines. This
-        buffer may be allocated or reallocated by this function.
-
-    LineBufferSize - Supplies a pointer that in input contains the size of the
-        supplied line buffer. If the line buffer is reallocated, this size
-        will be updated.
+    Selection - Supplies a pointer to the compiled selection.
 
 Return Value:
 
@@ -498,41 +583,51 @@ Return Value:
 {
 
     LONG Element;
+    PSTR FieldEnd;
     PSTR FieldStart;
     BOOL FirstElement;
-    BOOL LastLine;
     PSTR Line;
-    CHAR OriginalSeparator;
+    PSTR LineEnd;
+    size_t LineLength;
+    CUT_OUTPUT_SPAN Pending;
+    PCUT_RANGE Span;
+    PCUT_RANGE SpanEnd;
+    PSTR SpanStart;
     INT Status;
 
-    LastLine = FALSE;
-    Status = 0;
-    while (LastLine == FALSE) {
-        Status = CutReadLine(Input, LineBuffer, LineBufferSize, &LastLine);
+    Pending.Start = NULL;
+    Pending.End = NULL;
+    SpanEnd = Selection->Spans + Selection->SpanCount;
+    while (TRUE) {
+        Status = SwReadLineSlice(Reader, &Line, &LineLength);
         if (Status != 0) {
-            break;
-        }
+            if (Status == EOF) {
+                Status = 0;
+            }
 
-        Line = *LineBuffer;
-        if ((LastLine != FALSE) && (*Line == '\0')) {
             break;
         }
 
+        LineEnd = Line + LineLength;
+
         //
-        // If byte or character mode, print every character in range.
+        // If byte or character mode, print every run of selected characters
+        // that lands within the line.
         //
 
         if ((Options & (CUT_OPTION_BYTE | CUT_OPTION_CHARACTER)) != 0) {
-            Element = 0;
-            while (*Line != '\0') {
-                if (CutIsElementInRange(Element, Options, Range, RangeSize) !=
-                    FALSE) {
+            for (Span = Selection->Spans; Span < SpanEnd; Span += 1) {
+                if (Span->Start >= LineLength) {
+                    break;
+                }
 
-                    putchar(*Line);
+                SpanStart = Line + Span->Start;
+                if ((Span->End == -1) || (Span->End >= LineLength)) {
+                    CutAddOutput(&Pending, SpanStart, LineEnd);
+                    break;
                 }
 
-                Element += 1;
-                Line += 1;
+                CutAddOutput(&Pending, SpanStart, Line + Span->End + 1);
             }
 
         //
@@ -540,264 +635,382 @@ Return Value:
         //
 
         } else if ((Options & CUT_OPTION_FIELD) != 0) {
+            FieldEnd = memchr(Line, Delimiter, LineLength);
+
+            //
+            // If there was never any separator, print the line unless the
+            // option suppresses it.
+            //
+
+            if (FieldEnd == NULL) {
+                if ((Options & CUT_OPTION_ONLY_DELIMITED) != 0) {
+                    continue;
+                }
+
+                CutAddOutput(&Pending, Line, LineEnd);
+                CutFinishLine(&Pending, LineEnd);
+                continue;
+            }
+
             Element = 0;
-            Line = *LineBuffer;
+            FieldStart = Line;
             FirstElement = TRUE;
-            while (*Line != '\0') {
-                FieldStart = Line;
+            while (TRUE) {
 
                 //
-                // Find the next field.
+                // Once past the last element the bitmap describes, either
+                // nothing else on the line is selected, or everything is. In
+                // the latter case the rest of the line goes out as is, unless
+                // the delimiters need replacing.
                 //
 
-                while ((*Line != '\0') && (*Line != Delimiter)) {
-                    Line += 1;
-                }
-
-                OriginalSeparator = *Line;
-                if (OriginalSeparator == '\0') {
-
-                    //
-                    // If there was never any separator, print the line unless
-                    // the option suppresses it.
-                    //
+                if (Element >= Selection->Limit) {
+                    if (Selection->SelectRest == FALSE) {
+                        break;
+                    }
 
-                    if (Element == 0) {
-                        if ((Options & CUT_OPTION_ONLY_DELIMITED) == 0) {
-                            fputs(FieldStart, stdout);
+                    if (OutputDelimiter == NULL) {
+                        if (FirstElement == FALSE) {
+                            FieldStart -= 1;
                         }
 
+                        CutAddOutput(&Pending, FieldStart, LineEnd);
                         break;
                     }
+                }
 
-                } else {
-                    *Line = '\0';
-                    Line += 1;
+                if (FieldEnd == NULL) {
+                    FieldEnd = LineEnd;
                 }
 
-                if (CutIsElementInRange(Element, Options, Range, RangeSize) !=
-                    FALSE) {
+                if (CUT_IS_SELECTED(Selection, Element)) {
 
                     //
                     // Spit out the delimiter for this field if there was one.
+                    // The input delimiter is just the byte before the field,
+                    // so it can be merged with the field.
                     //
 
                     if (FirstElement == FALSE) {
                         if (OutputDelimiter != NULL) {
+                            CutFlushOutput(&Pending);
                             fputs(OutputDelimiter, stdout);
+                            CutAddOutput(&Pending, FieldStart, FieldEnd);
 
                         } else {
-                            putchar(Delimiter);
+                            CutAddOutput(&Pending, FieldStart - 1, FieldEnd);
                         }
+
+                    } else {
+                        CutAddOutput(&Pending, FieldStart, FieldEnd);
                     }
 
-                    fputs(FieldStart, stdout);
                     FirstElement = FALSE;
                 }
 
+                if (FieldEnd == LineEnd) {
+                    break;
+                }
+
                 Element += 1;
+                FieldStart = FieldEnd + 1;
+                FieldEnd = memchr(FieldStart, Delimiter, LineEnd - FieldStart);
             }
         }
 
-        putchar('\n');
+        CutFinishLine(&Pending, LineEnd);
     }
 
     return Status;
 }
 
-INT
-CutReadLine (
-    FILE *Input,
-    PSTR *LineBuffer,
-    PUINTN LineBufferSize,
-    PBOOL LastLine
+VOID
+CutAddOutput (
+    PCUT_OUTPUT_SPAN Pending,
+    PSTR Start,
+    PSTR End
     )
 
 /*++
 
 Routine Description:
 
-    This routine reads a line from the input.
+    This routine adds a piece of the current line to the output. If it
+    directly follows the pending piece, the two are merged.
 
 Arguments:
 
-    Input - Supplies a pointer to the input file to read.
-
-    LineBuffer - Supplies a pointer to the buffer used to hold lines. This
-        buffer may be allocated or reallocated by this function.
+    Pending - Supplies a pointer to the pending output.
 
-    LineBufferSize - Supplies a pointer that in input contains the size of the
-        supplied line buffer. If the line buffer is reallocated, this size
-        will be updated.
+    Start - Supplies a pointer to the start of the piece.
 
-    LastLine - Supplies a pointer to a boolean that will be set to TRUE if the
-        line returned was the last one in the file.
+    End - Supplies a pointer one beyond the end of the piece.
 
 Return Value:
 
-    Returns an integer exit code. 0 for success, nonzero otherwise.
+    None.
 
 --*/
 
 {
 
-    INT Character;
-    UINTN Index;
-    PSTR Line;
-    UINTN LineSize;
-    PSTR NewBuffer;
-    UINTN NewBufferSize;
-    INT Status;
+    if ((Pending->Start != NULL) && (Pending->End == Start)) {
+        Pending->End = End;
+        return;
+    }
 
-    Index = 0;
-    Line = *LineBuffer;
-    LineSize = *LineBufferSize;
-    while (TRUE) {
+    CutFlushOutput(Pending);
+    Pending->Start = Start;
+    Pending->End = End;
+    return;
+}
 
-        //
-        // If the next character and a terminator is too big for the buffer,
-        // reallocate it.
-        //
+VOID
+CutFlushOutput (
+    PCUT_OUTPUT_SPAN Pending
+    )
 
-        if (Index + 1 >= LineSize) {
-            if (LineSize == 0) {
-                NewBufferSize = CUT_INITIAL_LINE_SIZE;
+/*++
 
-            } else {
-                NewBufferSize = LineSize * 2;
-            }
+Routine Description:
 
-            NewBuffer = realloc(Line, NewBufferSize);
-            if (NewBuffer == NULL) {
-                Status = ENOMEM;
-                goto ReadLineEnd;
-            }
+    This routine writes out any pending output.
 
-            Line = NewBuffer;
-            LineSize = NewBufferSize;
-        }
+Arguments:
 
-        Character = fgetc(Input);
-        if (Character == EOF) {
-            *LastLine = TRUE;
-            break;
-        }
+    Pending - Supplies a pointer to the pending output.
 
-        Line[Index] = Character;
-        Index += 1;
-        if (Character == '\n') {
-            break;
-        }
-    }
+Return Value:
 
-    //
-    // Remove the newline and maybe a carraige return before that.
-    //
+    None.
+
+--*/
 
-    if ((Index != 0) && (Line[Index - 1] == '\n')) {
-        Index -= 1;
+{
+
+    if (Pending->Start != NULL) {
+        fwrite(Pending->Start, 1, Pending->End - Pending->Start, stdout);
+        Pending->Start = NULL;
     }
 
+    return;
+}
+
+VOID
+CutFinishLine (
+    PCUT_OUTPUT_SPAN Pending,
+    PSTR LineEnd
+    )
+
+/*++
+
+Routine Description:
+
+    This routine writes out any pending output followed by a newline.
+
+Arguments:
+
+    Pending - Supplies a pointer to the pending output.
+
+    LineEnd - Supplies a pointer to the end of the line, where the line
+        reader put a null terminator.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
     //
-    // Add a terminator.
+    // If the pending output runs to the end of the line, temporarily put the
+    // newline back in place of the terminator so it all goes out in one
+    // write.
     //
 
-    Line[Index] = '\0';
-    Index += 1;
+    if ((Pending->Start != NULL) && (Pending->End == LineEnd)) {
+        *LineEnd = '\n';
+        Pending->End += 1;
+        CutFlushOutput(Pending);
+        *LineEnd = '\0';
 
-    assert(Index <= LineSize);
-
-    Status = 0;
+    } else {
+        CutFlushOutput(Pending);
+        putchar('\n');
+    }
 
-ReadLineEnd:
-    *LineBuffer = Line;
-    *LineBufferSize = LineSize;
-    return Status;
+    return;
 }
 
-BOOL
-CutIsElementInRange (
-    LONG Element,
-    INT Options,
+INT
+CutCreateSelection (
     PCUT_RANGE RangeArray,
-    UINTN RangeArraySize
+    UINTN RangeArraySize,
+    INT Options,
+    PCUT_SELECTION Selection
     )
 
 /*++
 
 Routine Description:
 
-    This routine determines whether the given element number is in the
-    specified cut range array.
+    This routine compiles a sorted range array into a bitmap of selected
+    elements, and the runs of selected elements.
 
 Arguments:
 
-    Element - Supplies the zero-based element number. Cut ranges have been
-        converted from one-based to zero-based as they were created.
+    RangeArray - Supplies a pointer to the sorted array of cut ranges.
 
-    Options - Supplies the cut options. The complement bit is checked here.
+    RangeArraySize - Supplies the number of elements in the range array.
 
-    RangeArray - Supplies a pointer where an array of cut ranges will be
-        returned on success. The caller is responsible for freeing this array
-        when done.
+    Options - Supplies the cut options. The complement bit is applied here.
 
-    RangeArraySize - Supplies a pointer where the number of elements in the
-        returned cut array will be returned.
+    Selection - Supplies a pointer where the selection will be returned. The
+        caller must call CutDestroySelection when done with it.
 
 Return Value:
 
-    TRUE if the element should be printed.
-
-    FALSE if the element should be discarded.
+    Returns an integer exit code. 0 for success, nonzero otherwise.
 
 --*/
 
 {
 
+    LONG Element;
+    LONG End;
     UINTN Index;
-    BOOL InRange;
+    LONG Limit;
     PCUT_RANGE Range;
+    BOOL Selected;
+    UINTN SpanCount;
 
-    InRange = FALSE;
+    memset(Selection, 0, sizeof(CUT_SELECTION));
+
+    //
+    // The bitmap covers everything up to the last boundary of any range.
+    // Beyond that, elements are selected only if some range is open ended.
+    //
+
+    Limit = 0;
     for (Index = 0; Index < RangeArraySize; Index += 1) {
         Range = &(RangeArray[Index]);
+        End = Range->Start;
+        if (Range->End != -1) {
+            End = Range->End + 1;
 
-        //
-        // If the range starts after the element, then neither this range nor
-        // any after it will match.
-        //
+        } else {
+            Selection->SelectRest = TRUE;
+        }
 
-        if (Range->Start > Element) {
-            break;
+        if (End > Limit) {
+            Limit = End;
         }
+    }
 
-        //
-        // The element is greater than or equal to the start. See if it's also
-        // within the end, inclusive.
-        //
+    Selection->Limit = Limit;
+    Selection->Bitmap = malloc((Limit / 8) + 1);
+    if (Selection->Bitmap == NULL) {
+        return ENOMEM;
+    }
 
-        if ((Range->End >= Element) || (Range->End == -1)) {
-            InRange = TRUE;
-            break;
+    memset(Selection->Bitmap, 0, (Limit / 8) + 1);
+    for (Index = 0; Index < RangeArraySize; Index += 1) {
+        Range = &(RangeArray[Index]);
+        End = Range->End;
+        if (End == -1) {
+            End = Limit - 1;
         }
 
-        //
-        // The element was within the start but not in the end. Move to the
-        // next element. Remember, the user can specify overlapping ranges.
-        //
-
+        for (Element = Range->Start; Element <= End; Element += 1) {
+            Selection->Bitmap[Element >> 3] |= 1 << (Element & 0x7);
+        }
     }
 
     if ((Options & CUT_OPTION_COMPLEMENT) != 0) {
-        if (InRange == FALSE) {
-            InRange = TRUE;
+        for (Index = 0; Index < (Limit / 8) + 1; Index += 1) {
+            Selection->Bitmap[Index] = ~(Selection->Bitmap[Index]);
+        }
+
+        Selection->SelectRest = !Selection->SelectRest;
+    }
+
+    //
+    // Gather the runs of selected elements. There can't be more runs than
+    // half the elements, plus one for the run at the end.
+    //
+
+    Selection->Spans = malloc(((Limit / 2) + 2) * sizeof(CUT_RANGE));
+    if (Selection->Spans == NULL) {
+        return ENOMEM;
+    }
+
+    SpanCount = 0;
+    Range = NULL;
+    for (Element = 0; Element <= Limit; Element += 1) {
+        if (Element == Limit) {
+            Selected = Selection->SelectRest;
 
         } else {
-            InRange = FALSE;
+            Selected = CUT_IS_SELECTED(Selection, Element);
+        }
+
+        if (Selected == FALSE) {
+            Range = NULL;
+            continue;
+        }
+
+        if (Range == NULL) {
+            Range = &(Selection->Spans[SpanCount]);
+            SpanCount += 1;
+            Range->Start = Element;
         }
+
+        Range->End = Element;
+    }
+
+    if ((SpanCount != 0) && (Selection->SelectRest != FALSE)) {
+        Selection->Spans[SpanCount - 1].End = -1;
+    }
+
+    Selection->SpanCount = SpanCount;
+    return 0;
+}
+
+VOID
+CutDestroySelection (
+    PCUT_SELECTION Selection
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases the resources of a compiled selection.
+
+Arguments:
+
+    Selection - Supplies a pointer to the selection.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (Selection->Bitmap != NULL) {
+        free(Selection->Bitmap);
+        Selection->Bitmap = NULL;
+    }
+
+    if (Selection->Spans != NULL) {
+        free(Selection->Spans);
+        Selection->Spans = NULL;
     }
 
-    return InRange;
+    return;
 }
 
 INT
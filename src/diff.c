@@ -103,6 +103,13 @@ Module Name:
 
 #define DIFF_INITIAL_LINE_BUFFER 256
 
+//
+// Define the size of each block of the arena that file lines are allocated
+// from.
+//
+
+#define DIFF_LINE_ARENA_BLOCK_SIZE (64 * 1024)
+
 //
 // Define the colors used for insertion and deletion.
 //
@@ -191,6 +198,9 @@ Structure Description:
 
     Lines - Stores an array of pointers to the lines of the file.
 
+    LineArena - Stores a pointer to the arena the lines and their data are
+        allocated from.
+
 --*/
 
 typedef struct _DIFF_FILE {
@@ -202,6 +212,7 @@ typedef struct _DIFF_FILE {
     FILE *File;
     INTN LineCount;
     PDIFF_LINE *Lines;
+    PSWISS_ARENA LineArena;
 } DIFF_FILE, *PDIFF_FILE;
 
 /*++
@@ -324,11 +335,6 @@ DiffDestroyFile (
     PDIFF_FILE File
     );
 
-VOID
-DiffDestroyLine (
-    PDIFF_LINE Line
-    );
-
 DIFF_FILE_TYPE
 DiffGetFileType (
     mode_t Mode
@@ -1635,8 +1641,6 @@ Return Value:
 
 {
 
-    UINTN LineIndex;
-
     if (File == &(Context->EmptyFile)) {
         File->Name = NULL;
         return;
@@ -1650,46 +1654,15 @@ Return Value:
         fclose(File->File);
     }
 
-    for (LineIndex = 0; LineIndex < File->LineCount; LineIndex += 1) {
-        DiffDestroyLine(File->Lines[LineIndex]);
-    }
-
     if (File->Lines != NULL) {
         free(File->Lines);
     }
 
-    free(File);
-    return;
-}
-
-VOID
-DiffDestroyLine (
-    PDIFF_LINE Line
-    )
-
-/*++
-
-Routine Description:
-
-    This routine destroys a diff line structure.
-
-Arguments:
-
-    Line - Supplies a pointer to the line to destroy.
-
-Return Value:
-
-    None.
-
---*/
-
-{
-
-    if (Line->Data != NULL) {
-        free(Line->Data);
+    if (File->LineArena != NULL) {
+        SwDestroyArena(File->LineArena);
     }
 
-    free(Line);
+    free(File);
     return;
 }
 
@@ -1891,7 +1864,6 @@ Return Value:
     INT Status;
 
     AppendedPath = NULL;
-    Line = NULL;
     LineArrayCapacity = 0;
     LineBuffer = NULL;
     LineBufferCapacity = 0;
@@ -1939,6 +1911,13 @@ Return Value:
         goto LoadFileEnd;
     }
 
+    if (File->LineArena == NULL) {
+        File->LineArena = SwCreateArena(DIFF_LINE_ARENA_BLOCK_SIZE);
+        if (File->LineArena == NULL) {
+            goto LoadFileEnd;
+        }
+    }
+
     while (TRUE) {
         LineBufferSize = 0;
         LineHash = 0;
@@ -2008,25 +1987,19 @@ Return Value:
         }
 
         //
-        // Allocate a line structure.
+        // Allocate a line structure with room for a line of exactly the right
+        // size right after it, and copy the line in.
         //
 
-        Line = malloc(sizeof(DIFF_LINE));
+        Line = SwArenaAllocate(File->LineArena,
+                               sizeof(DIFF_LINE) + LineBufferSize + 1);
+
         if (Line == NULL) {
             goto LoadFileEnd;
         }
 
         memset(Line, 0, sizeof(DIFF_LINE));
-
-        //
-        // Allocate a line of exactly the right size and copy it in.
-        //
-
-        Line->Data = malloc(LineBufferSize + 1);
-        if (Line->Data == NULL) {
-            goto LoadFileEnd;
-        }
-
+        Line->Data = (PSTR)(Line + 1);
         memcpy(Line->Data, LineBuffer, LineBufferSize);
         Line->Data[LineBufferSize] = '\0';
         Line->Size = LineBufferSize + 1;
@@ -2055,7 +2028,6 @@ Return Value:
 
         File->Lines[File->LineCount] = Line;
         File->LineCount += 1;
-        Line = NULL;
 
         //
         // If this was the last line, stop.
@@ -2080,10 +2052,6 @@ Return Value:
     Status = 0;
 
 LoadFileEnd:
-    if (Line != NULL) {
-        DiffDestroyLine(Line);
-    }
-
     if (AppendedPath != NULL) {
         free(AppendedPath);
     }
@@ -138,6 +138,7 @@ Return Value:
 
     if (Name == NULL) {
         fprintf(stderr, DIRNAME_USAGE);
+        return 1;
     }
 
     Result = dirname(Name);
@@ -33,6 +33,7 @@ Module Name:
 
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <regex.h>
 #include <stdlib.h>
 #include <string.h>
@@ -44,6 +45,13 @@ Module Name:
 
 #define EXPR_INTEGER_STRING_SIZE 64
 
+//
+// Define how many parentheses can be open at once. This keeps a long run of
+// open parentheses from overflowing the stack.
+//
+
+#define EXPR_MAX_NESTING 1024
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -66,15 +74,39 @@ typedef enum _EXPR_OPERATOR {
     ExprMatch,
 } EXPR_OPERATOR, *PEXPR_OPERATOR;
 
+/*++
+
+Structure Description:
+
+    This structure stores the state of the expression parser.
+
+Members:
+
+    Arguments - Stores the array of arguments making up the expression.
+
+    ArgumentCount - Stores the number of elements in the argument array.
+
+    ArgumentIndex - Stores the index of the next argument to parse.
+
+    Depth - Stores the number of parentheses currently open.
+
+--*/
+
+typedef struct _EXPR_PARSER {
+    CHAR **Arguments;
+    INT ArgumentCount;
+    INT ArgumentIndex;
+    ULONG Depth;
+} EXPR_PARSER, *PEXPR_PARSER;
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
 
 INT
 ExprEvaluate (
-    PINT ArgumentIndex,
-    INT ArgumentCount,
-    CHAR **Arguments,
+    PEXPR_PARSER Parser,
+    ULONG MinimumPrecedence,
     PSTR *ResultValue
     );
 
@@ -92,6 +124,11 @@ ExprEvaluateOperator (
     PSTR *AnswerString
     );
 
+BOOL
+ExprIsNull (
+    PSTR Value
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -132,45 +169,47 @@ Return Value:
 {
 
     PSTR Answer;
-    INT Index;
+    EXPR_PARSER Parser;
     INT Status;
 
-    if (ArgumentCount == 2) {
-        SwPrintError(0, NULL, "Invalid argument count");
-        Status = EINVAL;
+    Parser.Arguments = Arguments;
+    Parser.ArgumentCount = ArgumentCount;
+    Parser.ArgumentIndex = 1;
+    Parser.Depth = 0;
+    Status = ExprEvaluate(&Parser, 0, &Answer);
+    if (Status != 0) {
         goto MainEnd;
     }
 
-    Index = 1;
-    if (ArgumentCount == 2) {
-        Answer = Arguments[1];
-        Status = 0;
+    //
+    // The only thing that can stop the parse early is a close parenthesis
+    // without an open one.
+    //
 
-    } else {
-        Status = ExprEvaluate(&Index, ArgumentCount, Arguments, &Answer);
-        if (Status != 0) {
-            goto MainEnd;
-        }
+    if (Parser.ArgumentIndex != ArgumentCount) {
+        SwPrintError(0, Arguments[Parser.ArgumentIndex], "Unexpected argument");
+        Status = EINVAL;
+        free(Answer);
+        goto MainEnd;
     }
 
     printf("%s\n", Answer);
-    if ((*Answer == '\0') || (strcmp(Answer, "0") == 0)) {
+    if (ExprIsNull(Answer) != FALSE) {
         Status = 1;
     }
 
-    if (ArgumentCount != 2) {
-        free(Answer);
-    }
+    free(Answer);
 
 MainEnd:
 
     //
     // Expr returns 0 if the result is non-zero and non-null, 1 if the result
-    // is 0 or null, 2 if the expression is invalid, and 3 on any other error.
+    // is 0 or null, 2 if the expression is invalid or can't be computed, and
+    // 3 on any other error.
     //
 
     if (Status > 1) {
-        if (Status == EINVAL) {
+        if ((Status == EINVAL) || (Status == EDOM) || (Status == ERANGE)) {
             Status = 2;
 
         } else {
@@ -187,9 +226,8 @@ Return Value:
 
 INT
 ExprEvaluate (
-    PINT ArgumentIndex,
-    INT ArgumentCount,
-    CHAR **Arguments,
+    PEXPR_PARSER Parser,
+    ULONG MinimumPrecedence,
     PSTR *ResultValue
     )
 
@@ -197,18 +235,19 @@ ExprEvaluate (
 
 Routine Description:
 
-    This routine evaluates an expression for the expr routine.
+    This routine evaluates an expression for the expr routine. It evaluates
+    an operand, then keeps applying operators as long as they bind at least
+    as tightly as the given precedence. The right side of each operator is
+    evaluated the same way with a higher minimum precedence, so operators of
+    equal precedence group from left to right.
 
 Arguments:
 
-    ArgumentIndex - Supplies a pointer that on input contains the starting
-        argument to evaluate. This will be updated to reflect the arguments
-        evaluated.
+    Parser - Supplies a pointer to the parser state. The argument index is
+        advanced past the arguments evaluated.
 
-    ArgumentCount - Supplies the number of arguments in the arguments array.
-
-    Arguments - Supplies an array of pointers to strings representing the
-        arguments.
+    MinimumPrecedence - Supplies the lowest precedence operator that may be
+        applied at this level.
 
     ResultValue - Supplies a pointer where a string will be returned containing
         the result value. The caller is responsible for freeing this string.
@@ -224,150 +263,144 @@ Return Value:
 {
 
     PSTR Answer;
-    INT Index;
+    PSTR Argument;
+    CHAR **Arguments;
     PSTR Left;
-    BOOL LeftAllocated;
-    EXPR_OPERATOR NextOperator;
-    ULONG NextOperatorPrecedence;
     EXPR_OPERATOR Operator;
     ULONG OperatorPrecedence;
     PSTR Right;
-    BOOL RightAllocated;
     INT Status;
 
-    Answer = NULL;
-    LeftAllocated = FALSE;
-    RightAllocated = FALSE;
-    Index = *ArgumentIndex;
-    if (Index >= ArgumentCount) {
+    Arguments = Parser->Arguments;
+    Left = NULL;
+    Right = NULL;
+    if (Parser->ArgumentIndex >= Parser->ArgumentCount) {
         SwPrintError(0, NULL, "Syntax error");
         Status = EINVAL;
         goto EvaluateEnd;
     }
 
-    Status = 0;
-    Left = Arguments[Index];
-    Index += 1;
-    if (strcmp(Left, "(") == 0) {
-        Status = ExprEvaluate(&Index, ArgumentCount, Arguments, &Left);
-        if (Status != 0) {
+    Argument = Arguments[Parser->ArgumentIndex];
+    Parser->ArgumentIndex += 1;
+    if (strcmp(Argument, "(") == 0) {
+        if (Parser->Depth >= EXPR_MAX_NESTING) {
+            SwPrintError(0, NULL, "Expression nested too deeply");
+            Status = EINVAL;
             goto EvaluateEnd;
         }
 
-        LeftAllocated = TRUE;
-        Answer = Left;
-    }
-
-    while (Index < ArgumentCount) {
-
-        //
-        // If the next token is a close parentheses, finish this.
-        //
-
-        if (strcmp(Arguments[Index], ")") == 0) {
-            if (LeftAllocated != FALSE) {
-                Answer = Left;
-
-            } else {
-                Answer = SwStringDuplicate(Left, strlen(Left) + 1);
-                if (Answer == NULL) {
-                    Status = ENOMEM;
-                    goto EvaluateEnd;
-                }
-            }
-
-            Index += 1;
-            break;
-        }
-
-        Operator = ExprGetOperator(Arguments[Index], &OperatorPrecedence);
-        if (Operator == ExprInvalid) {
-            SwPrintError(0, Arguments[Index], "Invalid operator");
-            Status = EINVAL;
+        Parser->Depth += 1;
+        Status = ExprEvaluate(Parser, 0, &Left);
+        Parser->Depth -= 1;
+        if (Status != 0) {
             goto EvaluateEnd;
         }
 
-        Index += 1;
-        if (Index == ArgumentCount) {
-            SwPrintError(0, NULL, "Missing operand");
+        if ((Parser->ArgumentIndex >= Parser->ArgumentCount) ||
+            (strcmp(Arguments[Parser->ArgumentIndex], ")") != 0)) {
+
+            SwPrintError(0, NULL, "Expected ')'");
             Status = EINVAL;
             goto EvaluateEnd;
         }
 
+        Parser->ArgumentIndex += 1;
+
+    //
+    // A close parenthesis can't start an operand, even though nothing else
+    // has the chance to catch it when it is the only argument.
+    //
+
+    } else if (strcmp(Argument, ")") == 0) {
+        SwPrintError(0, NULL, "Unexpected ')'");
+        Status = EINVAL;
+        goto EvaluateEnd;
+
+    } else {
+
         //
-        // If the right side is an open parentheses, recurse to figure out
-        // what it is.
+        // As in GNU expr, a plus sign takes the next argument as a plain
+        // string, even if it looks like an operator.
         //
 
-        RightAllocated = FALSE;
-        if (strcmp(Arguments[Index], "(") == 0) {
-            Index += 1;
-            Status = ExprEvaluate(&Index, ArgumentCount, Arguments, &Right);
-            if (Status != 0) {
+        if (strcmp(Argument, "+") == 0) {
+            if (Parser->ArgumentIndex >= Parser->ArgumentCount) {
+                SwPrintError(0, NULL, "Missing argument after '+'");
+                Status = EINVAL;
                 goto EvaluateEnd;
             }
 
-            RightAllocated = TRUE;
+            Argument = Arguments[Parser->ArgumentIndex];
+            Parser->ArgumentIndex += 1;
+        }
+
+        Left = SwStringDuplicate(Argument, strlen(Argument) + 1);
+        if (Left == NULL) {
+            Status = ENOMEM;
+            goto EvaluateEnd;
+        }
+    }
+
+    while (Parser->ArgumentIndex < Parser->ArgumentCount) {
 
         //
-        // If there are more arguments, get the next operator and figure out if
-        // it's of higher precedence than this one. If it is, recurse to
-        // figure out that answer first, and then use it as the right operand.
+        // A close parenthesis ends this expression. The open parenthesis
+        // checks for it.
         //
 
-        } else if (ArgumentCount - Index > 1) {
-            NextOperator = ExprGetOperator(Arguments[Index + 1],
-                                           &NextOperatorPrecedence);
-
-            if ((NextOperator != ExprInvalid) &&
-                (NextOperatorPrecedence > OperatorPrecedence)) {
+        Argument = Arguments[Parser->ArgumentIndex];
+        if (strcmp(Argument, ")") == 0) {
+            break;
+        }
 
-                Status = ExprEvaluate(&Index, ArgumentCount, Arguments, &Right);
-                if (Status != 0) {
-                    goto EvaluateEnd;
-                }
+        Operator = ExprGetOperator(Argument, &OperatorPrecedence);
+        if (Operator == ExprInvalid) {
+            SwPrintError(0, Argument, "Invalid operator");
+            Status = EINVAL;
+            goto EvaluateEnd;
+        }
 
-                RightAllocated = TRUE;
-            }
+        if (OperatorPrecedence < MinimumPrecedence) {
+            break;
         }
 
-        if (RightAllocated == FALSE) {
-            Right = Arguments[Index];
-            Index += 1;
+        Parser->ArgumentIndex += 1;
+        if (Parser->ArgumentIndex == Parser->ArgumentCount) {
+            SwPrintError(0, NULL, "Missing operand");
+            Status = EINVAL;
+            goto EvaluateEnd;
         }
 
-        //
-        // Evaluate the expression.
-        //
+        Status = ExprEvaluate(Parser, OperatorPrecedence + 1, &Right);
+        if (Status != 0) {
+            goto EvaluateEnd;
+        }
 
         Status = ExprEvaluateOperator(Left, Operator, Right, &Answer);
+        free(Left);
+        free(Right);
+        Left = Answer;
+        Right = NULL;
         if (Status != 0) {
             goto EvaluateEnd;
         }
+    }
 
-        //
-        // If left or right was allocated, free them.
-        //
+    Status = 0;
 
-        if (LeftAllocated != FALSE) {
+EvaluateEnd:
+    if (Status != 0) {
+        if (Left != NULL) {
             free(Left);
+            Left = NULL;
         }
 
-        if (RightAllocated != FALSE) {
+        if (Right != NULL) {
             free(Right);
         }
-
-        //
-        // Set the answer to be the new left.
-        //
-
-        Left = Answer;
-        LeftAllocated = TRUE;
     }
 
-EvaluateEnd:
-    *ArgumentIndex = Index;
-    *ResultValue = Answer;
+    *ResultValue = Left;
     return Status;
 }
 
@@ -506,7 +539,7 @@ Return Value:
     size_t ErrorStringSize;
     BOOL GotIntegerAnswer;
     BOOL GotIntegers;
-    INT IntegerAnswer;
+    LONGLONG IntegerAnswer;
     BOOL IntegersOptional;
     BOOL IntegersRequired;
     INT LeftInteger;
@@ -514,6 +547,7 @@ Return Value:
     regex_t RegularExpression;
     INT RightInteger;
     INT Status;
+    long Value;
 
     Answer = NULL;
     LeftInteger = 0;
@@ -544,7 +578,8 @@ Return Value:
     GotIntegers = FALSE;
     if ((IntegersRequired != FALSE) || (IntegersOptional != FALSE)) {
         GotIntegers = TRUE;
-        LeftInteger = strtol(Left, &AfterScan, 10);
+        errno = 0;
+        Value = strtol(Left, &AfterScan, 10);
         if ((AfterScan == Left) || (*AfterScan != '\0')) {
             if (IntegersRequired != FALSE) {
                 SwPrintError(0, Left, "Invalid number");
@@ -553,10 +588,20 @@ Return Value:
             }
 
             GotIntegers = FALSE;
+
+        } else if ((errno == ERANGE) || (Value < INT_MIN) ||
+                   (Value > INT_MAX)) {
+
+            SwPrintError(0, Left, "Integer overflow");
+            Status = ERANGE;
+            goto EvaluateOperatorEnd;
         }
 
-        RightInteger = strtol(Right, &AfterScan, 10);
-        if ((AfterScan == Left) || (*AfterScan != '\0')) {
+        LeftInteger = Value;
+
+        errno = 0;
+        Value = strtol(Right, &AfterScan, 10);
+        if ((AfterScan == Right) || (*AfterScan != '\0')) {
             if (IntegersRequired != FALSE) {
                 SwPrintError(0, Right, "Invalid number");
                 Status = EINVAL;
@@ -564,7 +609,16 @@ Return Value:
             }
 
             GotIntegers = FALSE;
+
+        } else if ((errno == ERANGE) || (Value < INT_MIN) ||
+                   (Value > INT_MAX)) {
+
+            SwPrintError(0, Right, "Integer overflow");
+            Status = ERANGE;
+            goto EvaluateOperatorEnd;
         }
+
+        RightInteger = Value;
     }
 
     switch (Operator) {
@@ -575,13 +629,10 @@ Return Value:
     //
 
     case ExprOr:
-        if ((strlen(Left) != 0) &&
-            ((GotIntegers == FALSE) || (LeftInteger != 0))) {
-
+        if (ExprIsNull(Left) == FALSE) {
             Answer = SwStringDuplicate(Left, strlen(Left) + 1);
 
-        } else if ((strlen(Right) != 0) &&
-                   ((GotIntegers == FALSE) || (RightInteger != 0))) {
+        } else if (ExprIsNull(Right) == FALSE) {
 
             Answer = SwStringDuplicate(Right, strlen(Right) + 1);
 
@@ -598,10 +649,7 @@ Return Value:
     //
 
     case ExprAnd:
-        if ((strlen(Left) != 0) &&
-            ((GotIntegers == FALSE) || (LeftInteger != 0)) &&
-            (strlen(Right) != 0) &&
-            ((GotIntegers == FALSE) || (RightInteger != 0))) {
+        if ((ExprIsNull(Left) == FALSE) && (ExprIsNull(Right) == FALSE)) {
 
             Answer = SwStringDuplicate(Left, strlen(Left) + 1);
 
@@ -701,22 +749,29 @@ Return Value:
 
         break;
 
+    //
+    // Arithmetic is done with twice the width of the operands, so that an
+    // answer too big for an integer can be caught below rather than wrapping
+    // or trapping.
+    //
+
     case ExprPlus:
         GotIntegerAnswer = TRUE;
-        IntegerAnswer = LeftInteger + RightInteger;
+        IntegerAnswer = (LONGLONG)LeftInteger + RightInteger;
         break;
 
     case ExprMinus:
         GotIntegerAnswer = TRUE;
-        IntegerAnswer = LeftInteger - RightInteger;
+        IntegerAnswer = (LONGLONG)LeftInteger - RightInteger;
         break;
 
     case ExprMultiply:
         GotIntegerAnswer = TRUE;
-        IntegerAnswer = LeftInteger * RightInteger;
+        IntegerAnswer = (LONGLONG)LeftInteger * RightInteger;
         break;
 
     case ExprDivide:
+    case ExprModulo:
         GotIntegerAnswer = TRUE;
         if (RightInteger == 0) {
             SwPrintError(0, NULL, "Divide by zero");
@@ -724,12 +779,13 @@ Return Value:
             goto EvaluateOperatorEnd;
         }
 
-        IntegerAnswer = LeftInteger / RightInteger;
-        break;
+        if (Operator == ExprDivide) {
+            IntegerAnswer = (LONGLONG)LeftInteger / RightInteger;
+
+        } else {
+            IntegerAnswer = (LONGLONG)LeftInteger % RightInteger;
+        }
 
-    case ExprModulo:
-        GotIntegerAnswer = TRUE;
-        IntegerAnswer = LeftInteger % RightInteger;
         break;
 
     //
@@ -775,6 +831,10 @@ Return Value:
                 (Match[1].rm_so == -1)) {
 
                 Answer = strdup("");
+                if (Answer == NULL) {
+                    Status = ENOMEM;
+                    goto EvaluateOperatorEnd;
+                }
 
             //
             // Return the first subgroup if it did match.
@@ -804,7 +864,7 @@ Return Value:
 
         } else {
             GotIntegerAnswer = TRUE;
-            if (Match[0].rm_so == 0) {
+            if ((Status == 0) && (Match[0].rm_so == 0)) {
                 IntegerAnswer = Match[0].rm_eo - Match[0].rm_so;
             }
         }
@@ -826,6 +886,12 @@ Return Value:
     //
 
     if (GotIntegerAnswer != FALSE) {
+        if ((IntegerAnswer < INT_MIN) || (IntegerAnswer > INT_MAX)) {
+            SwPrintError(0, NULL, "Integer overflow");
+            Status = ERANGE;
+            goto EvaluateOperatorEnd;
+        }
+
         Answer = malloc(EXPR_INTEGER_STRING_SIZE);
         if (Answer == NULL) {
             Status = ENOMEM;
@@ -835,7 +901,7 @@ Return Value:
         snprintf(Answer,
                  EXPR_INTEGER_STRING_SIZE,
                  "%d",
-                 IntegerAnswer);
+                 (INT)IntegerAnswer);
 
     } else {
 
@@ -848,3 +914,50 @@ Return Value:
     return Status;
 }
 
+BOOL
+ExprIsNull (
+    PSTR Value
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether an expr value is null or zero, which is
+    what the | and & operators and the exit status treat as false.
+
+Arguments:
+
+    Value - Supplies a pointer to the value.
+
+Return Value:
+
+    TRUE if the value is the empty string or an integer zero, such as "0",
+    "-0" or "00".
+
+    FALSE otherwise.
+
+--*/
+
+{
+
+    if (*Value == '\0') {
+        return TRUE;
+    }
+
+    if (*Value == '-') {
+        Value += 1;
+    }
+
+    do {
+        if (*Value != '0') {
+            return FALSE;
+        }
+
+        Value += 1;
+
+    } while (*Value != '\0');
+
+    return TRUE;
+}
+
@@ -43,6 +43,12 @@ Module Name:
 #include "swlib.h"
 #include "swisscmd.h"
 
+#if defined(__SSE2__)
+
+#include <emmintrin.h>
+
+#endif
+
 //
 // ---------------------------------------------------------------- Definitions
 //
@@ -84,8 +90,6 @@ Module Name:
 
 #define GREP_READ_BLOCK_SIZE 1024
 
-#define GREP_INITIAL_LINE_SIZE 16
-
 //
 // Define grep options.
 //
@@ -164,6 +168,46 @@ Module Name:
 
 #define GREP_MAX_RECURSION_DEPTH 300
 
+//
+// Define the number of fixed string patterns at which grep stops searching
+// for each pattern individually and instead compiles them all into a single
+// Aho-Corasick automaton that scans each line once.
+//
+
+#define GREP_AUTOMATON_MINIMUM_PATTERNS 4
+
+//
+// Define the index of the root state of the automaton, and the value used to
+// indicate a missing transition.
+//
+
+#define GREP_AUTOMATON_ROOT 0
+#define GREP_AUTOMATON_NO_STATE MAX_ULONG
+
+//
+// Define the number of outgoing edges above which transitions are found with
+// a binary search rather than a linear scan.
+//
+
+#define GREP_AUTOMATON_LINEAR_SEARCH_MAX 8
+
+//
+// Define automaton state flags.
+//
+
+//
+// This flag is set if a pattern ends exactly at this state.
+//
+
+#define GREP_STATE_PATTERN_END 0x0001
+
+//
+// This flag is set if a pattern ends at this state or at any state along its
+// chain of failure links, meaning that reaching this state is a match.
+//
+
+#define GREP_STATE_MATCH 0x0002
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -180,8 +224,8 @@ Structure Description:
 
     FileName - Stores the name of the file.
 
-    File - Stores the open file pointer, or NULL if the file could not be
-        opened.
+    Descriptor - Stores the open file descriptor, or -1 if the file has not
+        been opened.
 
     Binary - Stores a boolean indicating if this file is a binray file or not.
 
@@ -190,7 +234,7 @@ Structure Description:
 typedef struct _GREP_INPUT {
     LIST_ENTRY ListEntry;
     PSTR FileName;
-    FILE *File;
+    INT Descriptor;
     BOOL Binary;
 } GREP_INPUT, *PGREP_INPUT;
 
@@ -204,7 +248,13 @@ Structure Description:
 
     ListEntry - Stores pointers to the next and previous pattern entries.
 
-    Pattern - Stores the pattern string.
+    Pattern - Stores the pattern string. For fixed strings with the ignore
+        case option, this is stored case folded.
+
+    PatternLength - Stores the length of the fixed string pattern.
+
+    SkipTable - Stores a pointer to the Horspool bad character shift table for
+        fixed string patterns, indexed by case folded input character.
 
     Expression - Stores the regular expression structure.
 
@@ -213,11 +263,104 @@ Structure Description:
 typedef struct _GREP_PATTERN {
     LIST_ENTRY ListEntry;
     PSTR Pattern;
+    size_t PatternLength;
+    size_t *SkipTable;
     regex_t Expression;
 } GREP_PATTERN, *PGREP_PATTERN;
 
 /*++
 
+Structure Description:
+
+    This structure defines a node of the trie built on the way to creating the
+    fixed string automaton.
+
+Members:
+
+    FirstChild - Stores the index of the first child node, or 0 if the node
+        has no children. Children are kept sorted by label. The root is node 0,
+        which can never be a child.
+
+    NextSibling - Stores the index of the next sibling node, or 0 if this is
+        the last child of its parent.
+
+    Label - Stores the input character leading into this node.
+
+    PatternEnd - Stores a boolean indicating if a pattern ends at this node.
+
+--*/
+
+typedef struct _GREP_TRIE_NODE {
+    ULONG FirstChild;
+    ULONG NextSibling;
+    UCHAR Label;
+    UCHAR PatternEnd;
+} GREP_TRIE_NODE, *PGREP_TRIE_NODE;
+
+/*++
+
+Structure Description:
+
+    This structure defines a state in the fixed string automaton.
+
+Members:
+
+    EdgeIndex - Stores the index into the edge arrays of the first outgoing
+        edge of this state. Edges for a state are contiguous and sorted by
+        label.
+
+    EdgeCount - Stores the number of outgoing edges.
+
+    Flags - Stores a bitfield of flags about the state. See GREP_STATE_*
+        definitions.
+
+    Failure - Stores the index of the state representing the longest proper
+        suffix of this state's string that is also a prefix of some pattern.
+
+--*/
+
+typedef struct _GREP_AUTOMATON_STATE {
+    ULONG EdgeIndex;
+    USHORT EdgeCount;
+    USHORT Flags;
+    ULONG Failure;
+} GREP_AUTOMATON_STATE, *PGREP_AUTOMATON_STATE;
+
+/*++
+
+Structure Description:
+
+    This structure defines an Aho-Corasick automaton matching all fixed
+    string patterns at once. States are numbered in breadth first order, so
+    the shallow states visited most often sit together in memory.
+
+Members:
+
+    RootTransition - Stores the full transition row for the root state, which
+        is where the scan spends most of its time. Characters that do not
+        start any pattern lead back to the root.
+
+    States - Stores the array of states.
+
+    StateCount - Stores the number of states in the automaton.
+
+    EdgeLabels - Stores the array of edge labels (folded input characters).
+
+    EdgeTargets - Stores the array of edge destination states, parallel to
+        the labels array.
+
+--*/
+
+typedef struct _GREP_AUTOMATON {
+    ULONG RootTransition[256];
+    PGREP_AUTOMATON_STATE States;
+    ULONG StateCount;
+    PUCHAR EdgeLabels;
+    PULONG EdgeTargets;
+} GREP_AUTOMATON, *PGREP_AUTOMATON;
+
+/*++
+
 Structure Description:
 
     This structure defines the context for an instantiation of the grep
@@ -231,12 +374,21 @@ Structure Description:
 
     Options - Stores the application options. See GREP_OPTION_* definitions.
 
+    FoldTable - Stores the table used to fold input characters before
+        comparing them against fixed string patterns. This is the identity
+        mapping unless case is being ignored.
+
+    Automaton - Stores an optional pointer to the automaton matching all the
+        fixed string patterns at once.
+
 --*/
 
 typedef struct _GREP_CONTEXT {
     LIST_ENTRY InputList;
     LIST_ENTRY PatternList;
     ULONG Options;
+    UCHAR FoldTable[256];
+    PGREP_AUTOMATON Automaton;
 } GREP_CONTEXT, *PGREP_CONTEXT;
 
 //
@@ -260,6 +412,23 @@ GrepCompileRegularExpressions (
     PGREP_CONTEXT Context
     );
 
+INT
+GrepCompileFixedStrings (
+    PGREP_CONTEXT Context
+    );
+
+INT
+GrepCompileAutomaton (
+    PGREP_CONTEXT Context,
+    size_t PatternCount,
+    size_t TotalLength
+    );
+
+VOID
+GrepDestroyAutomaton (
+    PGREP_AUTOMATON Automaton
+    );
+
 INT
 GrepAddInputFile (
     PGREP_CONTEXT Context,
@@ -276,22 +445,30 @@ INT
 GrepProcessInputEntry (
     PGREP_CONTEXT Context,
     PGREP_INPUT Input,
-    PSTR *Buffer,
-    size_t *BufferSize
+    PSWISS_LINE_READER Reader
     );
 
 INT
 GrepReadLine (
     PGREP_CONTEXT Context,
     PGREP_INPUT Input,
-    PSTR *Buffer,
-    size_t *BufferSize
+    PSWISS_LINE_READER Reader,
+    PSTR *Line,
+    size_t *Length
+    );
+
+BOOL
+GrepMatchLine (
+    PGREP_CONTEXT Context,
+    PSTR Input,
+    size_t Length
     );
 
 BOOL
 GrepMatchPattern (
     PGREP_CONTEXT Context,
     PSTR Input,
+    size_t Length,
     PGREP_PATTERN Pattern
     );
 
@@ -299,9 +476,32 @@ BOOL
 GrepMatchFixedString (
     PGREP_CONTEXT Context,
     PSTR Input,
+    size_t Length,
+    PGREP_PATTERN Pattern
+    );
+
+PSTR
+GrepSearchFixedString (
+    PGREP_CONTEXT Context,
+    PSTR Input,
+    size_t Length,
     PGREP_PATTERN Pattern
     );
 
+BOOL
+GrepMatchAutomaton (
+    PGREP_CONTEXT Context,
+    PSTR Input,
+    size_t Length
+    );
+
+ULONG
+GrepFindTransition (
+    PGREP_AUTOMATON Automaton,
+    ULONG State,
+    UCHAR Character
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -660,7 +860,7 @@ Return Value:
             goto MainEnd;
         }
 
-        InputEntry->File = stdin;
+        InputEntry->Descriptor = STDIN_FILENO;
         InputEntry->FileName = strdup("(standard in)");
         if (InputEntry->FileName == NULL) {
             Status = ENOMEM;
@@ -705,8 +905,10 @@ Return Value:
     while (LIST_EMPTY(&(Context.InputList)) == FALSE) {
         InputEntry = LIST_VALUE(Context.InputList.Next, GREP_INPUT, ListEntry);
         LIST_REMOVE(&(InputEntry->ListEntry));
-        if ((InputEntry->File != stdin) && (InputEntry->File != NULL)) {
-            fclose(InputEntry->File);
+        if ((InputEntry->Descriptor != STDIN_FILENO) &&
+            (InputEntry->Descriptor >= 0)) {
+
+            close(InputEntry->Descriptor);
         }
 
         if (InputEntry->FileName != NULL) {
@@ -726,9 +928,17 @@ Return Value:
             regfree(&(Pattern->Expression));
         }
 
+        if (Pattern->SkipTable != NULL) {
+            free(Pattern->SkipTable);
+        }
+
         free(Pattern);
     }
 
+    if (Context.Automaton != NULL) {
+        GrepDestroyAutomaton(Context.Automaton);
+    }
+
     return Status;
 }
 
@@ -998,11 +1208,11 @@ Return Value:
     INT Status;
 
     //
-    // Skip this if they're just fixed strings and not regular expressions.
+    // Fixed strings get search tables rather than regular expressions.
     //
 
     if ((Context->Options & GREP_OPTION_FIXED_STRINGS) != 0) {
-        return 0;
+        return GrepCompileFixedStrings(Context);
     }
 
     //
@@ -1062,26 +1272,21 @@ Return Value:
 }
 
 INT
-GrepAddInputFile (
-    PGREP_CONTEXT Context,
-    PSTR Path,
-    ULONG RecursionLevel
+GrepCompileFixedStrings (
+    PGREP_CONTEXT Context
     )
 
 /*++
 
 Routine Description:
 
-    This routine adds a file to the list of files grep should process.
+    This routine builds the case folding table and the Horspool shift table
+    for each fixed string pattern.
 
 Arguments:
 
     Context - Supplies a pointer to the application context.
 
-    Path - Supplies a pointer to the file path to add.
-
-    RecursionLevel - Supplies the recursion depth of this function.
-
 Return Value:
 
     0 on success.
@@ -1092,139 +1297,108 @@ Return Value:
 
 {
 
-    PSTR AppendedPath;
-    ULONG AppendedPathSize;
-    DIR *Directory;
-    struct dirent Entry;
-    struct dirent *EntryPointer;
-    PGREP_INPUT InputEntry;
-    struct stat Stat;
-    INT Status;
-
-    Directory = NULL;
-    InputEntry = NULL;
-    Status = SwStat(Path, TRUE, &Stat);
-    if (Status != 0) {
-        Status = errno;
-        SwPrintError(Status, Path, "Unable to stat");
-        goto AddInputFileEnd;
-    }
-
-    if (S_ISDIR(Stat.st_mode)) {
-
-        //
-        // Skip it unless recursive mode is on.
-        //
+    INT Character;
+    PLIST_ENTRY CurrentEntry;
+    size_t Index;
+    size_t Length;
+    PGREP_PATTERN Pattern;
+    size_t PatternCount;
+    PUCHAR PatternString;
+    size_t *SkipTable;
+    size_t TotalLength;
 
-        if ((Context->Options & GREP_OPTION_RECURSIVE) == 0) {
-            Status = 0;
-            goto AddInputFileEnd;
-        }
+    //
+    // Build the fold table once, so that ignoring case costs the same single
+    // table lookup per byte as the case sensitive search.
+    //
 
-        if (RecursionLevel >= GREP_MAX_RECURSION_DEPTH) {
-            SwPrintError(Status, Path, "Max recursion depth reached");
-            Status = ELOOP;
-            goto AddInputFileEnd;
+    for (Character = 0; Character < 256; Character += 1) {
+        Context->FoldTable[Character] = Character;
+        if ((Context->Options & GREP_OPTION_IGNORE_CASE) != 0) {
+            Context->FoldTable[Character] = tolower(Character);
         }
+    }
 
-        Directory = opendir(Path);
-        if (Directory == NULL) {
-            Status = errno;
-            SwPrintError(Status, Path, "Unable to open directory");
-            goto AddInputFileEnd;
+    PatternCount = 0;
+    TotalLength = 0;
+    CurrentEntry = Context->PatternList.Next;
+    while (CurrentEntry != &(Context->PatternList)) {
+        Pattern = LIST_VALUE(CurrentEntry, GREP_PATTERN, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        PatternString = (PUCHAR)(Pattern->Pattern);
+        Length = strlen(Pattern->Pattern);
+        Pattern->PatternLength = Length;
+        for (Index = 0; Index < Length; Index += 1) {
+            PatternString[Index] = Context->FoldTable[PatternString[Index]];
         }
 
-        //
-        // Loop through all entries in the directory.
-        //
-
-        while (TRUE) {
-            Status = SwReadDirectory(Directory, &Entry, &EntryPointer);
-            if (Status != 0) {
-                SwPrintError(Status, Path, "Unable to read directory");
-                goto AddInputFileEnd;
-            }
-
-            if (EntryPointer == NULL) {
-                break;
-            }
-
-            if ((strcmp(Entry.d_name, ".") == 0) ||
-                (strcmp(Entry.d_name, "..") == 0)) {
-
-                continue;
-            }
-
-            Status = SwAppendPath(Path,
-                                  strlen(Path) + 1,
-                                  Entry.d_name,
-                                  strlen(Entry.d_name) + 1,
-                                  &AppendedPath,
-                                  &AppendedPathSize);
+        PatternCount += 1;
+        TotalLength += Length;
+    }
 
-            if (Status == FALSE) {
-                Status = ENOMEM;
-                goto AddInputFileEnd;
-            }
+    //
+    // With enough patterns, searching for each one in turn loses to scanning
+    // the line once with an automaton that matches them all.
+    //
 
-            Status = GrepAddInputFile(Context,
-                                      AppendedPath,
-                                      RecursionLevel + 1);
+    if (PatternCount >= GREP_AUTOMATON_MINIMUM_PATTERNS) {
+        return GrepCompileAutomaton(Context, PatternCount, TotalLength);
+    }
 
-            free(AppendedPath);
-            if (Status != 0) {
-                goto AddInputFileEnd;
-            }
+    CurrentEntry = Context->PatternList.Next;
+    while (CurrentEntry != &(Context->PatternList)) {
+        Pattern = LIST_VALUE(CurrentEntry, GREP_PATTERN, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        PatternString = (PUCHAR)(Pattern->Pattern);
+        Length = Pattern->PatternLength;
+        SkipTable = malloc(sizeof(size_t) * 256);
+        if (SkipTable == NULL) {
+            return ENOMEM;
         }
 
-    //
-    // This is not a directory, add it as an input.
-    //
+        //
+        // Characters not in the pattern (other than in the last position)
+        // allow the window to move over by the whole pattern length.
+        //
 
-    } else {
-        InputEntry = malloc(sizeof(GREP_INPUT));
-        if (InputEntry == NULL) {
-            Status = ENOMEM;
-            goto AddInputFileEnd;
+        for (Character = 0; Character < 256; Character += 1) {
+            SkipTable[Character] = Length;
         }
 
-        memset(InputEntry, 0, sizeof(GREP_INPUT));
-        InputEntry->FileName = strdup(Path);
-        if (InputEntry->FileName == NULL) {
-            Status = ENOMEM;
-            goto AddInputFileEnd;
+        for (Index = 0; Index + 1 < Length; Index += 1) {
+            SkipTable[PatternString[Index]] = Length - 1 - Index;
         }
 
-        InputEntry->Binary = FALSE;
-        INSERT_BEFORE(&(InputEntry->ListEntry), &(Context->InputList));
-        InputEntry = NULL;
-    }
-
-    Status = 0;
-
-AddInputFileEnd:
-    if (Directory != NULL) {
-        closedir(Directory);
+        Pattern->SkipTable = SkipTable;
     }
 
-    return Status;
+    return 0;
 }
 
 INT
-GrepProcessInput (
-    PGREP_CONTEXT Context
+GrepCompileAutomaton (
+    PGREP_CONTEXT Context,
+    size_t PatternCount,
+    size_t TotalLength
     )
 
 /*++
 
 Routine Description:
 
-    This routine compiles all regular expression patterns if appropriate.
+    This routine compiles all of the (already case folded) fixed string
+    patterns into a single Aho-Corasick automaton. A trie of the patterns is
+    built first, then flattened in breadth first order into compact state and
+    edge arrays, and finally the failure links are computed.
 
 Arguments:
 
     Context - Supplies a pointer to the application context.
 
+    PatternCount - Supplies the number of patterns in the pattern list.
+
+    TotalLength - Supplies the sum of the lengths of all patterns.
+
 Return Value:
 
     0 on success.
@@ -1235,50 +1409,480 @@ Return Value:
 
 {
 
+    PGREP_AUTOMATON Automaton;
+    UCHAR Character;
+    ULONG Child;
     PLIST_ENTRY CurrentEntry;
-    BOOL FileOpened;
-    PGREP_INPUT Input;
-    PSTR LineBuffer;
-    size_t LineBufferSize;
+    ULONG Edge;
+    ULONG EdgeEnd;
+    ULONG Failure;
+    ULONG Head;
+    size_t Index;
+    ULONG Next;
+    ULONG Node;
+    ULONG NodeCount;
+    PGREP_TRIE_NODE Nodes;
+    PGREP_PATTERN Pattern;
+    PUCHAR PatternString;
+    ULONG Previous;
+    PULONG Queue;
+    PGREP_AUTOMATON_STATE States;
     INT Status;
-    INT TotalStatus;
+    ULONG Tail;
 
-    LineBuffer = NULL;
-    LineBufferSize = 0;
-    TotalStatus = 1;
+    Automaton = NULL;
+    Queue = NULL;
 
     //
-    // Just loop through each input.
+    // The trie can have at most one node per pattern character, plus the root.
     //
 
-    CurrentEntry = Context->InputList.Next;
-    while (CurrentEntry != &(Context->InputList)) {
-        Input = LIST_VALUE(CurrentEntry, GREP_INPUT, ListEntry);
-        CurrentEntry = CurrentEntry->Next;
-        FileOpened = FALSE;
-        if (Input->File == NULL) {
-            Input->File = fopen(Input->FileName, "r");
-            if (Input->File == NULL) {
-                if ((Context->Options &
-                     GREP_OPTION_SUPPRESS_BLAND_ERRORS) == 0) {
+    if (TotalLength + 1 >= GREP_AUTOMATON_NO_STATE) {
+        return ENOMEM;
+    }
 
-                    Status = errno;
+    Nodes = malloc((TotalLength + 1) * sizeof(GREP_TRIE_NODE));
+    if (Nodes == NULL) {
+        Status = ENOMEM;
+        goto CompileAutomatonEnd;
+    }
+
+    memset(&(Nodes[GREP_AUTOMATON_ROOT]), 0, sizeof(GREP_TRIE_NODE));
+    NodeCount = 1;
+
+    //
+    // Add each pattern to the trie, keeping each node's children sorted.
+    //
+
+    CurrentEntry = Context->PatternList.Next;
+    while (CurrentEntry != &(Context->PatternList)) {
+        Pattern = LIST_VALUE(CurrentEntry, GREP_PATTERN, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        PatternString = (PUCHAR)(Pattern->Pattern);
+        Node = GREP_AUTOMATON_ROOT;
+        for (Index = 0; Index < Pattern->PatternLength; Index += 1) {
+            Character = PatternString[Index];
+            Previous = 0;
+            Child = Nodes[Node].FirstChild;
+            while ((Child != 0) && (Nodes[Child].Label < Character)) {
+                Previous = Child;
+                Child = Nodes[Child].NextSibling;
+            }
+
+            if ((Child == 0) || (Nodes[Child].Label != Character)) {
+                Nodes[NodeCount].FirstChild = 0;
+                Nodes[NodeCount].NextSibling = Child;
+                Nodes[NodeCount].Label = Character;
+                Nodes[NodeCount].PatternEnd = FALSE;
+                Child = NodeCount;
+                NodeCount += 1;
+                if (Previous == 0) {
+                    Nodes[Node].FirstChild = Child;
+
+                } else {
+                    Nodes[Previous].NextSibling = Child;
+                }
+            }
+
+            Node = Child;
+        }
+
+        Nodes[Node].PatternEnd = TRUE;
+    }
+
+    Automaton = malloc(sizeof(GREP_AUTOMATON));
+    if (Automaton == NULL) {
+        Status = ENOMEM;
+        goto CompileAutomatonEnd;
+    }
+
+    memset(Automaton, 0, sizeof(GREP_AUTOMATON));
+    Automaton->StateCount = NodeCount;
+    Automaton->States = malloc(NodeCount * sizeof(GREP_AUTOMATON_STATE));
+    Automaton->EdgeLabels = malloc(NodeCount * sizeof(UCHAR));
+    Automaton->EdgeTargets = malloc(NodeCount * sizeof(ULONG));
+    Queue = malloc(NodeCount * sizeof(ULONG));
+    if ((Automaton->States == NULL) || (Automaton->EdgeLabels == NULL) ||
+        (Automaton->EdgeTargets == NULL) || (Queue == NULL)) {
+
+        Status = ENOMEM;
+        goto CompileAutomatonEnd;
+    }
+
+    //
+    // Flatten the trie in breadth first order. A node's new state index is
+    // its position in the queue, which is known as soon as it is queued, so
+    // each state's edges can be written out as the state is dequeued.
+    //
+
+    States = Automaton->States;
+    Edge = 0;
+    Head = 0;
+    Tail = 1;
+    Queue[0] = GREP_AUTOMATON_ROOT;
+    while (Head < Tail) {
+        Node = Queue[Head];
+        States[Head].EdgeIndex = Edge;
+        States[Head].EdgeCount = 0;
+        States[Head].Flags = 0;
+        States[Head].Failure = GREP_AUTOMATON_ROOT;
+        if (Nodes[Node].PatternEnd != FALSE) {
+            States[Head].Flags = GREP_STATE_PATTERN_END | GREP_STATE_MATCH;
+        }
+
+        Child = Nodes[Node].FirstChild;
+        while (Child != 0) {
+            Automaton->EdgeLabels[Edge] = Nodes[Child].Label;
+            Automaton->EdgeTargets[Edge] = Tail;
+            Queue[Tail] = Child;
+            Tail += 1;
+            Edge += 1;
+            States[Head].EdgeCount += 1;
+            Child = Nodes[Child].NextSibling;
+        }
+
+        Head += 1;
+    }
+
+    assert(Tail == NodeCount);
+
+    free(Nodes);
+    Nodes = NULL;
+
+    //
+    // Fill out the root's full transition row.
+    //
+
+    for (Index = 0; Index < 256; Index += 1) {
+        Automaton->RootTransition[Index] = GREP_AUTOMATON_ROOT;
+    }
+
+    EdgeEnd = States[GREP_AUTOMATON_ROOT].EdgeCount;
+    for (Edge = 0; Edge < EdgeEnd; Edge += 1) {
+        Automaton->RootTransition[Automaton->EdgeLabels[Edge]] =
+                                                 Automaton->EdgeTargets[Edge];
+    }
+
+    //
+    // Compute the failure links, again in breadth first order so that every
+    // shallower state is complete before it is needed. The children of the
+    // root fail back to the root, which the initialization above handled.
+    // A state inherits the match flag from the state it fails to, so that
+    // patterns that are suffixes of other partial matches are not missed.
+    //
+
+    for (Node = 1; Node < NodeCount; Node += 1) {
+        Edge = States[Node].EdgeIndex;
+        EdgeEnd = Edge + States[Node].EdgeCount;
+        while (Edge < EdgeEnd) {
+            Character = Automaton->EdgeLabels[Edge];
+            Child = Automaton->EdgeTargets[Edge];
+            Failure = States[Node].Failure;
+            while (TRUE) {
+                if (Failure == GREP_AUTOMATON_ROOT) {
+                    Next = Automaton->RootTransition[Character];
+                    break;
+                }
+
+                Next = GrepFindTransition(Automaton, Failure, Character);
+
+                if (Next != GREP_AUTOMATON_NO_STATE) {
+                    break;
+                }
+
+                Failure = States[Failure].Failure;
+            }
+
+            States[Child].Failure = Next;
+            States[Child].Flags |= States[Next].Flags & GREP_STATE_MATCH;
+            Edge += 1;
+        }
+    }
+
+    Context->Automaton = Automaton;
+    Automaton = NULL;
+    Status = 0;
+
+CompileAutomatonEnd:
+    if (Nodes != NULL) {
+        free(Nodes);
+    }
+
+    if (Queue != NULL) {
+        free(Queue);
+    }
+
+    if (Automaton != NULL) {
+        GrepDestroyAutomaton(Automaton);
+    }
+
+    return Status;
+}
+
+VOID
+GrepDestroyAutomaton (
+    PGREP_AUTOMATON Automaton
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys a fixed string automaton.
+
+Arguments:
+
+    Automaton - Supplies a pointer to the automaton to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (Automaton->States != NULL) {
+        free(Automaton->States);
+    }
+
+    if (Automaton->EdgeLabels != NULL) {
+        free(Automaton->EdgeLabels);
+    }
+
+    if (Automaton->EdgeTargets != NULL) {
+        free(Automaton->EdgeTargets);
+    }
+
+    free(Automaton);
+    return;
+}
+
+INT
+GrepAddInputFile (
+    PGREP_CONTEXT Context,
+    PSTR Path,
+    ULONG RecursionLevel
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds a file to the list of files grep should process.
+
+Arguments:
+
+    Context - Supplies a pointer to the application context.
+
+    Path - Supplies a pointer to the file path to add.
+
+    RecursionLevel - Supplies the recursion depth of this function.
+
+Return Value:
+
+    0 on success.
+
+    Non-zero on failure.
+
+--*/
+
+{
+
+    PSTR AppendedPath;
+    ULONG AppendedPathSize;
+    DIR *Directory;
+    struct dirent Entry;
+    struct dirent *EntryPointer;
+    PGREP_INPUT InputEntry;
+    struct stat Stat;
+    INT Status;
+
+    Directory = NULL;
+    InputEntry = NULL;
+    Status = SwStat(Path, TRUE, &Stat);
+    if (Status != 0) {
+        Status = errno;
+        SwPrintError(Status, Path, "Unable to stat");
+        goto AddInputFileEnd;
+    }
+
+    if (S_ISDIR(Stat.st_mode)) {
+
+        //
+        // Skip it unless recursive mode is on.
+        //
+
+        if ((Context->Options & GREP_OPTION_RECURSIVE) == 0) {
+            Status = 0;
+            goto AddInputFileEnd;
+        }
+
+        if (RecursionLevel >= GREP_MAX_RECURSION_DEPTH) {
+            SwPrintError(Status, Path, "Max recursion depth reached");
+            Status = ELOOP;
+            goto AddInputFileEnd;
+        }
+
+        Directory = opendir(Path);
+        if (Directory == NULL) {
+            Status = errno;
+            SwPrintError(Status, Path, "Unable to open directory");
+            goto AddInputFileEnd;
+        }
+
+        //
+        // Loop through all entries in the directory.
+        //
+
+        while (TRUE) {
+            Status = SwReadDirectory(Directory, &Entry, &EntryPointer);
+            if (Status != 0) {
+                SwPrintError(Status, Path, "Unable to read directory");
+                goto AddInputFileEnd;
+            }
+
+            if (EntryPointer == NULL) {
+                break;
+            }
+
+            if ((strcmp(Entry.d_name, ".") == 0) ||
+                (strcmp(Entry.d_name, "..") == 0)) {
+
+                continue;
+            }
+
+            Status = SwAppendPath(Path,
+                                  strlen(Path) + 1,
+                                  Entry.d_name,
+                                  strlen(Entry.d_name) + 1,
+                                  &AppendedPath,
+                                  &AppendedPathSize);
+
+            if (Status == FALSE) {
+                Status = ENOMEM;
+                goto AddInputFileEnd;
+            }
+
+            Status = GrepAddInputFile(Context,
+                                      AppendedPath,
+                                      RecursionLevel + 1);
+
+            free(AppendedPath);
+            if (Status != 0) {
+                goto AddInputFileEnd;
+            }
+        }
+
+    //
+    // This is not a directory, add it as an input.
+    //
+
+    } else {
+        InputEntry = malloc(sizeof(GREP_INPUT));
+        if (InputEntry == NULL) {
+            Status = ENOMEM;
+            goto AddInputFileEnd;
+        }
+
+        memset(InputEntry, 0, sizeof(GREP_INPUT));
+        InputEntry->FileName = strdup(Path);
+        if (InputEntry->FileName == NULL) {
+            Status = ENOMEM;
+            goto AddInputFileEnd;
+        }
+
+        InputEntry->Descriptor = -1;
+        InputEntry->Binary = FALSE;
+        INSERT_BEFORE(&(InputEntry->ListEntry), &(Context->InputList));
+        InputEntry = NULL;
+    }
+
+    Status = 0;
+
+AddInputFileEnd:
+    if (Directory != NULL) {
+        closedir(Directory);
+    }
+
+    return Status;
+}
+
+INT
+GrepProcessInput (
+    PGREP_CONTEXT Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine compiles all regular expression patterns if appropriate.
+
+Arguments:
+
+    Context - Supplies a pointer to the application context.
+
+Return Value:
+
+    0 on success.
+
+    Non-zero on failure.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    BOOL FileOpened;
+    PGREP_INPUT Input;
+    PSWISS_LINE_READER Reader;
+    INT Status;
+    INT TotalStatus;
+
+    TotalStatus = 1;
+
+    //
+    // Create a single line reader whose buffer is shared across all inputs.
+    //
+
+    Reader = SwCreateLineReader(-1);
+    if (Reader == NULL) {
+        TotalStatus = ENOMEM;
+        goto ProcessInputEnd;
+    }
+
+    //
+    // Just loop through each input.
+    //
+
+    CurrentEntry = Context->InputList.Next;
+    while (CurrentEntry != &(Context->InputList)) {
+        Input = LIST_VALUE(CurrentEntry, GREP_INPUT, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        FileOpened = FALSE;
+        if (Input->Descriptor < 0) {
+            Input->Descriptor = open(Input->FileName, O_RDONLY);
+            if (Input->Descriptor < 0) {
+                if ((Context->Options &
+                     GREP_OPTION_SUPPRESS_BLAND_ERRORS) == 0) {
+
+                    Status = errno;
                     SwPrintError(Status, Input->FileName, "Unable to open");
                     goto ProcessInputEnd;
                 }
+
+                continue;
             }
 
             FileOpened = TRUE;
         }
 
-        Status = GrepProcessInputEntry(Context,
-                                       Input,
-                                       &LineBuffer,
-                                       &LineBufferSize);
-
+        SwResetLineReader(Reader, Input->Descriptor);
+        Status = GrepProcessInputEntry(Context, Input, Reader);
         if (FileOpened != FALSE) {
-            fclose(Input->File);
-            Input->File = NULL;
+            close(Input->Descriptor);
+            Input->Descriptor = -1;
         }
 
         if (Status == 0) {
@@ -1292,8 +1896,8 @@ Return Value:
     }
 
 ProcessInputEnd:
-    if (LineBuffer != NULL) {
-        free(LineBuffer);
+    if (Reader != NULL) {
+        SwDestroyLineReader(Reader);
     }
 
     return TotalStatus;
@@ -1303,8 +1907,7 @@ INT
 GrepProcessInputEntry (
     PGREP_CONTEXT Context,
     PGREP_INPUT Input,
-    PSTR *Buffer,
-    size_t *BufferSize
+    PSWISS_LINE_READER Reader
     )
 
 /*++
@@ -1319,12 +1922,8 @@ Routine Description:
 
     Input - Supplies a pointer to the input entry.
 
-    Buffer - Supplies a pointer that on input contains a buffer. On output,
-        returns a potentially reallocated buffer.
-
-    BufferSize - Supplies a pointer that on input contains the size of the
-        input buffer. On output, returns the potentially expanded size of the
-        buffer.
+    Reader - Supplies a pointer to the line reader, already set up to read
+        from the input's descriptor.
 
 Return Value:
 
@@ -1338,12 +1937,12 @@ Return Value:
 
 {
 
-    PLIST_ENTRY CurrentEntry;
+    PSTR Line;
+    size_t LineLength;
     ULONG LineNumber;
     BOOL Match;
     ULONG MatchCount;
     BOOL MultipleInputs;
-    PGREP_PATTERN Pattern;
     INT Status;
 
     LineNumber = 1;
@@ -1358,7 +1957,7 @@ Return Value:
     //
 
     while (TRUE) {
-        Status = GrepReadLine(Context, Input, Buffer, BufferSize);
+        Status = GrepReadLine(Context, Input, Reader, &Line, &LineLength);
         if (Status == EOF) {
             Status = 0;
             break;
@@ -1367,45 +1966,43 @@ Return Value:
             goto ProcessInputEntryEnd;
         }
 
-        CurrentEntry = Context->PatternList.Next;
-        while (CurrentEntry != &(Context->PatternList)) {
-            Pattern = LIST_VALUE(CurrentEntry, GREP_PATTERN, ListEntry);
-            CurrentEntry = CurrentEntry->Next;
-            Match = GrepMatchPattern(Context, *Buffer, Pattern);
-            if (Match != FALSE) {
-                MatchCount += 1;
-            }
-
-            //
-            // If it didn't match, keep going.
-            //
+        //
+        // Each line is matched once against the whole pattern list, and is
+        // selected at most once no matter how many patterns it matches.
+        //
 
-            if (Match == FALSE) {
-                continue;
-            }
+        Match = GrepMatchLine(Context, Line, LineLength);
+        if (Match == FALSE) {
+            LineNumber += 1;
+            continue;
+        }
 
-            if ((Context->Options & GREP_OPTION_QUIET) != 0) {
-                continue;
-            }
+        MatchCount += 1;
 
-            //
-            // If the "print file name" option is present, print the file name
-            // and suppress normal output.
-            //
+        //
+        // In quiet mode the first match decides the result, so there's no
+        // need to look any further.
+        //
 
-            if ((Context->Options & GREP_OPTION_PRINT_FILE_NAMES) != 0) {
-                printf("%s\n", Input->FileName);
-                break;
-            }
+        if ((Context->Options & GREP_OPTION_QUIET) != 0) {
+            break;
+        }
 
-            //
-            // With line counts only, just keep going.
-            //
+        //
+        // If the "print file name" option is present, print the file name
+        // and suppress normal output.
+        //
 
-            if ((Context->Options & GREP_OPTION_LINE_COUNT) != 0) {
-                continue;
-            }
+        if ((Context->Options & GREP_OPTION_PRINT_FILE_NAMES) != 0) {
+            printf("%s\n", Input->FileName);
+            break;
+        }
 
+        //
+        // With line counts only, just keep going.
+        //
+
+        if ((Context->Options & GREP_OPTION_LINE_COUNT) == 0) {
             if (Input->Binary != FALSE) {
                 printf("Binary file %s matches.\n", Input->FileName);
                 break;
@@ -1429,17 +2026,17 @@ Return Value:
             }
 
             //
-            // Print the line itself.
+            // Print the line itself. The line is known not to contain any
+            // null characters, as those would have marked the file binary.
             //
 
-            printf("%s\n", *Buffer);
+            Line[LineLength] = '\n';
+            fwrite(Line, 1, LineLength + 1, stdout);
+            Line[LineLength] = '\0';
         }
 
         LineNumber += 1;
-        if ((MatchCount != 0) &&
-            ((Input->Binary != FALSE) ||
-             ((Context->Options & GREP_OPTION_PRINT_FILE_NAMES) != 0))) {
-
+        if (Input->Binary != FALSE) {
             break;
         }
     }
@@ -1474,30 +2071,33 @@ INT
 GrepReadLine (
     PGREP_CONTEXT Context,
     PGREP_INPUT Input,
-    PSTR *Buffer,
-    size_t *BufferSize
+    PSWISS_LINE_READER Reader,
+    PSTR *Line,
+    size_t *Length
     )
 
 /*++
 
 Routine Description:
 
-    This routine reads a new line into the given buffer.
+    This routine reads the next line from the input. Lines are returned as
+    slices of the line reader's buffer, not copies.
 
 Arguments:
 
     Context - Supplies a pointer to the application context.
 
-    Input - Supplies a pointer to the input to read from.
+    Input - Supplies a pointer to the input to read from. If the line contains
+        null characters, the input is marked as binary.
 
-    Buffer - Supplies a pointer that on input contains a buffer. On output,
-        returns the buffer containing the line, which may be reallocated from
-        the original.
+    Reader - Supplies a pointer to the line reader for the input.
 
-    BufferSize - Supplies a pointer that on input contains the size of the
-        input buffer. On output, returns the potentially expanded size of the
-        buffer. Note that this returns the size of the allocation, not the
-        length of the string. The string is null terminated.
+    Line - Supplies a pointer where a pointer to the null terminated line will
+        be returned on success. The line may contain embedded null characters
+        if the input is binary.
+
+    Length - Supplies a pointer where the length of the line in bytes will be
+        returned on success.
 
 Return Value:
 
@@ -1511,96 +2111,84 @@ Return Value:
 
 {
 
-    INT Character;
-    size_t CharacterCount;
-    PSTR NewBuffer;
     INT Status;
-    PSTR String;
-    size_t StringSize;
 
-    CharacterCount = 0;
-    String = *Buffer;
-    StringSize = *BufferSize;
+    Status = SwReadLineSlice(Reader, Line, Length);
+    if (Status != 0) {
+        return Status;
+    }
 
-    //
-    // Loop reading characters.
-    //
+    if ((Input->Binary == FALSE) && (memchr(*Line, '\0', *Length) != NULL)) {
+        Input->Binary = TRUE;
+    }
 
-    while (TRUE) {
+    return 0;
+}
 
-        //
-        // Ensure that the string is big enough to take two more characters.
-        //
+BOOL
+GrepMatchLine (
+    PGREP_CONTEXT Context,
+    PSTR Input,
+    size_t Length
+    )
+
+/*++
 
-        if (CharacterCount + 2 > StringSize) {
-            if (StringSize == 0) {
-                StringSize = GREP_INITIAL_LINE_SIZE;
+Routine Description:
 
-            } else {
-                StringSize *= 2;
-            }
+    This routine determines if the given input line is selected, meaning it
+    matches at least one pattern (or, with the invert option, none of them).
 
-            assert(StringSize >= CharacterCount + 2);
+Arguments:
 
-            NewBuffer = realloc(String, StringSize);
-            if (NewBuffer == NULL) {
-                Status = ENOMEM;
-                goto ReadLineEnd;
-            }
+    Context - Supplies a pointer to the application context.
 
-            String = NewBuffer;
-        }
+    Input - Supplies a pointer to the null terminated input line.
 
-        //
-        // Get a new character. If it's the end of the file, terminate this
-        // line, or if this line is empty, return EOF overall.
-        //
+    Length - Supplies the length of the line in bytes.
 
-        Character = fgetc(Input->File);
-        if (Character == EOF) {
-            if (CharacterCount != 0) {
-                break;
-            }
+Return Value:
 
-            Status = EOF;
-            goto ReadLineEnd;
+    TRUE if the line is selected.
 
-        } else {
-            if (Character == '\0') {
-                Input->Binary = TRUE;
-            }
+    FALSE if the line is not selected.
 
-            //
-            // Skip over any null terminators at the beginning.
-            //
+--*/
 
-            if ((Character == '\0') && (CharacterCount == 0)) {
-                continue;
-            }
+{
 
-            if ((Character == '\n') || (Character == '\0')) {
-                break;
+    PLIST_ENTRY CurrentEntry;
+    BOOL Match;
+    PGREP_PATTERN Pattern;
 
-            } else {
-                String[CharacterCount] = Character;
-                CharacterCount += 1;
+    Match = FALSE;
+    if (Context->Automaton != NULL) {
+        Match = GrepMatchAutomaton(Context, Input, Length);
+
+    } else {
+        CurrentEntry = Context->PatternList.Next;
+        while (CurrentEntry != &(Context->PatternList)) {
+            Pattern = LIST_VALUE(CurrentEntry, GREP_PATTERN, ListEntry);
+            CurrentEntry = CurrentEntry->Next;
+            Match = GrepMatchPattern(Context, Input, Length, Pattern);
+            if (Match != FALSE) {
+                break;
             }
         }
     }
 
-    String[CharacterCount] = '\0';
-    Status = 0;
+    if ((Context->Options & GREP_OPTION_NEGATE_SEARCH) != 0) {
+        Match = !Match;
+    }
 
-ReadLineEnd:
-    *Buffer = String;
-    *BufferSize = StringSize;
-    return Status;
+    return Match;
 }
 
 BOOL
 GrepMatchPattern (
     PGREP_CONTEXT Context,
     PSTR Input,
+    size_t Length,
     PGREP_PATTERN Pattern
     )
 
@@ -1617,6 +2205,10 @@ Routine Description:
 
     Input - Supplies a pointer to the null terminated input line.
 
+    Length - Supplies the length of the line in bytes. If this is longer than
+        the string length, the line contains embedded null characters, and each
+        null separated segment is matched individually.
+
     Pattern - Supplies a pointer to the pattern to match against.
 
 Return Value:
@@ -1631,33 +2223,54 @@ Return Value:
 
     regmatch_t ExpressionMatch;
     BOOL Match;
+    size_t SegmentLength;
     INT Status;
 
-    Match = FALSE;
-
     //
-    // First figure out if the pattern matched.
+    // Fixed strings are searched with an explicit length, so embedded null
+    // characters need no special handling.
     //
 
     if ((Context->Options & GREP_OPTION_FIXED_STRINGS) != 0) {
-        Match = GrepMatchFixedString(Context, Input, Pattern);
+        Match = GrepMatchFixedString(Context, Input, Length, Pattern);
 
     } else {
-        Status = regexec(&(Pattern->Expression), Input, 1, &ExpressionMatch, 0);
-        if (Status == 0) {
-            Match = TRUE;
-            if ((Context->Options & GREP_OPTION_FULL_LINE_ONLY) != 0) {
-                if ((ExpressionMatch.rm_so != 0) ||
-                    (Input[ExpressionMatch.rm_eo - 1] != '\0')) {
-
-                    Match = FALSE;
+        while (TRUE) {
+            Match = FALSE;
+            Status = regexec(&(Pattern->Expression),
+                             Input,
+                             1,
+                             &ExpressionMatch,
+                             0);
+
+            if (Status == 0) {
+                Match = TRUE;
+                if ((Context->Options & GREP_OPTION_FULL_LINE_ONLY) != 0) {
+                    if ((ExpressionMatch.rm_so != 0) ||
+                        (Input[ExpressionMatch.rm_eo - 1] != '\0')) {
+
+                        Match = FALSE;
+                    }
                 }
             }
-        }
-    }
 
-    if ((Context->Options & GREP_OPTION_NEGATE_SEARCH) != 0) {
-        Match = !Match;
+            if (Match != FALSE) {
+                break;
+            }
+
+            //
+            // Move on to the next null separated segment of a binary line, if
+            // there is one.
+            //
+
+            SegmentLength = strlen(Input);
+            if (SegmentLength >= Length) {
+                break;
+            }
+
+            Input += SegmentLength + 1;
+            Length -= SegmentLength + 1;
+        }
     }
 
     return Match;
@@ -1667,6 +2280,7 @@ BOOL
 GrepMatchFixedString (
     PGREP_CONTEXT Context,
     PSTR Input,
+    size_t Length,
     PGREP_PATTERN Pattern
     )
 
@@ -1680,7 +2294,9 @@ Routine Description:
 
     Context - Supplies a pointer to the application context.
 
-    Input - Supplies a pointer to the null terminated input line.
+    Input - Supplies a pointer to the input line.
+
+    Length - Supplies the length of the input line in bytes.
 
     Pattern - Supplies a pointer to the pattern to match against.
 
@@ -1694,68 +2310,367 @@ Return Value:
 
 {
 
-    ULONG BeginIndex;
-    BOOL IgnoreCase;
-    BOOL Match;
-    PSTR PatternString;
-    ULONG SearchIndex;
+    PUCHAR FoldTable;
+    size_t Index;
+    PUCHAR PatternString;
+
+    //
+    // If the match is required to use up the whole line, then the line is
+    // either exactly the pattern or it isn't a match.
+    //
+
+    if ((Context->Options & GREP_OPTION_FULL_LINE_ONLY) != 0) {
+        if (Length != Pattern->PatternLength) {
+            return FALSE;
+        }
+
+        FoldTable = Context->FoldTable;
+        PatternString = (PUCHAR)(Pattern->Pattern);
+        for (Index = 0; Index < Length; Index += 1) {
+            if (FoldTable[(UCHAR)(Input[Index])] != PatternString[Index]) {
+                return FALSE;
+            }
+        }
+
+        return TRUE;
+    }
+
+    if (GrepSearchFixedString(Context, Input, Length, Pattern) != NULL) {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+PSTR
+GrepSearchFixedString (
+    PGREP_CONTEXT Context,
+    PSTR Input,
+    size_t Length,
+    PGREP_PATTERN Pattern
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the first occurrence of a fixed string pattern within
+    the given input. Where SSE2 is available, candidate positions are first
+    found sixteen at a time by comparing against the first and last pattern
+    characters. The remainder is searched with the Boyer-Moore-Horspool
+    algorithm.
+
+Arguments:
+
+    Context - Supplies a pointer to the application context.
 
-    IgnoreCase = FALSE;
+    Input - Supplies a pointer to the input to search.
+
+    Length - Supplies the length of the input in bytes.
+
+    Pattern - Supplies a pointer to the compiled fixed string pattern.
+
+Return Value:
+
+    Returns a pointer to the first occurrence of the pattern within the input.
+
+    NULL if the pattern does not occur in the input.
+
+--*/
+
+{
+
+    PUCHAR FoldTable;
+    size_t Index;
+    UCHAR LastCharacter;
+    size_t LastIndex;
+    size_t Offset;
+    PUCHAR PatternString;
+    size_t PatternLength;
+    PUCHAR Text;
+
+#if defined(__SSE2__)
+
+    __m128i Block;
+    PUCHAR Candidate;
+    UINT CandidateMask;
+    __m128i FirstAlternate;
+    __m128i FirstMatch;
+    __m128i FirstValue;
+    __m128i LastAlternate;
+    __m128i LastMatch;
+    __m128i LastValue;
+
+#endif
+
+    FoldTable = Context->FoldTable;
+    PatternString = (PUCHAR)(Pattern->Pattern);
+    PatternLength = Pattern->PatternLength;
+    Text = (PUCHAR)Input;
+    if (PatternLength == 0) {
+        return Input;
+    }
+
+    if (PatternLength > Length) {
+        return NULL;
+    }
+
+    LastIndex = PatternLength - 1;
+    LastCharacter = PatternString[LastIndex];
+    Offset = 0;
+
+#if defined(__SSE2__)
+
+    //
+    // The pattern is stored folded. When ignoring case, also compare against
+    // the upper case forms of the first and last characters.
+    //
+
+    FirstValue = _mm_set1_epi8(PatternString[0]);
+    LastValue = _mm_set1_epi8(LastCharacter);
+    FirstAlternate = FirstValue;
+    LastAlternate = LastValue;
     if ((Context->Options & GREP_OPTION_IGNORE_CASE) != 0) {
-        IgnoreCase = TRUE;
+        FirstAlternate = _mm_set1_epi8(toupper(PatternString[0]));
+        LastAlternate = _mm_set1_epi8(toupper(LastCharacter));
     }
 
-    Match = FALSE;
-    PatternString = Pattern->Pattern;
-    SearchIndex = 0;
-    BeginIndex = 0;
-    while (Input[BeginIndex] != '\0') {
-        SearchIndex = 0;
+    while (Offset + LastIndex + 16 <= Length) {
+        Block = _mm_loadu_si128((__m128i *)(Text + Offset));
+        FirstMatch = _mm_or_si128(_mm_cmpeq_epi8(Block, FirstValue),
+                                  _mm_cmpeq_epi8(Block, FirstAlternate));
 
-        //
-        // This seems like a mess, but isn't so bad. Loop as long as:
-        // 1. The pattern hasn't ended, AND
-        // 2. Either:
-        //    a. The pattern matches the input, OR
-        //    b. "Ignore case" is on and the lowercase versions of the pattern
-        //       and inputs match.
-        //
-        // See, not so bad.
-        //
+        Block = _mm_loadu_si128((__m128i *)(Text + Offset + LastIndex));
+        LastMatch = _mm_or_si128(_mm_cmpeq_epi8(Block, LastValue),
+                                 _mm_cmpeq_epi8(Block, LastAlternate));
 
-        while ((PatternString[SearchIndex] != '\0') &&
-               ((Input[BeginIndex + SearchIndex] ==
-                 PatternString[SearchIndex]) ||
-                ((IgnoreCase != FALSE) &&
-                 (tolower(Input[BeginIndex + SearchIndex]) ==
-                  tolower(PatternString[SearchIndex]))))) {
+        CandidateMask = _mm_movemask_epi8(_mm_and_si128(FirstMatch,
+                                                        LastMatch));
 
-            SearchIndex += 1;
+        while (CandidateMask != 0) {
+            Index = 0;
+            Candidate = Text + Offset + __builtin_ctz(CandidateMask);
+            while ((Index < PatternLength) &&
+                   (FoldTable[Candidate[Index]] == PatternString[Index])) {
+
+                Index += 1;
+            }
+
+            if (Index == PatternLength) {
+                return (PSTR)Candidate;
+            }
+
+            CandidateMask &= CandidateMask - 1;
         }
 
-        if (PatternString[SearchIndex] == '\0') {
-            Match = TRUE;
-            break;
+        Offset += 16;
+    }
+
+#endif
+
+    //
+    // Compare the last character of the window first, then the rest. On a
+    // mismatch, shift by the amount the skip table says is safe for the
+    // character under the end of the window.
+    //
+
+    while (Offset + LastIndex < Length) {
+        if (FoldTable[Text[Offset + LastIndex]] == LastCharacter) {
+            Index = 0;
+            while ((Index < LastIndex) &&
+                   (FoldTable[Text[Offset + Index]] == PatternString[Index])) {
+
+                Index += 1;
+            }
+
+            if (Index == LastIndex) {
+                return (PSTR)(Text + Offset);
+            }
+        }
+
+        Offset += Pattern->SkipTable[FoldTable[Text[Offset + LastIndex]]];
+    }
+
+    return NULL;
+}
+
+BOOL
+GrepMatchAutomaton (
+    PGREP_CONTEXT Context,
+    PSTR Input,
+    size_t Length
+    )
+
+/*++
+
+Routine Description:
+
+    This routine scans an input line once with the fixed string automaton to
+    determine if any of the patterns occur in it.
+
+Arguments:
+
+    Context - Supplies a pointer to the application context.
+
+    Input - Supplies a pointer to the input line.
+
+    Length - Supplies the length of the input line in bytes.
+
+Return Value:
+
+    TRUE if any pattern matched the input.
+
+    FALSE if no pattern matched.
+
+--*/
+
+{
+
+    PGREP_AUTOMATON Automaton;
+    UCHAR Character;
+    PUCHAR FoldTable;
+    size_t Index;
+    ULONG Next;
+    ULONG State;
+    PGREP_AUTOMATON_STATE States;
+    PUCHAR Text;
+
+    Automaton = Context->Automaton;
+    FoldTable = Context->FoldTable;
+    States = Automaton->States;
+    Text = (PUCHAR)Input;
+
+    //
+    // To use up the whole line, the line itself must spell out a path from
+    // the root to the end of some pattern, without ever following a failure
+    // link.
+    //
+
+    if ((Context->Options & GREP_OPTION_FULL_LINE_ONLY) != 0) {
+        State = GREP_AUTOMATON_ROOT;
+        for (Index = 0; Index < Length; Index += 1) {
+            State = GrepFindTransition(Automaton,
+                                       State,
+                                       FoldTable[Text[Index]]);
+
+            if (State == GREP_AUTOMATON_NO_STATE) {
+                return FALSE;
+            }
+        }
+
+        if ((States[State].Flags & GREP_STATE_PATTERN_END) != 0) {
+            return TRUE;
         }
 
-        BeginIndex += 1;
+        return FALSE;
     }
 
     //
-    // If there's a match and it's required to use up the whole line, see that
-    // it does. That case could have been optimized by stopping the loop above
-    // early, but it's expected to be an uncommonly used flag, so adding the
-    // extra compare in every loop iteration seemed worse.
+    // An empty pattern matches every line.
     //
 
-    if ((Match != FALSE) &&
-        ((Context->Options & GREP_OPTION_FULL_LINE_ONLY) != 0)) {
+    if ((States[GREP_AUTOMATON_ROOT].Flags & GREP_STATE_MATCH) != 0) {
+        return TRUE;
+    }
+
+    State = GREP_AUTOMATON_ROOT;
+    for (Index = 0; Index < Length; Index += 1) {
+        Character = FoldTable[Text[Index]];
+        while (TRUE) {
+            if (State == GREP_AUTOMATON_ROOT) {
+                State = Automaton->RootTransition[Character];
+                break;
+            }
+
+            Next = GrepFindTransition(Automaton, State, Character);
+            if (Next != GREP_AUTOMATON_NO_STATE) {
+                State = Next;
+                break;
+            }
 
-        if ((BeginIndex != 0) || (Input[BeginIndex + SearchIndex] != '\0')) {
-            Match = FALSE;
+            State = States[State].Failure;
+        }
+
+        if ((States[State].Flags & GREP_STATE_MATCH) != 0) {
+            return TRUE;
         }
     }
 
-    return Match;
+    return FALSE;
+}
+
+ULONG
+GrepFindTransition (
+    PGREP_AUTOMATON Automaton,
+    ULONG State,
+    UCHAR Character
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the outgoing edge of an automaton state for the given
+    character, without following failure links.
+
+Arguments:
+
+    Automaton - Supplies a pointer to the automaton.
+
+    State - Supplies the index of the state to transition from.
+
+    Character - Supplies the folded input character.
+
+Return Value:
+
+    Returns the index of the destination state.
+
+    GREP_AUTOMATON_NO_STATE if the state has no edge for the character.
+
+--*/
+
+{
+
+    ULONG Count;
+    PUCHAR Labels;
+    ULONG Maximum;
+    ULONG Middle;
+    ULONG Minimum;
+
+    Labels = Automaton->EdgeLabels + Automaton->States[State].EdgeIndex;
+    Count = Automaton->States[State].EdgeCount;
+    if (Count <= GREP_AUTOMATON_LINEAR_SEARCH_MAX) {
+        for (Middle = 0; Middle < Count; Middle += 1) {
+            if (Labels[Middle] >= Character) {
+                if (Labels[Middle] == Character) {
+                    return Automaton->EdgeTargets[
+                                   Automaton->States[State].EdgeIndex + Middle];
+                }
+
+                break;
+            }
+        }
+
+        return GREP_AUTOMATON_NO_STATE;
+    }
+
+    Minimum = 0;
+    Maximum = Count;
+    while (Minimum < Maximum) {
+        Middle = Minimum + ((Maximum - Minimum) / 2);
+        if (Labels[Middle] < Character) {
+            Minimum = Middle + 1;
+
+        } else {
+            Maximum = Middle;
+        }
+    }
+
+    if ((Minimum < Count) && (Labels[Minimum] == Character)) {
+        return Automaton->EdgeTargets[
+                                  Automaton->States[State].EdgeIndex + Minimum];
+    }
+
+    return GREP_AUTOMATON_NO_STATE;
 }
 
@@ -291,6 +291,20 @@ Return Value:
                     ConversionIndex += 1;
                 }
 
+                //
+                // A format that ends partway through a conversion has no
+                // specifier to print, and there's nothing after it to scan.
+                //
+
+                if (Format[ConversionIndex] == '\0') {
+                    SwPrintError(0,
+                                 Format + Index,
+                                 "Incomplete conversion specification");
+
+                    ReturnValue = 1;
+                    break;
+                }
+
                 //
                 // Get the conversion specifier and temporarily null terminate
                 // the format specifier.
@@ -321,13 +335,21 @@ Return Value:
                     (ConversionSpecifier == 'p') ||
                     (ConversionSpecifier == 'C')) {
 
+                    //
+                    // A missing argument is treated as zero.
+                    //
+
                     if (QuadWord != FALSE) {
-                        BigInteger = strtoll(Argument, &AfterScan, 0);
-                        if (((BigInteger == -1) && (errno != 0)) ||
-                            (AfterScan == Argument)) {
+                        BigInteger = 0;
+                        if (Argument != NULL) {
+                            errno = 0;
+                            BigInteger = strtoll(Argument, &AfterScan, 0);
+                            if ((errno != 0) || (AfterScan == Argument) ||
+                                (*AfterScan != '\0')) {
 
-                            SwPrintError(0, Argument, "Invalid number");
-                            ReturnValue = errno;
+                                SwPrintError(0, Argument, "Invalid number");
+                                ReturnValue = 1;
+                            }
                         }
 
                         printf(Format + Index, BigInteger);
@@ -342,12 +364,20 @@ Return Value:
                             }
 
                         } else {
-                            Integer = strtol(Argument, &AfterScan, 0);
-                            if (((Integer == -1) && (errno != 0)) ||
-                                (AfterScan == Argument)) {
-
-                                SwPrintError(0, Argument, "Invalid number");
-                                ReturnValue = errno;
+                            Integer = 0;
+                            if (Argument != NULL) {
+                                errno = 0;
+                                Integer = strtol(Argument, &AfterScan, 0);
+                                if ((errno != 0) ||
+                                    (AfterScan == Argument) ||
+                                    (*AfterScan != '\0')) {
+
+                                    SwPrintError(0,
+                                                 Argument,
+                                                 "Invalid number");
+
+                                    ReturnValue = 1;
+                                }
                             }
                         }
 
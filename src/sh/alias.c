@@ -65,12 +65,23 @@ ShPrintAlias (
     PSHELL_ALIAS Alias
     );
 
+VOID
+ShUpdateAliasGeneration (
+    PSHELL Shell
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
 
 BOOL ShDebugAlias = FALSE;
 
+//
+// Store the last alias generation number handed out.
+//
+
+ULONG ShLastAliasGeneration;
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -227,12 +238,14 @@ Return Value:
 
     PSHELL_ALIAS Alias;
 
-    while (LIST_EMPTY(&(Shell->AliasList)) == FALSE) {
-        Alias = LIST_VALUE(Shell->AliasList.Next, SHELL_ALIAS, ListEntry);
-        LIST_REMOVE(&(Alias->ListEntry));
+    while (LIST_EMPTY(&(Shell->Aliases.List)) == FALSE) {
+        Alias = LIST_VALUE(Shell->Aliases.List.Next, SHELL_ALIAS, ListEntry);
+        ShNameTableRemove(&(Shell->Aliases), &(Alias->ListEntry), Alias->Hash);
         ShDestroyAlias(Alias);
     }
 
+    ShDestroyNameTable(&(Shell->Aliases));
+    ShUpdateAliasGeneration(Shell);
     return;
 }
 
@@ -291,8 +304,8 @@ Return Value:
     //
 
     if (ArgumentCount == 1) {
-        CurrentEntry = Shell->AliasList.Next;
-        while (CurrentEntry != &(Shell->AliasList)) {
+        CurrentEntry = Shell->Aliases.List.Next;
+        while (CurrentEntry != &(Shell->Aliases.List)) {
             Alias = LIST_VALUE(CurrentEntry, SHELL_ALIAS, ListEntry);
             CurrentEntry = CurrentEntry->Next;
             Result = ShPrintAlias(Alias);
@@ -347,6 +360,7 @@ Return Value:
                 goto BuiltinAliasEnd;
             }
 
+            Alias->Hash = SwHashString(Name, NameSize);
             Alias->Name = Name;
             Alias->NameSize = NameSize;
         }
@@ -375,9 +389,23 @@ Return Value:
         Alias->Value = Value;
         Alias->ValueSize = ValueSize;
         if (Alias->ListEntry.Next == NULL) {
-            INSERT_BEFORE(&(Alias->ListEntry), &(Shell->AliasList));
+            Result = ShNameTableInsert(&(Shell->Aliases),
+                                       &(Alias->ListEntry),
+                                       Alias->Name,
+                                       Alias->NameSize,
+                                       Alias->Hash);
+
+            if (Result == FALSE) {
+                ShDestroyAlias(Alias);
+                Alias = NULL;
+                Name = NULL;
+                Value = NULL;
+                ReturnValue = 1;
+                goto BuiltinAliasEnd;
+            }
         }
 
+        ShUpdateAliasGeneration(Shell);
         Alias = NULL;
         Name = NULL;
         Value = NULL;
@@ -456,8 +484,12 @@ Return Value:
             ReturnValue = 1;
 
         } else {
-            LIST_REMOVE(&(Alias->ListEntry));
+            ShNameTableRemove(&(Shell->Aliases),
+                              &(Alias->ListEntry),
+                              Alias->Hash);
+
             ShDestroyAlias(Alias);
+            ShUpdateAliasGeneration(Shell);
         }
     }
 
@@ -496,21 +528,20 @@ Return Value:
 
 {
 
-    PSHELL_ALIAS Alias;
-    PLIST_ENTRY CurrentEntry;
+    PLIST_ENTRY Entry;
 
     assert((Name != NULL) && (NameSize != 0));
 
-    CurrentEntry = Shell->AliasList.Next;
-    while (CurrentEntry != &(Shell->AliasList)) {
-        Alias = LIST_VALUE(CurrentEntry, SHELL_ALIAS, ListEntry);
-        CurrentEntry = CurrentEntry->Next;
-        if (strncmp(Alias->Name, Name, NameSize - 1) == 0) {
-            return Alias;
-        }
+    Entry = ShNameTableLookup(&(Shell->Aliases),
+                              Name,
+                              NameSize,
+                              SwHashString(Name, NameSize));
+
+    if (Entry == NULL) {
+        return NULL;
     }
 
-    return NULL;
+    return LIST_VALUE(Entry, SHELL_ALIAS, ListEntry);
 }
 
 //
@@ -597,3 +628,42 @@ Return Value:
     return TRUE;
 }
 
+VOID
+ShUpdateAliasGeneration (
+    PSHELL Shell
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gives the shell a new alias generation number after its
+    aliases have changed, so that text parsed with the old aliases is not
+    reused.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell whose aliases changed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (Shell->Aliases.Count == 0) {
+        Shell->AliasGeneration = 0;
+        return;
+    }
+
+    ShLastAliasGeneration += 1;
+    if (ShLastAliasGeneration == 0) {
+        ShLastAliasGeneration += 1;
+    }
+
+    Shell->AliasGeneration = ShLastAliasGeneration;
+    return;
+}
+
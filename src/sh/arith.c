@@ -112,10 +112,122 @@ Module Name:
 #define SHELL_ARITHMETIC_OR_ASSIGN             618
 #define SHELL_ARITHMETIC_XOR_ASSIGN            619
 
+//
+// Define the number of slots in the cache of compiled expressions, and the
+// size of the largest expression that gets cached.
+//
+
+#define SHELL_ARITHMETIC_CACHE_SIZE 64
+#define SHELL_ARITHMETIC_CACHE_MAX_TEXT_SIZE 256
+
+//
+// Define the initial number of instructions allocated for a program.
+//
+
+#define SHELL_ARITHMETIC_INITIAL_PROGRAM_SIZE 8
+
+//
+// Define the number of values a program can use without allocating its
+// evaluation stack.
+//
+
+#define SHELL_ARITHMETIC_LOCAL_STACK_SIZE 16
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
 
+typedef enum _SHELL_ARITHMETIC_OPCODE {
+    ShellArithmeticInvalid,
+    ShellArithmeticConstant,
+    ShellArithmeticVariable,
+    ShellArithmeticUnary,
+    ShellArithmeticBinary,
+    ShellArithmeticTernary
+} SHELL_ARITHMETIC_OPCODE, *PSHELL_ARITHMETIC_OPCODE;
+
+/*++
+
+Structure Description:
+
+    This structure defines a single instruction of a compiled arithmetic
+    expression. Instructions run against a stack of values: constants and
+    variables push a value, and operators pop their operands and push the
+    result.
+
+Members:
+
+    Opcode - Stores the kind of instruction this is.
+
+    Operator - Stores the operator token for unary and binary instructions.
+        Unary instructions apply the operator with a left operand of zero.
+
+    Value - Stores the value pushed by a constant instruction.
+
+    Name - Stores the name of the variable pushed by a variable instruction.
+
+    NameSize - Stores the size of the name in bytes including the null
+        terminator.
+
+--*/
+
+typedef struct _SHELL_ARITHMETIC_INSTRUCTION {
+    SHELL_ARITHMETIC_OPCODE Opcode;
+    ULONG Operator;
+    LONG Value;
+    PSTR Name;
+    UINTN NameSize;
+} SHELL_ARITHMETIC_INSTRUCTION, *PSHELL_ARITHMETIC_INSTRUCTION;
+
+/*++
+
+Structure Description:
+
+    This structure defines a compiled arithmetic expression.
+
+Members:
+
+    Hash - Stores the hash of the expression text.
+
+    Text - Stores a pointer to the expression text the program was compiled
+        from, allocated with the program.
+
+    TextSize - Stores the size of the expression text in bytes.
+
+    Instructions - Stores the array of instructions.
+
+    InstructionCount - Stores the number of valid instructions in the array.
+
+    InstructionCapacity - Stores the number of instructions the array can
+        hold.
+
+    Depth - Stores the number of values on the stack after the instructions
+        emitted so far, used while compiling.
+
+    StackSize - Stores the largest number of values on the stack at any
+        point while running the program.
+
+    AssignmentName - Stores a pointer to the name of the variable the result
+        is assigned to, or NULL if the expression is not an assignment.
+
+    AssignmentNameSize - Stores the size of the assignment name in bytes
+        including the null terminator.
+
+--*/
+
+typedef struct _SHELL_ARITHMETIC_PROGRAM {
+    ULONG Hash;
+    PSTR Text;
+    UINTN TextSize;
+    PSHELL_ARITHMETIC_INSTRUCTION Instructions;
+    ULONG InstructionCount;
+    ULONG InstructionCapacity;
+    ULONG Depth;
+    ULONG StackSize;
+    PSTR AssignmentName;
+    UINTN AssignmentNameSize;
+} SHELL_ARITHMETIC_PROGRAM, *PSHELL_ARITHMETIC_PROGRAM;
+
 /*++
 
 Structure Description:
@@ -149,6 +261,9 @@ Structure Description:
 
     AssignmentNameSize - Stores the size of the assignment name in bytes.
 
+    Program - Stores a pointer to the program the parser emits instructions
+        into.
+
 --*/
 
 typedef struct _SHELL_ARITHMETIC_LEXER {
@@ -163,6 +278,7 @@ typedef struct _SHELL_ARITHMETIC_LEXER {
     UINTN TokensRead;
     PSTR AssignmentName;
     UINTN AssignmentNameSize;
+    PSHELL_ARITHMETIC_PROGRAM Program;
 } SHELL_ARITHMETIC_LEXER, *PSHELL_ARITHMETIC_LEXER;
 
 /*++
@@ -178,28 +294,45 @@ Structure Description:
         Elements get pushed onto the front of the list, so following the
         next pointer goes to older elements.
 
-    TokenType - Stores the type of this token.
-
-    Value - Stores the value for numeric tokens.
+    TokenType - Stores the type of this token. Number elements stand for a
+        value the instructions emitted so far leave on the evaluation stack.
 
 --*/
 
 typedef struct SHELL_ARITHMETIC_PARSE_ELEMENT {
     LIST_ENTRY ListEntry;
     ULONG TokenType;
-    LONG Value;
 } SHELL_ARITHMETIC_PARSE_ELEMENT, *PSHELL_ARITHMETIC_PARSE_ELEMENT;
 
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
 
+BOOL
+ShCompileArithmeticExpression (
+    PSHELL Shell,
+    PSTR String,
+    UINTN Length,
+    PSHELL_ARITHMETIC_PROGRAM *Program
+    );
+
+BOOL
+ShRunArithmeticProgram (
+    PSHELL Shell,
+    PSHELL_ARITHMETIC_PROGRAM Program,
+    PLONG ExpressionResult
+    );
+
+VOID
+ShDestroyArithmeticProgram (
+    PSHELL_ARITHMETIC_PROGRAM Program
+    );
+
 BOOL
 ShParseArithmeticExpression (
     PSHELL Shell,
     PSHELL_ARITHMETIC_LEXER Lexer,
-    BOOL Nested,
-    PLONG ExpressionResult
+    BOOL Nested
     );
 
 BOOL
@@ -220,15 +353,30 @@ ShArithmeticShiftOrReduce (
     PBOOL Shift
     );
 
+BOOL
+ShEmitArithmeticInstruction (
+    PSHELL_ARITHMETIC_LEXER Lexer,
+    SHELL_ARITHMETIC_OPCODE Opcode,
+    ULONG Operator,
+    LONG Value
+    );
+
 BOOL
 ShEvaluateArithmeticOperator (
     PSHELL Shell,
-    PSHELL_ARITHMETIC_PARSE_ELEMENT LeftValue,
-    PSHELL_ARITHMETIC_PARSE_ELEMENT Operator,
-    PSHELL_ARITHMETIC_PARSE_ELEMENT RightValue,
+    ULONG Operator,
+    LONG Left,
+    LONG Right,
     PLONG Result
     );
 
+BOOL
+ShConvertArithmeticValue (
+    PSTR String,
+    UINTN StringSize,
+    PLONG Value
+    );
+
 ULONG
 ShGetOperatorPrecedence (
     ULONG TokenType
@@ -237,7 +385,7 @@ ShGetOperatorPrecedence (
 BOOL
 ShAssignArithmeticResult (
     PSHELL Shell,
-    PSHELL_ARITHMETIC_LEXER Lexer,
+    PSHELL_ARITHMETIC_PROGRAM Program,
     LONG Value
     );
 
@@ -283,6 +431,13 @@ PSTR ShArithmeticTokenStrings[] = {
     "ARITHMETIC_XOR_ASSIGN"
 };
 
+//
+// Store the cache of compiled expressions, indexed by the hash of their text.
+// Loops tend to evaluate the same few expressions over and over.
+//
+
+PSHELL_ARITHMETIC_PROGRAM ShArithmeticCache[SHELL_ARITHMETIC_CACHE_SIZE];
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -304,105 +459,489 @@ Routine Description:
     expansions have already taken place except for variable names without a
     dollar sign.
 
-Arguments:
+Arguments:
+
+    Shell - Supplies a pointer to the shell.
+
+    String - Supplies a pointer to the input string.
+
+    Length - Supplies the length of the input string in bytes.
+
+    Answer - Supplies a pointer where the evaluation will be returned on
+        success. The caller is responsible for freeing this memory.
+
+    AnswerSize - Supplies a pointer where the size of the answer buffer will
+        be returned including the null terminating byte on success.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on failure.
+
+--*/
+
+{
+
+    PSTR AnswerBuffer;
+    ULONG CacheIndex;
+    ULONG Hash;
+    LONG NumericAnswer;
+    PSHELL_ARITHMETIC_PROGRAM Program;
+    BOOL Result;
+
+    AnswerBuffer = NULL;
+    CacheIndex = SHELL_ARITHMETIC_CACHE_SIZE;
+    Hash = 0;
+    Program = NULL;
+
+    //
+    // Look for the compiled expression in the cache, and compile it if it's
+    // not there.
+    //
+
+    if ((Length != 0) && (Length <= SHELL_ARITHMETIC_CACHE_MAX_TEXT_SIZE)) {
+        Hash = SwHashString(String, Length);
+        CacheIndex = Hash % SHELL_ARITHMETIC_CACHE_SIZE;
+        Program = ShArithmeticCache[CacheIndex];
+        if ((Program != NULL) &&
+            ((Program->Hash != Hash) ||
+             (Program->TextSize != Length) ||
+             (memcmp(Program->Text, String, Length) != 0))) {
+
+            Program = NULL;
+        }
+    }
+
+    if (Program == NULL) {
+        Result = ShCompileArithmeticExpression(Shell, String, Length, &Program);
+        if (Result == FALSE) {
+            goto EvaluateArithmeticExpressionEnd;
+        }
+
+        Program->Hash = Hash;
+        if (CacheIndex < SHELL_ARITHMETIC_CACHE_SIZE) {
+            if (ShArithmeticCache[CacheIndex] != NULL) {
+                ShDestroyArithmeticProgram(ShArithmeticCache[CacheIndex]);
+            }
+
+            ShArithmeticCache[CacheIndex] = Program;
+        }
+    }
+
+    Result = ShRunArithmeticProgram(Shell, Program, &NumericAnswer);
+    if (Result == FALSE) {
+        goto EvaluateArithmeticExpressionEnd;
+    }
+
+    //
+    // Convert the answer to a string for the caller. So nice.
+    //
+
+    AnswerBuffer = malloc(SHELL_ARITHMETIC_INTEGER_STRING_BUFFER_SIZE);
+    if (AnswerBuffer == NULL) {
+        Result = FALSE;
+        goto EvaluateArithmeticExpressionEnd;
+    }
+
+    *AnswerSize = snprintf(AnswerBuffer,
+                           SHELL_ARITHMETIC_INTEGER_STRING_BUFFER_SIZE,
+                           "%d",
+                           NumericAnswer) + 1;
+
+    Result = TRUE;
+
+EvaluateArithmeticExpressionEnd:
+    if ((Program != NULL) && (CacheIndex == SHELL_ARITHMETIC_CACHE_SIZE)) {
+        ShDestroyArithmeticProgram(Program);
+    }
+
+    if (Result == FALSE) {
+        if (AnswerBuffer != NULL) {
+            free(AnswerBuffer);
+            AnswerBuffer = NULL;
+        }
+    }
+
+    *Answer = AnswerBuffer;
+    return Result;
+}
+
+VOID
+ShClearArithmeticCache (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees all the compiled arithmetic expressions held in the
+    cache.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Index;
+
+    for (Index = 0; Index < SHELL_ARITHMETIC_CACHE_SIZE; Index += 1) {
+        if (ShArithmeticCache[Index] != NULL) {
+            ShDestroyArithmeticProgram(ShArithmeticCache[Index]);
+            ShArithmeticCache[Index] = NULL;
+        }
+    }
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+BOOL
+ShCompileArithmeticExpression (
+    PSHELL Shell,
+    PSTR String,
+    UINTN Length,
+    PSHELL_ARITHMETIC_PROGRAM *Program
+    )
+
+/*++
+
+Routine Description:
+
+    This routine compiles an arithmetic expression into a program that can be
+    run any number of times.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell.
+
+    String - Supplies a pointer to the expression text.
+
+    Length - Supplies the length of the expression text in bytes.
+
+    Program - Supplies a pointer where a pointer to the compiled program will
+        be returned on success. Destroy it with ShDestroyArithmeticProgram.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on failure.
+
+--*/
+
+{
+
+    SHELL_ARITHMETIC_LEXER Lexer;
+    PSHELL_ARITHMETIC_PROGRAM NewProgram;
+    BOOL Result;
+
+    memset(&Lexer, 0, sizeof(SHELL_ARITHMETIC_LEXER));
+    NewProgram = malloc(sizeof(SHELL_ARITHMETIC_PROGRAM) + Length);
+    if (NewProgram == NULL) {
+        Result = FALSE;
+        goto CompileArithmeticExpressionEnd;
+    }
+
+    memset(NewProgram, 0, sizeof(SHELL_ARITHMETIC_PROGRAM));
+    NewProgram->Text = (PSTR)(NewProgram + 1);
+    NewProgram->TextSize = Length;
+    memcpy(NewProgram->Text, String, Length);
+    Lexer.TokenBufferCapacity = SHELL_ARITHMETIC_INITIAL_TOKEN_BUFFER_SIZE;
+    Lexer.TokenBuffer = malloc(SHELL_ARITHMETIC_INITIAL_TOKEN_BUFFER_SIZE);
+    if (Lexer.TokenBuffer == NULL) {
+        Result = FALSE;
+        goto CompileArithmeticExpressionEnd;
+    }
+
+    Lexer.Input = String;
+    Lexer.InputSize = Length;
+    Lexer.Program = NewProgram;
+    Result = ShParseArithmeticExpression(Shell, &Lexer, FALSE);
+    if (Result == FALSE) {
+        goto CompileArithmeticExpressionEnd;
+    }
+
+    assert(NewProgram->Depth == 1);
+
+    //
+    // If the whole expression was an assignment, the program keeps the name
+    // to assign the result to.
+    //
+
+    NewProgram->AssignmentName = Lexer.AssignmentName;
+    NewProgram->AssignmentNameSize = Lexer.AssignmentNameSize;
+    Lexer.AssignmentName = NULL;
+
+CompileArithmeticExpressionEnd:
+    if (Lexer.TokenBuffer != NULL) {
+        free(Lexer.TokenBuffer);
+    }
+
+    if (Lexer.AssignmentName != NULL) {
+        free(Lexer.AssignmentName);
+    }
+
+    if (Result == FALSE) {
+        if (NewProgram != NULL) {
+            ShDestroyArithmeticProgram(NewProgram);
+            NewProgram = NULL;
+        }
+    }
+
+    *Program = NewProgram;
+    return Result;
+}
+
+BOOL
+ShRunArithmeticProgram (
+    PSHELL Shell,
+    PSHELL_ARITHMETIC_PROGRAM Program,
+    PLONG ExpressionResult
+    )
+
+/*++
+
+Routine Description:
+
+    This routine runs a compiled arithmetic expression against the current
+    values of the shell's variables, and performs its assignment if it has
+    one.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell.
+
+    Program - Supplies a pointer to the compiled expression.
+
+    ExpressionResult - Supplies a pointer where the value of the expression
+        will be returned on success.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on failure.
+
+--*/
+
+{
+
+    LONG Condition;
+    ULONG Depth;
+    PSHELL_ARITHMETIC_INSTRUCTION Instruction;
+    ULONG InstructionIndex;
+    LONG LocalStack[SHELL_ARITHMETIC_LOCAL_STACK_SIZE];
+    BOOL Result;
+    PLONG Stack;
+    LONG Value;
+    PSTR ValueString;
+    UINTN ValueStringSize;
+
+    Stack = LocalStack;
+    if (Program->StackSize > SHELL_ARITHMETIC_LOCAL_STACK_SIZE) {
+        Stack = malloc(Program->StackSize * sizeof(LONG));
+        if (Stack == NULL) {
+            return FALSE;
+        }
+    }
+
+    Depth = 0;
+    for (InstructionIndex = 0;
+         InstructionIndex < Program->InstructionCount;
+         InstructionIndex += 1) {
+
+        Instruction = &(Program->Instructions[InstructionIndex]);
+        switch (Instruction->Opcode) {
+        case ShellArithmeticConstant:
+            Stack[Depth] = Instruction->Value;
+            Depth += 1;
+            break;
+
+        //
+        // Unset variables count as zero.
+        //
+
+        case ShellArithmeticVariable:
+            Value = 0;
+            Result = ShGetVariable(Shell,
+                                   Instruction->Name,
+                                   Instruction->NameSize,
+                                   &ValueString,
+                                   &ValueStringSize);
+
+            if (Result != FALSE) {
+                Result = ShConvertArithmeticValue(ValueString,
+                                                  ValueStringSize,
+                                                  &Value);
+
+                if (Result == FALSE) {
+                    goto RunArithmeticProgramEnd;
+                }
+            }
+
+            Stack[Depth] = Value;
+            Depth += 1;
+            break;
+
+        case ShellArithmeticUnary:
+
+            assert(Depth >= 1);
+
+            Result = ShEvaluateArithmeticOperator(Shell,
+                                                  Instruction->Operator,
+                                                  0,
+                                                  Stack[Depth - 1],
+                                                  &(Stack[Depth - 1]));
+
+            if (Result == FALSE) {
+                goto RunArithmeticProgramEnd;
+            }
+
+            break;
+
+        case ShellArithmeticBinary:
+
+            assert(Depth >= 2);
+
+            Result = ShEvaluateArithmeticOperator(Shell,
+                                                  Instruction->Operator,
+                                                  Stack[Depth - 2],
+                                                  Stack[Depth - 1],
+                                                  &(Stack[Depth - 2]));
+
+            if (Result == FALSE) {
+                goto RunArithmeticProgramEnd;
+            }
+
+            Depth -= 1;
+            break;
+
+        case ShellArithmeticTernary:
+
+            assert(Depth >= 3);
+
+            Condition = Stack[Depth - 3];
+            Value = Stack[Depth - 1];
+            if (Condition != 0) {
+                Value = Stack[Depth - 2];
+            }
+
+            if (ShDebugArithmeticParser != FALSE) {
+                ShPrintTrace(Shell,
+                             "arith: %ld <== %ld ? %ld : %ld\n",
+                             Value,
+                             Condition,
+                             Stack[Depth - 2],
+                             Stack[Depth - 1]);
+            }
+
+            Depth -= 2;
+            Stack[Depth - 1] = Value;
+            break;
+
+        default:
+
+            assert(FALSE);
+
+            Result = FALSE;
+            goto RunArithmeticProgramEnd;
+        }
+    }
+
+    assert(Depth == 1);
+
+    *ExpressionResult = Stack[0];
+    Result = TRUE;
+    if (Program->AssignmentName != NULL) {
+        Result = ShAssignArithmeticResult(Shell, Program, Stack[0]);
+    }
+
+RunArithmeticProgramEnd:
+    if (Stack != LocalStack) {
+        free(Stack);
+    }
+
+    if (ShDebugArithmeticParser != FALSE) {
+        if (Result != FALSE) {
+            ShPrintTrace(Shell, "Arithmetic Result: %ld\n", *ExpressionResult);
+
+        } else {
+            ShPrintTrace(Shell,
+                         "Error: Failed to evaluate arithmetic expression.\n");
+        }
+    }
+
+    return Result;
+}
+
+VOID
+ShDestroyArithmeticProgram (
+    PSHELL_ARITHMETIC_PROGRAM Program
+    )
 
-    Shell - Supplies a pointer to the shell.
+/*++
 
-    String - Supplies a pointer to the input string.
+Routine Description:
 
-    Length - Supplies the length of the input string in bytes.
+    This routine destroys a compiled arithmetic expression.
 
-    Answer - Supplies a pointer where the evaluation will be returned on
-        success. The caller is responsible for freeing this memory.
+Arguments:
 
-    AnswerSize - Supplies a pointer where the size of the answer buffer will
-        be returned including the null terminating byte on success.
+    Program - Supplies a pointer to the program to destroy.
 
 Return Value:
 
-    TRUE on success.
-
-    FALSE on failure.
+    None.
 
 --*/
 
 {
 
-    PSTR AnswerBuffer;
-    SHELL_ARITHMETIC_LEXER Lexer;
-    LONG NumericAnswer;
-    BOOL Result;
-
-    AnswerBuffer = NULL;
-    memset(&Lexer, 0, sizeof(SHELL_ARITHMETIC_LEXER));
-    Lexer.TokenBufferCapacity = SHELL_ARITHMETIC_INITIAL_TOKEN_BUFFER_SIZE;
-    Lexer.TokenBuffer = malloc(SHELL_ARITHMETIC_INITIAL_TOKEN_BUFFER_SIZE);
-    if (Shell->Lexer.TokenBuffer == NULL) {
-        Result = FALSE;
-        goto EvaluateArithmeticExpressionEnd;
-    }
-
-    Lexer.Input = String;
-    Lexer.InputSize = Length;
-    Result = ShParseArithmeticExpression(Shell, &Lexer, FALSE, &NumericAnswer);
-    if (Result == FALSE) {
-        goto EvaluateArithmeticExpressionEnd;
-    }
-
-    //
-    // Convert the answer to a string for the caller. So nice.
-    //
-
-    AnswerBuffer = malloc(SHELL_ARITHMETIC_INTEGER_STRING_BUFFER_SIZE);
-    if (AnswerBuffer == NULL) {
-        Result = FALSE;
-        goto EvaluateArithmeticExpressionEnd;
-    }
-
-    *AnswerSize = snprintf(AnswerBuffer,
-                           SHELL_ARITHMETIC_INTEGER_STRING_BUFFER_SIZE,
-                           "%d",
-                           NumericAnswer) + 1;
-
-    Result = TRUE;
+    ULONG Index;
 
-EvaluateArithmeticExpressionEnd:
-    if (Lexer.TokenBuffer != NULL) {
-        free(Lexer.TokenBuffer);
-    }
+    if (Program->Instructions != NULL) {
+        for (Index = 0; Index < Program->InstructionCount; Index += 1) {
+            if (Program->Instructions[Index].Name != NULL) {
+                free(Program->Instructions[Index].Name);
+            }
+        }
 
-    if (Lexer.AssignmentName != NULL) {
-        free(Lexer.AssignmentName);
+        free(Program->Instructions);
     }
 
-    if (Result == FALSE) {
-        if (AnswerBuffer != NULL) {
-            free(AnswerBuffer);
-            AnswerBuffer = NULL;
-        }
+    if (Program->AssignmentName != NULL) {
+        free(Program->AssignmentName);
     }
 
-    *Answer = AnswerBuffer;
-    return Result;
+    free(Program);
+    return;
 }
 
-//
-// --------------------------------------------------------- Internal Functions
-//
-
 BOOL
 ShParseArithmeticExpression (
     PSHELL Shell,
     PSHELL_ARITHMETIC_LEXER Lexer,
-    BOOL Nested,
-    PLONG ExpressionResult
+    BOOL Nested
     )
 
 /*++
 
 Routine Description:
 
-    This routine parses and evaluates an arithmetic expression.
+    This routine parses an arithmetic expression, emitting the instructions
+    that compute it into the lexer's program.
 
 Arguments:
 
@@ -414,9 +953,6 @@ Routine Description:
         expression (FALSE) or whether this is nested as part of evaluating
         an expression inside parentheses or after a ? or :.
 
-    ExpressionResult - Supplies a pointer where the evaluation will be returned
-        on success.
-
 Return Value:
 
     TRUE on success.
@@ -474,35 +1010,20 @@ Return Value:
 
             if ((LIST_EMPTY(&Stack) != FALSE) || (Stack.Next->Next != &Stack)) {
                 Result = FALSE;
-                *ExpressionResult = 0;
-                break;
 
             } else {
                 Element = LIST_VALUE(Stack.Next,
                                      SHELL_ARITHMETIC_PARSE_ELEMENT,
                                      ListEntry);
 
+                Result = TRUE;
                 if (Element->TokenType != SHELL_ARITHMETIC_NUMBER) {
                     Result = FALSE;
-                    *ExpressionResult = 0;
-
-                } else {
-                    *ExpressionResult = Element->Value;
-                    if (Lexer->AssignmentName != NULL) {
-                        Result = ShAssignArithmeticResult(Shell,
-                                                          Lexer,
-                                                          Element->Value);
-
-                        if (Result == FALSE) {
-                            goto ParseArithmeticExpressionEnd;
-                        }
-                    }
-
-                    Result = TRUE;
-                    break;
                 }
             }
 
+            break;
+
         } else {
             Element = malloc(sizeof(SHELL_ARITHMETIC_PARSE_ELEMENT));
             if (Element == NULL) {
@@ -528,14 +1049,8 @@ Return Value:
         free(Element);
     }
 
-    if (ShDebugArithmeticParser != FALSE) {
-        if (Result != FALSE) {
-            ShPrintTrace(Shell, "Arithmetic Result: %ld\n", *ExpressionResult);
-
-        } else {
-            ShPrintTrace(Shell,
-                         "Error: Failed to parse arithmetic expression.\n");
-        }
+    if ((ShDebugArithmeticParser != FALSE) && (Result == FALSE)) {
+        ShPrintTrace(Shell, "Error: Failed to parse arithmetic expression.\n");
     }
 
     return Result;
@@ -580,91 +1095,98 @@ Return Value:
 
 {
 
-    PSTR AfterScan;
-    LONG FalseValue;
+    PSHELL_ARITHMETIC_INSTRUCTION Instruction;
     BOOL IsName;
+    PSHELL_ARITHMETIC_PROGRAM Program;
     BOOL Result;
     PSHELL_ARITHMETIC_PARSE_ELEMENT Top;
-    LONG TrueValue;
     LONG Value;
-    PSTR ValueString;
-    UINTN ValueStringSize;
 
     Result = ShGetArithmeticToken(Shell, Lexer);
     if (Result == FALSE) {
         return FALSE;
     }
 
-    if ((Lexer->TokenType == SHELL_ARITHMETIC_NUMBER) ||
-        (Lexer->TokenType == SHELL_ARITHMETIC_WORD)) {
+    if (Lexer->TokenType == SHELL_ARITHMETIC_WORD) {
 
-        if (Lexer->TokenType == SHELL_ARITHMETIC_WORD) {
-            Result = ShGetVariable(Shell,
-                                   Lexer->TokenBuffer,
-                                   Lexer->TokenBufferSize,
-                                   &ValueString,
-                                   &ValueStringSize);
+        //
+        // Variables need to be valid names.
+        //
 
-            if (Result == FALSE) {
-                ValueString = NULL;
-            }
+        IsName = ShIsName(Lexer->TokenBuffer, Lexer->TokenBufferSize);
+        if (IsName == FALSE) {
+            return FALSE;
+        }
 
-            //
-            // Variables need to be valid names.
-            //
+        //
+        // If this is the first token and it's a variable name, save it in
+        // case it's an assignment.
+        //
 
-            IsName = ShIsName(Lexer->TokenBuffer, Lexer->TokenBufferSize);
-            if (IsName == FALSE) {
+        if (Lexer->TokensRead == 1) {
+
+            assert(Lexer->AssignmentName == NULL);
+
+            Lexer->AssignmentName = SwStringDuplicate(Lexer->TokenBuffer,
+                                                      Lexer->TokenBufferSize);
+
+            if (Lexer->AssignmentName == NULL) {
                 return FALSE;
             }
 
-            //
-            // If this is the first token and it's a variable name, save it
-            // in case it's an assignment.
-            //
+            Lexer->AssignmentNameSize = Lexer->TokenBufferSize;
+        }
 
-            if (Lexer->TokensRead == 1) {
+        //
+        // The variable's value is read when the program runs.
+        //
 
-                assert(Lexer->AssignmentName == NULL);
+        Result = ShEmitArithmeticInstruction(Lexer,
+                                             ShellArithmeticVariable,
+                                             0,
+                                             0);
 
-                Lexer->AssignmentName = SwStringDuplicate(
-                                                       Lexer->TokenBuffer,
-                                                       Lexer->TokenBufferSize);
+        if (Result == FALSE) {
+            return FALSE;
+        }
 
-                if (Lexer->AssignmentName == NULL) {
-                    return FALSE;
-                }
+        Program = Lexer->Program;
+        Instruction = &(Program->Instructions[Program->InstructionCount - 1]);
 
-                Lexer->AssignmentNameSize = Lexer->TokenBufferSize;
-            }
+        Instruction->Name = SwStringDuplicate(Lexer->TokenBuffer,
+                                              Lexer->TokenBufferSize);
 
-        } else {
-            ValueString = Lexer->TokenBuffer;
-            ValueStringSize = Lexer->TokenBufferSize;
+        if (Instruction->Name == NULL) {
+            return FALSE;
         }
 
-        //
-        // If there's a buffer, attempt to convert it to a number.
-        //
+        Instruction->NameSize = Lexer->TokenBufferSize;
+        Element->TokenType = SHELL_ARITHMETIC_NUMBER;
+        return TRUE;
 
-        Value = 0;
-        if (ValueString != NULL) {
-            Value = strtol(ValueString, &AfterScan, 0);
-            if (((Value == -1) && (errno != 0)) ||
-                ((UINTN)AfterScan !=
-                 (UINTN)ValueString + ValueStringSize - 1)) {
+    } else if (Lexer->TokenType == SHELL_ARITHMETIC_NUMBER) {
+        Result = ShConvertArithmeticValue(Lexer->TokenBuffer,
+                                          Lexer->TokenBufferSize,
+                                          &Value);
 
-                Result = FALSE;
-                return FALSE;
-            }
+        if (Result == FALSE) {
+            return FALSE;
+        }
+
+        Result = ShEmitArithmeticInstruction(Lexer,
+                                             ShellArithmeticConstant,
+                                             0,
+                                             Value);
+
+        if (Result == FALSE) {
+            return FALSE;
         }
 
         Element->TokenType = SHELL_ARITHMETIC_NUMBER;
-        Element->Value = Value;
         return TRUE;
 
     } else if (Lexer->TokenType == '(') {
-        Result = ShParseArithmeticExpression(Shell, Lexer, TRUE, &Value);
+        Result = ShParseArithmeticExpression(Shell, Lexer, TRUE);
         if (Result == FALSE) {
             return FALSE;
         }
@@ -674,60 +1196,54 @@ Return Value:
         }
 
         Element->TokenType = SHELL_ARITHMETIC_NUMBER;
-        Element->Value = Value;
         return TRUE;
 
     //
     // The question mark ternary operator is also recursive, as it requires two
     // full expressions. This cheats and does a bit of reducing which isn't
     // ideal architecturally but seeing as it's the only thing that does this
-    // and I'm a little tipsy we'll let it slide.
+    // and I'm a little tipsy we'll let it slide. Both sides are computed, and
+    // the ternary instruction then picks one based on the value at the top of
+    // the stack.
     //
 
     } else if (Lexer->TokenType == '?') {
-        Result = ShParseArithmeticExpression(Shell, Lexer, TRUE, &TrueValue);
-        if (Result == FALSE) {
+        if (LIST_EMPTY(Stack) != FALSE) {
             return FALSE;
         }
 
-        if (Lexer->TokenType != ':') {
+        Top = LIST_VALUE(Stack->Next,
+                         SHELL_ARITHMETIC_PARSE_ELEMENT,
+                         ListEntry);
+
+        if (Top->TokenType != SHELL_ARITHMETIC_NUMBER) {
             return FALSE;
         }
 
-        Result = ShParseArithmeticExpression(Shell, Lexer, TRUE, &FalseValue);
+        Result = ShParseArithmeticExpression(Shell, Lexer, TRUE);
         if (Result == FALSE) {
             return FALSE;
         }
 
-        Top = LIST_VALUE(Stack->Next,
-                         SHELL_ARITHMETIC_PARSE_ELEMENT,
-                         ListEntry);
-
-        if ((LIST_EMPTY(Stack) != FALSE) ||
-            (Top->TokenType != SHELL_ARITHMETIC_NUMBER)) {
-
+        if (Lexer->TokenType != ':') {
             return FALSE;
         }
 
-        if (Top->Value != 0) {
-            Value = TrueValue;
-
-        } else {
-            Value = FalseValue;
+        Result = ShParseArithmeticExpression(Shell, Lexer, TRUE);
+        if (Result == FALSE) {
+            return FALSE;
         }
 
-        if (ShDebugArithmeticParser != FALSE) {
-            ShPrintTrace(Shell,
-                         "arith: %ld <== %ld ? %ld : %ld\n",
-                         Value,
-                         Top->Value,
-                         TrueValue,
-                         FalseValue);
+        Result = ShEmitArithmeticInstruction(Lexer,
+                                             ShellArithmeticTernary,
+                                             '?',
+                                             0);
+
+        if (Result == FALSE) {
+            return FALSE;
         }
 
-        Top->Value = Value;
         Element->TokenType = SHELL_ARITHMETIC_END_OF_FILE;
-        Element->Value = 0;
         return TRUE;
 
     //
@@ -739,7 +1255,6 @@ Return Value:
     } else if ((Lexer->TokenType == ')') || (Lexer->TokenType == ':')) {
         if (Nested != FALSE) {
             Element->TokenType = SHELL_ARITHMETIC_END_OF_FILE;
-            Element->Value = 0;
             return TRUE;
 
         } else {
@@ -748,7 +1263,6 @@ Return Value:
     }
 
     Element->TokenType = Lexer->TokenType;
-    Element->Value = 0;
     return TRUE;
 }
 
@@ -766,7 +1280,8 @@ ShArithmeticShiftOrReduce (
 Routine Description:
 
     This routine attempts to reduce the given parse stack if possible, or
-    directs the caller to shift.
+    directs the caller to shift. Reducing emits the instruction for the
+    operator being reduced.
 
 Arguments:
 
@@ -791,9 +1306,9 @@ Return Value:
 
 {
 
-    LONG Answer;
     ULONG NextPrecedence;
     ULONG NextToken;
+    SHELL_ARITHMETIC_OPCODE Opcode;
     PSHELL_ARITHMETIC_PARSE_ELEMENT Operator;
     BOOL Result;
     ULONG StackPrecedence;
@@ -878,17 +1393,22 @@ Return Value:
                 (TwoBack->TokenType != SHELL_ARITHMETIC_NUMBER)) {
 
                 //
-                // Reduce the unary + or minus and return.
+                // Reduce the unary + or minus and return. Unary plus doesn't
+                // need an instruction at all.
                 //
 
-                LIST_REMOVE(&(Top->ListEntry));
                 if (Operator->TokenType == '-') {
-                    Operator->Value = -Top->Value;
+                    Result = ShEmitArithmeticInstruction(Lexer,
+                                                         ShellArithmeticUnary,
+                                                         '-',
+                                                         0);
 
-                } else {
-                    Operator->Value = Top->Value;
+                    if (Result == FALSE) {
+                        return FALSE;
+                    }
                 }
 
+                LIST_REMOVE(&(Top->ListEntry));
                 Operator->TokenType = Top->TokenType;
                 free(Top);
                 return TRUE;
@@ -922,11 +1442,15 @@ Return Value:
             assert((TwoBack == NULL) ||
                    (TwoBack->TokenType == SHELL_ARITHMETIC_NUMBER));
 
-            Result = ShEvaluateArithmeticOperator(Shell,
-                                                  TwoBack,
-                                                  Operator,
-                                                  Top,
-                                                  &Answer);
+            Opcode = ShellArithmeticUnary;
+            if (TwoBack != NULL) {
+                Opcode = ShellArithmeticBinary;
+            }
+
+            Result = ShEmitArithmeticInstruction(Lexer,
+                                                 Opcode,
+                                                 Operator->TokenType,
+                                                 0);
 
             if (Result == FALSE) {
                 return FALSE;
@@ -941,7 +1465,6 @@ Return Value:
             }
 
             Operator->TokenType = SHELL_ARITHMETIC_NUMBER;
-            Operator->Value = Answer;
 
         } else {
             *Shift = TRUE;
@@ -971,12 +1494,112 @@ Return Value:
     return TRUE;
 }
 
+BOOL
+ShEmitArithmeticInstruction (
+    PSHELL_ARITHMETIC_LEXER Lexer,
+    SHELL_ARITHMETIC_OPCODE Opcode,
+    ULONG Operator,
+    LONG Value
+    )
+
+/*++
+
+Routine Description:
+
+    This routine appends an instruction to the program being compiled.
+
+Arguments:
+
+    Lexer - Supplies a pointer to the lexer, which holds the program.
+
+    Opcode - Supplies the kind of instruction to add.
+
+    Operator - Supplies the operator token for unary and binary instructions.
+
+    Value - Supplies the value for constant instructions.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on allocation failure.
+
+--*/
+
+{
+
+    ULONG Capacity;
+    PSHELL_ARITHMETIC_INSTRUCTION Instruction;
+    PSHELL_ARITHMETIC_INSTRUCTION Instructions;
+    PSHELL_ARITHMETIC_PROGRAM Program;
+
+    Program = Lexer->Program;
+    if (Program->InstructionCount == Program->InstructionCapacity) {
+        Capacity = Program->InstructionCapacity * 2;
+        if (Capacity == 0) {
+            Capacity = SHELL_ARITHMETIC_INITIAL_PROGRAM_SIZE;
+        }
+
+        Instructions = realloc(Program->Instructions,
+                               Capacity * sizeof(SHELL_ARITHMETIC_INSTRUCTION));
+
+        if (Instructions == NULL) {
+            return FALSE;
+        }
+
+        Program->Instructions = Instructions;
+        Program->InstructionCapacity = Capacity;
+    }
+
+    Instruction = &(Program->Instructions[Program->InstructionCount]);
+    Instruction->Opcode = Opcode;
+    Instruction->Operator = Operator;
+    Instruction->Value = Value;
+    Instruction->Name = NULL;
+    Instruction->NameSize = 0;
+    Program->InstructionCount += 1;
+
+    //
+    // Keep track of how deep the evaluation stack gets.
+    //
+
+    switch (Opcode) {
+    case ShellArithmeticConstant:
+    case ShellArithmeticVariable:
+        Program->Depth += 1;
+        if (Program->Depth > Program->StackSize) {
+            Program->StackSize = Program->Depth;
+        }
+
+        break;
+
+    case ShellArithmeticBinary:
+
+        assert(Program->Depth >= 2);
+
+        Program->Depth -= 1;
+        break;
+
+    case ShellArithmeticTernary:
+
+        assert(Program->Depth >= 3);
+
+        Program->Depth -= 2;
+        break;
+
+    default:
+        break;
+    }
+
+    return TRUE;
+}
+
 BOOL
 ShEvaluateArithmeticOperator (
     PSHELL Shell,
-    PSHELL_ARITHMETIC_PARSE_ELEMENT LeftValue,
-    PSHELL_ARITHMETIC_PARSE_ELEMENT Operator,
-    PSHELL_ARITHMETIC_PARSE_ELEMENT RightValue,
+    ULONG Operator,
+    LONG Left,
+    LONG Right,
     PLONG Result
     )
 
@@ -990,11 +1613,11 @@ Routine Description:
 
     Shell - Supplies a pointer to the shell.
 
-    LeftValue - Supplies a pointer to the left operand.
+    Operator - Supplies the operator token.
 
-    Operator - Supplies a pointer to the operator.
+    Left - Supplies the left operand, which is zero for unary operators.
 
-    RightValue - Supplies a pointer to the right operand.
+    Right - Supplies the right operand.
 
     Result - Supplies a pointer where the resulting value will be returned on
         success.
@@ -1011,28 +1634,16 @@ Return Value:
 
     LONG Answer;
     CHAR DebugOperator[2];
-    LONG Left;
-    LONG Right;
-
-    assert(((LeftValue == NULL) ||
-            (LeftValue->TokenType == SHELL_ARITHMETIC_NUMBER)) &&
-           (RightValue->TokenType == SHELL_ARITHMETIC_NUMBER));
 
-    Left = 0;
-    if (LeftValue != 0) {
-        Left = LeftValue->Value;
-    }
-
-    Right = RightValue->Value;
-    DebugOperator[0] = (CHAR)Operator->TokenType;
-    if (Operator->TokenType < 0x100) {
+    DebugOperator[0] = (CHAR)Operator;
+    if (Operator < 0x100) {
         DebugOperator[1] = ' ';
 
     } else {
         DebugOperator[1] = '=';
     }
 
-    switch (Operator->TokenType) {
+    switch (Operator) {
     case SHELL_ARITHMETIC_LEFT_SHIFT_ASSIGN:
     case SHELL_ARITHMETIC_SHIFT_LEFT:
         DebugOperator[0] = '<';
@@ -1168,6 +1779,53 @@ Return Value:
     return TRUE;
 }
 
+BOOL
+ShConvertArithmeticValue (
+    PSTR String,
+    UINTN StringSize,
+    PLONG Value
+    )
+
+/*++
+
+Routine Description:
+
+    This routine converts a number or the value of a variable to an integer.
+    The whole string must be a valid number.
+
+Arguments:
+
+    String - Supplies a pointer to the string to convert.
+
+    StringSize - Supplies the size of the string in bytes including the null
+        terminator.
+
+    Value - Supplies a pointer where the value will be returned on success.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE if the string is not a number.
+
+--*/
+
+{
+
+    PSTR AfterScan;
+    LONG Converted;
+
+    Converted = strtol(String, &AfterScan, 0);
+    if (((Converted == -1) && (errno != 0)) ||
+        ((UINTN)AfterScan != (UINTN)String + StringSize - 1)) {
+
+        return FALSE;
+    }
+
+    *Value = Converted;
+    return TRUE;
+}
+
 ULONG
 ShGetOperatorPrecedence (
     ULONG TokenType
@@ -1272,7 +1930,7 @@ Return Value:
 BOOL
 ShAssignArithmeticResult (
     PSHELL Shell,
-    PSHELL_ARITHMETIC_LEXER Lexer,
+    PSHELL_ARITHMETIC_PROGRAM Program,
     LONG Value
     )
 
@@ -1287,7 +1945,8 @@ Routine Description:
 
     Shell - Supplies a pointer to the shell to operate on.
 
-    Lexer - Supplies a pointer to the initialized lexer.
+    Program - Supplies a pointer to the compiled expression, which holds the
+        name of the variable to assign.
 
     Value - Supplies the numeric value to assign.
 
@@ -1310,11 +1969,12 @@ Return Value:
                           "%d",
                           Value) + 1;
 
-    assert((Lexer->AssignmentName != NULL) && (Lexer->AssignmentNameSize != 0));
+    assert((Program->AssignmentName != NULL) &&
+           (Program->AssignmentNameSize != 0));
 
     Result = ShSetVariable(Shell,
-                           Lexer->AssignmentName,
-                           Lexer->AssignmentNameSize,
+                           Program->AssignmentName,
+                           Program->AssignmentNameSize,
                            StringBuffer,
                            StringSize);
 
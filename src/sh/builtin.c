@@ -199,6 +199,13 @@ ShBuiltinType (
     PSTR *Arguments
     );
 
+INT
+ShBuiltinHash (
+    PSHELL Shell,
+    INT ArgumentCount,
+    PSTR *Arguments
+    );
+
 INT
 ShBuiltinTypeOrCommand (
     PSHELL Shell,
@@ -380,6 +387,13 @@ Return Value:
 
         break;
 
+    case 'h':
+        if (strcmp(Command + 1, "ash") == 0) {
+            EntryPoint = ShBuiltinHash;
+        }
+
+        break;
+
     case 'l':
         if (strcmp(Command + 1, "ocal") == 0) {
             EntryPoint = ShBuiltinLocal;
@@ -611,6 +625,23 @@ Return Value:
     Shell->Options &= ~SHELL_OPTION_PRINT_PROMPTS;
     Shell->Options |= SHELL_OPTION_INPUT_BUFFER_ONLY;
 
+    //
+    // Loops and traps tend to eval the same strings over and over, so reuse
+    // the parsed commands if this text has been seen before.
+    //
+
+    Shell->Lexer.ParsedInput = ShLookupParsedInput(Shell,
+                                                   Input,
+                                                   InputSize,
+                                                   FALSE);
+
+    if (Shell->Lexer.ParsedInput == NULL) {
+        Shell->Lexer.ParsedInput = ShParseInput(Shell,
+                                                Input,
+                                                InputSize,
+                                                FALSE);
+    }
+
     //
     // Run the commands.
     //
@@ -2368,6 +2399,121 @@ Return Value:
     return Result;
 }
 
+INT
+ShBuiltinHash (
+    PSHELL Shell,
+    INT ArgumentCount,
+    PSTR *Arguments
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the 'hash' builtin command, which displays or
+    changes the remembered locations of commands. With no arguments, the
+    remembered locations are printed. The -r option forgets all remembered
+    locations. Each command name argument is searched for in the path and
+    remembered.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell.
+
+    ArgumentCount - Supplies the number of arguments on the command line.
+
+    Arguments - Supplies the array of pointers to strings representing each
+        argument.
+
+Return Value:
+
+    0 on success.
+
+    1 if a command could not be found.
+
+--*/
+
+{
+
+    PSTR Argument;
+    INT ArgumentIndex;
+    PSTR FullCommandPath;
+    ULONG FullCommandPathSize;
+    BOOL Result;
+    INT ReturnValue;
+    INT TotalReturnValue;
+
+    for (ArgumentIndex = 1; ArgumentIndex < ArgumentCount; ArgumentIndex += 1) {
+        Argument = Arguments[ArgumentIndex];
+        if (*Argument != '-') {
+            break;
+        }
+
+        Argument += 1;
+        if (*Argument == '-') {
+            ArgumentIndex += 1;
+            break;
+        }
+
+        while (*Argument != '\0') {
+            switch (*Argument) {
+            case 'r':
+                ShClearCommandHash(Shell);
+                break;
+
+            default:
+                PRINT_ERROR("hash: Invalid option %c.\n", *Argument);
+                return 1;
+            }
+
+            Argument += 1;
+        }
+    }
+
+    if (ArgumentCount == 1) {
+        ShPrintCommandHash(Shell);
+        return 0;
+    }
+
+    //
+    // Look up each command, which remembers where it is. Builtins, functions,
+    // and paths are left alone since they're never searched for.
+    //
+
+    TotalReturnValue = 0;
+    while (ArgumentIndex < ArgumentCount) {
+        Argument = Arguments[ArgumentIndex];
+        ArgumentIndex += 1;
+        if ((ShIsBuiltinCommand(Argument) != NULL) ||
+            (ShGetFunction(Shell, Argument, strlen(Argument) + 1) != NULL) ||
+            (SwDoesPathHaveSeparators(Argument) != 0)) {
+
+            continue;
+        }
+
+        ReturnValue = 0;
+        FullCommandPath = NULL;
+        Result = ShLocateCommand(Shell,
+                                 Argument,
+                                 strlen(Argument) + 1,
+                                 TRUE,
+                                 &FullCommandPath,
+                                 &FullCommandPathSize,
+                                 &ReturnValue);
+
+        if ((Result == FALSE) || (ReturnValue != 0)) {
+            PRINT_ERROR("sh: hash: %s: Command not found.\n", Argument);
+            TotalReturnValue = 1;
+        }
+
+        if ((FullCommandPath != NULL) && (FullCommandPath != Argument)) {
+            free(FullCommandPath);
+        }
+    }
+
+    return TotalReturnValue;
+}
+
 INT
 ShBuiltinTypeOrCommand (
     PSHELL Shell,
@@ -0,0 +1,854 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+This project is dual licensed. You are receiving it under the terms of the
+GNU General Public License version 3 (GPLv3). Alternative licensing terms are
+available. Contact info@minocacorp.com for details. See the LICENSE file at the
+root of this project for complete licensing information.
+
+Module Name:
+
+    cache.c
+
+Abstract:
+
+    This module implements the parse cache, which holds the parsed commands
+    of command substitutions and eval strings so that running the same text
+    again doesn't have to lex and parse it again.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    POSIX
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include "sh.h"
+#include "shparse.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../swlib.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the number of buckets in the parse cache hash table.
+//
+
+#define SHELL_PARSE_CACHE_HASH_SIZE 64
+
+//
+// Define the maximum number of entries kept in the parse cache. The least
+// recently used entry is dropped to make room for a new one.
+//
+
+#define SHELL_PARSE_CACHE_MAX_ENTRIES 256
+
+//
+// Define the size of the largest text that gets cached.
+//
+
+#define SHELL_PARSE_CACHE_MAX_TEXT_SIZE 0x4000
+
+//
+// Define the initial number of commands allocated in a new entry.
+//
+
+#define SHELL_PARSE_CACHE_INITIAL_COMMANDS 4
+
+//
+// Define the characters that can come just before a command word, and the
+// characters that can end a word.
+//
+
+#define SHELL_PARSE_CACHE_COMMAND_START_CHARACTERS "\n;&|(){}`"
+#define SHELL_PARSE_CACHE_WORD_END_CHARACTERS " \t\n;&|()`"
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+BOOL
+ShIsParseCacheable (
+    PSTR Text,
+    UINTN TextSize
+    );
+
+BOOL
+ShIsCommandPosition (
+    PSTR Text,
+    PSTR Word
+    );
+
+ULONG
+ShHashParseCacheKey (
+    PSTR Text,
+    UINTN TextSize,
+    ULONG AliasGeneration,
+    BOOL Dequoted
+    );
+
+VOID
+ShInsertParseCacheEntry (
+    PSHELL_PARSE_CACHE_ENTRY Entry
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// Store the array of hash buckets of the parse cache, allocated when the
+// first entry is added.
+//
+
+PLIST_ENTRY ShParseCacheBuckets;
+
+//
+// Store the list of cached entries, most recently used first.
+//
+
+LIST_ENTRY ShParseCacheRecentList;
+
+//
+// Store the number of entries in the parse cache.
+//
+
+ULONG ShParseCacheCount;
+
+//
+// Define the commands that change the aliases. Text that runs one of these
+// is not worth caching, as the rest of it has to be parsed again after.
+//
+
+PSTR ShParseCacheAliasCommands[] = {
+    "alias",
+    "unalias",
+    NULL
+};
+
+//
+// Define the reserved words that can come just before a command word.
+//
+
+PSTR ShParseCacheCommandKeywords[] = {
+    "if",
+    "then",
+    "else",
+    "elif",
+    "while",
+    "until",
+    "do",
+    "!",
+    NULL
+};
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+PSHELL_PARSE_CACHE_ENTRY
+ShLookupParsedInput (
+    PSHELL Shell,
+    PSTR Text,
+    UINTN TextSize,
+    BOOL Dequoted
+    )
+
+/*++
+
+Routine Description:
+
+    This routine looks for already parsed commands for the given text in the
+    parse cache.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell that would parse the text.
+
+    Text - Supplies a pointer to the text to look up.
+
+    TextSize - Supplies the size of the text in bytes including the null
+        terminator.
+
+    Dequoted - Supplies a boolean indicating if the text gets backslashes
+        removed before it is parsed, as for a backquoted command substitution.
+
+Return Value:
+
+    Returns a pointer to the cache entry on success. The caller is responsible
+    for releasing the reference it holds.
+
+    NULL if the text has not been cached.
+
+--*/
+
+{
+
+    PLIST_ENTRY Bucket;
+    PLIST_ENTRY CurrentEntry;
+    PSHELL_PARSE_CACHE_ENTRY Entry;
+    ULONG Hash;
+
+    if ((ShParseCacheBuckets == NULL) || (TextSize == 0)) {
+        return NULL;
+    }
+
+    Hash = ShHashParseCacheKey(Text,
+                               TextSize,
+                               Shell->AliasGeneration,
+                               Dequoted);
+
+    Bucket = &(ShParseCacheBuckets[Hash % SHELL_PARSE_CACHE_HASH_SIZE]);
+    CurrentEntry = Bucket->Next;
+    while (CurrentEntry != Bucket) {
+        Entry = LIST_VALUE(CurrentEntry, SHELL_PARSE_CACHE_ENTRY, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if ((Entry->Hash == Hash) &&
+            (Entry->AliasGeneration == Shell->AliasGeneration) &&
+            (Entry->Dequoted == Dequoted) &&
+            (Entry->TextSize == TextSize) &&
+            (memcmp(Entry->Text, Text, TextSize - 1) == 0)) {
+
+            LIST_REMOVE(&(Entry->RecentListEntry));
+            INSERT_AFTER(&(Entry->RecentListEntry), &ShParseCacheRecentList);
+            Entry->ReferenceCount += 1;
+            return Entry;
+        }
+    }
+
+    return NULL;
+}
+
+PSHELL_PARSE_CACHE_ENTRY
+ShParseInput (
+    PSHELL Shell,
+    PSTR Text,
+    UINTN TextSize,
+    BOOL Dequoted
+    )
+
+/*++
+
+Routine Description:
+
+    This routine parses all the input in the given shell's lexer up front, and
+    adds the result to the parse cache if it parsed cleanly. Parse errors are
+    reported just as they would be when running the input.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell whose lexer has been set up with
+        the input.
+
+    Text - Supplies a pointer to the text the input came from, used as the
+        cache key.
+
+    TextSize - Supplies the size of the text in bytes including the null
+        terminator.
+
+    Dequoted - Supplies a boolean indicating if the input is the text with
+        backslashes removed, as for a backquoted command substitution.
+
+Return Value:
+
+    Returns a pointer to the parsed input on success. The caller is
+    responsible for releasing the reference it holds.
+
+    NULL if the text should not be parsed ahead of time, or on allocation
+    failure before anything was read. The lexer is left untouched, and the
+    input should be run as usual.
+
+--*/
+
+{
+
+    ULONG AliasGeneration;
+    UINTN Capacity;
+    PSHELL_NODE Command;
+    UINTN Growth;
+    PSHELL_PARSED_COMMAND Commands;
+    PSHELL_PARSE_CACHE_ENTRY Entry;
+    UINTN InputSize;
+    PSHELL_LEXER_STATE Lexer;
+    PSHELL_PARSED_COMMAND Parsed;
+    BOOL Result;
+
+    if (ShIsParseCacheable(Text, TextSize) == FALSE) {
+        return NULL;
+    }
+
+    //
+    // Keep a copy of the lexer input too if it isn't just the text, so that
+    // parsing can pick up part way through it later. Alias substitution
+    // changes the lexer's own copy as it goes.
+    //
+
+    Lexer = &(Shell->Lexer);
+
+    assert((Lexer->InputBufferNextIndex == 0) && (Lexer->InputBuffer != NULL));
+
+    InputSize = 0;
+    if (Dequoted != FALSE) {
+        InputSize = Lexer->InputBufferSize;
+    }
+
+    Entry = malloc(sizeof(SHELL_PARSE_CACHE_ENTRY) + TextSize + InputSize);
+    if (Entry == NULL) {
+        return NULL;
+    }
+
+    memset(Entry, 0, sizeof(SHELL_PARSE_CACHE_ENTRY));
+    Entry->Commands = malloc(SHELL_PARSE_CACHE_INITIAL_COMMANDS *
+                             sizeof(SHELL_PARSED_COMMAND));
+
+    if (Entry->Commands == NULL) {
+        free(Entry);
+        return NULL;
+    }
+
+    Capacity = SHELL_PARSE_CACHE_INITIAL_COMMANDS;
+    AliasGeneration = Shell->AliasGeneration;
+    Entry->ReferenceCount = 1;
+    Entry->Hash = ShHashParseCacheKey(Text,
+                                      TextSize,
+                                      AliasGeneration,
+                                      Dequoted);
+
+    Entry->AliasGeneration = AliasGeneration;
+    Entry->Dequoted = Dequoted;
+    Entry->Text = (PSTR)(Entry + 1);
+    Entry->TextSize = TextSize;
+    memcpy(Entry->Text, Text, TextSize);
+    Entry->Input = Entry->Text;
+    Entry->InputSize = TextSize;
+    if (InputSize != 0) {
+        Entry->Input = Entry->Text + TextSize;
+        Entry->InputSize = InputSize;
+        memcpy(Entry->Input, Lexer->InputBuffer, InputSize);
+    }
+
+    //
+    // Parse the same way running the input would, including carrying on past
+    // errors in an interactive shell.
+    //
+
+    while (TRUE) {
+        Result = ShParse(Shell, &Command);
+        if (Result == FALSE) {
+            Entry->ParseFailed = TRUE;
+            if ((Shell->Options & SHELL_OPTION_INTERACTIVE) != 0) {
+                Shell->Lexer.LexerPrimed = FALSE;
+                continue;
+            }
+
+            break;
+        }
+
+        if (Command == NULL) {
+            break;
+        }
+
+        if (Entry->CommandCount == Capacity) {
+            Capacity *= 2;
+            Commands = realloc(Entry->Commands,
+                               Capacity * sizeof(SHELL_PARSED_COMMAND));
+
+            if (Commands == NULL) {
+                ShReleaseNode(Command);
+                Entry->ParseFailed = TRUE;
+                break;
+            }
+
+            Entry->Commands = Commands;
+        }
+
+        //
+        // Remember where the text after this command starts, in case running
+        // it changes the aliases. That's only possible when the lexer is
+        // cleanly sitting on the newline that ended the command. Alias
+        // values are only ever spliced in just before the current position,
+        // so taking out how much the input grew gives the original offset.
+        //
+
+        Parsed = &(Entry->Commands[Entry->CommandCount]);
+        Parsed->Node = Command;
+        Parsed->InputOffset = 0;
+        Parsed->LineNumber = Lexer->LineNumber;
+        Growth = Lexer->InputBufferSize - Entry->InputSize;
+        if ((Lexer->TokenType == '\n') &&
+            (Lexer->UnputCharacterValid == FALSE) &&
+            (LIST_EMPTY(&(Lexer->HereDocumentList)) != FALSE) &&
+            (Lexer->InputBufferSize >= Entry->InputSize) &&
+            (Lexer->InputBufferNextIndex > Growth)) {
+
+            Parsed->InputOffset = Lexer->InputBufferNextIndex - Growth;
+        }
+
+        Entry->CommandCount += 1;
+    }
+
+    if ((Entry->ParseFailed == FALSE) &&
+        (Shell->AliasGeneration == AliasGeneration)) {
+
+        ShInsertParseCacheEntry(Entry);
+    }
+
+    return Entry;
+}
+
+BOOL
+ShResumeParsingInput (
+    PSHELL Shell,
+    UINTN CommandIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine stops running the already parsed commands in the given
+    shell's lexer, and sets the lexer up to parse the rest of the text itself.
+    This is needed when a command changes the aliases, since the commands
+    after it may now parse differently.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell running parsed input.
+
+    CommandIndex - Supplies the number of parsed commands already run.
+        Parsing picks up after the last of them.
+
+Return Value:
+
+    TRUE if the lexer now parses the rest of the text, and the parsed input
+    was released.
+
+    FALSE if parsing cannot pick up there. The parsed commands should still
+    be run.
+
+--*/
+
+{
+
+    PSHELL_PARSE_CACHE_ENTRY Entry;
+    PSTR InputBuffer;
+    PSHELL_LEXER_STATE Lexer;
+    PSHELL_PARSED_COMMAND Parsed;
+
+    Lexer = &(Shell->Lexer);
+    Entry = Lexer->ParsedInput;
+
+    assert((Entry != NULL) && (CommandIndex != 0) &&
+           (CommandIndex <= Entry->CommandCount));
+
+    //
+    // Parsing again after a parse error would report it a second time.
+    //
+
+    Parsed = &(Entry->Commands[CommandIndex - 1]);
+    if ((Entry->ParseFailed != FALSE) || (Parsed->InputOffset == 0)) {
+        return FALSE;
+    }
+
+    //
+    // Put the lexer back where it was when the command was parsed: just past
+    // the newline that ended it, with that newline as the current token. The
+    // input is restored first, since substitutions have changed it.
+    //
+
+    if (Lexer->InputBufferCapacity < Entry->InputSize) {
+        InputBuffer = realloc(Lexer->InputBuffer, Entry->InputSize);
+        if (InputBuffer == NULL) {
+            return FALSE;
+        }
+
+        Lexer->InputBuffer = InputBuffer;
+        Lexer->InputBufferCapacity = Entry->InputSize;
+    }
+
+    memcpy(Lexer->InputBuffer, Entry->Input, Entry->InputSize);
+    Lexer->InputBufferSize = Entry->InputSize;
+    Lexer->InputBufferNextIndex = Parsed->InputOffset;
+    Lexer->LineNumber = Parsed->LineNumber;
+    Lexer->TokenType = '\n';
+    Lexer->TokenBufferSize = 0;
+    Lexer->UnputCharacterValid = FALSE;
+    Lexer->LexerPrimed = TRUE;
+    Lexer->LastAlias = NULL;
+    Lexer->ParsedInput = NULL;
+    ShReleaseParsedInput(Entry);
+    return TRUE;
+}
+
+VOID
+ShReleaseParsedInput (
+    PSHELL_PARSE_CACHE_ENTRY Entry
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases a reference on parsed input, destroying it if it
+    was the last one.
+
+Arguments:
+
+    Entry - Supplies a pointer to the parsed input.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN Index;
+
+    assert(Entry->ReferenceCount != 0);
+
+    Entry->ReferenceCount -= 1;
+    if (Entry->ReferenceCount != 0) {
+        return;
+    }
+
+    assert(Entry->ListEntry.Next == NULL);
+
+    for (Index = 0; Index < Entry->CommandCount; Index += 1) {
+        ShReleaseNode(Entry->Commands[Index].Node);
+    }
+
+    free(Entry->Commands);
+    free(Entry);
+    return;
+}
+
+VOID
+ShClearParseCache (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases everything held in the parse cache.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSHELL_PARSE_CACHE_ENTRY Entry;
+
+    if (ShParseCacheBuckets == NULL) {
+        return;
+    }
+
+    while (LIST_EMPTY(&ShParseCacheRecentList) == FALSE) {
+        Entry = LIST_VALUE(ShParseCacheRecentList.Next,
+                           SHELL_PARSE_CACHE_ENTRY,
+                           RecentListEntry);
+
+        LIST_REMOVE(&(Entry->RecentListEntry));
+        LIST_REMOVE(&(Entry->ListEntry));
+        Entry->ListEntry.Next = NULL;
+        ShReleaseParsedInput(Entry);
+    }
+
+    ShParseCacheCount = 0;
+    free(ShParseCacheBuckets);
+    ShParseCacheBuckets = NULL;
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+BOOL
+ShIsParseCacheable (
+    PSTR Text,
+    UINTN TextSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether the given text is worth parsing ahead of
+    time and caching. Text that runs alias or unalias itself is not, since the
+    rest of it has to be parsed again after that command runs. Changing the
+    aliases any other way, such as from a function, is handled when the
+    commands run.
+
+Arguments:
+
+    Text - Supplies a pointer to the text.
+
+    TextSize - Supplies the size of the text in bytes including the null
+        terminator.
+
+Return Value:
+
+    TRUE if the text can be cached.
+
+    FALSE if the text should be parsed as it runs.
+
+--*/
+
+{
+
+    PSTR Current;
+    PSTR End;
+    UINTN Index;
+    PSTR Word;
+    UINTN WordSize;
+
+    if ((TextSize <= 1) || (TextSize > SHELL_PARSE_CACHE_MAX_TEXT_SIZE)) {
+        return FALSE;
+    }
+
+    End = Text + TextSize - 1;
+    for (Index = 0; ShParseCacheAliasCommands[Index] != NULL; Index += 1) {
+        Word = ShParseCacheAliasCommands[Index];
+        WordSize = strlen(Word);
+        Current = Text;
+        while ((UINTN)(End - Current) >= WordSize) {
+            Current = memchr(Current, Word[0], End - Current);
+            if ((Current == NULL) || ((UINTN)(End - Current) < WordSize)) {
+                break;
+            }
+
+            if ((memcmp(Current, Word, WordSize) == 0) &&
+                ((Current + WordSize == End) ||
+                 (strchr(SHELL_PARSE_CACHE_WORD_END_CHARACTERS,
+                         Current[WordSize]) != NULL)) &&
+                (ShIsCommandPosition(Text, Current) != FALSE)) {
+
+                return FALSE;
+            }
+
+            Current += 1;
+        }
+    }
+
+    return TRUE;
+}
+
+BOOL
+ShIsCommandPosition (
+    PSTR Text,
+    PSTR Word
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether a word in the given text is where the
+    name of a command would go. This only looks back at what comes before the
+    word, and errs on the side of saying yes.
+
+Arguments:
+
+    Text - Supplies a pointer to the start of the text.
+
+    Word - Supplies a pointer to the word within the text.
+
+Return Value:
+
+    TRUE if the word may be a command name.
+
+    FALSE if the word is an argument or part of a longer word.
+
+--*/
+
+{
+
+    PSTR Current;
+    UINTN Index;
+    PSTR Keyword;
+    UINTN KeywordSize;
+    PSTR PreviousEnd;
+
+    Current = Word;
+    while ((Current > Text) &&
+           ((Current[-1] == ' ') || (Current[-1] == '\t'))) {
+
+        Current -= 1;
+    }
+
+    if ((Current == Text) ||
+        (strchr(SHELL_PARSE_CACHE_COMMAND_START_CHARACTERS, Current[-1]) !=
+         NULL)) {
+
+        return TRUE;
+    }
+
+    //
+    // Nothing but blanks between the previous word and this one means this
+    // is an argument, unless the previous word is a reserved word that a
+    // command can follow.
+    //
+
+    if (Current == Word) {
+        return FALSE;
+    }
+
+    PreviousEnd = Current;
+    while ((Current > Text) &&
+           (strchr(SHELL_PARSE_CACHE_WORD_END_CHARACTERS, Current[-1]) ==
+            NULL)) {
+
+        Current -= 1;
+    }
+
+    for (Index = 0; ShParseCacheCommandKeywords[Index] != NULL; Index += 1) {
+        Keyword = ShParseCacheCommandKeywords[Index];
+        KeywordSize = strlen(Keyword);
+        if (((UINTN)(PreviousEnd - Current) == KeywordSize) &&
+            (memcmp(Current, Keyword, KeywordSize) == 0)) {
+
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+ULONG
+ShHashParseCacheKey (
+    PSTR Text,
+    UINTN TextSize,
+    ULONG AliasGeneration,
+    BOOL Dequoted
+    )
+
+/*++
+
+Routine Description:
+
+    This routine computes the hash of a parse cache key.
+
+Arguments:
+
+    Text - Supplies a pointer to the text.
+
+    TextSize - Supplies the size of the text in bytes including the null
+        terminator.
+
+    AliasGeneration - Supplies the alias generation the text is parsed with.
+
+    Dequoted - Supplies a boolean indicating if the text is dequoted before
+        being parsed.
+
+Return Value:
+
+    Returns the hash of the key.
+
+--*/
+
+{
+
+    ULONG Hash;
+
+    Hash = SwHashString(Text, TextSize);
+    Hash ^= AliasGeneration * 31;
+    if (Dequoted != FALSE) {
+        Hash = ~Hash;
+    }
+
+    return Hash;
+}
+
+VOID
+ShInsertParseCacheEntry (
+    PSHELL_PARSE_CACHE_ENTRY Entry
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds an entry to the parse cache, evicting the least recently
+    used entry if the cache is full. The cache takes its own reference on the
+    entry.
+
+Arguments:
+
+    Entry - Supplies a pointer to the entry to add.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN Index;
+    PSHELL_PARSE_CACHE_ENTRY Oldest;
+
+    if (ShParseCacheBuckets == NULL) {
+        ShParseCacheBuckets = malloc(SHELL_PARSE_CACHE_HASH_SIZE *
+                                     sizeof(LIST_ENTRY));
+
+        if (ShParseCacheBuckets == NULL) {
+            return;
+        }
+
+        for (Index = 0; Index < SHELL_PARSE_CACHE_HASH_SIZE; Index += 1) {
+            INITIALIZE_LIST_HEAD(&(ShParseCacheBuckets[Index]));
+        }
+
+        INITIALIZE_LIST_HEAD(&ShParseCacheRecentList);
+        ShParseCacheCount = 0;
+    }
+
+    if (ShParseCacheCount >= SHELL_PARSE_CACHE_MAX_ENTRIES) {
+        Oldest = LIST_VALUE(ShParseCacheRecentList.Previous,
+                            SHELL_PARSE_CACHE_ENTRY,
+                            RecentListEntry);
+
+        LIST_REMOVE(&(Oldest->RecentListEntry));
+        LIST_REMOVE(&(Oldest->ListEntry));
+        Oldest->ListEntry.Next = NULL;
+        ShParseCacheCount -= 1;
+        ShReleaseParsedInput(Oldest);
+    }
+
+    INSERT_AFTER(&(Entry->ListEntry),
+                 &(ShParseCacheBuckets[Entry->Hash %
+                                       SHELL_PARSE_CACHE_HASH_SIZE]));
+
+    INSERT_AFTER(&(Entry->RecentListEntry), &ShParseCacheRecentList);
+    ShParseCacheCount += 1;
+    Entry->ReferenceCount += 1;
+    return;
+}
+
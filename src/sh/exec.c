@@ -213,13 +213,44 @@ Return Value:
 {
 
     PSHELL_NODE Command;
+    UINTN CommandIndex;
+    PSHELL_PARSE_CACHE_ENTRY ParsedInput;
     BOOL Result;
 
+    CommandIndex = 0;
+    ParsedInput = Shell->Lexer.ParsedInput;
     Result = FALSE;
     ShPrintPrompt(Shell, 1);
     while (Shell->Exited == FALSE) {
         ShCheckForSignals(Shell);
-        Result = ShParse(Shell, &Command);
+
+        //
+        // If the input was parsed ahead of time, run through those commands
+        // rather than parsing again. A parse error was already reported, and
+        // ends the run once the commands before it are done.
+        //
+
+        if (ParsedInput != NULL) {
+            if (CommandIndex == ParsedInput->CommandCount) {
+                Result = TRUE;
+                if ((ParsedInput->ParseFailed != FALSE) &&
+                    ((Shell->Options & SHELL_OPTION_INTERACTIVE) == 0)) {
+
+                    Result = FALSE;
+                }
+
+                break;
+            }
+
+            Command = ParsedInput->Commands[CommandIndex].Node;
+            CommandIndex += 1;
+            ShRetainNode(Command);
+            Result = TRUE;
+
+        } else {
+            Result = ShParse(Shell, &Command);
+        }
+
         if (Result == FALSE) {
             if ((Shell->Options & SHELL_OPTION_INTERACTIVE) != 0) {
                 ShPrintPrompt(Shell, 1);
@@ -239,6 +270,22 @@ Return Value:
         }
 
         ShReleaseNode(Command);
+
+        //
+        // The rest of the parsed commands were parsed with the old aliases.
+        // If that command changed them, go back to parsing as the commands
+        // run.
+        //
+
+        if ((ParsedInput != NULL) &&
+            (Shell->AliasGeneration != ParsedInput->AliasGeneration) &&
+            (CommandIndex != ParsedInput->CommandCount)) {
+
+            if (ShResumeParsingInput(Shell, CommandIndex) != FALSE) {
+                ParsedInput = NULL;
+            }
+        }
+
         if (Result == FALSE) {
             if ((Shell->Options & SHELL_OPTION_INTERACTIVE) == 0) {
                 break;
@@ -302,10 +349,14 @@ Return Value:
             }
 
             ShClose(Shell, ActiveRedirect->OriginalDescriptor);
-        }
 
-        if (ActiveRedirect->ChildProcessId > 0) {
-            SwWaitPid(ActiveRedirect->ChildProcessId, 0, NULL);
+        //
+        // If the descriptor wasn't open before the redirection, close it to
+        // put it back that way.
+        //
+
+        } else {
+            ShClose(Shell, ActiveRedirect->FileNumber);
         }
 
         free(ActiveRedirect);
@@ -404,10 +455,12 @@ Return Value:
     PSTR FullCommandPath;
     ULONG FullCommandPathSize;
     BOOL Result;
+    SHELL_PROFILE_SAMPLE Sample;
     INT Status;
 
     FullCommandPath = NULL;
     *ReturnValue = -1;
+    ShBeginCallProfileSample(Shell, ShellProfileCommand, Arguments[0], &Sample);
 
     //
     // If enabled, try the builtin commands.
@@ -421,6 +474,7 @@ Return Value:
                                  ArgumentCount,
                                  TRUE,
                                  !Asynchronous,
+                                 TRUE,
                                  ReturnValue);
 
         ShSetTerminalMode(Shell, TRUE);
@@ -484,6 +538,7 @@ Return Value:
         free(FullCommandPath);
     }
 
+    ShEndProfileSample(&Sample);
     return Status;
 }
 
@@ -522,6 +577,7 @@ Return Value:
     PSHELL_EXECUTION_NODE ExecutionNode;
     ULONG OriginalLineNumber;
     BOOL Result;
+    SHELL_PROFILE_SAMPLE Sample;
 
     if ((Node->RunInBackground != FALSE) && (SwForkSupported != 0)) {
         return ShExecuteAsynchronousNode(Shell, Node);
@@ -536,7 +592,7 @@ Return Value:
         return FALSE;
     }
 
-    INITIALIZE_LIST_HEAD(&(ExecutionNode->VariableList));
+    ShInitializeNameTable(&(ExecutionNode->Variables));
     INITIALIZE_LIST_HEAD(&(ExecutionNode->ArgumentList));
     INITIALIZE_LIST_HEAD(&(ExecutionNode->ActiveRedirectList));
     ExecutionNode->Node = Node;
@@ -545,6 +601,7 @@ Return Value:
     INSERT_AFTER(&(ExecutionNode->ListEntry), &(Shell->ExecutionStack));
     OriginalLineNumber = Shell->ExecutingLineNumber;
     Shell->ExecutingLineNumber = Node->LineNumber;
+    ShBeginNodeProfileSample(Shell, Node, &Sample);
     Result = ShApplyRedirections(Shell, ExecutionNode);
     if (Result == FALSE) {
         goto ExecuteNodeEnd;
@@ -613,9 +670,11 @@ Return Value:
     }
 
     ShDestroyArgumentList(&(ExecutionNode->ArgumentList));
-    ShDestroyVariableList(&(ExecutionNode->VariableList));
+    ShDestroyVariableTable(&(ExecutionNode->Variables));
     ShRestoreRedirections(Shell, &(ExecutionNode->ActiveRedirectList));
     free(ExecutionNode);
+    ShReleaseExpansionScratch(Shell);
+    ShEndProfileSample(&Sample);
     Shell->ExecutingLineNumber = OriginalLineNumber;
     Shell->LastReturnValue = Shell->ReturnValue;
     return Result;
@@ -1077,6 +1136,7 @@ Return Value:
     PSHELL_BUILTIN_COMMAND BuiltinCommand;
     PSTR ExpandedArguments;
     UINTN ExpandedArgumentsSize;
+    ULONG ExpansionOptions;
     PSHELL_FUNCTION Function;
     PSHELL_EXECUTION_NODE LatestExecutionNode;
     PSHELL_NODE Node;
@@ -1108,13 +1168,19 @@ Return Value:
     if (SimpleCommand->Arguments != NULL) {
 
         //
-        // Perform expansions, field splitting, and quote removal.
+        // Perform expansions, field splitting, and quote removal. Commands
+        // made up only of literal words just get split apart.
         //
 
+        ExpansionOptions = 0;
+        if (SimpleCommand->ArgumentsLiteral != FALSE) {
+            ExpansionOptions = SHELL_EXPANSION_OPTION_LITERAL;
+        }
+
         Result = ShPerformExpansions(Shell,
                                      SimpleCommand->Arguments,
                                      SimpleCommand->ArgumentsSize,
-                                     0,
+                                     ExpansionOptions,
                                      &ExpandedArguments,
                                      &ExpandedArgumentsSize,
                                      &Arguments,
@@ -1324,6 +1390,7 @@ Return Value:
     PSHELL_NODE Body;
     PSHELL_NODE OriginalNode;
     BOOL Result;
+    SHELL_PROFILE_SAMPLE Sample;
 
     assert(ExecutingNode->Node->Type == ShellNodeSimpleCommand);
     assert((ExecutingNode->Flags & SHELL_EXECUTION_BODY) == 0);
@@ -1355,7 +1422,13 @@ Return Value:
            (Function->Children.Next->Next == &(Function->Children)));
 
     Body = LIST_VALUE(Function->Children.Next, SHELL_NODE, SiblingListEntry);
+    ShBeginCallProfileSample(Shell,
+                             ShellProfileFunction,
+                             Function->U.Function.Name,
+                             &Sample);
+
     Result = ShExecuteNode(Shell, Body);
+    ShEndProfileSample(&Sample);
     if (Result == FALSE) {
         goto ExecuteFunctionInvocationEnd;
     }
@@ -1507,6 +1580,7 @@ Return Value:
 {
 
     PSHELL_NODE DoGroup;
+    ULONG ExpansionOptions;
     PSHELL_NODE_FOR ForStatement;
     PSHELL_NODE Node;
     BOOL Result;
@@ -1545,10 +1619,15 @@ Return Value:
                                      &WordCount);
 
     } else {
+        ExpansionOptions = 0;
+        if (ForStatement->WordListLiteral != FALSE) {
+            ExpansionOptions = SHELL_EXPANSION_OPTION_LITERAL;
+        }
+
         Result = ShPerformExpansions(Shell,
                                      ForStatement->WordListBuffer,
                                      ForStatement->WordListBufferSize,
-                                     0,
+                                     ExpansionOptions,
                                      &WordListString,
                                      &WordListStringSize,
                                      &Words,
@@ -2144,6 +2223,7 @@ Return Value:
     PSHELL_ACTIVE_REDIRECT ActiveRedirect;
     PSTR AfterScan;
     PLIST_ENTRY CurrentEntry;
+    INT DocumentDescriptor;
     PSTR DocumentText;
     UINTN DocumentTextSize;
     PSTR ExpandedFileName;
@@ -2157,18 +2237,16 @@ Return Value:
     ULONG Options;
     INT OriginalDescriptor;
     unsigned long PathSize;
-    INT Pipe[2];
     PSHELL_IO_REDIRECT Redirect;
     BOOL Result;
     INT SourceFileNumber;
     SHELL_IO_REDIRECTION_TYPE Type;
 
     ActiveRedirect = NULL;
+    DocumentDescriptor = -1;
     ExpandedFileName = NULL;
     ExpandedFileNameSize = 0;
     ExpandedString = NULL;
-    Pipe[0] = -1;
-    Pipe[1] = -1;
 
     //
     // Loop through all the redirections.
@@ -2190,8 +2268,6 @@ Return Value:
             goto ApplyRedirectionsEnd;
         }
 
-        ActiveRedirect->ChildProcessId = -1;
-
         //
         // Expand the file name.
         //
@@ -2375,44 +2451,47 @@ Return Value:
             }
 
             //
-            // Create a pipe for the here document and wire up the file
-            // descriptor to the read end of the pipe.
+            // Save the original descriptor first, then put the document text
+            // somewhere it can be read back from and wire up the file
+            // descriptor to that. If the descriptor wasn't open, the document
+            // may land right on it.
             //
 
-            Result = ShCreatePipe(Pipe);
-            if (Result == FALSE) {
-                goto ApplyRedirectionsEnd;
-            }
+            assert(DocumentTextSize != 0);
 
             OriginalDescriptor = ShDup(Shell, Redirect->FileNumber, FALSE);
-            if (OriginalDescriptor == -1) {
-                Result = FALSE;
-                goto ApplyRedirectionsEnd;
-            }
+            Result = ShOpenInputText(DocumentText,
+                                     DocumentTextSize - 1,
+                                     &DocumentDescriptor);
 
-            ShDup2(Shell, Pipe[0], Redirect->FileNumber);
-            ShClose(Shell, Pipe[0]);
-            Pipe[0] = -1;
-
-            //
-            // Launch the subprocess or thread to feed the document text into
-            // the descriptor.
-            //
+            if (ExpandedString != NULL) {
+                free(ExpandedString);
+                ExpandedString = NULL;
+            }
 
-            assert(DocumentTextSize != 0);
+            if (Result == FALSE) {
+                PRINT_ERROR("sh: Unable to create here document.\n");
+                if (OriginalDescriptor != -1) {
+                    ShClose(Shell, OriginalDescriptor);
+                }
 
-            DocumentTextSize -= 1;
-            Result = ShPushInputText(DocumentText, DocumentTextSize, Pipe[1]);
-            if (Result < 0) {
                 goto ApplyRedirectionsEnd;
             }
 
-            if (Result > 0) {
-                ActiveRedirect->ChildProcessId = Result;
+            if (DocumentDescriptor != Redirect->FileNumber) {
+                NewDescriptor = ShDup2(Shell,
+                                       DocumentDescriptor,
+                                       Redirect->FileNumber);
+
+                if (NewDescriptor < 0) {
+                    Result = FALSE;
+                    goto ApplyRedirectionsEnd;
+                }
+
+                ShClose(Shell, DocumentDescriptor);
             }
 
-            ShClose(Shell, Pipe[1]);
-            Pipe[1] = -1;
+            DocumentDescriptor = -1;
 
         } else {
 
@@ -2454,12 +2533,8 @@ Return Value:
     Result = TRUE;
 
 ApplyRedirectionsEnd:
-    if (Pipe[0] != -1) {
-        ShClose(Shell, Pipe[0]);
-    }
-
-    if (Pipe[1] != -1) {
-        ShClose(Shell, Pipe[1]);
+    if (DocumentDescriptor != -1) {
+        ShClose(Shell, DocumentDescriptor);
     }
 
     if (ExpandedString != NULL) {
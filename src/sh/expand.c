@@ -193,12 +193,21 @@ ShGetPositionalArgument (
 
 BOOL
 ShAddExpansionRangeEntry (
+    PSHELL Shell,
     PLIST_ENTRY ListHead,
     SHELL_EXPANSION_TYPE Type,
     UINTN Index,
     UINTN Length
     );
 
+BOOL
+ShSplitLiteralFields (
+    PSTR String,
+    UINTN StringSize,
+    PSTR **FieldsArray,
+    PULONG FieldsArrayCount
+    );
+
 VOID
 ShTrimVariableValue (
     PSTR *Value,
@@ -220,6 +229,33 @@ ShEscapeSpecialCharacters (
 // -------------------------------------------------------------------- Globals
 //
 
+//
+// Define the characters that disqualify a word from being a plain literal.
+// These start expansions, act as pathname patterns, or are quoting the lexer
+// left behind. Whitespace would be split differently too.
+//
+
+const CHAR ShNonLiteralCharacters[] = {
+    '$',
+    '`',
+    '~',
+    '*',
+    '?',
+    '[',
+    '\\',
+    '\'',
+    '"',
+    ' ',
+    '\t',
+    '\r',
+    '\n',
+    '\v',
+    '\f',
+    SHELL_CONTROL_ESCAPE,
+    SHELL_CONTROL_QUOTE,
+    '\0'
+};
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -282,7 +318,6 @@ Return Value:
 
     UINTN BufferCapacity;
     UINTN EndIndex;
-    PSHELL_EXPANSION_RANGE Expansion;
     LIST_ENTRY ExpansionList;
     PSTR Field;
     ULONG FieldIndex;
@@ -290,6 +325,7 @@ Return Value:
     BOOL Result;
 
     INITIALIZE_LIST_HEAD(&ExpansionList);
+    Shell->ExpansionDepth += 1;
     if (Fields != NULL) {
         *Fields = NULL;
     }
@@ -300,6 +336,27 @@ Return Value:
         goto PerformExpansionsEnd;
     }
 
+    //
+    // If the parser already determined that there's nothing to expand, just
+    // chop the words apart. Quote removal, pathname expansion, and IFS have
+    // nothing to act on.
+    //
+
+    if ((Options & SHELL_EXPANSION_OPTION_LITERAL) != 0) {
+        Result = TRUE;
+        if ((Options & SHELL_EXPANSION_OPTION_NO_FIELD_SPLIT) == 0) {
+
+            assert((Fields != NULL) && (FieldCount != NULL));
+
+            Result = ShSplitLiteralFields(String,
+                                          StringSize,
+                                          Fields,
+                                          FieldCount);
+        }
+
+        goto PerformExpansionsEnd;
+    }
+
     //
     // Do most of the work of substituting the expansions and keeping a list of
     // them.
@@ -396,23 +453,88 @@ Return Value:
     }
 
     //
-    // Free up the expansion list.
+    // The expansion list itself lives in the expansion arena, which is
+    // emptied in bulk once the command completes.
     //
 
-    while (LIST_EMPTY(&ExpansionList) == FALSE) {
-        Expansion = LIST_VALUE(ExpansionList.Next,
-                               SHELL_EXPANSION_RANGE,
-                               ListEntry);
-
-        LIST_REMOVE(&(Expansion->ListEntry));
-        free(Expansion);
-    }
-
+    Shell->ExpansionDepth -= 1;
     *ExpandedString = String;
     *ExpandedStringSize = StringSize;
     return Result;
 }
 
+BOOL
+ShIsLiteralWord (
+    PSTR Word,
+    UINTN WordSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether or not a word from the parser is a plain
+    literal, which expansion, field splitting, pathname expansion, and quote
+    removal would all leave untouched.
+
+Arguments:
+
+    Word - Supplies a pointer to the word, as produced by the lexer.
+
+    WordSize - Supplies the size of the word in bytes including the null
+        terminator.
+
+Return Value:
+
+    TRUE if the word needs no expansion at all.
+
+    FALSE if the word must go through expansion.
+
+--*/
+
+{
+
+    if ((WordSize <= 1) ||
+        (strcspn(Word, ShNonLiteralCharacters) != WordSize - 1)) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+VOID
+ShReleaseExpansionScratch (
+    PSHELL Shell
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees all the scratch memory handed out during expansions in
+    one shot. It is called when a command completes, and does nothing if an
+    expansion is still in progress.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if ((Shell->ExpansionArena != NULL) && (Shell->ExpansionDepth == 0)) {
+        SwResetArena(Shell->ExpansionArena);
+    }
+
+    return;
+}
+
 PLIST_ENTRY
 ShGetCurrentArgumentList (
     PSHELL Shell
@@ -1875,7 +1997,8 @@ Return Value:
         }
 
     } else {
-        Result = ShAddExpansionRangeEntry(ExpansionList,
+        Result = ShAddExpansionRangeEntry(Shell,
+                                          ExpansionList,
                                           ExpansionType,
                                           ExpansionOuterBegin,
                                           ValueSize);
@@ -1898,12 +2021,10 @@ Return Value:
         free(AllocatedValue);
     }
 
-    while (LIST_EMPTY(&ModifierExpansionList) == FALSE) {
-        CurrentEntry = ModifierExpansionList.Next;
-        LIST_REMOVE(CurrentEntry);
-        Expansion = LIST_VALUE(CurrentEntry, SHELL_EXPANSION_RANGE, ListEntry);
-        free(Expansion);
-    }
+    //
+    // Any modifier expansions not handed up are simply abandoned, as they
+    // live in the expansion arena.
+    //
 
     return Result;
 }
@@ -2176,7 +2297,8 @@ Return Value:
     // Take note of the expansion if requested.
     //
 
-    Result = ShAddExpansionRangeEntry(ExpansionList,
+    Result = ShAddExpansionRangeEntry(Shell,
+                                      ExpansionList,
                                       Type,
                                       ExpansionOuterBegin,
                                       ValueSize);
@@ -2428,7 +2550,8 @@ Return Value:
     // Take note of the expansion if requested.
     //
 
-    Result = ShAddExpansionRangeEntry(ExpansionList,
+    Result = ShAddExpansionRangeEntry(Shell,
+                                      ExpansionList,
                                       ShellExpansionFieldSplit,
                                       *ExpansionIndex,
                                       OutputSize);
@@ -2613,7 +2736,8 @@ Return Value:
     // Take note of the expansion if requested.
     //
 
-    Result = ShAddExpansionRangeEntry(ExpansionList,
+    Result = ShAddExpansionRangeEntry(Shell,
+                                      ExpansionList,
                                       ShellExpansionFieldSplit,
                                       *ExpansionIndex,
                                       HomeSize);
@@ -2795,7 +2919,8 @@ Return Value:
     // Take note of the expansion if requested.
     //
 
-    Result = ShAddExpansionRangeEntry(ExpansionList,
+    Result = ShAddExpansionRangeEntry(Shell,
+                                      ExpansionList,
                                       ShellExpansionFieldSplit,
                                       *ExpansionIndex,
                                       OutputSize);
@@ -3296,6 +3421,7 @@ Return Value:
 
 BOOL
 ShAddExpansionRangeEntry (
+    PSHELL Shell,
     PLIST_ENTRY ListHead,
     SHELL_EXPANSION_TYPE Type,
     UINTN Index,
@@ -3307,10 +3433,13 @@ ShAddExpansionRangeEntry (
 Routine Description:
 
     This routine allocates an expansion range entry, initializes it, and
-    places it on the end of the given list.
+    places it on the end of the given list. Entries come out of the shell's
+    expansion arena, so they are never freed individually.
 
 Arguments:
 
+    Shell - Supplies a pointer to the shell.
+
     ListHead - Supplies an optional pointer to the head of the list. If NULL,
         this routine is a no-op.
 
@@ -3338,7 +3467,16 @@ Return Value:
         return TRUE;
     }
 
-    Range = malloc(sizeof(SHELL_EXPANSION_RANGE));
+    if (Shell->ExpansionArena == NULL) {
+        Shell->ExpansionArena = SwCreateArena(SHELL_EXPANSION_ARENA_BLOCK_SIZE);
+        if (Shell->ExpansionArena == NULL) {
+            return FALSE;
+        }
+    }
+
+    Range = SwArenaAllocate(Shell->ExpansionArena,
+                            sizeof(SHELL_EXPANSION_RANGE));
+
     if (Range == NULL) {
         return FALSE;
     }
@@ -3350,6 +3488,85 @@ Return Value:
     return TRUE;
 }
 
+BOOL
+ShSplitLiteralFields (
+    PSTR String,
+    UINTN StringSize,
+    PSTR **FieldsArray,
+    PULONG FieldsArrayCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine splits a string made up of literal words separated by single
+    spaces into fields. This is the equivalent of field splitting for strings
+    with no expansions in them, without the need for an expansion list or IFS.
+
+Arguments:
+
+    String - Supplies a pointer to the string to split in place.
+
+    StringSize - Supplies the size of the string in bytes including the null
+        terminator.
+
+    FieldsArray - Supplies a pointer where the array of pointers to the fields
+        will be returned. This array will contain a NULL entry at the end of it,
+        though that entry will not be included in the field count. The caller
+        is responsible for freeing this memory.
+
+    FieldsArrayCount - Supplies a pointer where the number of elements in the
+        returned field array will be returned on success.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on allocation failure.
+
+--*/
+
+{
+
+    PSTR Current;
+    ULONG FieldCount;
+    ULONG FieldIndex;
+    PSTR *Fields;
+
+    FieldCount = 0;
+    if (StringSize > 1) {
+        FieldCount = 1;
+        Current = strchr(String, ' ');
+        while (Current != NULL) {
+            FieldCount += 1;
+            Current = strchr(Current + 1, ' ');
+        }
+    }
+
+    Fields = malloc((FieldCount + 1) * sizeof(PSTR));
+    if (Fields == NULL) {
+        return FALSE;
+    }
+
+    Current = String;
+    for (FieldIndex = 0; FieldIndex < FieldCount; FieldIndex += 1) {
+        Fields[FieldIndex] = Current;
+        Current = strchr(Current, ' ');
+        if (Current == NULL) {
+            break;
+        }
+
+        *Current = '\0';
+        Current += 1;
+    }
+
+    Fields[FieldCount] = NULL;
+    *FieldsArray = Fields;
+    *FieldsArrayCount = FieldCount;
+    return TRUE;
+}
+
 VOID
 ShTrimVariableValue (
     PSTR *Value,
@@ -326,6 +326,11 @@ Return Value:
         Lexer->InputFile = NULL;
     }
 
+    if (Lexer->ParsedInput != NULL) {
+        ShReleaseParsedInput(Lexer->ParsedInput);
+        Lexer->ParsedInput = NULL;
+    }
+
     return;
 }
 
@@ -1352,8 +1357,36 @@ Return Value:
 
 {
 
+    CHAR Next;
+    PSHELL_LEXER_STATE Lexer;
     BOOL Result;
 
+    //
+    // Hand out characters straight from the input buffer when nothing
+    // special is going on, which is the case for nearly every character of a
+    // script.
+    //
+
+    Lexer = &(Shell->Lexer);
+    if ((Lexer->UnputCharacterValid == FALSE) &&
+        ((Shell->Options & SHELL_OPTION_DISPLAY_INPUT) == 0)) {
+
+        while (Lexer->InputBufferNextIndex < Lexer->InputBufferSize) {
+            Next = Lexer->InputBuffer[Lexer->InputBufferNextIndex];
+            Lexer->InputBufferNextIndex += 1;
+            if ((Next == '\r') || (Next == '\0')) {
+                continue;
+            }
+
+            if (Next == '\n') {
+                Lexer->LineNumber += 1;
+            }
+
+            *Character = Next;
+            return TRUE;
+        }
+    }
+
     do {
         Result = ShGetAnyInputCharacter(Shell, Character);
 
@@ -1392,7 +1425,7 @@ Return Value:
 
 {
 
-    size_t BytesRead;
+    ssize_t BytesRead;
     size_t BytesToRead;
     PSHELL_LEXER_STATE Lexer;
     PSTR NewInputBuffer;
@@ -1469,24 +1502,42 @@ Return Value:
             BytesToRead = 1;
 
         } else {
+
+            //
+            // Script files are read in big blocks. Nothing else reads from
+            // the script, so reading ahead is safe.
+            //
+
+            if ((Lexer->InputFile != NULL) &&
+                (Lexer->InputBufferCapacity < SHELL_FILE_INPUT_BUFFER_SIZE)) {
+
+                NewInputBuffer = realloc(Lexer->InputBuffer,
+                                         SHELL_FILE_INPUT_BUFFER_SIZE);
+
+                if (NewInputBuffer != NULL) {
+                    Lexer->InputBuffer = NewInputBuffer;
+                    Lexer->InputBufferCapacity = SHELL_FILE_INPUT_BUFFER_SIZE;
+                }
+            }
+
             BytesToRead = Lexer->InputBufferCapacity;
         }
 
         //
-        // Read using a file stream.
+        // Read script files straight from the descriptor rather than going
+        // through the stream, which would only add another copy.
         //
 
         if (Lexer->InputFile != NULL) {
             do {
-                BytesRead = fread(Lexer->InputBuffer,
-                                  1,
-                                  BytesToRead,
-                                  Lexer->InputFile);
+                BytesRead = read(fileno(Lexer->InputFile),
+                                 Lexer->InputBuffer,
+                                 BytesToRead);
 
-            } while ((BytesRead == 0) && (errno == EINTR));
+            } while ((BytesRead < 0) && (errno == EINTR));
 
             if (BytesRead <= 0) {
-                if (feof(Lexer->InputFile) != 0) {
+                if (BytesRead == 0) {
                     *Character = EOF;
                     goto GetInputCharacterEnd;
                 }
@@ -1604,7 +1604,14 @@ Return Value:
         // coming in add them to the wordlist.
         //
 
+        ForNode->U.For.WordListLiteral = TRUE;
         while (SHELL_TOKEN_WORD_LIKE(Shell->Lexer.TokenType)) {
+            if (ShIsLiteralWord(Shell->Lexer.TokenBuffer,
+                                Shell->Lexer.TokenBufferSize) == FALSE) {
+
+                ForNode->U.For.WordListLiteral = FALSE;
+            }
+
             Result = ShStringAppend(&(ForNode->U.For.WordListBuffer),
                                     &(ForNode->U.For.WordListBufferSize),
                                     &(ForNode->U.For.WordListBufferCapacity),
@@ -3782,6 +3789,7 @@ Return Value:
     }
 
     Assignment->ValueSize = ValueSize;
+    Assignment->ValueLiteral = ShIsLiteralWord(Value, ValueSize);
 
     assert(Node->Type == ShellNodeSimpleCommand);
 
@@ -3997,6 +4005,20 @@ Return Value:
     assert(ComponentSize != 0);
 
     SimpleCommand = &(Command->U.SimpleCommand);
+
+    //
+    // Decide at parse time whether the command will ever need expanding. The
+    // first word sets the flag and any word that isn't literal clears it.
+    //
+
+    if (SimpleCommand->Arguments == NULL) {
+        SimpleCommand->ArgumentsLiteral = TRUE;
+    }
+
+    if (ShIsLiteralWord(Component, ComponentSize) == FALSE) {
+        SimpleCommand->ArgumentsLiteral = FALSE;
+    }
+
     Result = ShStringAppend(&(SimpleCommand->Arguments),
                             &(SimpleCommand->ArgumentsSize),
                             &(SimpleCommand->ArgumentsBufferCapacity),
@@ -134,6 +134,30 @@ ShPathCompareStrings (
     const void *RightString
     );
 
+PSHELL_COMMAND_HASH_ENTRY
+ShLookupCommandHash (
+    PSHELL Shell,
+    PSTR Path,
+    PSTR Command,
+    UINTN CommandSize
+    );
+
+VOID
+ShAddCommandHash (
+    PSHELL Shell,
+    PSTR Path,
+    UINTN PathSize,
+    PSTR Command,
+    UINTN CommandSize,
+    PSTR FullCommand,
+    UINTN FullCommandSize
+    );
+
+BOOL
+ShIsPathEntryAbsolute (
+    PSTR PathEntry
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -647,6 +671,8 @@ ShLocateCommand (
 Routine Description:
 
     This routine locates a command using the PATH environment variable.
+    Executables found by searching the path are remembered, so that finding
+    them again doesn't require searching the path all over again.
 
 Arguments:
 
@@ -691,10 +717,12 @@ Return Value:
     ULONG ExtensionLength;
     PSTR *ExtensionList;
     unsigned int ExtensionListCount;
+    PSHELL_COMMAND_HASH_ENTRY HashEntry;
     CHAR ListSeparator;
     PSTR NextListSeparator;
     PSTR Path;
     UINTN PathSize;
+    BOOL Remember;
     BOOL Result;
     struct stat Stat;
     INT Status;
@@ -706,8 +734,16 @@ Return Value:
     ExtendedPath = NULL;
     ShGetExecutableExtensions(&ExtensionList, &ExtensionListCount);
     ListSeparator = ShGetPathListSeparator();
+
+    //
+    // Only executable lookups are remembered, since a search that accepts
+    // any file might stop earlier in the path.
+    //
+
+    Remember = MustBeExecutable;
     if (ShExecutableBitSupported == 0) {
         MustBeExecutable = FALSE;
+        Remember = TRUE;
     }
 
     //
@@ -811,6 +847,27 @@ Return Value:
         goto LocateCommandEnd;
     }
 
+    //
+    // Use the remembered location if the command has been found before.
+    //
+
+    if (Remember != FALSE) {
+        HashEntry = ShLookupCommandHash(Shell, Path, Command, CommandSize);
+        if (HashEntry != NULL) {
+            *FullCommand = SwStringDuplicate(HashEntry->Path,
+                                             HashEntry->PathSize);
+
+            if (*FullCommand == NULL) {
+                Result = FALSE;
+                goto LocateCommandEnd;
+            }
+
+            *FullCommandSize = HashEntry->PathSize;
+            Result = TRUE;
+            goto LocateCommandEnd;
+        }
+    }
+
     //
     // Loop through each entry in the path.
     //
@@ -854,6 +911,18 @@ Return Value:
             ((MustBeExecutable == FALSE) ||
              ((Stat.st_mode & S_IXUSR) != 0))) {
 
+            if ((Remember != FALSE) &&
+                (ShIsPathEntryAbsolute(CurrentPath) != FALSE)) {
+
+                ShAddCommandHash(Shell,
+                                 Path,
+                                 PathSize,
+                                 Command,
+                                 CommandSize,
+                                 CompletePath,
+                                 CompletePathSize);
+            }
+
             *FullCommand = CompletePath;
             *FullCommandSize = CompletePathSize;
             CompletePath = NULL;
@@ -888,6 +957,18 @@ Return Value:
                 ((MustBeExecutable == FALSE) ||
                  ((Stat.st_mode & S_IXUSR) != 0))) {
 
+                if ((Remember != FALSE) &&
+                    (ShIsPathEntryAbsolute(CurrentPath) != FALSE)) {
+
+                    ShAddCommandHash(Shell,
+                                     Path,
+                                     PathSize,
+                                     Command,
+                                     CommandSize,
+                                     ExtendedPath,
+                                     CompletePathSize + ExtensionLength);
+                }
+
                 *FullCommand = ExtendedPath;
                 *FullCommandSize = CompletePathSize + ExtensionLength;
                 ExtendedPath = NULL;
@@ -937,6 +1018,206 @@ Return Value:
     return Result;
 }
 
+VOID
+ShClearCommandHash (
+    PSHELL Shell
+    )
+
+/*++
+
+Routine Description:
+
+    This routine forgets all remembered command locations in the given shell.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLIST_ENTRY Bucket;
+    ULONG BucketIndex;
+    PSHELL_COMMAND_HASH_ENTRY Entry;
+
+    if (Shell->CommandHash != NULL) {
+        for (BucketIndex = 0;
+             BucketIndex < SHELL_COMMAND_HASH_SIZE;
+             BucketIndex += 1) {
+
+            Bucket = &(Shell->CommandHash[BucketIndex]);
+            while (LIST_EMPTY(Bucket) == FALSE) {
+                Entry = LIST_VALUE(Bucket->Next,
+                                   SHELL_COMMAND_HASH_ENTRY,
+                                   ListEntry);
+
+                LIST_REMOVE(&(Entry->ListEntry));
+                free(Entry);
+            }
+        }
+
+        free(Shell->CommandHash);
+        Shell->CommandHash = NULL;
+    }
+
+    if (Shell->CommandHashPath != NULL) {
+        free(Shell->CommandHashPath);
+        Shell->CommandHashPath = NULL;
+    }
+
+    return;
+}
+
+BOOL
+ShCopyCommandHash (
+    PSHELL Source,
+    PSHELL Destination
+    )
+
+/*++
+
+Routine Description:
+
+    This routine copies the remembered command locations from one shell to
+    another.
+
+Arguments:
+
+    Source - Supplies a pointer to the shell to copy locations from.
+
+    Destination - Supplies a pointer to the shell to copy locations to. This
+        shell is assumed to have no remembered locations yet.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on allocation failure.
+
+--*/
+
+{
+
+    PLIST_ENTRY Bucket;
+    ULONG BucketIndex;
+    PLIST_ENTRY CurrentEntry;
+    PSHELL_COMMAND_HASH_ENTRY Entry;
+    UINTN PathSize;
+
+    assert(Destination->CommandHash == NULL);
+
+    if ((Source->CommandHash == NULL) || (Source->CommandHashPath == NULL)) {
+        return TRUE;
+    }
+
+    PathSize = strlen(Source->CommandHashPath) + 1;
+    for (BucketIndex = 0;
+         BucketIndex < SHELL_COMMAND_HASH_SIZE;
+         BucketIndex += 1) {
+
+        Bucket = &(Source->CommandHash[BucketIndex]);
+        CurrentEntry = Bucket->Next;
+        while (CurrentEntry != Bucket) {
+            Entry = LIST_VALUE(CurrentEntry,
+                               SHELL_COMMAND_HASH_ENTRY,
+                               ListEntry);
+
+            CurrentEntry = CurrentEntry->Next;
+            ShAddCommandHash(Destination,
+                             Source->CommandHashPath,
+                             PathSize,
+                             Entry->Name,
+                             Entry->NameSize,
+                             Entry->Path,
+                             Entry->PathSize);
+
+            if (Destination->CommandHash == NULL) {
+                return FALSE;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+VOID
+ShPrintCommandHash (
+    PSHELL Shell
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prints the full path of each remembered command location to
+    standard out.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLIST_ENTRY Bucket;
+    ULONG BucketIndex;
+    PLIST_ENTRY CurrentEntry;
+    PSHELL_COMMAND_HASH_ENTRY Entry;
+    PSTR Path;
+    UINTN PathSize;
+    BOOL Result;
+
+    if (Shell->CommandHash == NULL) {
+        return;
+    }
+
+    //
+    // Don't show locations that were found with some other path, as they'd
+    // just be forgotten on the next lookup anyway.
+    //
+
+    Result = ShGetVariable(Shell,
+                           SHELL_PATH,
+                           sizeof(SHELL_PATH),
+                           &Path,
+                           &PathSize);
+
+    if ((Result == FALSE) || (Path == NULL) ||
+        (strcmp(Shell->CommandHashPath, Path) != 0)) {
+
+        ShClearCommandHash(Shell);
+        return;
+    }
+
+    for (BucketIndex = 0;
+         BucketIndex < SHELL_COMMAND_HASH_SIZE;
+         BucketIndex += 1) {
+
+        Bucket = &(Shell->CommandHash[BucketIndex]);
+        CurrentEntry = Bucket->Next;
+        while (CurrentEntry != Bucket) {
+            Entry = LIST_VALUE(CurrentEntry,
+                               SHELL_COMMAND_HASH_ENTRY,
+                               ListEntry);
+
+            CurrentEntry = CurrentEntry->Next;
+            printf("%s\n", Entry->Path);
+        }
+    }
+
+    return;
+}
+
 INT
 ShBuiltinPwd (
     PSHELL Shell,
@@ -1831,7 +2112,10 @@ ShArePatternCharactersInPath (
 Routine Description:
 
     This routine determines if the given string contains any special pattern
-    characters: * ? or [ that not quoted by a backslash.
+    characters: * ? or [ that not quoted by a backslash. A [ only counts if
+    a ] comes somewhere after it, since otherwise it can't start a bracket
+    expression and just matches itself. This keeps commands like [ from
+    scanning the current directory every time they run.
 
 Arguments:
 
@@ -1861,7 +2145,13 @@ Return Value:
             continue;
         }
 
-        if ((*Path == '?') || (*Path == '*') || (*Path == '[')) {
+        if ((*Path == '?') || (*Path == '*')) {
+            return TRUE;
+        }
+
+        if ((*Path == '[') && (PathSize > 1) &&
+            (memchr(Path + 1, ']', PathSize - 1) != NULL)) {
+
             return TRUE;
         }
 
@@ -2578,3 +2868,226 @@ Return Value:
     return Result;
 }
 
+PSHELL_COMMAND_HASH_ENTRY
+ShLookupCommandHash (
+    PSHELL Shell,
+    PSTR Path,
+    PSTR Command,
+    UINTN CommandSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine looks up the remembered location of a command. If the path
+    has changed since the locations were remembered, all of them are
+    forgotten. If the remembered file is no longer there or no longer
+    executable, that one location is forgotten.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell.
+
+    Path - Supplies a pointer to the current value of the PATH variable.
+
+    Command - Supplies a pointer to the command name.
+
+    CommandSize - Supplies the size of the command name in bytes including the
+        null terminator.
+
+Return Value:
+
+    Returns a pointer to the remembered location on success.
+
+    NULL if the command's location is not known.
+
+--*/
+
+{
+
+    PLIST_ENTRY Bucket;
+    PLIST_ENTRY CurrentEntry;
+    PSHELL_COMMAND_HASH_ENTRY Entry;
+    ULONG Hash;
+    struct stat Stat;
+    INT Status;
+
+    if (Shell->CommandHash == NULL) {
+        return NULL;
+    }
+
+    if (strcmp(Shell->CommandHashPath, Path) != 0) {
+        ShClearCommandHash(Shell);
+        return NULL;
+    }
+
+    Hash = SwHashString(Command, CommandSize);
+    Bucket = &(Shell->CommandHash[Hash % SHELL_COMMAND_HASH_SIZE]);
+    CurrentEntry = Bucket->Next;
+    while (CurrentEntry != Bucket) {
+        Entry = LIST_VALUE(CurrentEntry, SHELL_COMMAND_HASH_ENTRY, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if ((Entry->Hash != Hash) || (Entry->NameSize != CommandSize) ||
+            (memcmp(Entry->Name, Command, CommandSize) != 0)) {
+
+            continue;
+        }
+
+        //
+        // Make sure the file is still there, which is a lot cheaper than
+        // searching the whole path again.
+        //
+
+        Status = SwStat(Entry->Path, TRUE, &Stat);
+        if ((Status == 0) && (S_ISREG(Stat.st_mode)) &&
+            ((ShExecutableBitSupported == 0) ||
+             ((Stat.st_mode & S_IXUSR) != 0))) {
+
+            return Entry;
+        }
+
+        LIST_REMOVE(&(Entry->ListEntry));
+        free(Entry);
+        break;
+    }
+
+    return NULL;
+}
+
+VOID
+ShAddCommandHash (
+    PSHELL Shell,
+    PSTR Path,
+    UINTN PathSize,
+    PSTR Command,
+    UINTN CommandSize,
+    PSTR FullCommand,
+    UINTN FullCommandSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine remembers the location of a command. Failures are not
+    reported, since the command can always be found again by searching the
+    path. If the table can't be set up, the shell is left with no remembered
+    locations at all.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell.
+
+    Path - Supplies a pointer to the current value of the PATH variable.
+
+    PathSize - Supplies the size of the path value in bytes including the null
+        terminator.
+
+    Command - Supplies a pointer to the command name.
+
+    CommandSize - Supplies the size of the command name in bytes including the
+        null terminator.
+
+    FullCommand - Supplies a pointer to the full path the command was found
+        at.
+
+    FullCommandSize - Supplies the size of the full command path in bytes
+        including the null terminator.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG BucketIndex;
+    PSHELL_COMMAND_HASH_ENTRY Entry;
+
+    if (Shell->CommandHash == NULL) {
+        Shell->CommandHashPath = SwStringDuplicate(Path, PathSize);
+        Shell->CommandHash = malloc(
+                               sizeof(LIST_ENTRY) * SHELL_COMMAND_HASH_SIZE);
+
+        if ((Shell->CommandHashPath == NULL) || (Shell->CommandHash == NULL)) {
+            goto AddCommandHashError;
+        }
+
+        for (BucketIndex = 0;
+             BucketIndex < SHELL_COMMAND_HASH_SIZE;
+             BucketIndex += 1) {
+
+            INITIALIZE_LIST_HEAD(&(Shell->CommandHash[BucketIndex]));
+        }
+    }
+
+    assert(strcmp(Shell->CommandHashPath, Path) == 0);
+
+    Entry = malloc(sizeof(SHELL_COMMAND_HASH_ENTRY) + CommandSize +
+                   FullCommandSize);
+
+    if (Entry == NULL) {
+        goto AddCommandHashError;
+    }
+
+    Entry->Hash = SwHashString(Command, CommandSize);
+    Entry->Name = (PSTR)(Entry + 1);
+    Entry->NameSize = CommandSize;
+    memcpy(Entry->Name, Command, CommandSize);
+    Entry->Path = Entry->Name + CommandSize;
+    Entry->PathSize = FullCommandSize;
+    memcpy(Entry->Path, FullCommand, FullCommandSize);
+    BucketIndex = Entry->Hash % SHELL_COMMAND_HASH_SIZE;
+    INSERT_BEFORE(&(Entry->ListEntry), &(Shell->CommandHash[BucketIndex]));
+    return;
+
+AddCommandHashError:
+    ShClearCommandHash(Shell);
+    return;
+}
+
+BOOL
+ShIsPathEntryAbsolute (
+    PSTR PathEntry
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether an entry in the PATH variable is an
+    absolute path. Commands found through relative entries depend on the
+    current directory, and so can't be remembered.
+
+Arguments:
+
+    PathEntry - Supplies a pointer to the path entry. It does not need to be
+        null terminated.
+
+Return Value:
+
+    TRUE if the entry is an absolute path.
+
+    FALSE if the entry is relative to the current directory.
+
+--*/
+
+{
+
+    if ((PathEntry[0] == '/') || (PathEntry[0] == '\\')) {
+        return TRUE;
+    }
+
+    //
+    // Also allow for drive letters.
+    //
+
+    if ((isalpha(PathEntry[0])) && (PathEntry[1] == ':')) {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
@@ -0,0 +1,1182 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+This project is dual licensed. You are receiving it under the terms of the
+GNU General Public License version 3 (GPLv3). Alternative licensing terms are
+available. Contact info@minocacorp.com for details. See the LICENSE file at the
+root of this project for complete licensing information.
+
+Module Name:
+
+    profile.c
+
+Abstract:
+
+    This module implements the shell profiler, which records the wall clock
+    and processor time spent in each line, function, and command when the
+    profile option is set.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    POSIX
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include "sh.h"
+#include "shparse.h"
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../swlib.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the size of the buffer used to build the name of a node entry.
+//
+
+#define SHELL_PROFILE_NODE_NAME_SIZE 48
+
+//
+// Define the suffix of profile file names that get folded stacks rather than
+// a report.
+//
+
+#define SHELL_PROFILE_FOLDED_SUFFIX ".folded"
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure defines the time accumulated for a single line, function,
+    or command.
+
+Members:
+
+    ListEntry - Stores pointers to the next and previous entries in the name
+        table of entries of the same type.
+
+    Type - Stores the type of thing being measured.
+
+    Name - Stores a pointer to the name of the entry.
+
+    NameSize - Stores the size of the name in bytes including the null
+        terminator.
+
+    Depth - Stores the number of measurements of this entry currently in
+        progress. Time is only added when the outermost one finishes, so that
+        recursion isn't counted twice.
+
+    Count - Stores the number of times the entry was run.
+
+    WallTime - Stores the total wall clock time spent in the entry, in
+        microseconds.
+
+    ProcessorTime - Stores the total processor time spent in the entry by the
+        shell and its children, in microseconds.
+
+--*/
+
+struct _SHELL_PROFILE_ENTRY {
+    LIST_ENTRY ListEntry;
+    SHELL_PROFILE_TYPE Type;
+    PSTR Name;
+    UINTN NameSize;
+    ULONG Depth;
+    ULONGLONG Count;
+    ULONGLONG WallTime;
+    ULONGLONG ProcessorTime;
+};
+
+/*++
+
+Structure Description:
+
+    This structure defines a node in the profiler's call tree. There is one
+    frame for each distinct stack of function and command calls.
+
+Members:
+
+    Parent - Stores a pointer to the calling frame, or NULL for the root.
+
+    Child - Stores a pointer to the first frame called from this one.
+
+    Sibling - Stores a pointer to the next frame with the same parent.
+
+    Entry - Stores a pointer to the function or command this frame runs, or
+        NULL for the root frame.
+
+    SelfTime - Stores the wall clock time spent in this frame but not in any
+        of its children, in microseconds.
+
+--*/
+
+struct _SHELL_PROFILE_FRAME {
+    PSHELL_PROFILE_FRAME Parent;
+    PSHELL_PROFILE_FRAME Child;
+    PSHELL_PROFILE_FRAME Sibling;
+    PSHELL_PROFILE_ENTRY Entry;
+    LONGLONG SelfTime;
+};
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+VOID
+ShStartProfiler (
+    VOID
+    );
+
+BOOL
+ShIsProfileInUse (
+    VOID
+    );
+
+PSHELL_PROFILE_ENTRY
+ShGetProfileEntry (
+    SHELL_PROFILE_TYPE Type,
+    PSTR Name,
+    UINTN NameSize
+    );
+
+VOID
+ShStartProfileSample (
+    PSHELL_PROFILE_SAMPLE Sample
+    );
+
+VOID
+ShGetProfileTimes (
+    PULONGLONG WallTime,
+    PULONGLONG ProcessorTime
+    );
+
+VOID
+ShWriteProfileReport (
+    FILE *File,
+    PSHELL Shell
+    );
+
+int
+ShCompareProfileEntries (
+    const void *Left,
+    const void *Right
+    );
+
+VOID
+ShWriteFoldedProfileFrame (
+    FILE *File,
+    PSHELL Shell,
+    PSHELL_PROFILE_FRAME Frame
+    );
+
+VOID
+ShWriteProfileFramePath (
+    FILE *File,
+    PSHELL Shell,
+    PSHELL_PROFILE_FRAME Frame
+    );
+
+VOID
+ShDestroyProfileFrames (
+    PSHELL_PROFILE_FRAME Frame
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// Store whether or not the profiler has been set up.
+//
+
+BOOL ShProfileStarted;
+
+//
+// Store the ID of the process that collected the profile, and the number of
+// measurements it has in progress.
+//
+
+pid_t ShProfileProcessId;
+ULONG ShProfileActiveSamples;
+
+//
+// Store the monotonic clock time when profiling began, in microseconds.
+//
+
+ULONGLONG ShProfileStartTime;
+
+//
+// Store the tables of entries, one for each type.
+//
+
+SHELL_NAME_TABLE ShProfileTables[ShellProfileTypeCount];
+
+//
+// Store the root of the call tree, and the frame currently running.
+//
+
+SHELL_PROFILE_FRAME ShProfileRootFrame;
+PSHELL_PROFILE_FRAME ShProfileCurrentFrame;
+
+//
+// Store the names of the node types that are measured. Lists and terms just
+// hold other commands, and function definitions take no time, so those are
+// not measured.
+//
+
+PSTR ShProfileNodeTypeNames[] = {
+    NULL,
+    NULL,
+    "and-or",
+    "pipeline",
+    "command",
+    NULL,
+    "if",
+    NULL,
+    "for",
+    "brace group",
+    "case",
+    "while",
+    "until",
+    "subshell",
+};
+
+//
+// Store the names of each type of entry, as printed in the report.
+//
+
+PSTR ShProfileTypeNames[ShellProfileTypeCount] = {
+    "line",
+    "function",
+    "command",
+};
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+VOID
+ShBeginNodeProfileSample (
+    PSHELL Shell,
+    PSHELL_NODE Node,
+    PSHELL_PROFILE_SAMPLE Sample
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts timing the execution of a node if profiling is
+    enabled. Time is charged to the node's line number and type.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell executing the node.
+
+    Node - Supplies a pointer to the node about to be executed.
+
+    Sample - Supplies a pointer to the sample to start. Pass it to
+        ShEndProfileSample once the node is done.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    CHAR Name[SHELL_PROFILE_NODE_NAME_SIZE];
+    INT NameSize;
+    PSTR TypeName;
+
+    Sample->Entry = NULL;
+    Sample->Frame = NULL;
+    if ((Shell->Options & SHELL_OPTION_PROFILE) == 0) {
+        return;
+    }
+
+    assert(Node->Type < sizeof(ShProfileNodeTypeNames) /
+                        sizeof(ShProfileNodeTypeNames[0]));
+
+    TypeName = ShProfileNodeTypeNames[Node->Type];
+    if (TypeName == NULL) {
+        return;
+    }
+
+    NameSize = snprintf(Name,
+                        sizeof(Name),
+                        "%u: %s",
+                        Node->LineNumber,
+                        TypeName);
+
+    if ((NameSize <= 0) || (NameSize >= sizeof(Name))) {
+        return;
+    }
+
+    Sample->Entry = ShGetProfileEntry(ShellProfileNode, Name, NameSize + 1);
+    if (Sample->Entry == NULL) {
+        return;
+    }
+
+    ShStartProfileSample(Sample);
+    return;
+}
+
+VOID
+ShBeginCallProfileSample (
+    PSHELL Shell,
+    SHELL_PROFILE_TYPE Type,
+    PSTR Name,
+    PSHELL_PROFILE_SAMPLE Sample
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts timing a function invocation or a command if
+    profiling is enabled, and pushes it onto the profiler's call stack.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell making the call.
+
+    Type - Supplies the type of call being made.
+
+    Name - Supplies a pointer to the null terminated name of the function or
+        command.
+
+    Sample - Supplies a pointer to the sample to start. Pass it to
+        ShEndProfileSample once the call returns.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSHELL_PROFILE_FRAME Frame;
+    PSHELL_PROFILE_FRAME Parent;
+
+    assert((Type == ShellProfileFunction) || (Type == ShellProfileCommand));
+
+    Sample->Entry = NULL;
+    Sample->Frame = NULL;
+    if ((Shell->Options & SHELL_OPTION_PROFILE) == 0) {
+        return;
+    }
+
+    Sample->Entry = ShGetProfileEntry(Type, Name, strlen(Name) + 1);
+    if (Sample->Entry == NULL) {
+        return;
+    }
+
+    //
+    // Find the frame for this call under the current one, or create it if
+    // this is the first time this call has been made from here. If there's
+    // no memory for a new frame, the call is still timed but it is left out
+    // of the call tree.
+    //
+
+    Parent = ShProfileCurrentFrame;
+    Frame = Parent->Child;
+    while ((Frame != NULL) && (Frame->Entry != Sample->Entry)) {
+        Frame = Frame->Sibling;
+    }
+
+    if (Frame == NULL) {
+        Frame = malloc(sizeof(SHELL_PROFILE_FRAME));
+        if (Frame != NULL) {
+            Frame->Parent = Parent;
+            Frame->Child = NULL;
+            Frame->Sibling = Parent->Child;
+            Frame->Entry = Sample->Entry;
+            Frame->SelfTime = 0;
+            Parent->Child = Frame;
+        }
+    }
+
+    if (Frame != NULL) {
+        Sample->Frame = Frame;
+        ShProfileCurrentFrame = Frame;
+    }
+
+    ShStartProfileSample(Sample);
+    return;
+}
+
+VOID
+ShEndProfileSample (
+    PSHELL_PROFILE_SAMPLE Sample
+    )
+
+/*++
+
+Routine Description:
+
+    This routine stops a timing measurement and adds the elapsed time to the
+    profile.
+
+Arguments:
+
+    Sample - Supplies a pointer to the sample that was started.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSHELL_PROFILE_ENTRY Entry;
+    PSHELL_PROFILE_FRAME Frame;
+    ULONGLONG ProcessorTime;
+    ULONGLONG WallTime;
+
+    Entry = Sample->Entry;
+    if (Entry == NULL) {
+        return;
+    }
+
+    ShGetProfileTimes(&WallTime, &ProcessorTime);
+    WallTime -= Sample->WallTime;
+    ProcessorTime -= Sample->ProcessorTime;
+
+    assert((Entry->Depth != 0) && (ShProfileActiveSamples != 0));
+
+    ShProfileActiveSamples -= 1;
+    Entry->Depth -= 1;
+    if (Entry->Depth == 0) {
+        Entry->WallTime += WallTime;
+        Entry->ProcessorTime += ProcessorTime;
+    }
+
+    //
+    // Charge the time to the frame, and take it back out of the caller's own
+    // time.
+    //
+
+    Frame = Sample->Frame;
+    if (Frame != NULL) {
+
+        assert(ShProfileCurrentFrame == Frame);
+
+        Frame->SelfTime += WallTime;
+        Frame->Parent->SelfTime -= WallTime;
+        ShProfileCurrentFrame = Frame->Parent;
+    }
+
+    Sample->Entry = NULL;
+    Sample->Frame = NULL;
+    return;
+}
+
+VOID
+ShWriteProfile (
+    PSHELL Shell
+    )
+
+/*++
+
+Routine Description:
+
+    This routine writes out the profile collected so far. It goes to the file
+    named by the SHPROFILE variable, or standard error if that is not set. If
+    the file name ends in .folded, the profile is written as folded call
+    stacks suitable for making a flame graph. Otherwise a report sorted by
+    time is written. Nothing is written if the profile option has been
+    cleared.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    FILE *File;
+    BOOL Folded;
+    PSTR Path;
+    UINTN PathSize;
+    BOOL Result;
+    UINTN SuffixSize;
+    ULONGLONG TotalTime;
+    ULONGLONG WallTime;
+
+    if ((ShProfileStarted == FALSE) || (ShIsProfileInUse() != FALSE)) {
+        return;
+    }
+
+    //
+    // Turning the option off with "set +o profile" stops collection, and
+    // throws away what was collected before rather than reporting it.
+    //
+
+    if ((Shell->Options & SHELL_OPTION_PROFILE) == 0) {
+        return;
+    }
+
+    File = stderr;
+    Folded = FALSE;
+    Result = ShGetVariable(Shell,
+                           SHELL_PROFILE,
+                           sizeof(SHELL_PROFILE),
+                           &Path,
+                           &PathSize);
+
+    if ((Result != FALSE) && (PathSize > 1)) {
+        SuffixSize = sizeof(SHELL_PROFILE_FOLDED_SUFFIX);
+        if ((PathSize >= SuffixSize) &&
+            (strcmp(Path + PathSize - SuffixSize,
+                    SHELL_PROFILE_FOLDED_SUFFIX) == 0)) {
+
+            Folded = TRUE;
+        }
+
+        //
+        // Append, since any shells run by this one write to the same file
+        // when they exit.
+        //
+
+        File = fopen(Path, "a");
+        if (File == NULL) {
+            SwPrintError(errno, Path, "Unable to open profile");
+            return;
+        }
+    }
+
+    //
+    // The root frame is charged with everything not spent in a function or
+    // command.
+    //
+
+    ShGetProfileTimes(&WallTime, NULL);
+    TotalTime = WallTime - ShProfileStartTime;
+    ShProfileRootFrame.SelfTime += TotalTime;
+    if (Folded != FALSE) {
+        ShWriteFoldedProfileFrame(File, Shell, &ShProfileRootFrame);
+
+    } else {
+        fprintf(File,
+                "Profile of %s: %llu.%06llu seconds\n",
+                Shell->CommandName,
+                TotalTime / 1000000ULL,
+                TotalTime % 1000000ULL);
+
+        ShWriteProfileReport(File, Shell);
+    }
+
+    ShProfileRootFrame.SelfTime -= TotalTime;
+    if (File != stderr) {
+        fclose(File);
+
+    } else {
+        fflush(File);
+    }
+
+    return;
+}
+
+VOID
+ShClearProfile (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine throws away everything the profiler has collected. Nothing
+    is done if measurements are still in progress in this process, which
+    happens when a shell is run from another shell without forking.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSHELL_PROFILE_ENTRY Entry;
+    PSHELL_NAME_TABLE Table;
+    ULONG Type;
+
+    if ((ShProfileStarted == FALSE) || (ShIsProfileInUse() != FALSE)) {
+        return;
+    }
+
+    for (Type = 0; Type < ShellProfileTypeCount; Type += 1) {
+        Table = &(ShProfileTables[Type]);
+        while (LIST_EMPTY(&(Table->List)) == FALSE) {
+            Entry = LIST_VALUE(Table->List.Next,
+                               SHELL_PROFILE_ENTRY,
+                               ListEntry);
+
+            LIST_REMOVE(&(Entry->ListEntry));
+            free(Entry);
+        }
+
+        ShDestroyNameTable(Table);
+    }
+
+    ShDestroyProfileFrames(ShProfileRootFrame.Child);
+    ShProfileRootFrame.Child = NULL;
+    ShProfileRootFrame.SelfTime = 0;
+    ShProfileCurrentFrame = NULL;
+    ShProfileActiveSamples = 0;
+    ShProfileStarted = FALSE;
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+VOID
+ShStartProfiler (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets up the profiler the first time something is measured.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Type;
+
+    if (ShProfileStarted != FALSE) {
+        return;
+    }
+
+    for (Type = 0; Type < ShellProfileTypeCount; Type += 1) {
+        ShInitializeNameTable(&(ShProfileTables[Type]));
+    }
+
+    memset(&ShProfileRootFrame, 0, sizeof(SHELL_PROFILE_FRAME));
+    ShProfileCurrentFrame = &ShProfileRootFrame;
+    ShGetProfileTimes(&ShProfileStartTime, NULL);
+    ShProfileProcessId = SwGetProcessId();
+    ShProfileActiveSamples = 0;
+    ShProfileStarted = TRUE;
+    return;
+}
+
+BOOL
+ShIsProfileInUse (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether the profile has measurements in progress
+    that will still finish. Measurements inherited from a parent process
+    across a fork never finish.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    TRUE if this process has measurements in progress.
+
+    FALSE if the profile can be written out or thrown away.
+
+--*/
+
+{
+
+    if ((ShProfileActiveSamples != 0) &&
+        (ShProfileProcessId == SwGetProcessId())) {
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+PSHELL_PROFILE_ENTRY
+ShGetProfileEntry (
+    SHELL_PROFILE_TYPE Type,
+    PSTR Name,
+    UINTN NameSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the profile entry with the given name, creating it if
+    it doesn't exist yet.
+
+Arguments:
+
+    Type - Supplies the type of entry to get.
+
+    Name - Supplies a pointer to the name of the entry.
+
+    NameSize - Supplies the size of the name in bytes including the null
+        terminator.
+
+Return Value:
+
+    Returns a pointer to the entry on success.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    PSHELL_PROFILE_ENTRY Entry;
+    ULONG Hash;
+    PLIST_ENTRY ListEntry;
+    BOOL Result;
+
+    ShStartProfiler();
+    Hash = SwHashString(Name, NameSize);
+    ListEntry = ShNameTableLookup(&(ShProfileTables[Type]),
+                                  Name,
+                                  NameSize,
+                                  Hash);
+
+    if (ListEntry != NULL) {
+        return LIST_VALUE(ListEntry, SHELL_PROFILE_ENTRY, ListEntry);
+    }
+
+    //
+    // Allocate the entry and its name together.
+    //
+
+    Entry = malloc(sizeof(SHELL_PROFILE_ENTRY) + NameSize);
+    if (Entry == NULL) {
+        return NULL;
+    }
+
+    memset(Entry, 0, sizeof(SHELL_PROFILE_ENTRY));
+    Entry->Type = Type;
+    Entry->Name = (PSTR)(Entry + 1);
+    Entry->NameSize = NameSize;
+    memcpy(Entry->Name, Name, NameSize);
+    Result = ShNameTableInsert(&(ShProfileTables[Type]),
+                               &(Entry->ListEntry),
+                               Entry->Name,
+                               NameSize,
+                               Hash);
+
+    if (Result == FALSE) {
+        free(Entry);
+        return NULL;
+    }
+
+    return Entry;
+}
+
+VOID
+ShStartProfileSample (
+    PSHELL_PROFILE_SAMPLE Sample
+    )
+
+/*++
+
+Routine Description:
+
+    This routine counts a run of the sample's entry and records the starting
+    times.
+
+Arguments:
+
+    Sample - Supplies a pointer to the sample, whose entry is filled in.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    Sample->Entry->Count += 1;
+    Sample->Entry->Depth += 1;
+    ShProfileActiveSamples += 1;
+    ShGetProfileTimes(&(Sample->WallTime), &(Sample->ProcessorTime));
+    return;
+}
+
+VOID
+ShGetProfileTimes (
+    PULONGLONG WallTime,
+    PULONGLONG ProcessorTime
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads the clocks the profiler uses.
+
+Arguments:
+
+    WallTime - Supplies a pointer where the monotonic clock time will be
+        returned, in microseconds.
+
+    ProcessorTime - Supplies an optional pointer where the processor time used
+        by the shell and its children will be returned, in microseconds.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    struct timespec Time;
+
+    if (SwGetMonotonicClock(&Time) != 0) {
+        memset(&Time, 0, sizeof(Time));
+    }
+
+    *WallTime = (Time.tv_sec * 1000000ULL) + (Time.tv_nsec / 1000);
+    if (ProcessorTime != NULL) {
+        if (ShGetProcessorTime(ProcessorTime) == 0) {
+            *ProcessorTime = 0;
+        }
+    }
+
+    return;
+}
+
+VOID
+ShWriteProfileReport (
+    FILE *File,
+    PSHELL Shell
+    )
+
+/*++
+
+Routine Description:
+
+    This routine writes every profile entry out as a table, from the most
+    time spent to the least.
+
+Arguments:
+
+    File - Supplies the file to write to.
+
+    Shell - Supplies a pointer to the shell.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PSHELL_PROFILE_ENTRY Entry;
+    PSHELL_PROFILE_ENTRY *Entries;
+    UINTN EntryCount;
+    UINTN Index;
+    PSHELL_NAME_TABLE Table;
+    ULONG Type;
+
+    EntryCount = 0;
+    for (Type = 0; Type < ShellProfileTypeCount; Type += 1) {
+        EntryCount += ShProfileTables[Type].Count;
+    }
+
+    if (EntryCount == 0) {
+        return;
+    }
+
+    Entries = malloc(EntryCount * sizeof(PSHELL_PROFILE_ENTRY));
+    if (Entries == NULL) {
+        return;
+    }
+
+    Index = 0;
+    for (Type = 0; Type < ShellProfileTypeCount; Type += 1) {
+        Table = &(ShProfileTables[Type]);
+        CurrentEntry = Table->List.Next;
+        while (CurrentEntry != &(Table->List)) {
+            Entries[Index] = LIST_VALUE(CurrentEntry,
+                                        SHELL_PROFILE_ENTRY,
+                                        ListEntry);
+
+            Index += 1;
+            CurrentEntry = CurrentEntry->Next;
+        }
+    }
+
+    assert(Index == EntryCount);
+
+    qsort(Entries,
+          EntryCount,
+          sizeof(PSHELL_PROFILE_ENTRY),
+          ShCompareProfileEntries);
+
+    fprintf(File,
+            "%10s %14s %14s  %-9s %s\n",
+            "Calls",
+            "Wall (ms)",
+            "CPU (ms)",
+            "Type",
+            "Name");
+
+    for (Index = 0; Index < EntryCount; Index += 1) {
+        Entry = Entries[Index];
+        fprintf(File,
+                "%10llu %10llu.%03llu %10llu.%03llu  %-9s %s\n",
+                Entry->Count,
+                Entry->WallTime / 1000ULL,
+                Entry->WallTime % 1000ULL,
+                Entry->ProcessorTime / 1000ULL,
+                Entry->ProcessorTime % 1000ULL,
+                ShProfileTypeNames[Entry->Type],
+                Entry->Name);
+    }
+
+    free(Entries);
+    return;
+}
+
+int
+ShCompareProfileEntries (
+    const void *Left,
+    const void *Right
+    )
+
+/*++
+
+Routine Description:
+
+    This routine compares two profile entries for sorting, putting the entry
+    with the most wall clock time first.
+
+Arguments:
+
+    Left - Supplies a pointer to a pointer to the left entry.
+
+    Right - Supplies a pointer to a pointer to the right entry.
+
+Return Value:
+
+    Less than zero if the left entry should go first.
+
+    Zero if the entries are equal.
+
+    Greater than zero if the right entry should go first.
+
+--*/
+
+{
+
+    PSHELL_PROFILE_ENTRY LeftEntry;
+    PSHELL_PROFILE_ENTRY RightEntry;
+
+    LeftEntry = *((PSHELL_PROFILE_ENTRY *)Left);
+    RightEntry = *((PSHELL_PROFILE_ENTRY *)Right);
+    if (LeftEntry->WallTime > RightEntry->WallTime) {
+        return -1;
+
+    } else if (LeftEntry->WallTime < RightEntry->WallTime) {
+        return 1;
+    }
+
+    if (LeftEntry->Type != RightEntry->Type) {
+        return (int)LeftEntry->Type - (int)RightEntry->Type;
+    }
+
+    return strcmp(LeftEntry->Name, RightEntry->Name);
+}
+
+VOID
+ShWriteFoldedProfileFrame (
+    FILE *File,
+    PSHELL Shell,
+    PSHELL_PROFILE_FRAME Frame
+    )
+
+/*++
+
+Routine Description:
+
+    This routine writes a frame and all the frames it called in folded stack
+    format. Each line holds the names of the frames from the root down, split
+    by semicolons, followed by the microseconds spent in the last one.
+
+Arguments:
+
+    File - Supplies the file to write to.
+
+    Shell - Supplies a pointer to the shell.
+
+    Frame - Supplies a pointer to the frame to write.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSHELL_PROFILE_FRAME Child;
+
+    if (Frame->SelfTime > 0) {
+        ShWriteProfileFramePath(File, Shell, Frame);
+        fprintf(File, " %lld\n", Frame->SelfTime);
+    }
+
+    Child = Frame->Child;
+    while (Child != NULL) {
+        ShWriteFoldedProfileFrame(File, Shell, Child);
+        Child = Child->Sibling;
+    }
+
+    return;
+}
+
+VOID
+ShWriteProfileFramePath (
+    FILE *File,
+    PSHELL Shell,
+    PSHELL_PROFILE_FRAME Frame
+    )
+
+/*++
+
+Routine Description:
+
+    This routine writes the names of a frame and all its callers, starting
+    with the root.
+
+Arguments:
+
+    File - Supplies the file to write to.
+
+    Shell - Supplies a pointer to the shell.
+
+    Frame - Supplies a pointer to the innermost frame.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSTR Name;
+
+    if (Frame->Parent != NULL) {
+        ShWriteProfileFramePath(File, Shell, Frame->Parent);
+        fputc(';', File);
+        Name = Frame->Entry->Name;
+
+    } else {
+        Name = Shell->CommandName;
+    }
+
+    //
+    // Semicolons separate frames and a space separates the count, so neither
+    // can appear in a name.
+    //
+
+    while (*Name != '\0') {
+        if ((*Name == ';') || (*Name == ' ')) {
+            fputc('_', File);
+
+        } else {
+            fputc(*Name, File);
+        }
+
+        Name += 1;
+    }
+
+    return;
+}
+
+VOID
+ShDestroyProfileFrames (
+    PSHELL_PROFILE_FRAME Frame
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees a frame, its siblings, and everything they called.
+
+Arguments:
+
+    Frame - Supplies a pointer to the first frame to free.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSHELL_PROFILE_FRAME Next;
+
+    while (Frame != NULL) {
+        ShDestroyProfileFrames(Frame->Child);
+        Next = Frame->Sibling;
+        free(Frame);
+        Frame = Next;
+    }
+
+    return;
+}
+
@@ -78,6 +78,11 @@ Module Name:
     "  -v (verbose) -- Write all input to standard out as it is read.\n"       \
     "  -x (xtrace) -- Write a trace of each command after it expands but \n"   \
     "        before it executes.\n"                                            \
+    "  -o profile -- Time each line, function, and command, and write a\n"     \
+    "        report to $SHPROFILE (or standard error) on exit. Names ending\n" \
+    "        in .folded get flame graph stacks instead. Starting the shell\n"  \
+    "        with SHPROFILE in the environment also sets this. Clearing\n"     \
+    "        it with set +o profile stops profiling and drops the report.\n"   \
     "  --help -- Show this help text and exit.\n"                              \
     "  --version -- Show the application version information and exit.\n\n"    \
 
@@ -115,6 +120,7 @@ SHELL_OPTION_STRING ShOptionStrings[] = {
     {"nolog", 0, SHELL_OPTION_NO_COMMAND_HISTORY},
     {"notify", 'b', SHELL_OPTION_ASYNCHRONOUS_JOB_NOTIFICATION},
     {"nounset", 'u', SHELL_OPTION_EXIT_ON_UNSET_VARIABLE},
+    {"profile", 0, SHELL_OPTION_PROFILE},
     {"verbose", 'v', SHELL_OPTION_DISPLAY_INPUT},
     {"interactive", 'i', SHELL_INTERACTIVE_OPTIONS},
     {"xtrace", 'x', SHELL_OPTION_TRACE_COMMAND},
@@ -167,10 +173,18 @@ Return Value:
     BOOL Set;
     PSHELL Shell;
     INT StandardErrorCopy;
+    PSTR Value;
+    UINTN ValueSize;
 
     InputDescriptor = -1;
     InputDescriptorHigh = -1;
     srand(time(NULL));
+
+    //
+    // Throw out anything profiled by a parent shell this one was forked from.
+    //
+
+    ShClearProfile();
     ReturnValue = ENOMEM;
     Shell = ShCreateShell(NULL, 0);
     if (Shell == NULL) {
@@ -178,6 +192,27 @@ Return Value:
         goto MainEnd;
     }
 
+    Result = ShInitializeVariables(Shell);
+    if (Result == FALSE) {
+        PRINT_ERROR("Error: Unable to initialize variables.\n");
+        goto MainEnd;
+    }
+
+    //
+    // Turn on profiling if the environment names a profile file, so scripts
+    // can be profiled without changing them.
+    //
+
+    Result = ShGetVariable(Shell,
+                           SHELL_PROFILE,
+                           sizeof(SHELL_PROFILE),
+                           &Value,
+                           &ValueSize);
+
+    if (Result != FALSE) {
+        Shell->Options |= SHELL_OPTION_PROFILE;
+    }
+
     StandardErrorCopy = ShDup(Shell, STDERR_FILENO, FALSE);
     if (StandardErrorCopy >= 0) {
         Shell->NonStandardError = fdopen(StandardErrorCopy, "w");
@@ -211,7 +246,7 @@ Return Value:
             } else {
                 ArgumentIndex += 1;
                 Argument = Arguments[ArgumentIndex];
-                ArgumentSize = strlen(Arguments[ArgumentIndex + 1]) + 1;
+                ArgumentSize = strlen(Argument) + 1;
             }
 
             Result = ShSetOptions(Shell,
@@ -221,8 +256,7 @@ Return Value:
                                   Set);
 
             if (Result == FALSE) {
-                PRINT_ERROR("Error: Unknown option %s.\n",
-                            Arguments[ArgumentIndex + 1]);
+                PRINT_ERROR("Error: Unknown option %s.\n", Argument);
 
                 ReturnValue = EINVAL;
                 goto MainEnd;
@@ -476,6 +510,7 @@ Return Value:
 
     Shell->Exited = TRUE;
     ShRunAtExitSignal(Shell);
+    ShWriteProfile(Shell);
     ShSetTerminalMode(Shell, FALSE);
     ShRestoreOriginalSignalDispositions();
 
@@ -492,6 +527,9 @@ Return Value:
         ShDestroyShell(Shell);
     }
 
+    ShClearParseCache();
+    ShClearArithmeticCache();
+    ShClearProfile();
     return ReturnValue;
 }
 
@@ -593,7 +631,7 @@ Return Value:
         }
     }
 
-    if (String[0] == '-') {
+    if (Set != FALSE) {
         Shell->Options |= Options;
 
     } else {
@@ -193,6 +193,13 @@ Module Name:
 
 #define SHELL_OPTION_INPUT_BUFFER_ONLY 0x00040000
 
+//
+// This option records how long each command, function, and external command
+// takes to run, and writes out a report when the shell exits.
+//
+
+#define SHELL_OPTION_PROFILE 0x00080000
+
 //
 // Define shell execution node flags.
 //
@@ -232,6 +239,13 @@ Module Name:
 
 #define DEFAULT_INPUT_BUFFER_SIZE 1024
 
+//
+// Define the size of the input buffer used when reading a script file. Big
+// blocks keep lexing large scripts from being bound by read calls.
+//
+
+#define SHELL_FILE_INPUT_BUFFER_SIZE 0x10000
+
 //
 // Define the default size of the token buffer.
 //
@@ -247,6 +261,21 @@ Module Name:
 #define SHELL_EXPANSION_OPTION_NO_TILDE_EXPANSION 0x00000004
 #define SHELL_EXPANSION_OPTION_NO_PATH_EXPANSION  0x00000008
 
+//
+// Set this option when the parser has already determined that the string is
+// made up only of literal words separated by single spaces. The string is
+// then only split, skipping the expansion machinery entirely.
+//
+
+#define SHELL_EXPANSION_OPTION_LITERAL            0x00000010
+
+//
+// Define the size of each block of the arena that holds scratch memory used
+// while expanding a command.
+//
+
+#define SHELL_EXPANSION_ARENA_BLOCK_SIZE 4096
+
 //
 // Define dequoting behaviors.
 //
@@ -269,6 +298,7 @@ Module Name:
 #define SHELL_LINE_NUMBER "LINENO"
 #define SHELL_OLDPWD "OLDPWD"
 #define SHELL_PATH "PATH"
+#define SHELL_PROFILE "SHPROFILE"
 #define SHELL_PS1 "PS1"
 #define SHELL_PS2 "PS2"
 #define SHELL_PS4 "PS4"
@@ -280,6 +310,12 @@ Module Name:
 
 #define SHELL_IFS_DEFAULT " \t\n"
 
+//
+// Define the number of buckets in the table of remembered command locations.
+//
+
+#define SHELL_COMMAND_HASH_SIZE 64
+
 //
 // Define shell control characters.
 //
@@ -308,6 +344,73 @@ typedef enum _SHELL_UNSET_TYPE {
 
 /*++
 
+Structure Description:
+
+    This structure defines a slot in the index of a name table.
+
+Members:
+
+    Entry - Stores a pointer to the list entry of the named item, NULL if the
+        slot has never been used, or a special value if the item was removed.
+
+    Hash - Stores the hash of the name.
+
+    Name - Stores a pointer to the item's name.
+
+    NameSize - Stores the size of the name in bytes including the null
+        terminator.
+
+--*/
+
+typedef struct _SHELL_NAME_TABLE_SLOT {
+    PLIST_ENTRY Entry;
+    ULONG Hash;
+    PSTR Name;
+    UINTN NameSize;
+} SHELL_NAME_TABLE_SLOT, *PSHELL_NAME_TABLE_SLOT;
+
+/*++
+
+Structure Description:
+
+    This structure defines a table of named items, such as variables,
+    functions, or aliases. Items are kept on a list in the order they were
+    added, and indexed by name with an open addressed hash table.
+
+Members:
+
+    List - Stores the head of the list of items, in the order they were added.
+
+    Slots - Stores a pointer to the array of index slots.
+
+    Capacity - Stores the number of slots in the index, which is always a
+        power of two.
+
+    Shift - Stores the number of bits to shift a scrambled hash right by to
+        get a slot index.
+
+    Count - Stores the number of items in the table.
+
+    Used - Stores the number of slots that are either holding an item or
+        marked as deleted.
+
+    ReferenceCount - Stores the number of shells sharing the table. A shared
+        table must be copied before it is changed.
+
+--*/
+
+typedef struct _SHELL_NAME_TABLE {
+    LIST_ENTRY List;
+    PSHELL_NAME_TABLE_SLOT Slots;
+    ULONG Capacity;
+    ULONG Shift;
+    ULONG Count;
+    ULONG Used;
+    ULONG ReferenceCount;
+} SHELL_NAME_TABLE, *PSHELL_NAME_TABLE;
+
+/*++
+
 Structure Description:
 
     This structure defines a shell signal action.
@@ -344,6 +447,8 @@ Structure Description:
 
     ListEntry - Stores pointers to the next and previous aliases in the shell.
 
+    Hash - Stores the hash of the alias name.
+
     Name - Stores a pointer to the name that triggers the alias replacement.
 
     NameSize - Stores the size of the name buffer in bytes including the null
@@ -357,6 +462,7 @@ Structure Description:
 
 typedef struct _SHELL_ALIAS {
     LIST_ENTRY ListEntry;
+    ULONG Hash;
     PSTR Name;
     UINTN NameSize;
     PSTR Value;
@@ -447,23 +553,56 @@ Structure Description:
     ListEntry - Stores pointers to the next and previous functions in the
         global list.
 
-    Name - Stores a pointer to the function name string.
-
-    NameSize - Stores the size of the function name string in bytes including
-        the null terminator.
+    Hash - Stores the hash of the function name.
 
     Node - Stores a pointer to the shell node containing the function
-        definition.
+        definition, which also holds the function name.
 
 --*/
 
 typedef struct _SHELL_FUNCTION {
     LIST_ENTRY ListEntry;
+    ULONG Hash;
     PSHELL_NODE Node;
 } SHELL_FUNCTION, *PSHELL_FUNCTION;
 
 /*++
 
+Structure Description:
+
+    This structure defines a remembered command location. The name and path
+    strings are allocated along with the structure.
+
+Members:
+
+    ListEntry - Stores pointers to the next and previous entries in the hash
+        bucket.
+
+    Hash - Stores the hash of the command name.
+
+    Name - Stores a pointer to the command name as typed.
+
+    NameSize - Stores the size of the command name in bytes including the null
+        terminator.
+
+    Path - Stores a pointer to the full path the command was found at.
+
+    PathSize - Stores the size of the path in bytes including the null
+        terminator.
+
+--*/
+
+typedef struct _SHELL_COMMAND_HASH_ENTRY {
+    LIST_ENTRY ListEntry;
+    ULONG Hash;
+    PSTR Name;
+    UINTN NameSize;
+    PSTR Path;
+    UINTN PathSize;
+} SHELL_COMMAND_HASH_ENTRY, *PSHELL_COMMAND_HASH_ENTRY;
+
+/*++
+
 Structure Description:
 
     This structure defines an execution node in the shell.
@@ -473,8 +612,7 @@ Structure Description:
     ListEntry - Stores pointers to the next and previous execution nodes in
         the system. The next pointer points at older nodes on the stack.
 
-    VariableList - Stores the head of the list of variables assigned in this
-        scope.
+    Variables - Stores the table of variables assigned in this scope.
 
     ArgumentList - Stores the list of arguments this function was invoked with.
 
@@ -494,7 +632,7 @@ Structure Description:
 
 typedef struct _SHELL_EXECUTION_NODE {
     LIST_ENTRY ListEntry;
-    LIST_ENTRY VariableList;
+    SHELL_NAME_TABLE Variables;
     LIST_ENTRY ArgumentList;
     LIST_ENTRY ActiveRedirectList;
     PSHELL_NODE Node;
@@ -555,6 +693,140 @@ typedef struct _SHELL_EXPANSION_RANGE {
 
 /*++
 
+Structure Description:
+
+    This structure stores one complete command parsed ahead of time.
+
+Members:
+
+    Node - Stores a pointer to the parsed command.
+
+    InputOffset - Stores the offset into the lexer input, before any alias
+        substitution, where the text after this command starts. Zero if
+        parsing cannot pick up again after this command.
+
+    LineNumber - Stores the lexer line number just after this command.
+
+--*/
+
+typedef struct _SHELL_PARSED_COMMAND {
+    PSHELL_NODE Node;
+    UINTN InputOffset;
+    ULONG LineNumber;
+} SHELL_PARSED_COMMAND, *PSHELL_PARSED_COMMAND;
+
+/*++
+
+Structure Description:
+
+    This structure defines a parsed piece of shell input, such as the text of
+    a command substitution or an eval string. Parsed input is kept in a cache
+    so that text run over and over again, say inside a loop, is only lexed
+    and parsed once. The text is allocated along with the structure.
+
+Members:
+
+    ListEntry - Stores pointers to the next and previous entries in the cache
+        hash bucket. The next pointer is NULL if the entry is not in the
+        cache.
+
+    RecentListEntry - Stores pointers to the next and previous entries in the
+        list of cached entries, ordered from most to least recently used.
+
+    ReferenceCount - Stores the number of references on the entry. The cache
+        holds one, as does each lexer running it.
+
+    Hash - Stores the hash of the text.
+
+    AliasGeneration - Stores the alias generation of the shell the text was
+        parsed in, since aliases are substituted at parse time.
+
+    Dequoted - Stores a boolean indicating whether or not the text had
+        backslashes removed as for a backquoted command substitution.
+
+    ParseFailed - Stores a boolean indicating that the text did not parse
+        all the way through. Such entries are never cached.
+
+    Text - Stores a pointer to the original text.
+
+    TextSize - Stores the size of the text in bytes including the null
+        terminator.
+
+    Input - Stores a pointer to the lexer input the text was parsed from.
+        This is the text itself unless it was dequoted.
+
+    InputSize - Stores the size of the lexer input in bytes including the
+        null terminator.
+
+    Commands - Stores a pointer to the array of complete commands parsed out
+        of the text, in order, along with where the text after each one
+        starts.
+
+    CommandCount - Stores the number of elements in the commands array.
+
+--*/
+
+typedef struct _SHELL_PARSE_CACHE_ENTRY {
+    LIST_ENTRY ListEntry;
+    LIST_ENTRY RecentListEntry;
+    ULONG ReferenceCount;
+    ULONG Hash;
+    ULONG AliasGeneration;
+    BOOL Dequoted;
+    BOOL ParseFailed;
+    PSTR Text;
+    UINTN TextSize;
+    PSTR Input;
+    UINTN InputSize;
+    PSHELL_PARSED_COMMAND Commands;
+    UINTN CommandCount;
+} SHELL_PARSE_CACHE_ENTRY, *PSHELL_PARSE_CACHE_ENTRY;
+
+typedef enum _SHELL_PROFILE_TYPE {
+    ShellProfileNode,
+    ShellProfileFunction,
+    ShellProfileCommand,
+    ShellProfileTypeCount
+} SHELL_PROFILE_TYPE, *PSHELL_PROFILE_TYPE;
+
+typedef struct _SHELL_PROFILE_ENTRY
+    SHELL_PROFILE_ENTRY, *PSHELL_PROFILE_ENTRY;
+
+typedef struct _SHELL_PROFILE_FRAME
+    SHELL_PROFILE_FRAME, *PSHELL_PROFILE_FRAME;
+
+/*++
+
+Structure Description:
+
+    This structure defines a single timing measurement made by the profiler.
+    It lives on the stack of the routine being measured.
+
+Members:
+
+    Entry - Stores a pointer to the profile entry the time is charged to, or
+        NULL if nothing is being measured.
+
+    Frame - Stores a pointer to the call stack frame pushed for a function or
+        command measurement, or NULL if no frame was pushed.
+
+    WallTime - Stores the monotonic clock time when the measurement started,
+        in microseconds.
+
+    ProcessorTime - Stores the processor time used by the shell and its
+        children when the measurement started, in microseconds.
+
+--*/
+
+typedef struct _SHELL_PROFILE_SAMPLE {
+    PSHELL_PROFILE_ENTRY Entry;
+    PSHELL_PROFILE_FRAME Frame;
+    ULONGLONG WallTime;
+    ULONGLONG ProcessorTime;
+} SHELL_PROFILE_SAMPLE, *PSHELL_PROFILE_SAMPLE;
+
+/*++
+
 Structure Description:
 
     This structure defines the lexer state for a shell.
@@ -598,6 +870,9 @@ Structure Description:
     HereDocumentList - Stores the list of here documents that have yet
         to be collected by the parser.
 
+    ParsedInput - Stores an optional pointer to the already parsed commands
+        to run instead of reading the input.
+
 --*/
 
 typedef struct _SHELL_LEXER_STATE {
@@ -616,6 +891,7 @@ typedef struct _SHELL_LEXER_STATE {
     BOOL LexerPrimed;
     PSHELL_ALIAS LastAlias;
     LIST_ENTRY HereDocumentList;
+    PSHELL_PARSE_CACHE_ENTRY ParsedInput;
 } SHELL_LEXER_STATE, *PSHELL_LEXER_STATE;
 
 /*++
@@ -630,8 +906,9 @@ Structure Description:
 
     Parser - Stores the parser state.
 
-    VariableList - Stores the head of the list of environment variables for
-        this shell.
+    Variables - Stores a pointer to the table of environment variables for
+        this shell. Subshells share their parent's table until one of them
+        changes it.
 
     ExecutionStack - Stores the stack of nodes being executed. The next pointer
         points to the newest thing (items are pushed onto the front of the
@@ -639,9 +916,11 @@ Structure Description:
 
     ArgumentList - Stores the list of arguments this shell was invoked with.
 
-    FunctionList - Stores the list of functions owned in this shell.
+    Functions - Stores a pointer to the table of functions declared in this
+        shell, which is shared with subshells in the same way as the
+        variables.
 
-    AliasList - Stores the list of aliases in the shell.
+    Aliases - Stores the table of aliases in the shell.
 
     SignalActionList - Stores the list of signal actions for this shell.
 
@@ -687,15 +966,34 @@ Structure Description:
         This is needed so that a shell process in a pipeline waiting on a
         child subprocess to finish doesn't hold the read end open.
 
+    CommandHash - Stores an optional pointer to the array of hash buckets of
+        remembered command locations. This is allocated when the first command
+        is remembered.
+
+    CommandHashPath - Stores a pointer to a copy of the PATH value the
+        remembered locations were found with. The table is emptied when PATH
+        no longer matches this.
+
+    AliasGeneration - Stores a number identifying the current set of aliases.
+        It changes whenever an alias is defined or removed, and is zero when
+        there are no aliases.
+
+    ExpansionArena - Stores an optional pointer to the arena that scratch
+        memory used during expansions is carved from. It is created when first
+        needed and emptied in one shot after each command completes.
+
+    ExpansionDepth - Stores the number of expansions currently in progress in
+        this shell. The expansion arena is only emptied when this is zero.
+
 --*/
 
 typedef struct _SHELL {
     SHELL_LEXER_STATE Lexer;
-    LIST_ENTRY VariableList;
+    PSHELL_NAME_TABLE Variables;
     LIST_ENTRY ExecutionStack;
     LIST_ENTRY ArgumentList;
-    LIST_ENTRY FunctionList;
-    LIST_ENTRY AliasList;
+    PSHELL_NAME_TABLE Functions;
+    SHELL_NAME_TABLE Aliases;
     LIST_ENTRY SignalActionList;
     PSTR CommandName;
     UINTN CommandNameSize;
@@ -713,6 +1011,11 @@ typedef struct _SHELL {
     LIST_ENTRY ActiveRedirectList;
     PSTR Prompt;
     INT PostForkCloseDescriptor;
+    PLIST_ENTRY CommandHash;
+    PSTR CommandHashPath;
+    ULONG AliasGeneration;
+    struct _SWISS_ARENA *ExpansionArena;
+    ULONG ExpansionDepth;
 } SHELL, *PSHELL;
 
 typedef
@@ -765,16 +1068,12 @@ Structure Description:
     OriginalDescriptor - Stores another handle representing the original
         descriptor before the redirection took it over.
 
-    ChildProcessId - Stores the ID of the child process created if creating
-        this redirect involved creating a child process to push the I/O.
-
 --*/
 
 typedef struct _SHELL_ACTIVE_REDIRECT {
     LIST_ENTRY ListEntry;
     INT FileNumber;
     INT OriginalDescriptor;
-    pid_t ChildProcessId;
 } SHELL_ACTIVE_REDIRECT, *PSHELL_ACTIVE_REDIRECT;
 
 //
@@ -1026,7 +1325,9 @@ ShCreateShell (
 
 Routine Description:
 
-    This routine creates a new shell object.
+    This routine creates a new shell object. The shell starts out with no
+    variables; the caller either initializes them from the environment or
+    hands over a parent's.
 
 Arguments:
 
@@ -1540,6 +1841,58 @@ Return Value:
 
 --*/
 
+BOOL
+ShIsLiteralWord (
+    PSTR Word,
+    UINTN WordSize
+    );
+
+/*++
+
+Routine Description:
+
+    This routine determines whether or not a word from the parser is a plain
+    literal, which expansion, field splitting, pathname expansion, and quote
+    removal would all leave untouched.
+
+Arguments:
+
+    Word - Supplies a pointer to the word, as produced by the lexer.
+
+    WordSize - Supplies the size of the word in bytes including the null
+        terminator.
+
+Return Value:
+
+    TRUE if the word needs no expansion at all.
+
+    FALSE if the word must go through expansion.
+
+--*/
+
+VOID
+ShReleaseExpansionScratch (
+    PSHELL Shell
+    );
+
+/*++
+
+Routine Description:
+
+    This routine frees all the scratch memory handed out during expansions in
+    one shot. It is called when a command completes, and does nothing if an
+    expansion is still in progress.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell.
+
+Return Value:
+
+    None.
+
+--*/
+
 PLIST_ENTRY
 ShGetCurrentArgumentList (
     PSHELL Shell
@@ -1602,117 +1955,581 @@ Return Value:
 --*/
 
 //
-// Environment variable functions
+// Name table functions
 //
 
-BOOL
-ShInitializeVariables (
-    PSHELL Shell
+PSHELL_NAME_TABLE
+ShCreateNameTable (
+    VOID
     );
 
 /*++
 
 Routine Description:
 
-    This routine performs some variable initialization in the shell, as well as
-    handling the ENV variable.
+    This routine allocates and initializes an empty name table with a single
+    reference.
 
 Arguments:
 
-    Shell - Supplies a pointer to the shell.
+    None.
 
 Return Value:
 
-    TRUE on success.
+    Returns a pointer to the new table on success. Free it with free once it
+    has been destroyed.
 
-    FALSE on failure.
+    NULL on allocation failure.
 
 --*/
 
-BOOL
-ShGetVariable (
-    PSHELL Shell,
-    PSTR Name,
-    UINTN NameSize,
-    PSTR *Value,
-    PUINTN ValueSize
+VOID
+ShInitializeNameTable (
+    PSHELL_NAME_TABLE Table
     );
 
 /*++
 
 Routine Description:
 
-    This routine gets the value of the given environment variable.
+    This routine initializes an empty name table. No memory is allocated until
+    the first entry is added.
 
 Arguments:
 
-    Shell - Supplies a pointer to the shell.
+    Table - Supplies a pointer to the table to initialize.
 
-    Name - Supplies a pointer to the string of the name of the variable to get.
+Return Value:
 
-    NameSize - Supplies the size of the name string buffer in bytes including
-        the null terminator.
+    None.
 
-    Value - Supplies a pointer where a pointer to the value string of the
-        variable will be returned on success. The caller does not own this
-        memory and should not edit or free it.
+--*/
 
-    ValueSize - Supplies an optional pointer where the the size of the value
-        string in bytes including the null terminator will be returned.
+VOID
+ShDestroyNameTable (
+    PSHELL_NAME_TABLE Table
+    );
 
-Return Value:
+/*++
 
-    TRUE if the variable is set (null or not).
+Routine Description:
 
-    FALSE if the variable is unset.
+    This routine frees the index of a name table. The owner is responsible
+    for removing and freeing the entries themselves first.
+
+Arguments:
+
+    Table - Supplies a pointer to the table to destroy.
+
+Return Value:
+
+    None.
 
 --*/
 
-BOOL
-ShSetVariable (
-    PSHELL Shell,
+PLIST_ENTRY
+ShNameTableLookup (
+    PSHELL_NAME_TABLE Table,
     PSTR Name,
     UINTN NameSize,
-    PSTR Value,
-    UINTN ValueSize
+    ULONG Hash
     );
 
 /*++
 
 Routine Description:
 
-    This routine sets a shell variable in the proper scope.
+    This routine finds the entry with the given name in a name table.
 
 Arguments:
 
-    Shell - Supplies a pointer to the shell.
-
-    Name - Supplies a pointer to the string of the name of the variable to set.
-        A copy of this string will be made.
+    Table - Supplies a pointer to the table to search.
 
-    NameSize - Supplies the size of the name string buffer in bytes including
-        the null terminator.
-
-    Value - Supplies the value string of the variable to set. This may get
-        expanded. A copy of this string will be made.
+    Name - Supplies a pointer to the name to find. This does not need to be
+        null terminated.
 
-    ValueSize - Supplies the size of the value string in bytes, including the
+    NameSize - Supplies the size of the name in bytes including space for a
         null terminator.
 
+    Hash - Supplies the hash of the name, as returned by SwHashString.
+
 Return Value:
 
-    TRUE on success.
+    Returns a pointer to the list entry of the matching entry on success.
 
-    FALSE on failure.
+    NULL if no entry has the given name.
 
 --*/
 
 BOOL
-ShSetVariableWithProperties (
-    PSHELL Shell,
+ShNameTableInsert (
+    PSHELL_NAME_TABLE Table,
+    PLIST_ENTRY Entry,
     PSTR Name,
     UINTN NameSize,
-    PSTR Value,
+    ULONG Hash
+    );
+
+/*++
+
+Routine Description:
+
+    This routine adds an entry to the end of a name table. The caller must
+    make sure no entry with the same name is already in the table.
+
+Arguments:
+
+    Table - Supplies a pointer to the table.
+
+    Entry - Supplies a pointer to the list entry embedded in the new entry.
+
+    Name - Supplies a pointer to the entry's name. This must stay valid and
+        unchanged for as long as the entry is in the table.
+
+    NameSize - Supplies the size of the name in bytes including the null
+        terminator.
+
+    Hash - Supplies the hash of the name, as returned by SwHashString.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on allocation failure, in which case the entry was not added.
+
+--*/
+
+VOID
+ShNameTableRemove (
+    PSHELL_NAME_TABLE Table,
+    PLIST_ENTRY Entry,
+    ULONG Hash
+    );
+
+/*++
+
+Routine Description:
+
+    This routine removes an entry from a name table. The entry itself is not
+    freed.
+
+Arguments:
+
+    Table - Supplies a pointer to the table.
+
+    Entry - Supplies a pointer to the list entry of the entry to remove.
+
+    Hash - Supplies the hash of the entry's name.
+
+Return Value:
+
+    None.
+
+--*/
+
+//
+// Parse cache functions
+//
+
+PSHELL_PARSE_CACHE_ENTRY
+ShLookupParsedInput (
+    PSHELL Shell,
+    PSTR Text,
+    UINTN TextSize,
+    BOOL Dequoted
+    );
+
+/*++
+
+Routine Description:
+
+    This routine looks for already parsed commands for the given text in the
+    parse cache.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell that would parse the text.
+
+    Text - Supplies a pointer to the text to look up.
+
+    TextSize - Supplies the size of the text in bytes including the null
+        terminator.
+
+    Dequoted - Supplies a boolean indicating if the text gets backslashes
+        removed before it is parsed, as for a backquoted command substitution.
+
+Return Value:
+
+    Returns a pointer to the cache entry on success. The caller is responsible
+    for releasing the reference it holds.
+
+    NULL if the text has not been cached.
+
+--*/
+
+PSHELL_PARSE_CACHE_ENTRY
+ShParseInput (
+    PSHELL Shell,
+    PSTR Text,
+    UINTN TextSize,
+    BOOL Dequoted
+    );
+
+/*++
+
+Routine Description:
+
+    This routine parses all the input in the given shell's lexer up front, and
+    adds the result to the parse cache if it parsed cleanly. Parse errors are
+    reported just as they would be when running the input.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell whose lexer has been set up with
+        the input.
+
+    Text - Supplies a pointer to the text the input came from, used as the
+        cache key.
+
+    TextSize - Supplies the size of the text in bytes including the null
+        terminator.
+
+    Dequoted - Supplies a boolean indicating if the input is the text with
+        backslashes removed, as for a backquoted command substitution.
+
+Return Value:
+
+    Returns a pointer to the parsed input on success. The caller is
+    responsible for releasing the reference it holds.
+
+    NULL if the text should not be parsed ahead of time, or on allocation
+    failure before anything was read. The lexer is left untouched, and the
+    input should be run as usual.
+
+--*/
+
+BOOL
+ShResumeParsingInput (
+    PSHELL Shell,
+    UINTN CommandIndex
+    );
+
+/*++
+
+Routine Description:
+
+    This routine stops running the already parsed commands in the given
+    shell's lexer, and sets the lexer up to parse the rest of the text itself.
+    This is needed when a command changes the aliases, since the commands
+    after it may now parse differently.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell running parsed input.
+
+    CommandIndex - Supplies the number of parsed commands already run.
+        Parsing picks up after the last of them.
+
+Return Value:
+
+    TRUE if the lexer now parses the rest of the text, and the parsed input
+    was released.
+
+    FALSE if parsing cannot pick up there. The parsed commands should still
+    be run.
+
+--*/
+
+VOID
+ShReleaseParsedInput (
+    PSHELL_PARSE_CACHE_ENTRY Entry
+    );
+
+/*++
+
+Routine Description:
+
+    This routine releases a reference on parsed input, destroying it if it
+    was the last one.
+
+Arguments:
+
+    Entry - Supplies a pointer to the parsed input.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+ShClearParseCache (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine releases everything held in the parse cache.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+//
+// Profiling functions
+//
+
+VOID
+ShBeginNodeProfileSample (
+    PSHELL Shell,
+    PSHELL_NODE Node,
+    PSHELL_PROFILE_SAMPLE Sample
+    );
+
+/*++
+
+Routine Description:
+
+    This routine starts timing the execution of a node if profiling is
+    enabled. Time is charged to the node's line number and type.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell executing the node.
+
+    Node - Supplies a pointer to the node about to be executed.
+
+    Sample - Supplies a pointer to the sample to start. Pass it to
+        ShEndProfileSample once the node is done.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+ShBeginCallProfileSample (
+    PSHELL Shell,
+    SHELL_PROFILE_TYPE Type,
+    PSTR Name,
+    PSHELL_PROFILE_SAMPLE Sample
+    );
+
+/*++
+
+Routine Description:
+
+    This routine starts timing a function invocation or a command if
+    profiling is enabled, and pushes it onto the profiler's call stack.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell making the call.
+
+    Type - Supplies the type of call being made.
+
+    Name - Supplies a pointer to the null terminated name of the function or
+        command.
+
+    Sample - Supplies a pointer to the sample to start. Pass it to
+        ShEndProfileSample once the call returns.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+ShEndProfileSample (
+    PSHELL_PROFILE_SAMPLE Sample
+    );
+
+/*++
+
+Routine Description:
+
+    This routine stops a timing measurement and adds the elapsed time to the
+    profile.
+
+Arguments:
+
+    Sample - Supplies a pointer to the sample that was started.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+ShWriteProfile (
+    PSHELL Shell
+    );
+
+/*++
+
+Routine Description:
+
+    This routine writes out the profile collected so far. It goes to the file
+    named by the SHPROFILE variable, or standard error if that is not set. If
+    the file name ends in .folded, the profile is written as folded call
+    stacks suitable for making a flame graph. Otherwise a report sorted by
+    time is written. Nothing is written if the profile option has been
+    cleared.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+ShClearProfile (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine throws away everything the profiler has collected.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+//
+// Environment variable functions
+//
+
+BOOL
+ShInitializeVariables (
+    PSHELL Shell
+    );
+
+/*++
+
+Routine Description:
+
+    This routine performs some variable initialization in the shell, as well as
+    handling the ENV variable.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on failure.
+
+--*/
+
+BOOL
+ShGetVariable (
+    PSHELL Shell,
+    PSTR Name,
+    UINTN NameSize,
+    PSTR *Value,
+    PUINTN ValueSize
+    );
+
+/*++
+
+Routine Description:
+
+    This routine gets the value of the given environment variable.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell.
+
+    Name - Supplies a pointer to the string of the name of the variable to get.
+
+    NameSize - Supplies the size of the name string buffer in bytes including
+        the null terminator.
+
+    Value - Supplies a pointer where a pointer to the value string of the
+        variable will be returned on success. The caller does not own this
+        memory and should not edit or free it.
+
+    ValueSize - Supplies an optional pointer where the the size of the value
+        string in bytes including the null terminator will be returned.
+
+Return Value:
+
+    TRUE if the variable is set (null or not).
+
+    FALSE if the variable is unset.
+
+--*/
+
+BOOL
+ShSetVariable (
+    PSHELL Shell,
+    PSTR Name,
+    UINTN NameSize,
+    PSTR Value,
+    UINTN ValueSize
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sets a shell variable in the proper scope.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell.
+
+    Name - Supplies a pointer to the string of the name of the variable to set.
+        A copy of this string will be made.
+
+    NameSize - Supplies the size of the name string buffer in bytes including
+        the null terminator.
+
+    Value - Supplies the value string of the variable to set. This may get
+        expanded. A copy of this string will be made.
+
+    ValueSize - Supplies the size of the value string in bytes, including the
+        null terminator.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on failure.
+
+--*/
+
+BOOL
+ShSetVariableWithProperties (
+    PSHELL Shell,
+    PSTR Name,
+    UINTN NameSize,
+    PSTR Value,
     UINTN ValueSize,
     BOOL Exported,
     BOOL ReadOnly,
@@ -1823,7 +2640,7 @@ Return Value:
 BOOL
 ShCopyVariables (
     PSHELL Source,
-    PLIST_ENTRY DestinationList
+    PSHELL_NAME_TABLE Destination
     );
 
 /*++
@@ -1837,8 +2654,38 @@ Routine Description:
 
     Source - Supplies a pointer to the shell containing the variables to copy.
 
-    DestinationList - Supplies a pointer to the head of the list where the
-        copies will be put.
+    Destination - Supplies a pointer to the table where the copies will be
+        put.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on failure.
+
+--*/
+
+BOOL
+ShShareVariables (
+    PSHELL Source,
+    PSHELL Destination
+    );
+
+/*++
+
+Routine Description:
+
+    This routine gives a new subshell the variables visible in its parent. If
+    the parent has no local variables in scope, the subshell shares the
+    parent's table, and whichever shell changes it first makes a copy.
+    Otherwise the visible variables are copied right away.
+
+Arguments:
+
+    Source - Supplies a pointer to the parent shell.
+
+    Destination - Supplies a pointer to the new subshell, which must not have
+        any variables yet.
 
 Return Value:
 
@@ -1849,19 +2696,41 @@ Return Value:
 --*/
 
 VOID
-ShDestroyVariableList (
-    PLIST_ENTRY List
+ShReleaseVariables (
+    PSHELL Shell
     );
 
 /*++
 
 Routine Description:
 
-    This routine destroys an environment variable list.
+    This routine releases a shell's reference on its variable table,
+    destroying the variables if no other shell is sharing them.
 
 Arguments:
 
-    List - Supplies a pointer to the list to destroy.
+    Shell - Supplies a pointer to the dying shell.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+ShDestroyVariableTable (
+    PSHELL_NAME_TABLE Table
+    );
+
+/*++
+
+Routine Description:
+
+    This routine destroys all the variables in a table.
+
+Arguments:
+
+    Table - Supplies a pointer to the table to destroy.
 
 Return Value:
 
@@ -1927,7 +2796,7 @@ Return Value:
 --*/
 
 BOOL
-ShCopyFunctionList (
+ShShareFunctionList (
     PSHELL Source,
     PSHELL Destination
     );
@@ -1936,16 +2805,17 @@ ShCopyFunctionList (
 
 Routine Description:
 
-    This routine copies the list of declared functions from one shell to
-    another.
+    This routine shares the declared functions of one shell with a new
+    subshell. The function table is copied the first time either shell changes
+    it.
 
 Arguments:
 
     Source - Supplies a pointer to the shell containing the function
         definitions.
 
-    Destination - Supplies a pointer to the shell where the function
-        definitions should be copied to.
+    Destination - Supplies a pointer to the new subshell, which must not have
+        any functions declared yet.
 
 Return Value:
 
@@ -1964,7 +2834,8 @@ ShDestroyFunctionList (
 
 Routine Description:
 
-    This routine cleans up the list of functions on the given shell.
+    This routine releases a shell's reference on its function table, cleaning
+    up the functions if no other shell is sharing them.
 
 Arguments:
 
@@ -2254,6 +3125,28 @@ Return Value:
 
 --*/
 
+VOID
+ShClearArithmeticCache (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine frees all the compiled arithmetic expressions held in the
+    cache.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
 //
 // Path related functions
 //
@@ -2417,6 +3310,77 @@ Return Value:
 
 --*/
 
+VOID
+ShClearCommandHash (
+    PSHELL Shell
+    );
+
+/*++
+
+Routine Description:
+
+    This routine forgets all remembered command locations in the given shell.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell.
+
+Return Value:
+
+    None.
+
+--*/
+
+BOOL
+ShCopyCommandHash (
+    PSHELL Source,
+    PSHELL Destination
+    );
+
+/*++
+
+Routine Description:
+
+    This routine copies the remembered command locations from one shell to
+    another.
+
+Arguments:
+
+    Source - Supplies a pointer to the shell to copy locations from.
+
+    Destination - Supplies a pointer to the shell to copy locations to. This
+        shell is assumed to have no remembered locations yet.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on allocation failure.
+
+--*/
+
+VOID
+ShPrintCommandHash (
+    PSHELL Shell
+    );
+
+/*++
+
+Routine Description:
+
+    This routine prints the full path of each remembered command location to
+    standard out.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell.
+
+Return Value:
+
+    None.
+
+--*/
+
 INT
 ShBuiltinPwd (
     PSHELL Shell,
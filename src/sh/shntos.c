@@ -53,7 +53,6 @@ Module Name:
 #define SHELL_NT_PIPE_SIZE (1024 * 1024 * 10)
 
 #define SHELL_NT_OUTPUT_CHUNK_SIZE 1024
-#define SHELL_NT_INPUT_CHUNK_SIZE 1024
 
 //
 // Define the unix null device and the corresponding Windows device.
@@ -100,29 +99,6 @@ typedef struct _SHELL_NT_OUTPUT_COLLECTION {
     unsigned long BufferCapacity;
 } SHELL_NT_OUTPUT_COLLECTION, *PSHELL_NT_OUTPUT_COLLECTION;
 
-/*++
-
-Structure Description:
-
-    This structure defines the context for a thread that pushes input into a
-    pipe.
-
-Members:
-
-    Handle - Stores the pipe to write.
-
-    Buffer - Stores a pointer to the buffer containing the input to write.
-
-    BufferSize - Stores the size of the buffer including a null terminator.
-
---*/
-
-typedef struct _SHELL_NT_INPUT_PUSH_CONTEXT {
-    int Handle;
-    void *Buffer;
-    unsigned long BufferSize;
-} SHELL_NT_INPUT_PUSH_CONTEXT, *PSHELL_NT_INPUT_PUSH_CONTEXT;
-
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
@@ -132,11 +108,6 @@ ShOutputCollectionThread (
     void *Context
     );
 
-void
-ShPushInputThread (
-    void *Context
-    );
-
 void
 ShNtSignalHandler (
     int SignalNumber
@@ -410,97 +381,114 @@ Return Value:
 }
 
 int
-ShPushInputText (
+ShOpenInputText (
     char *Text,
     unsigned long TextSize,
-    int Pipe
+    int *Descriptor
     )
 
 /*++
 
 Routine Description:
 
-    This routine forks an executable or thread to push the given input into the
-    given pipe.
+    This routine creates a file descriptor that reads back the given text,
+    without starting another process or thread to feed it. Text that fits is
+    written straight into a pipe. Anything bigger goes into a temporary file
+    that has no name.
 
 Arguments:
 
-    Text - Supplies a pointer to the string containing the text to push into
-        the input.
+    Text - Supplies a pointer to the text to read back.
 
-    TextSize - Supplies the number of bytes to write.
+    TextSize - Supplies the number of bytes of text.
 
-    Pipe - Supplies the pipe to write it into. The caller may (and is
-        responsible for) closing the pipe after this routine returns.
+    Descriptor - Supplies a pointer where the descriptor to read from will be
+        returned on success. The caller is responsible for closing it.
 
 Return Value:
 
-    Returns the pid that was created (and needs to be waited for) on success.
-
-    0 on success if no pid needs to be waited on.
+    1 on success.
 
-    -1 on failure.
+    0 on failure.
 
 --*/
 
 {
 
-    PSHELL_NT_INPUT_PUSH_CONTEXT Context;
-    int Result;
-    uintptr_t Thread;
+    ssize_t BytesWritten;
+    char Directory[MAX_PATH];
+    int File;
+    char Path[MAX_PATH];
+    int Pipe[2];
+    unsigned long TotalBytesWritten;
 
-    Result = -1;
-    Context = malloc(sizeof(SHELL_NT_INPUT_PUSH_CONTEXT));
-    if (Context == NULL) {
-        goto PushInputTextEnd;
-    }
+    *Descriptor = -1;
 
-    memset(Context, 0, sizeof(SHELL_NT_INPUT_PUSH_CONTEXT));
-    Context->Handle = -1;
+    //
+    // The pipes are big enough that anything that fits can be written
+    // before anyone reads the other end.
+    //
+
+    if (TextSize <= SHELL_NT_PIPE_SIZE) {
+        if (ShCreatePipe(Pipe) == 0) {
+            return 0;
+        }
+
+        File = Pipe[1];
+        *Descriptor = Pipe[0];
 
     //
-    // Copy the document.
+    // Put bigger text in a temporary file that is deleted when it is closed.
     //
 
-    Context->Buffer = malloc(TextSize);
-    if (Context->Buffer == NULL) {
-        goto PushInputTextEnd;
-    }
+    } else {
+        if ((GetTempPath(MAX_PATH, Directory) == 0) ||
+            (GetTempFileName(Directory, "sh", 0, Path) == 0)) {
 
-    memcpy(Context->Buffer, Text, TextSize);
-    Context->BufferSize = TextSize;
-    Context->Handle = dup(Pipe);
-    if (Context->Handle == -1) {
-        goto PushInputTextEnd;
-    }
+            return 0;
+        }
 
-    if (ShSetDescriptorFlags(Context->Handle, 0) != 0) {
-        goto PushInputTextEnd;
-    }
+        File = _open(Path,
+                     _O_RDWR | _O_BINARY | _O_TEMPORARY | _O_SHORT_LIVED);
 
-    Thread = _beginthread(ShPushInputThread, 0, Context);
-    if (Thread == -1) {
-        goto PushInputTextEnd;
+        if (File < 0) {
+            DeleteFile(Path);
+            return 0;
+        }
     }
 
-    Result = 0;
+    TotalBytesWritten = 0;
+    while (TotalBytesWritten != TextSize) {
+        BytesWritten = write(File,
+                             Text + TotalBytesWritten,
+                             TextSize - TotalBytesWritten);
 
-PushInputTextEnd:
-    if (Result != 0) {
-        if (Context != NULL) {
-            if (Context->Buffer != NULL) {
-                free(Context->Buffer);
+        if (BytesWritten <= 0) {
+            close(File);
+            if (*Descriptor != -1) {
+                close(*Descriptor);
+                *Descriptor = -1;
             }
 
-            if (Context->Handle != -1) {
-                close(Context->Handle);
-            }
+            return 0;
+        }
 
-            free(Context);
+        TotalBytesWritten += BytesWritten;
+    }
+
+    if (*Descriptor != -1) {
+        close(File);
+
+    } else {
+        if (lseek(File, 0, SEEK_SET) != 0) {
+            close(File);
+            return 0;
         }
+
+        *Descriptor = File;
     }
 
-    return Result;
+    return 1;
 }
 
 char
@@ -812,6 +800,62 @@ Return Value:
     return 1;
 }
 
+int
+ShGetProcessorTime (
+    unsigned long long *Microseconds
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the total processor time used so far by the shell
+    and all of its children that have been waited for.
+
+Arguments:
+
+    Microseconds - Supplies a pointer where the user plus system time will be
+        returned, in microseconds.
+
+Return Value:
+
+    1 on success.
+
+    0 on failure.
+
+--*/
+
+{
+
+    FILETIME CreationTime;
+    FILETIME ExitTime;
+    FILETIME KernelTime;
+    BOOL Result;
+    FILETIME UserTime;
+
+    //
+    // Windows doesn't keep track of the time of child processes, so only the
+    // shell's own time is reported.
+    //
+
+    Result = GetProcessTimes(GetCurrentProcess(),
+                             &CreationTime,
+                             &ExitTime,
+                             &KernelTime,
+                             &UserTime);
+
+    if (Result == FALSE) {
+        return 0;
+    }
+
+    *Microseconds = ((((unsigned long long)UserTime.dwHighDateTime << 32) |
+                      UserTime.dwLowDateTime) +
+                     (((unsigned long long)KernelTime.dwHighDateTime << 32) |
+                      KernelTime.dwLowDateTime)) / 10;
+
+    return 1;
+}
+
 int
 ShSetSignalDisposition (
     SHELL_SIGNAL Signal,
@@ -1175,74 +1219,6 @@ Return Value:
     return;
 }
 
-void
-ShPushInputThread (
-    void *Context
-    )
-
-/*++
-
-Routine Description:
-
-    This routine implements the input push thread on windows.
-
-Arguments:
-
-    Context - Supplies a pointer to the thread context, in this case it's a
-        pointer to the NT input push context.
-
-Return Value:
-
-    1 on success.
-
-    0 on failure.
-
---*/
-
-{
-
-    unsigned long BytesToWrite;
-    ssize_t BytesWritten;
-    PSHELL_NT_INPUT_PUSH_CONTEXT InputContext;
-    unsigned long TotalBytesWritten;
-
-    InputContext = (PSHELL_NT_INPUT_PUSH_CONTEXT)Context;
-
-    //
-    // Loop writing to the file descriptor.
-    //
-
-    TotalBytesWritten = 0;
-    while (TotalBytesWritten != InputContext->BufferSize) {
-        BytesToWrite = SHELL_NT_INPUT_CHUNK_SIZE;
-        if (InputContext->BufferSize - TotalBytesWritten < BytesToWrite) {
-            BytesToWrite = InputContext->BufferSize - TotalBytesWritten;
-        }
-
-        BytesWritten = write(InputContext->Handle,
-                             InputContext->Buffer + TotalBytesWritten,
-                             BytesToWrite);
-
-        if (BytesWritten <= 0) {
-            break;
-        }
-
-        TotalBytesWritten += BytesWritten;
-    }
-
-    //
-    // Release the resources.
-    //
-
-    if (InputContext->Buffer != NULL) {
-        free(InputContext->Buffer);
-    }
-
-    close(InputContext->Handle);
-    free(InputContext);
-    return;
-}
-
 void
 ShNtSignalHandler (
     int SignalNumber
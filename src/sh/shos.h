@@ -326,36 +326,35 @@ Return Value:
 --*/
 
 int
-ShPushInputText (
+ShOpenInputText (
     char *Text,
     unsigned long TextSize,
-    int Pipe
+    int *Descriptor
     );
 
 /*++
 
 Routine Description:
 
-    This routine forks an executable or thread to push the given input into the
-    given pipe.
+    This routine creates a file descriptor that reads back the given text,
+    without starting another process or thread to feed it. Text that fits is
+    written straight into a pipe. Anything bigger goes into a temporary file
+    that has no name.
 
 Arguments:
 
-    Text - Supplies a pointer to the string containing the text to push into
-        the input.
+    Text - Supplies a pointer to the text to read back.
 
-    TextSize - Supplies the number of bytes to write.
+    TextSize - Supplies the number of bytes of text.
 
-    Pipe - Supplies the pipe to write it into. The caller may (and is
-        responsible for) closing the pipe after this routine returns.
+    Descriptor - Supplies a pointer where the descriptor to read from will be
+        returned on success. The caller is responsible for closing it.
 
 Return Value:
 
-    Returns the pid that was created (and needs to be waited for) on success.
-
-    0 on success if no pid needs to be waited on.
+    1 on success.
 
-    -1 on failure.
+    0 on failure.
 
 --*/
 
@@ -453,7 +452,8 @@ Routine Description:
         name of the variable to set.
 
     Value - Supplies a pointer to the null terminated string containing the
-        value to set for the given environment variable.
+        value to set for the given environment variable. If this is NULL, the
+        variable is removed from the environment.
 
 Return Value:
 
@@ -512,6 +512,31 @@ Return Value:
 
 --*/
 
+int
+ShGetProcessorTime (
+    unsigned long long *Microseconds
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the total processor time used so far by the shell
+    and all of its children that have been waited for.
+
+Arguments:
+
+    Microseconds - Supplies a pointer where the user plus system time will be
+        returned, in microseconds.
+
+Return Value:
+
+    1 on success.
+
+    0 on failure.
+
+--*/
+
 int
 ShSetSignalDisposition (
     SHELL_SIGNAL Signal,
@@ -223,6 +223,9 @@ Structure Description:
     ArgumentsBufferCapacity - Stores the size of the arguments buffer
         allocation.
 
+    ArgumentsLiteral - Stores a boolean indicating that every word in the
+        arguments string is a plain literal, so the command can skip expansion.
+
 --*/
 
 typedef struct _SHELL_NODE_SIMPLE_COMMAND {
@@ -230,6 +233,7 @@ typedef struct _SHELL_NODE_SIMPLE_COMMAND {
     PSTR Arguments;
     UINTN ArgumentsSize;
     UINTN ArgumentsBufferCapacity;
+    BOOL ArgumentsLiteral;
 } SHELL_NODE_SIMPLE_COMMAND, *PSHELL_NODE_SIMPLE_COMMAND;
 
 /*++
@@ -272,6 +276,9 @@ Structure Description:
     WordListBufferCapacity - Stores the size of the allocation covering the
         word list buffer.
 
+    WordListLiteral - Stores a boolean indicating that every word in the word
+        list is a plain literal, so the list can skip expansion.
+
 --*/
 
 typedef struct _SHELL_NODE_FOR {
@@ -280,6 +287,7 @@ typedef struct _SHELL_NODE_FOR {
     PSTR WordListBuffer;
     UINTN WordListBufferSize;
     UINTN WordListBufferCapacity;
+    BOOL WordListLiteral;
 } SHELL_NODE_FOR, *PSHELL_NODE_FOR;
 
 /*++
@@ -408,6 +416,9 @@ Structure Description:
     ValueSize - Stores the size of the value string in bytes including the null
         terminator.
 
+    ValueLiteral - Stores a boolean indicating that the value is a plain
+        literal, and can be assigned as is without going through expansion.
+
 --*/
 
 typedef struct _SHELL_ASSIGNMENT {
@@ -416,6 +427,7 @@ typedef struct _SHELL_ASSIGNMENT {
     UINTN NameSize;
     PSTR Value;
     UINTN ValueSize;
+    BOOL ValueLiteral;
 } SHELL_ASSIGNMENT, *PSHELL_ASSIGNMENT;
 
 /*++
@@ -30,6 +30,8 @@ Module Name:
 // ------------------------------------------------------------------- Includes
 //
 
+#define _GNU_SOURCE 1
+
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -38,6 +40,8 @@ Module Name:
 #include <fcntl.h>
 #include <signal.h>
 #include <pwd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/times.h>
 #include <sys/wait.h>
 #include <errno.h>
@@ -48,7 +52,28 @@ Module Name:
 //
 
 #define SHELL_OUTPUT_CHUNK_SIZE 1024
-#define SHELL_INPUT_CHUNK_SIZE 1024
+
+//
+// Define the largest input text that is written straight into a pipe. Most
+// systems buffer at least this much in a pipe. Bigger text, or text that
+// turns out not to fit, goes into a temporary file instead.
+//
+
+#define SHELL_INPUT_PIPE_SIZE 0x10000
+
+//
+// Define the variable naming the directory for temporary files, and the
+// directory used if it is not set.
+//
+
+#define SHELL_TEMPORARY_DIRECTORY_VARIABLE "TMPDIR"
+#define SHELL_DEFAULT_TEMPORARY_DIRECTORY "/tmp"
+
+//
+// Define the name of the temporary files holding input text.
+//
+
+#define SHELL_INPUT_FILE_NAME "sh-input"
 
 //
 // ------------------------------------------------------ Data Type Definitions
@@ -327,94 +352,147 @@ Return Value:
 }
 
 int
-ShPushInputText (
+ShOpenInputText (
     char *Text,
     unsigned long TextSize,
-    int Pipe
+    int *Descriptor
     )
 
 /*++
 
 Routine Description:
 
-    This routine forks an executable or thread to push the given input into the
-    given pipe.
+    This routine creates a file descriptor that reads back the given text,
+    without starting another process or thread to feed it. Text that fits is
+    written straight into a pipe. Anything bigger goes into a temporary file
+    that has no name.
 
 Arguments:
 
-    Text - Supplies a pointer to the string containing the text to push into
-        the input.
+    Text - Supplies a pointer to the text to read back.
 
-    TextSize - Supplies the number of bytes to write.
+    TextSize - Supplies the number of bytes of text.
 
-    Pipe - Supplies the pipe to write it into. The caller may (and is
-        responsible for) closing the pipe after this routine returns.
+    Descriptor - Supplies a pointer where the descriptor to read from will be
+        returned on success. The caller is responsible for closing it.
 
 Return Value:
 
-    Returns the pid that was created (and needs to be waited for) on success.
-
-    0 on success if no pid needs to be waited on.
+    1 on success.
 
-    -1 on failure.
+    0 on failure.
 
 --*/
 
 {
 
-    unsigned long BytesToWrite;
     ssize_t BytesWritten;
-    pid_t Child;
+    char *Directory;
+    int File;
+    char *Path;
+    size_t PathSize;
+    int Pipe[2];
     unsigned long TotalBytesWritten;
 
+    *Descriptor = -1;
+
     //
-    // Fork off into a new process that pushes the input into the pipe and
-    // exits.
+    // Try a pipe first. The write end is non-blocking so that text that
+    // doesn't fit in the pipe can't hang the shell, since nobody is reading
+    // the other end yet.
     //
 
-    fflush(NULL);
-    Child = fork();
-    if (Child == -1) {
-        return 0;
-    }
+    if (TextSize <= SHELL_INPUT_PIPE_SIZE) {
+        if (pipe(Pipe) != 0) {
+            return 0;
+        }
 
-    //
-    // If this is the parent, the work here is done, so exit.
-    //
+        BytesWritten = 0;
+        if ((TextSize != 0) &&
+            (fcntl(Pipe[1], F_SETFL, O_NONBLOCK) == 0)) {
+
+            do {
+                BytesWritten = write(Pipe[1], Text, TextSize);
+
+            } while ((BytesWritten < 0) && (errno == EINTR));
+        }
+
+        close(Pipe[1]);
+        if (BytesWritten == (ssize_t)TextSize) {
+            *Descriptor = Pipe[0];
+            return 1;
+        }
 
-    if (Child != 0) {
-        return Child;
+        close(Pipe[0]);
     }
 
     //
-    // This is the child process. Loop writing to the file descriptor.
+    // Put the text in an anonymous file. Use a memory file if the system has
+    // them, or otherwise create a temporary file and unlink it right away.
     //
 
-    TotalBytesWritten = 0;
-    while (TotalBytesWritten != TextSize) {
-        BytesToWrite = SHELL_INPUT_CHUNK_SIZE;
-        if (TextSize - TotalBytesWritten < BytesToWrite) {
-            BytesToWrite = TextSize - TotalBytesWritten;
+    File = -1;
+
+#ifdef MFD_CLOEXEC
+
+    File = memfd_create(SHELL_INPUT_FILE_NAME, MFD_CLOEXEC);
+
+#endif
+
+    if (File < 0) {
+        Directory = getenv(SHELL_TEMPORARY_DIRECTORY_VARIABLE);
+        if ((Directory == NULL) || (*Directory == '\0')) {
+            Directory = SHELL_DEFAULT_TEMPORARY_DIRECTORY;
+        }
+
+        PathSize = strlen(Directory) + sizeof(SHELL_INPUT_FILE_NAME) + 8;
+        Path = malloc(PathSize);
+        if (Path == NULL) {
+            return 0;
         }
 
-        BytesWritten = write(Pipe,
+        snprintf(Path,
+                 PathSize,
+                 "%s/%s.XXXXXX",
+                 Directory,
+                 SHELL_INPUT_FILE_NAME);
+
+        File = mkstemp(Path);
+        if (File >= 0) {
+            unlink(Path);
+        }
+
+        free(Path);
+        if (File < 0) {
+            return 0;
+        }
+    }
+
+    TotalBytesWritten = 0;
+    while (TotalBytesWritten != TextSize) {
+        BytesWritten = write(File,
                              Text + TotalBytesWritten,
-                             BytesToWrite);
+                             TextSize - TotalBytesWritten);
 
         if (BytesWritten <= 0) {
-            break;
+            if ((BytesWritten < 0) && (errno == EINTR)) {
+                continue;
+            }
+
+            close(File);
+            return 0;
         }
 
         TotalBytesWritten += BytesWritten;
     }
 
-    //
-    // Exit immediately, as this was a child process and shouldn't go back to
-    // doing shell functions.
-    //
+    if (lseek(File, 0, SEEK_SET) != 0) {
+        close(File);
+        return 0;
+    }
 
-    exit(0);
-    return 0;
+    *Descriptor = File;
+    return 1;
 }
 
 char
@@ -539,7 +617,8 @@ Routine Description:
         name of the variable to set.
 
     Value - Supplies a pointer to the null terminated string containing the
-        value to set for the given environment variable.
+        value to set for the given environment variable. If this is NULL, the
+        variable is removed from the environment.
 
 Return Value:
 
@@ -551,6 +630,10 @@ Return Value:
 
 {
 
+    if (Value == NULL) {
+        return ShUnsetEnvironmentVariable(Name);
+    }
+
     if (setenv(Name, Value, 1) == 0) {
         return 1;
     }
@@ -695,6 +778,51 @@ Return Value:
     return 1;
 }
 
+int
+ShGetProcessorTime (
+    unsigned long long *Microseconds
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the total processor time used so far by the shell
+    and all of its children that have been waited for.
+
+Arguments:
+
+    Microseconds - Supplies a pointer where the user plus system time will be
+        returned, in microseconds.
+
+Return Value:
+
+    1 on success.
+
+    0 on failure.
+
+--*/
+
+{
+
+    struct rusage Children;
+    struct rusage Self;
+
+    if ((getrusage(RUSAGE_SELF, &Self) != 0) ||
+        (getrusage(RUSAGE_CHILDREN, &Children) != 0)) {
+
+        return 0;
+    }
+
+    *Microseconds = ((Self.ru_utime.tv_sec + Self.ru_stime.tv_sec +
+                      Children.ru_utime.tv_sec + Children.ru_stime.tv_sec) *
+                     1000000ULL) +
+                    Self.ru_utime.tv_usec + Self.ru_stime.tv_usec +
+                    Children.ru_utime.tv_usec + Children.ru_stime.tv_usec;
+
+    return 1;
+}
+
 int
 ShSetSignalDisposition (
     SHELL_SIGNAL Signal,
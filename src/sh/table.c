@@ -0,0 +1,505 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+This project is dual licensed. You are receiving it under the terms of the
+GNU General Public License version 3 (GPLv3). Alternative licensing terms are
+available. Contact info@minocacorp.com for details. See the LICENSE file at the
+root of this project for complete licensing information.
+
+Module Name:
+
+    table.c
+
+Abstract:
+
+    This module implements the name tables used to store shell variables,
+    functions, and aliases. Each table keeps its entries on a list in the
+    order they were added, and indexes them with an open addressed hash table
+    so they can be found by name without walking the list.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    POSIX
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include "sh.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the number of slots in a table's index when it is first created.
+// This must be a power of two.
+//
+
+#define SHELL_NAME_TABLE_INITIAL_CAPACITY 16
+
+//
+// Define the marker stored in slots whose entry has been removed. Lookups
+// have to keep probing past these.
+//
+
+#define SHELL_NAME_TABLE_DELETED ((PLIST_ENTRY)-1)
+
+//
+// Define the multiplier used to spread name hashes across the slots. The
+// shell's name hash leaves its low bits mostly up to the last character or
+// two, so the index is taken from the top bits of this product instead.
+//
+
+#define SHELL_NAME_TABLE_MULTIPLIER 0x9E3779B1
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+BOOL
+ShResizeNameTable (
+    PSHELL_NAME_TABLE Table,
+    ULONG Capacity
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+PSHELL_NAME_TABLE
+ShCreateNameTable (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates and initializes an empty name table with a single
+    reference.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns a pointer to the new table on success. Free it with free once it
+    has been destroyed.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    PSHELL_NAME_TABLE Table;
+
+    Table = malloc(sizeof(SHELL_NAME_TABLE));
+    if (Table == NULL) {
+        return NULL;
+    }
+
+    ShInitializeNameTable(Table);
+    return Table;
+}
+
+VOID
+ShInitializeNameTable (
+    PSHELL_NAME_TABLE Table
+    )
+
+/*++
+
+Routine Description:
+
+    This routine initializes an empty name table. No memory is allocated until
+    the first entry is added.
+
+Arguments:
+
+    Table - Supplies a pointer to the table to initialize.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    INITIALIZE_LIST_HEAD(&(Table->List));
+    Table->Slots = NULL;
+    Table->Capacity = 0;
+    Table->Shift = 0;
+    Table->Count = 0;
+    Table->Used = 0;
+    Table->ReferenceCount = 1;
+    return;
+}
+
+VOID
+ShDestroyNameTable (
+    PSHELL_NAME_TABLE Table
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees the index of a name table. The owner is responsible
+    for removing and freeing the entries themselves first.
+
+Arguments:
+
+    Table - Supplies a pointer to the table to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    assert(LIST_EMPTY(&(Table->List)) != FALSE);
+
+    if (Table->Slots != NULL) {
+        free(Table->Slots);
+    }
+
+    ShInitializeNameTable(Table);
+    return;
+}
+
+PLIST_ENTRY
+ShNameTableLookup (
+    PSHELL_NAME_TABLE Table,
+    PSTR Name,
+    UINTN NameSize,
+    ULONG Hash
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the entry with the given name in a name table.
+
+Arguments:
+
+    Table - Supplies a pointer to the table to search.
+
+    Name - Supplies a pointer to the name to find. This does not need to be
+        null terminated.
+
+    NameSize - Supplies the size of the name in bytes including space for a
+        null terminator.
+
+    Hash - Supplies the hash of the name, as returned by SwHashString.
+
+Return Value:
+
+    Returns a pointer to the list entry of the matching entry on success.
+
+    NULL if no entry has the given name.
+
+--*/
+
+{
+
+    ULONG Index;
+    ULONG Mask;
+    PSHELL_NAME_TABLE_SLOT Slot;
+
+    if (Table->Count == 0) {
+        return NULL;
+    }
+
+    Mask = Table->Capacity - 1;
+    Index = (ULONG)(Hash * SHELL_NAME_TABLE_MULTIPLIER) >> Table->Shift;
+    while (TRUE) {
+        Slot = &(Table->Slots[Index]);
+        if (Slot->Entry == NULL) {
+            break;
+        }
+
+        if ((Slot->Entry != SHELL_NAME_TABLE_DELETED) &&
+            (Slot->Hash == Hash) &&
+            (Slot->NameSize == NameSize) &&
+            (memcmp(Slot->Name, Name, NameSize - 1) == 0)) {
+
+            return Slot->Entry;
+        }
+
+        Index = (Index + 1) & Mask;
+    }
+
+    return NULL;
+}
+
+BOOL
+ShNameTableInsert (
+    PSHELL_NAME_TABLE Table,
+    PLIST_ENTRY Entry,
+    PSTR Name,
+    UINTN NameSize,
+    ULONG Hash
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds an entry to the end of a name table. The caller must
+    make sure no entry with the same name is already in the table.
+
+Arguments:
+
+    Table - Supplies a pointer to the table.
+
+    Entry - Supplies a pointer to the list entry embedded in the new entry.
+
+    Name - Supplies a pointer to the entry's name. This must stay valid and
+        unchanged for as long as the entry is in the table.
+
+    NameSize - Supplies the size of the name in bytes including the null
+        terminator.
+
+    Hash - Supplies the hash of the name, as returned by SwHashString.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on allocation failure, in which case the entry was not added.
+
+--*/
+
+{
+
+    ULONG Capacity;
+    ULONG Index;
+    ULONG Mask;
+    BOOL Result;
+    PSHELL_NAME_TABLE_SLOT Slot;
+
+    assert(ShNameTableLookup(Table, Name, NameSize, Hash) == NULL);
+
+    //
+    // Keep the index no more than three quarters full, counting deleted
+    // slots. If it's mostly deleted slots, rebuilding at the same size is
+    // enough to clean them out.
+    //
+
+    if ((Table->Used + 1) * 4 > Table->Capacity * 3) {
+        Capacity = Table->Capacity;
+        if (Capacity == 0) {
+            Capacity = SHELL_NAME_TABLE_INITIAL_CAPACITY;
+
+        } else if ((Table->Count + 1) * 2 > Capacity) {
+            Capacity *= 2;
+        }
+
+        Result = ShResizeNameTable(Table, Capacity);
+        if (Result == FALSE) {
+            return FALSE;
+        }
+    }
+
+    Mask = Table->Capacity - 1;
+    Index = (ULONG)(Hash * SHELL_NAME_TABLE_MULTIPLIER) >> Table->Shift;
+    while (TRUE) {
+        Slot = &(Table->Slots[Index]);
+        if ((Slot->Entry == NULL) ||
+            (Slot->Entry == SHELL_NAME_TABLE_DELETED)) {
+
+            break;
+        }
+
+        Index = (Index + 1) & Mask;
+    }
+
+    if (Slot->Entry == NULL) {
+        Table->Used += 1;
+    }
+
+    Slot->Entry = Entry;
+    Slot->Hash = Hash;
+    Slot->Name = Name;
+    Slot->NameSize = NameSize;
+    Table->Count += 1;
+    INSERT_BEFORE(Entry, &(Table->List));
+    return TRUE;
+}
+
+VOID
+ShNameTableRemove (
+    PSHELL_NAME_TABLE Table,
+    PLIST_ENTRY Entry,
+    ULONG Hash
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes an entry from a name table. The entry itself is not
+    freed.
+
+Arguments:
+
+    Table - Supplies a pointer to the table.
+
+    Entry - Supplies a pointer to the list entry of the entry to remove.
+
+    Hash - Supplies the hash of the entry's name.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Index;
+    ULONG Mask;
+    PSHELL_NAME_TABLE_SLOT Slot;
+
+    assert(Table->Count != 0);
+
+    Mask = Table->Capacity - 1;
+    Index = (ULONG)(Hash * SHELL_NAME_TABLE_MULTIPLIER) >> Table->Shift;
+    while (TRUE) {
+        Slot = &(Table->Slots[Index]);
+
+        assert(Slot->Entry != NULL);
+
+        if (Slot->Entry == Entry) {
+            break;
+        }
+
+        Index = (Index + 1) & Mask;
+    }
+
+    Slot->Entry = SHELL_NAME_TABLE_DELETED;
+    Table->Count -= 1;
+
+    //
+    // Once the table is empty, every slot can go back to being free.
+    //
+
+    if (Table->Count == 0) {
+        memset(Table->Slots,
+               0,
+               Table->Capacity * sizeof(SHELL_NAME_TABLE_SLOT));
+
+        Table->Used = 0;
+    }
+
+    LIST_REMOVE(Entry);
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+BOOL
+ShResizeNameTable (
+    PSHELL_NAME_TABLE Table,
+    ULONG Capacity
+    )
+
+/*++
+
+Routine Description:
+
+    This routine rebuilds the index of a name table with the given number of
+    slots, dropping any deleted slots along the way.
+
+Arguments:
+
+    Table - Supplies a pointer to the table.
+
+    Capacity - Supplies the new number of slots. This must be a power of two.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on allocation failure, in which case the table is unchanged.
+
+--*/
+
+{
+
+    ULONG Index;
+    ULONG Mask;
+    PSHELL_NAME_TABLE_SLOT NewSlot;
+    PSHELL_NAME_TABLE_SLOT NewSlots;
+    ULONG OldIndex;
+    PSHELL_NAME_TABLE_SLOT OldSlot;
+    ULONG Shift;
+
+    assert((Capacity & (Capacity - 1)) == 0);
+
+    NewSlots = calloc(Capacity, sizeof(SHELL_NAME_TABLE_SLOT));
+    if (NewSlots == NULL) {
+        return FALSE;
+    }
+
+    Shift = 32;
+    for (Index = Capacity; Index > 1; Index >>= 1) {
+        Shift -= 1;
+    }
+
+    Mask = Capacity - 1;
+    for (OldIndex = 0; OldIndex < Table->Capacity; OldIndex += 1) {
+        OldSlot = &(Table->Slots[OldIndex]);
+        if ((OldSlot->Entry == NULL) ||
+            (OldSlot->Entry == SHELL_NAME_TABLE_DELETED)) {
+
+            continue;
+        }
+
+        Index = (ULONG)(OldSlot->Hash * SHELL_NAME_TABLE_MULTIPLIER) >> Shift;
+        while (NewSlots[Index].Entry != NULL) {
+            Index = (Index + 1) & Mask;
+        }
+
+        NewSlot = &(NewSlots[Index]);
+        *NewSlot = *OldSlot;
+    }
+
+    if (Table->Slots != NULL) {
+        free(Table->Slots);
+    }
+
+    Table->Slots = NewSlots;
+    Table->Capacity = Capacity;
+    Table->Shift = Shift;
+    Table->Used = Table->Count;
+    return TRUE;
+}
+
@@ -90,7 +90,9 @@ ShCreateShell (
 
 Routine Description:
 
-    This routine creates a new shell object.
+    This routine creates a new shell object. The shell starts out with no
+    variables; the caller either initializes them from the environment or
+    hands over a parent's.
 
 Arguments:
 
@@ -140,14 +142,14 @@ Return Value:
     }
 
     INITIALIZE_LIST_HEAD(&(Shell->ExecutionStack));
-    INITIALIZE_LIST_HEAD(&(Shell->VariableList));
     INITIALIZE_LIST_HEAD(&(Shell->ArgumentList));
-    INITIALIZE_LIST_HEAD(&(Shell->FunctionList));
-    INITIALIZE_LIST_HEAD(&(Shell->AliasList));
+    ShInitializeNameTable(&(Shell->Aliases));
     INITIALIZE_LIST_HEAD(&(Shell->SignalActionList));
     INITIALIZE_LIST_HEAD(&(Shell->ActiveRedirectList));
-    Result = ShInitializeVariables(Shell);
-    if (Result == FALSE) {
+    Shell->Variables = ShCreateNameTable();
+    Shell->Functions = ShCreateNameTable();
+    if ((Shell->Variables == NULL) || (Shell->Functions == NULL)) {
+        Result = FALSE;
         goto CreateShellEnd;
     }
 
@@ -164,6 +166,14 @@ Return Value:
     if (Result == FALSE) {
         if (Shell != NULL) {
             ShDestroyLexer(&(Shell->Lexer));
+            if (Shell->Variables != NULL) {
+                free(Shell->Variables);
+            }
+
+            if (Shell->Functions != NULL) {
+                free(Shell->Functions);
+            }
+
             if (Shell->CommandName != NULL) {
                 free(Shell->CommandName);
             }
@@ -220,8 +230,9 @@ Return Value:
         ShDestroyHereDocument(HereDocument);
     }
 
-    ShDestroyVariableList(&(Shell->VariableList));
+    ShReleaseVariables(Shell);
     ShDestroyFunctionList(Shell);
+    ShClearCommandHash(Shell);
     ShDestroyAliasList(Shell);
     ShDestroySignalActionList(&(Shell->SignalActionList));
     if (Shell->CommandName != NULL) {
@@ -230,6 +241,10 @@ Return Value:
 
     ShDestroyArgumentList(&(Shell->ArgumentList));
     ShDestroyLexer(&(Shell->Lexer));
+    if (Shell->ExpansionArena != NULL) {
+        SwDestroyArena(Shell->ExpansionArena);
+        Shell->ExpansionArena = NULL;
+    }
 
     assert(LIST_EMPTY(&(Shell->ExecutionStack)) != FALSE);
     assert(LIST_EMPTY(&(Shell->ArgumentList)) != FALSE);
@@ -313,12 +328,17 @@ Return Value:
         goto CreateSubshellEnd;
     }
 
-    Result = ShCopyVariables(Shell, &(Subshell->VariableList));
+    Result = ShShareVariables(Shell, Subshell);
     if (Result == FALSE) {
         goto CreateSubshellEnd;
     }
 
-    Result = ShCopyFunctionList(Shell, Subshell);
+    Result = ShShareFunctionList(Shell, Subshell);
+    if (Result == FALSE) {
+        goto CreateSubshellEnd;
+    }
+
+    Result = ShCopyCommandHash(Shell, Subshell);
     if (Result == FALSE) {
         goto CreateSubshellEnd;
     }
@@ -340,6 +360,25 @@ Return Value:
         }
 
         Subshell->Lexer.InputBufferCapacity = Subshell->Lexer.InputBufferSize;
+
+        //
+        // Command substitutions are often run over and over again with the
+        // same text. Reuse the commands parsed last time if possible. The
+        // input is still set up in case a command changes the aliases and
+        // the rest has to be parsed again.
+        //
+
+        Subshell->Lexer.ParsedInput = ShLookupParsedInput(Subshell,
+                                                          Input,
+                                                          InputSize,
+                                                          DequoteForSubshell);
+
+        if (Subshell->Lexer.ParsedInput == NULL) {
+            Subshell->Lexer.ParsedInput = ShParseInput(Subshell,
+                                                       Input,
+                                                       InputSize,
+                                                       DequoteForSubshell);
+        }
     }
 
     Result = TRUE;
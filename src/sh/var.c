@@ -68,20 +68,20 @@ ShGetVariableInScope (
     PSHELL Shell,
     PSTR Name,
     UINTN NameSize,
-    PLIST_ENTRY *ListHead
+    PSHELL_NAME_TABLE *Table
     );
 
 PSHELL_VARIABLE
-ShGetVariableInList (
-    PLIST_ENTRY ListHead,
+ShGetVariableInTable (
+    PSHELL_NAME_TABLE Table,
     PSTR Name,
     UINTN NameSize,
     ULONG NameHash
     );
 
 BOOL
-ShSetVariableInList (
-    PLIST_ENTRY ListHead,
+ShSetVariableInTable (
+    PSHELL_NAME_TABLE Table,
     PSTR Name,
     UINTN NameSize,
     PSTR Value,
@@ -104,9 +104,19 @@ ShCreateVariable (
     );
 
 BOOL
-ShCopyVariablesOnList (
-    PLIST_ENTRY Source,
-    PLIST_ENTRY Destination
+ShCopyVariablesInTable (
+    PSHELL_NAME_TABLE Source,
+    PSHELL_NAME_TABLE Destination
+    );
+
+BOOL
+ShUnshareVariables (
+    PSHELL Shell
+    );
+
+BOOL
+ShUnshareFunctions (
+    PSHELL Shell
     );
 
 VOID
@@ -123,9 +133,9 @@ ShPrintAllVariables (
     );
 
 VOID
-ShPrintVariablesInList (
+ShPrintVariablesInTable (
     PSHELL Shell,
-    PLIST_ENTRY ListHead,
+    PSHELL_NAME_TABLE Table,
     BOOL Exported,
     BOOL ReadOnly
     );
@@ -139,12 +149,6 @@ ShBuiltinExportOrReadOnly (
     BOOL ReadOnly
     );
 
-ULONG
-ShHashName (
-    PSTR Name,
-    UINTN NameSize
-    );
-
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -242,19 +246,22 @@ Return Value:
 
         Value = Equals + 1;
         ValueSize = strlen(Value) + 1;
-        NameHash = ShHashName(Name, NameSize);
+        NameHash = SwHashString(Name, NameSize);
 
         //
         // If there are duplicate variables in the environment, use the latest.
         //
 
-        Variable = ShGetVariableInList(&(Shell->VariableList),
-                                       Name,
-                                       NameSize,
-                                       NameHash);
+        Variable = ShGetVariableInTable(Shell->Variables,
+                                        Name,
+                                        NameSize,
+                                        NameHash);
 
         if (Variable != NULL) {
-            LIST_REMOVE(&(Variable->ListEntry));
+            ShNameTableRemove(Shell->Variables,
+                              &(Variable->ListEntry),
+                              Variable->Hash);
+
             Variable->ListEntry.Next = NULL;
             ShDestroyVariable(Variable, FALSE);
         }
@@ -275,7 +282,16 @@ Return Value:
                                     TRUE);
 
         if (Variable != NULL) {
-            INSERT_BEFORE(&(Variable->ListEntry), &(Shell->VariableList));
+            Result = ShNameTableInsert(Shell->Variables,
+                                       &(Variable->ListEntry),
+                                       Variable->Name,
+                                       Variable->NameSize,
+                                       Variable->Hash);
+
+            if (Result == FALSE) {
+                Variable->ListEntry.Next = NULL;
+                ShDestroyVariable(Variable, FALSE);
+            }
         }
 
         free(Name);
@@ -610,16 +626,21 @@ Return Value:
 
 {
 
-    PLIST_ENTRY ListHead;
     BOOL Result;
+    PSHELL_NAME_TABLE Table;
     PSHELL_VARIABLE Variable;
 
-    Variable = ShGetVariableInScope(Shell, Name, NameSize, &ListHead);
-    if (Variable == NULL) {
-        ListHead = &(Shell->VariableList);
+    Variable = ShGetVariableInScope(Shell, Name, NameSize, &Table);
+    if ((Variable == NULL) || (Table == Shell->Variables)) {
+        Result = ShUnshareVariables(Shell);
+        if (Result == FALSE) {
+            return FALSE;
+        }
+
+        Table = Shell->Variables;
     }
 
-    Result = ShSetVariableInList(ListHead,
+    Result = ShSetVariableInTable(Table,
                                  Name,
                                  NameSize,
                                  Value,
@@ -684,16 +705,21 @@ Return Value:
 
 {
 
-    PLIST_ENTRY ListHead;
     BOOL Result;
+    PSHELL_NAME_TABLE Table;
     PSHELL_VARIABLE Variable;
 
-    Variable = ShGetVariableInScope(Shell, Name, NameSize, &ListHead);
-    if (Variable == NULL) {
-        ListHead = &(Shell->VariableList);
+    Variable = ShGetVariableInScope(Shell, Name, NameSize, &Table);
+    if ((Variable == NULL) || (Table == Shell->Variables)) {
+        Result = ShUnshareVariables(Shell);
+        if (Result == FALSE) {
+            return FALSE;
+        }
+
+        Table = Shell->Variables;
     }
 
-    Result = ShSetVariableInList(ListHead,
+    Result = ShSetVariableInTable(Table,
                                  Name,
                                  NameSize,
                                  Value,
@@ -744,10 +770,11 @@ Return Value:
 {
 
     PSHELL_FUNCTION ShellFunction;
+    PSHELL_NAME_TABLE Table;
     PSHELL_VARIABLE Variable;
 
     if ((Type == ShellUnsetDefault) || (Type == ShellUnsetVariable)) {
-        Variable = ShGetVariableInScope(Shell, Name, NameSize, NULL);
+        Variable = ShGetVariableInScope(Shell, Name, NameSize, &Table);
         if (Variable != NULL) {
             if (Variable->ReadOnly != FALSE) {
                 PRINT_ERROR("Variable %s is read only.\n", Variable->Name);
@@ -764,10 +791,26 @@ Return Value:
 
             //
             // The variable is neither unset nor read-only, destroy it, and
-            // don't put back any original environment variable.
+            // don't put back any original environment variable. If it lives
+            // in a table shared with another shell, get a private copy of the
+            // table first and find the variable again in there.
             //
 
-            LIST_REMOVE(&(Variable->ListEntry));
+            if (Table == Shell->Variables) {
+                if (ShUnshareVariables(Shell) == FALSE) {
+                    return FALSE;
+                }
+
+                Table = Shell->Variables;
+                Variable = ShGetVariableInTable(Table,
+                                                Name,
+                                                NameSize,
+                                                Variable->Hash);
+
+                assert(Variable != NULL);
+            }
+
+            ShNameTableRemove(Table, &(Variable->ListEntry), Variable->Hash);
             Variable->ListEntry.Next = NULL;
             ShDestroyVariable(Variable, FALSE);
             return TRUE;
@@ -782,7 +825,18 @@ Return Value:
     if ((Type == ShellUnsetDefault) || (Type == ShellUnsetFunction)) {
         ShellFunction = ShGetFunction(Shell, Name, NameSize);
         if (ShellFunction != NULL) {
-            LIST_REMOVE(&(ShellFunction->ListEntry));
+            if (ShUnshareFunctions(Shell) == FALSE) {
+                return FALSE;
+            }
+
+            ShellFunction = ShGetFunction(Shell, Name, NameSize);
+
+            assert(ShellFunction != NULL);
+
+            ShNameTableRemove(Shell->Functions,
+                              &(ShellFunction->ListEntry),
+                              ShellFunction->Hash);
+
             ShReleaseNode(ShellFunction->Node);
             free(ShellFunction);
             return TRUE;
@@ -828,6 +882,8 @@ Return Value:
     BOOL Result;
     BOOL SetInShell;
     PSHELL_NODE_SIMPLE_COMMAND SimpleCommand;
+    PSTR Value;
+    UINTN ValueSize;
 
     ExpandedValue = NULL;
     Node = ExecutionNode->Node;
@@ -860,29 +916,44 @@ Return Value:
     while (CurrentEntry != &(SimpleCommand->AssignmentList)) {
         Assignment = LIST_VALUE(CurrentEntry, SHELL_ASSIGNMENT, ListEntry);
         CurrentEntry = CurrentEntry->Next;
-        Result = ShPerformExpansions(Shell,
-                                     Assignment->Value,
-                                     Assignment->ValueSize,
-                                     SHELL_EXPANSION_OPTION_NO_FIELD_SPLIT,
-                                     &ExpandedValue,
-                                     &ExpandedValueSize,
-                                     NULL,
-                                     NULL);
 
-        if (Result == FALSE) {
-            goto ExecuteVariableAssignmentsEnd;
+        //
+        // Literal values are assigned straight out of the parse tree, as the
+        // variable gets its own copy anyway.
+        //
+
+        if (Assignment->ValueLiteral != FALSE) {
+            Value = Assignment->Value;
+            ValueSize = Assignment->ValueSize;
+
+        } else {
+            Result = ShPerformExpansions(Shell,
+                                         Assignment->Value,
+                                         Assignment->ValueSize,
+                                         SHELL_EXPANSION_OPTION_NO_FIELD_SPLIT,
+                                         &ExpandedValue,
+                                         &ExpandedValueSize,
+                                         NULL,
+                                         NULL);
+
+            if (Result == FALSE) {
+                goto ExecuteVariableAssignmentsEnd;
+            }
+
+            Value = ExpandedValue;
+            ValueSize = ExpandedValueSize;
         }
 
         if ((Shell->Options & SHELL_OPTION_TRACE_COMMAND) != 0) {
-            ShPrintTrace(Shell, "%s=%s ", Assignment->Name, ExpandedValue);
+            ShPrintTrace(Shell, "%s=%s ", Assignment->Name, Value);
         }
 
         if (SetInShell != FALSE) {
             Result = ShSetVariable(Shell,
                                    Assignment->Name,
                                    Assignment->NameSize,
-                                   ExpandedValue,
-                                   ExpandedValueSize);
+                                   Value,
+                                   ValueSize);
 
         } else {
 
@@ -891,22 +962,24 @@ Return Value:
             // command.
             //
 
-            Result = ShSetVariableInList(&(ExecutionNode->VariableList),
-                                         Assignment->Name,
-                                         Assignment->NameSize,
-                                         ExpandedValue,
-                                         ExpandedValueSize,
-                                         TRUE,
-                                         FALSE,
-                                         TRUE);
+            Result = ShSetVariableInTable(&(ExecutionNode->Variables),
+                                          Assignment->Name,
+                                          Assignment->NameSize,
+                                          Value,
+                                          ValueSize,
+                                          TRUE,
+                                          FALSE,
+                                          TRUE);
         }
 
         if (Result == FALSE) {
             goto ExecuteVariableAssignmentsEnd;
         }
 
-        free(ExpandedValue);
-        ExpandedValue = NULL;
+        if (ExpandedValue != NULL) {
+            free(ExpandedValue);
+            ExpandedValue = NULL;
+        }
     }
 
     Result = TRUE;
@@ -922,7 +995,7 @@ Return Value:
 BOOL
 ShCopyVariables (
     PSHELL Source,
-    PLIST_ENTRY DestinationList
+    PSHELL_NAME_TABLE Destination
     )
 
 /*++
@@ -936,8 +1009,8 @@ Routine Description:
 
     Source - Supplies a pointer to the shell containing the variables to copy.
 
-    DestinationList - Supplies a pointer to the head of the list where the
-        copies will be put.
+    Destination - Supplies a pointer to the table where the copies will be
+        put.
 
 Return Value:
 
@@ -957,7 +1030,7 @@ Return Value:
     // Copy the variables set in the shell first.
     //
 
-    Result = ShCopyVariablesOnList(&(Source->VariableList), DestinationList);
+    Result = ShCopyVariablesInTable(Source->Variables, Destination);
     if (Result == FALSE) {
         return FALSE;
     }
@@ -975,8 +1048,8 @@ Return Value:
                                    ListEntry);
 
         CurrentEntry = CurrentEntry->Previous;
-        Result = ShCopyVariablesOnList(&(ExecutionNode->VariableList),
-                                       DestinationList);
+        Result = ShCopyVariablesInTable(&(ExecutionNode->Variables),
+                                        Destination);
 
         if (Result == FALSE) {
             return FALSE;
@@ -986,20 +1059,127 @@ Return Value:
     return TRUE;
 }
 
+BOOL
+ShShareVariables (
+    PSHELL Source,
+    PSHELL Destination
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gives a new subshell the variables visible in its parent. If
+    the parent has no local variables in scope, the subshell shares the
+    parent's table, and whichever shell changes it first makes a copy.
+    Otherwise the visible variables are copied right away.
+
+Arguments:
+
+    Source - Supplies a pointer to the parent shell.
+
+    Destination - Supplies a pointer to the new subshell, which must not have
+        any variables yet.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on failure.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PSHELL_EXECUTION_NODE ExecutionNode;
+
+    assert((Destination->Variables->Count == 0) &&
+           (Destination->Variables->ReferenceCount == 1));
+
+    //
+    // Local variables and assignments in front of commands would have to be
+    // folded into the subshell's table, so just copy everything if there are
+    // any.
+    //
+
+    CurrentEntry = Source->ExecutionStack.Next;
+    while (CurrentEntry != &(Source->ExecutionStack)) {
+        ExecutionNode = LIST_VALUE(CurrentEntry,
+                                   SHELL_EXECUTION_NODE,
+                                   ListEntry);
+
+        CurrentEntry = CurrentEntry->Next;
+        if (ExecutionNode->Variables.Count != 0) {
+            return ShCopyVariables(Source, Destination->Variables);
+        }
+    }
+
+    ShDestroyNameTable(Destination->Variables);
+    free(Destination->Variables);
+    Destination->Variables = Source->Variables;
+    Destination->Variables->ReferenceCount += 1;
+    return TRUE;
+}
+
+VOID
+ShReleaseVariables (
+    PSHELL Shell
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases a shell's reference on its variable table,
+    destroying the variables if no other shell is sharing them.
+
+Arguments:
+
+    Shell - Supplies a pointer to the dying shell.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSHELL_NAME_TABLE Table;
+
+    Table = Shell->Variables;
+    if (Table == NULL) {
+        return;
+    }
+
+    Shell->Variables = NULL;
+
+    assert(Table->ReferenceCount != 0);
+
+    Table->ReferenceCount -= 1;
+    if (Table->ReferenceCount == 0) {
+        ShDestroyVariableTable(Table);
+        free(Table);
+    }
+
+    return;
+}
+
 VOID
-ShDestroyVariableList (
-    PLIST_ENTRY List
+ShDestroyVariableTable (
+    PSHELL_NAME_TABLE Table
     )
 
 /*++
 
 Routine Description:
 
-    This routine destroys an environment variable list.
+    This routine destroys all the variables in a table.
 
 Arguments:
 
-    List - Supplies a pointer to the list to destroy.
+    Table - Supplies a pointer to the table to destroy.
 
 Return Value:
 
@@ -1011,9 +1191,9 @@ Return Value:
 
     PSHELL_VARIABLE Variable;
 
-    while (LIST_EMPTY(List) == FALSE) {
-        Variable = LIST_VALUE(List->Next, SHELL_VARIABLE, ListEntry);
-        LIST_REMOVE(&(Variable->ListEntry));
+    while (LIST_EMPTY(&(Table->List)) == FALSE) {
+        Variable = LIST_VALUE(Table->List.Next, SHELL_VARIABLE, ListEntry);
+        ShNameTableRemove(Table, &(Variable->ListEntry), Variable->Hash);
         Variable->ListEntry.Next = NULL;
 
         //
@@ -1024,6 +1204,7 @@ Return Value:
         ShDestroyVariable(Variable, TRUE);
     }
 
+    ShDestroyNameTable(Table);
     return;
 }
 
@@ -1060,29 +1241,20 @@ Return Value:
 
 {
 
-    PLIST_ENTRY CurrentEntry;
-    PSHELL_FUNCTION Function;
-    PSTR FunctionName;
+    PLIST_ENTRY Entry;
 
     assert(NameSize > 1);
 
-    //
-    // Look through each function and try to match.
-    //
+    Entry = ShNameTableLookup(Shell->Functions,
+                              Name,
+                              NameSize,
+                              SwHashString(Name, NameSize));
 
-    CurrentEntry = Shell->FunctionList.Next;
-    while (CurrentEntry != &(Shell->FunctionList)) {
-        Function = LIST_VALUE(CurrentEntry, SHELL_FUNCTION, ListEntry);
-        CurrentEntry = CurrentEntry->Next;
-        FunctionName = Function->Node->U.Function.Name;
-        if ((strncmp(Name, FunctionName, NameSize - 1) == 0) &&
-            (FunctionName[NameSize - 1] == '\0')) {
-
-            return Function;
-        }
+    if (Entry == NULL) {
+        return NULL;
     }
 
-    return NULL;
+    return LIST_VALUE(Entry, SHELL_FUNCTION, ListEntry);
 }
 
 BOOL
@@ -1114,10 +1286,20 @@ Return Value:
 {
 
     PSHELL_FUNCTION NewFunction;
+    PSHELL_NODE OldNode;
     BOOL Result;
 
+    NewFunction = NULL;
+    OldNode = NULL;
+    Result = ShUnshareFunctions(Shell);
+    if (Result == FALSE) {
+        goto DeclareFunctionEnd;
+    }
+
     //
-    // Look to see if the function is already set in the list.
+    // Look to see if the function is already set in the list. The table
+    // refers to the name inside the old definition, so pull the function out
+    // and put it back in with the new one.
     //
 
     NewFunction = ShGetFunction(Shell,
@@ -1125,32 +1307,46 @@ Return Value:
                                 Function->U.Function.NameSize);
 
     if (NewFunction != NULL) {
-        if (NewFunction->Node != NULL) {
-            ShReleaseNode(NewFunction->Node);
-        }
+        ShNameTableRemove(Shell->Functions,
+                          &(NewFunction->ListEntry),
+                          NewFunction->Hash);
 
-        NewFunction->Node = Function;
-        ShRetainNode(Function);
-        Result = TRUE;
-        goto DeclareFunctionEnd;
-    }
+        OldNode = NewFunction->Node;
+        NewFunction->Node = NULL;
 
     //
-    // The variable doesn't exist, at least not on this list. Create it.
+    // The function doesn't exist. Create it.
     //
 
-    NewFunction = malloc(sizeof(SHELL_FUNCTION));
-    if (NewFunction == NULL) {
-        Result = FALSE;
+    } else {
+        NewFunction = malloc(sizeof(SHELL_FUNCTION));
+        if (NewFunction == NULL) {
+            Result = FALSE;
+            goto DeclareFunctionEnd;
+        }
+
+        NewFunction->Hash = SwHashString(Function->U.Function.Name,
+                                         Function->U.Function.NameSize);
+    }
+
+    Result = ShNameTableInsert(Shell->Functions,
+                               &(NewFunction->ListEntry),
+                               Function->U.Function.Name,
+                               Function->U.Function.NameSize,
+                               NewFunction->Hash);
+
+    if (Result == FALSE) {
         goto DeclareFunctionEnd;
     }
 
     NewFunction->Node = Function;
     ShRetainNode(Function);
-    INSERT_BEFORE(&(NewFunction->ListEntry), &(Shell->FunctionList));
-    Result = TRUE;
 
 DeclareFunctionEnd:
+    if (OldNode != NULL) {
+        ShReleaseNode(OldNode);
+    }
+
     if (Result == FALSE) {
         if (NewFunction != NULL) {
             free(NewFunction);
@@ -1161,7 +1357,7 @@ Return Value:
 }
 
 BOOL
-ShCopyFunctionList (
+ShShareFunctionList (
     PSHELL Source,
     PSHELL Destination
     )
@@ -1170,16 +1366,17 @@ ShCopyFunctionList (
 
 Routine Description:
 
-    This routine copies the list of declared functions from one shell to
-    another.
+    This routine shares the declared functions of one shell with a new
+    subshell. The function table is copied the first time either shell changes
+    it.
 
 Arguments:
 
     Source - Supplies a pointer to the shell containing the function
         definitions.
 
-    Destination - Supplies a pointer to the shell where the function
-        definitions should be copied to.
+    Destination - Supplies a pointer to the new subshell, which must not have
+        any functions declared yet.
 
 Return Value:
 
@@ -1191,20 +1388,13 @@ Return Value:
 
 {
 
-    PLIST_ENTRY CurrentEntry;
-    PSHELL_FUNCTION Function;
-    BOOL Result;
-
-    CurrentEntry = Source->FunctionList.Next;
-    while (CurrentEntry != &(Source->FunctionList)) {
-        Function = LIST_VALUE(CurrentEntry, SHELL_FUNCTION, ListEntry);
-        CurrentEntry = CurrentEntry->Next;
-        Result = ShDeclareFunction(Destination, Function->Node);
-        if (Result == FALSE) {
-            return FALSE;
-        }
-    }
+    assert((Destination->Functions->Count == 0) &&
+           (Destination->Functions->ReferenceCount == 1));
 
+    ShDestroyNameTable(Destination->Functions);
+    free(Destination->Functions);
+    Destination->Functions = Source->Functions;
+    Destination->Functions->ReferenceCount += 1;
     return TRUE;
 }
 
@@ -1217,7 +1407,8 @@ ShDestroyFunctionList (
 
 Routine Description:
 
-    This routine cleans up the list of functions on the given shell.
+    This routine releases a shell's reference on its function table, cleaning
+    up the functions if no other shell is sharing them.
 
 Arguments:
 
@@ -1232,17 +1423,31 @@ Return Value:
 {
 
     PSHELL_FUNCTION Function;
+    PSHELL_NAME_TABLE Table;
+
+    Table = Shell->Functions;
+    if (Table == NULL) {
+        return;
+    }
 
-    while (LIST_EMPTY(&(Shell->FunctionList)) == FALSE) {
-        Function = LIST_VALUE(Shell->FunctionList.Next,
-                              SHELL_FUNCTION,
-                              ListEntry);
+    Shell->Functions = NULL;
 
-        LIST_REMOVE(&(Function->ListEntry));
+    assert(Table->ReferenceCount != 0);
+
+    Table->ReferenceCount -= 1;
+    if (Table->ReferenceCount != 0) {
+        return;
+    }
+
+    while (LIST_EMPTY(&(Table->List)) == FALSE) {
+        Function = LIST_VALUE(Table->List.Next, SHELL_FUNCTION, ListEntry);
+        ShNameTableRemove(Table, &(Function->ListEntry), Function->Hash);
         ShReleaseNode(Function->Node);
         free(Function);
     }
 
+    ShDestroyNameTable(Table);
+    free(Table);
     return;
 }
 
@@ -1501,7 +1706,7 @@ Return Value:
             } else {
                 ArgumentIndex += 1;
                 Argument = Arguments[ArgumentIndex];
-                ArgumentSize = strlen(Arguments[ArgumentIndex + 1]) + 1;
+                ArgumentSize = strlen(Argument) + 1;
             }
 
             Result = ShSetOptions(Shell,
@@ -1511,8 +1716,7 @@ Return Value:
                                   Set);
 
             if (Result == FALSE) {
-                PRINT_ERROR("Error: Unknown option %s.\n",
-                            Arguments[ArgumentIndex + 1]);
+                PRINT_ERROR("Error: Unknown option %s.\n", Argument);
 
                 return EINVAL;
             }
@@ -1821,7 +2025,6 @@ Return Value:
     PSHELL_EXECUTION_NODE ExecutionNode;
     PSHELL_VARIABLE ExistingVariable;
     BOOL Exported;
-    PLIST_ENTRY ListHead;
     UINTN NameSize;
     BOOL ReadOnly;
     BOOL Result;
@@ -1896,7 +2099,6 @@ Return Value:
         Exported = FALSE;
         ReadOnly = FALSE;
         Set = FALSE;
-        ListHead = &(ExecutionNode->VariableList);
         ExistingVariable = ShGetVariableInScope(Shell,
                                                 Argument,
                                                 NameSize + 1,
@@ -1925,14 +2127,14 @@ Return Value:
         // Set the new variable in the scope of the function.
         //
 
-        Result = ShSetVariableInList(ListHead,
-                                     Argument,
-                                     NameSize + 1,
-                                     Value,
-                                     ValueSize,
-                                     Exported,
-                                     ReadOnly,
-                                     Set);
+        Result = ShSetVariableInTable(&(ExecutionNode->Variables),
+                                      Argument,
+                                      NameSize + 1,
+                                      Value,
+                                      ValueSize,
+                                      Exported,
+                                      ReadOnly,
+                                      Set);
 
         if (Result == FALSE) {
             ReturnValue = 1;
@@ -1955,7 +2157,7 @@ ShGetVariableInScope (
     PSHELL Shell,
     PSTR Name,
     UINTN NameSize,
-    PLIST_ENTRY *ListHead
+    PSHELL_NAME_TABLE *Table
     )
 
 /*++
@@ -1973,8 +2175,8 @@ Routine Description:
     NameSize - Supplies the size of the name string buffer in bytes including
         the null terminator.
 
-    ListHead - Supplies an optional pointer where the head of the list where
-        the variable was found will be returned.
+    Table - Supplies an optional pointer where a pointer to the table the
+        variable was found in will be returned.
 
 Return Value:
 
@@ -1991,7 +2193,7 @@ Return Value:
     ULONG NameHash;
     PSHELL_VARIABLE Variable;
 
-    NameHash = ShHashName(Name, NameSize);
+    NameHash = SwHashString(Name, NameSize);
 
     //
     // Look through each element on the stack (starting with the newest) to
@@ -2005,18 +2207,18 @@ Return Value:
                                    ListEntry);
 
         CurrentEntry = CurrentEntry->Next;
-        if (LIST_EMPTY(&(ExecutionNode->VariableList)) != FALSE) {
+        if (ExecutionNode->Variables.Count == 0) {
             continue;
         }
 
-        Variable = ShGetVariableInList(&(ExecutionNode->VariableList),
-                                       Name,
-                                       NameSize,
-                                       NameHash);
+        Variable = ShGetVariableInTable(&(ExecutionNode->Variables),
+                                        Name,
+                                        NameSize,
+                                        NameHash);
 
         if (Variable != NULL) {
-            if (ListHead != NULL) {
-                *ListHead = &(ExecutionNode->VariableList);
+            if (Table != NULL) {
+                *Table = &(ExecutionNode->Variables);
             }
 
             return Variable;
@@ -2027,14 +2229,14 @@ Return Value:
     // Try the shell itself.
     //
 
-    Variable = ShGetVariableInList(&(Shell->VariableList),
-                                   Name,
-                                   NameSize,
-                                   NameHash);
+    Variable = ShGetVariableInTable(Shell->Variables,
+                                    Name,
+                                    NameSize,
+                                    NameHash);
 
     if (Variable != NULL) {
-        if (ListHead != NULL) {
-            *ListHead = &(Shell->VariableList);
+        if (Table != NULL) {
+            *Table = Shell->Variables;
         }
     }
 
@@ -2042,8 +2244,8 @@ Return Value:
 }
 
 PSHELL_VARIABLE
-ShGetVariableInList (
-    PLIST_ENTRY ListHead,
+ShGetVariableInTable (
+    PSHELL_NAME_TABLE Table,
     PSTR Name,
     UINTN NameSize,
     ULONG NameHash
@@ -2053,12 +2255,12 @@ ShGetVariableInList (
 
 Routine Description:
 
-    This routine gets the value of the given environment variable searching
-    through a list of environment variable structures.
+    This routine gets the given environment variable from a table of
+    variables.
 
 Arguments:
 
-    ListHead - Supplies a pointer to the head of hte list to search.
+    Table - Supplies a pointer to the table to search.
 
     Name - Supplies a pointer to the string of the name of the variable to get.
 
@@ -2077,36 +2279,21 @@ Return Value:
 
 {
 
-    PLIST_ENTRY CurrentEntry;
-    PSHELL_VARIABLE Variable;
+    PLIST_ENTRY Entry;
 
     assert(NameSize > 1);
 
-    //
-    // Look through each variable and try to match.
-    //
-
-    CurrentEntry = ListHead->Next;
-    while (CurrentEntry != ListHead) {
-        Variable = LIST_VALUE(CurrentEntry, SHELL_VARIABLE, ListEntry);
-        CurrentEntry = CurrentEntry->Next;
-        if (Variable->Hash != NameHash) {
-            continue;
-        }
-
-        if ((strncmp(Name, Variable->Name, NameSize - 1) == 0) &&
-            (Variable->Name[NameSize - 1] == '\0')) {
-
-            return Variable;
-        }
+    Entry = ShNameTableLookup(Table, Name, NameSize, NameHash);
+    if (Entry == NULL) {
+        return NULL;
     }
 
-    return NULL;
+    return LIST_VALUE(Entry, SHELL_VARIABLE, ListEntry);
 }
 
 BOOL
-ShSetVariableInList (
-    PLIST_ENTRY ListHead,
+ShSetVariableInTable (
+    PSHELL_NAME_TABLE Table,
     PSTR Name,
     UINTN NameSize,
     PSTR Value,
@@ -2120,12 +2307,12 @@ ShSetVariableInList (
 
 Routine Description:
 
-    This routine sets an environment variable in the given list (of either a
+    This routine sets an environment variable in the given table (of either a
     node or a shell).
 
 Arguments:
 
-    ListHead - Supplies the head of the list of environment variables to add
+    Table - Supplies a pointer to the table of environment variables to add
         this one to.
 
     Name - Supplies a pointer to the string of the name of the variable to set.
@@ -2187,17 +2374,17 @@ Return Value:
         Result = ShFixUpPath(&ValueCopy, &PathSize);
         ValueSize = PathSize;
         if (Result == FALSE) {
-            goto SetVariableInListEnd;
+            goto SetVariableInTableEnd;
         }
     }
 
-    NameHash = ShHashName(Name, NameSize);
+    NameHash = SwHashString(Name, NameSize);
 
     //
-    // Look to see if the variable is already set in the list.
+    // Look to see if the variable is already set in the table.
     //
 
-    Variable = ShGetVariableInList(ListHead, Name, NameSize, NameHash);
+    Variable = ShGetVariableInTable(Table, Name, NameSize, NameHash);
     if (Variable != NULL) {
 
         //
@@ -2207,7 +2394,7 @@ Return Value:
         if (Variable->ReadOnly != FALSE) {
             PRINT_ERROR("Variable %s is read-only.\n", Variable->Name);
             Result = FALSE;
-            goto SetVariableInListEnd;
+            goto SetVariableInTableEnd;
         }
 
         //
@@ -2238,11 +2425,11 @@ Return Value:
 
         ValueCopy = NULL;
         Result = TRUE;
-        goto SetVariableInListEnd;
+        goto SetVariableInTableEnd;
     }
 
     //
-    // The variable doesn't exist, at least not on this list. Create it.
+    // The variable doesn't exist, at least not in this table. Create it.
     //
 
     Variable = ShCreateVariable(Name,
@@ -2256,13 +2443,22 @@ Return Value:
 
     if (Variable == NULL) {
         Result = FALSE;
-        goto SetVariableInListEnd;
+        goto SetVariableInTableEnd;
     }
 
-    INSERT_BEFORE(&(Variable->ListEntry), ListHead);
-    Result = TRUE;
+    Result = ShNameTableInsert(Table,
+                               &(Variable->ListEntry),
+                               Variable->Name,
+                               Variable->NameSize,
+                               Variable->Hash);
+
+    if (Result == FALSE) {
+        Variable->ListEntry.Next = NULL;
+        ShDestroyVariable(Variable, FALSE);
+        Variable = NULL;
+    }
 
-SetVariableInListEnd:
+SetVariableInTableEnd:
     if (Result != FALSE) {
 
         assert(Variable != NULL);
@@ -2402,26 +2598,25 @@ Return Value:
 }
 
 BOOL
-ShCopyVariablesOnList (
-    PLIST_ENTRY Source,
-    PLIST_ENTRY Destination
+ShCopyVariablesInTable (
+    PSHELL_NAME_TABLE Source,
+    PSHELL_NAME_TABLE Destination
     )
 
 /*++
 
 Routine Description:
 
-    This routine copies all the variables from one list to another. Any
-    variables with conflicting names already on the destination list will be
+    This routine copies all the variables from one table to another. Any
+    variables with conflicting names already in the destination table will be
     overwritten.
 
 Arguments:
 
-    Source - Supplies a pointer to the head of the list containing the
-        variables to copy.
+    Source - Supplies a pointer to the table containing the variables to copy.
 
-    Destination - Supplies a pointer to the head of the list where the copies
-        will be put.
+    Destination - Supplies a pointer to the table where the copies will be
+        put.
 
 Return Value:
 
@@ -2437,11 +2632,11 @@ Return Value:
     BOOL Result;
     PSHELL_VARIABLE Variable;
 
-    CurrentEntry = Source->Next;
-    while (CurrentEntry != Source) {
+    CurrentEntry = Source->List.Next;
+    while (CurrentEntry != &(Source->List)) {
         Variable = LIST_VALUE(CurrentEntry, SHELL_VARIABLE, ListEntry);
         CurrentEntry = CurrentEntry->Next;
-        Result = ShSetVariableInList(Destination,
+        Result = ShSetVariableInTable(Destination,
                                      Variable->Name,
                                      Variable->NameSize,
                                      Variable->Value,
@@ -2458,6 +2653,211 @@ Return Value:
     return TRUE;
 }
 
+BOOL
+ShUnshareVariables (
+    PSHELL Shell
+    )
+
+/*++
+
+Routine Description:
+
+    This routine makes sure a shell has a private variable table it can
+    change, copying the table if it is shared with another shell.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell about to change its variables.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on allocation failure, in which case the shell still shares its
+    table.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    BOOL Result;
+    PSHELL_VARIABLE Source;
+    PSHELL_NAME_TABLE Table;
+    PSHELL_VARIABLE Variable;
+
+    if (Shell->Variables->ReferenceCount == 1) {
+        return TRUE;
+    }
+
+    Table = ShCreateNameTable();
+    if (Table == NULL) {
+        return FALSE;
+    }
+
+    //
+    // The copies are created directly since the environment already matches
+    // the shared table. Exported copies remember the shared value as their
+    // original, which is what the environment should go back to when this
+    // shell is done with them.
+    //
+
+    CurrentEntry = Shell->Variables->List.Next;
+    while (CurrentEntry != &(Shell->Variables->List)) {
+        Source = LIST_VALUE(CurrentEntry, SHELL_VARIABLE, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        Variable = ShCreateVariable(Source->Name,
+                                    Source->NameSize,
+                                    Source->Hash,
+                                    Source->Value,
+                                    Source->ValueSize,
+                                    FALSE,
+                                    Source->ReadOnly,
+                                    Source->Set);
+
+        if (Variable == NULL) {
+            Result = FALSE;
+            goto UnshareVariablesEnd;
+        }
+
+        Result = ShNameTableInsert(Table,
+                                   &(Variable->ListEntry),
+                                   Variable->Name,
+                                   Variable->NameSize,
+                                   Variable->Hash);
+
+        if (Result == FALSE) {
+            Variable->ListEntry.Next = NULL;
+            ShDestroyVariable(Variable, FALSE);
+            goto UnshareVariablesEnd;
+        }
+
+        if (Source->Exported != FALSE) {
+            Variable->Exported = TRUE;
+            if (Source->Value != NULL) {
+                Variable->OriginalValue = SwStringDuplicate(Source->Value,
+                                                            Source->ValueSize);
+
+                if (Variable->OriginalValue == NULL) {
+                    Result = FALSE;
+                    goto UnshareVariablesEnd;
+                }
+
+                Variable->OriginalValueSize = Source->ValueSize;
+            }
+        }
+    }
+
+    Shell->Variables->ReferenceCount -= 1;
+    Shell->Variables = Table;
+    Table = NULL;
+    Result = TRUE;
+
+UnshareVariablesEnd:
+    if (Table != NULL) {
+        while (LIST_EMPTY(&(Table->List)) == FALSE) {
+            Variable = LIST_VALUE(Table->List.Next, SHELL_VARIABLE, ListEntry);
+            ShNameTableRemove(Table, &(Variable->ListEntry), Variable->Hash);
+            Variable->ListEntry.Next = NULL;
+            ShDestroyVariable(Variable, FALSE);
+        }
+
+        ShDestroyNameTable(Table);
+        free(Table);
+    }
+
+    return Result;
+}
+
+BOOL
+ShUnshareFunctions (
+    PSHELL Shell
+    )
+
+/*++
+
+Routine Description:
+
+    This routine makes sure a shell has a private function table it can
+    change, copying the table if it is shared with another shell.
+
+Arguments:
+
+    Shell - Supplies a pointer to the shell about to change its functions.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on allocation failure, in which case the shell still shares its
+    table.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PSHELL_FUNCTION Function;
+    PSHELL_FUNCTION NewFunction;
+    BOOL Result;
+    PSHELL_NAME_TABLE Table;
+
+    if (Shell->Functions->ReferenceCount == 1) {
+        return TRUE;
+    }
+
+    Table = ShCreateNameTable();
+    if (Table == NULL) {
+        return FALSE;
+    }
+
+    CurrentEntry = Shell->Functions->List.Next;
+    while (CurrentEntry != &(Shell->Functions->List)) {
+        Function = LIST_VALUE(CurrentEntry, SHELL_FUNCTION, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        NewFunction = malloc(sizeof(SHELL_FUNCTION));
+        if (NewFunction == NULL) {
+            Result = FALSE;
+            goto UnshareFunctionsEnd;
+        }
+
+        NewFunction->Hash = Function->Hash;
+        NewFunction->Node = Function->Node;
+        Result = ShNameTableInsert(Table,
+                                   &(NewFunction->ListEntry),
+                                   Function->Node->U.Function.Name,
+                                   Function->Node->U.Function.NameSize,
+                                   NewFunction->Hash);
+
+        if (Result == FALSE) {
+            free(NewFunction);
+            goto UnshareFunctionsEnd;
+        }
+
+        ShRetainNode(NewFunction->Node);
+    }
+
+    Shell->Functions->ReferenceCount -= 1;
+    Shell->Functions = Table;
+    Table = NULL;
+    Result = TRUE;
+
+UnshareFunctionsEnd:
+    if (Table != NULL) {
+        while (LIST_EMPTY(&(Table->List)) == FALSE) {
+            Function = LIST_VALUE(Table->List.Next, SHELL_FUNCTION, ListEntry);
+            ShNameTableRemove(Table, &(Function->ListEntry), Function->Hash);
+            ShReleaseNode(Function->Node);
+            free(Function);
+        }
+
+        ShDestroyNameTable(Table);
+        free(Table);
+    }
+
+    return Result;
+}
+
 VOID
 ShDestroyVariable (
     PSHELL_VARIABLE Variable,
@@ -2542,29 +2942,30 @@ Return Value:
 {
 
     BOOL Result;
-    LIST_ENTRY VariableList;
+    SHELL_NAME_TABLE Variables;
 
     //
-    // Create a copy of the variable list in the current shell, which sorts out
-    // de-duping and scope.
+    // Create a copy of the variable table in the current shell, which sorts
+    // out de-duping and scope.
     //
 
-    INITIALIZE_LIST_HEAD(&VariableList);
-    Result = ShCopyVariables(Shell, &VariableList);
+    ShInitializeNameTable(&Variables);
+    Result = ShCopyVariables(Shell, &Variables);
     if (Result == FALSE) {
         PRINT_ERROR("Could not create variable list.\n");
+        ShDestroyVariableTable(&Variables);
         return;
     }
 
-    ShPrintVariablesInList(Shell, &VariableList, Exported, ReadOnly);
-    ShDestroyVariableList(&VariableList);
+    ShPrintVariablesInTable(Shell, &Variables, Exported, ReadOnly);
+    ShDestroyVariableTable(&Variables);
     return;
 }
 
 VOID
-ShPrintVariablesInList (
+ShPrintVariablesInTable (
     PSHELL Shell,
-    PLIST_ENTRY ListHead,
+    PSHELL_NAME_TABLE Table,
     BOOL Exported,
     BOOL ReadOnly
     )
@@ -2573,14 +2974,14 @@ ShPrintVariablesInList (
 
 Routine Description:
 
-    This routine prints all the variables in the given list, skipping the ones
-    that already exist in a more local contest.
+    This routine prints all the variables in the given table, in the order
+    they were added.
 
 Arguments:
 
     Shell - Supplies a pointer to the shell.
 
-    ListHead - Supplies the head of the list of variables to print.
+    Table - Supplies a pointer to the table of variables to print.
 
     Exported - Supplies a boolean indicating if only exported variables should
         be printed.
@@ -2602,8 +3003,8 @@ Return Value:
     BOOL Result;
     PSHELL_VARIABLE Variable;
 
-    CurrentEntry = ListHead->Next;
-    while (CurrentEntry != ListHead) {
+    CurrentEntry = Table->List.Next;
+    while (CurrentEntry != &(Table->List)) {
         Variable = LIST_VALUE(CurrentEntry, SHELL_VARIABLE, ListEntry);
         CurrentEntry = CurrentEntry->Next;
 
@@ -2806,52 +3207,3 @@ Return Value:
     return ReturnValue;
 }
 
-ULONG
-ShHashName (
-    PSTR Name,
-    UINTN NameSize
-    )
-
-/*++
-
-Routine Description:
-
-    This routine hashes a variable name. For those paying close attention,
-    this happens to be same hash function as the ELF image format.
-
-Arguments:
-
-    Name - Supplies a pointer to the name to hash.
-
-    NameSize - Supplies the size to hash.
-
-Return Value:
-
-    Returns the hash of the name.
-
---*/
-
-{
-
-    ULONG Hash;
-    ULONG Temporary;
-
-    assert(NameSize != 0);
-
-    NameSize -= 1;
-    Hash = 0;
-    while (NameSize != 0) {
-        Hash = (Hash << 4) + *Name;
-        Temporary = Hash & 0xF0000000;
-        if (Temporary != 0) {
-            Hash ^= Temporary >> 24;
-        }
-
-        Hash &= ~Temporary;
-        Name += 1;
-        NameSize -= 1;
-    }
-
-    return Hash;
-}
-
@@ -34,9 +34,11 @@ Module Name:
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "swlib.h"
@@ -49,7 +51,8 @@ Module Name:
 #define SORT_VERSION_MINOR 0
 
 #define SORT_USAGE                                                             \
-    "usage: sort [-m][-o output][-bdfinru][-t char][-k keydef]... [file...]\n" \
+    "usage: sort [-m][-o output][-bdfinru][-t char][-k keydef]... "          \
+    "[-S size][-T dir] [file...]\n"                                            \
     "       sort -c [-bdfinru][-t char][-k keydef][file]\n\n"                  \
     "The sort utility either sorts all lines in a file, merges line of all \n" \
     "the named (presorted) files together, or checks to see if a single \n"    \
@@ -84,10 +87,18 @@ Module Name:
     "        flag meaning to that specific field.\n"                           \
     "  -t, --field-separator <character> -- Use the given character as a \n"   \
     "        field separator.\n"                                               \
+    "  -S, --buffer-size <size> -- Set the amount of memory used to hold \n"  \
+    "        lines. Larger inputs are sorted in pieces using temporary \n"     \
+    "        files. Plain numbers are in kilobytes, and K, M, and G \n"        \
+    "        suffixes are accepted.\n"                                         \
+    "  -T, --temporary-directory <dir> -- Create temporary files in the \n"   \
+    "        given directory rather than $TMPDIR or /tmp.\n"                   \
+    "  --parallel=<count> -- Sort using the given number of threads. The \n"  \
+    "        default is the number of processors.\n"                          \
     "  file -- Supplies the input file to sort. If no file is supplied or \n"  \
     "        the file is -, then use stdin.\n\n"
 
-#define SORT_OPTIONS_STRING "cmo:udfinrbk:t:"
+#define SORT_OPTIONS_STRING "cmo:udfinrbk:t:S:T:"
 
 //
 // Set this option to ignore leading blanks in comparisons.
@@ -148,6 +159,70 @@ Module Name:
 #define SORT_INITIAL_ELEMENT_COUNT 32
 #define SORT_INITIAL_STRING_SIZE 32
 
+//
+// Define the default amount of memory to fill with lines before spilling
+// sorted runs out to temporary files.
+//
+
+#define SORT_DEFAULT_BUFFER_SIZE (256ULL * 1024ULL * 1024ULL)
+
+//
+// Define the size of each block of the arena that input lines are allocated
+// from.
+//
+
+#define SORT_ARENA_BLOCK_SIZE (1024 * 1024)
+
+//
+// Define the maximum number of temporary files merged at once. If there are
+// more runs than this, they are merged in several passes.
+//
+
+#define SORT_MAXIMUM_MERGE_INPUTS 64
+
+//
+// Define the number of times to try creating a uniquely named temporary file.
+//
+
+#define SORT_TEMPORARY_TRY_COUNT 100
+
+//
+// Define the environment variable consulted for the temporary directory, and
+// the directory used if it is not set.
+//
+
+#define SORT_TEMPORARY_DIRECTORY_VARIABLE "TMPDIR"
+#define SORT_DEFAULT_TEMPORARY_DIRECTORY "/tmp"
+
+//
+// Define the maximum number of threads to sort with, and the minimum number
+// of lines each thread should get to make starting it worthwhile.
+//
+
+#define SORT_MAXIMUM_THREADS 256
+#define SORT_MINIMUM_THREAD_LINES 4096
+
+//
+// Define the number of lines at or below which the merge sort switches to an
+// insertion sort.
+//
+
+#define SORT_INSERTION_SORT_SIZE 8
+
+//
+// Define the bit flipped in a numeric key to make it compare correctly as an
+// unsigned prefix.
+//
+
+#define SORT_PREFIX_SIGN_BIT (1ULL << 63)
+
+//
+// Define the bit flipped in each character packed into a prefix, since
+// characters compare as signed values.
+//
+
+#define SORT_PREFIX_CHARACTER_BIAS 0x80
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -199,6 +274,31 @@ typedef struct _SORT_ARRAY {
 
 /*++
 
+Structure Description:
+
+    This structure defines the portion of a line covered by one sort key,
+    computed once when the line is read.
+
+Members:
+
+    Start - Stores the offset of the first character of the key, after any
+        leading blanks are skipped.
+
+    End - Stores the offset just past the last character of the key.
+
+    Value - Stores the numeric value of the key if the key is compared
+        numerically.
+
+--*/
+
+typedef struct _SORT_LINE_KEY {
+    ULONG Start;
+    ULONG End;
+    LONG Value;
+} SORT_LINE_KEY, *PSORT_LINE_KEY;
+
+/*++
+
 Structure Description:
 
     This structure defines a mutable string in the sort utility.
@@ -212,12 +312,22 @@ Structure Description:
 
     Capacity - Supplies the size of the buffer allocation.
 
+    Prefix - Stores the first several comparison characters of the first key
+        (or its numeric value) packed so that comparing two prefixes as
+        integers gives the same order as comparing the lines, unless the
+        prefixes are equal.
+
+    Keys - Stores an optional pointer to the array of precomputed key spans,
+        one for each sort key. Only input lines have these.
+
 --*/
 
 typedef struct _SORT_STRING {
     PSTR Data;
     UINTN Size;
     UINTN Capacity;
+    ULONGLONG Prefix;
+    PSORT_LINE_KEY Keys;
 } SORT_STRING, *PSORT_STRING;
 
 /*++
@@ -233,11 +343,17 @@ Structure Description:
 
     Line - Stores a pointer to the string containing the most recent line.
 
+    TemporaryPath - Stores the path of the temporary file backing this input
+        if it is a sorted run created by the sort utility itself. The file is
+        deleted when the input is destroyed. Lines in these files are read
+        back exactly as they were written.
+
 --*/
 
 typedef struct _SORT_INPUT {
     FILE *File;
     PSORT_STRING Line;
+    PSTR TemporaryPath;
 } SORT_INPUT, *PSORT_INPUT;
 
 /*++
@@ -294,6 +410,23 @@ Structure Description:
     Separator - Stores the field separator character, or -1 if none was
         supplied.
 
+    BufferSize - Stores the number of bytes of lines to hold in memory before
+        writing a sorted run out to a temporary file.
+
+    BufferUsed - Stores the approximate number of bytes currently used by
+        lines held in memory.
+
+    TemporaryDirectory - Stores the directory to create temporary files in.
+
+    TemporaryCount - Stores the number of temporary files created, used to
+        generate unique names.
+
+    ThreadCount - Stores the maximum number of threads to sort with.
+
+    LineArena - Stores a pointer to the arena that lines being sorted in
+        memory are allocated from. The arena is reset each time a run is
+        written out.
+
 --*/
 
 typedef struct _SORT_CONTEXT {
@@ -302,8 +435,52 @@ typedef struct _SORT_CONTEXT {
     ULONG Options;
     PSTR Output;
     INT Separator;
+    ULONGLONG BufferSize;
+    ULONGLONG BufferUsed;
+    PSTR TemporaryDirectory;
+    ULONG TemporaryCount;
+    ULONG ThreadCount;
+    PSWISS_ARENA LineArena;
 } SORT_CONTEXT, *PSORT_CONTEXT;
 
+/*++
+
+Structure Description:
+
+    This structure defines a unit of work handed to a sorting thread. It
+    either sorts one range of lines, or merges two sorted ranges.
+
+Members:
+
+    Sort - Stores a boolean indicating whether to sort the left range in place
+        (TRUE) or merge the left and right ranges (FALSE).
+
+    Left - Stores a pointer to the first range of lines.
+
+    LeftCount - Stores the number of lines in the first range.
+
+    Right - Stores a pointer to the second range of lines when merging.
+
+    RightCount - Stores the number of lines in the second range.
+
+    Destination - Stores a pointer where merged lines are written, or the
+        scratch space to use when sorting.
+
+    Thread - Stores the handle of the thread running this item, or NULL if
+        it ran on the calling thread.
+
+--*/
+
+typedef struct _SORT_WORK_ITEM {
+    BOOL Sort;
+    PVOID *Left;
+    UINTN LeftCount;
+    PVOID *Right;
+    UINTN RightCount;
+    PVOID *Destination;
+    PVOID Thread;
+} SORT_WORK_ITEM, *PSORT_WORK_ITEM;
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
@@ -317,9 +494,91 @@ SortCheckFile (
 INT
 SortMergeSortedFiles (
     PSORT_CONTEXT Context,
+    PSORT_ARRAY Inputs,
+    FILE *Output
+    );
+
+VOID
+SortSiftDown (
+    PSORT_ARRAY Inputs,
+    PUINTN Heap,
+    UINTN HeapSize,
+    UINTN Index
+    );
+
+INT
+SortWriteRun (
+    PSORT_CONTEXT Context,
+    PSORT_ARRAY Lines,
+    PSORT_ARRAY Runs
+    );
+
+INT
+SortMergeRuns (
+    PSORT_CONTEXT Context,
+    PSORT_ARRAY Runs,
     FILE *Output
     );
 
+INT
+SortOpenRuns (
+    PSORT_ARRAY Runs
+    );
+
+INT
+SortSortLines (
+    PSORT_CONTEXT Context,
+    PSORT_ARRAY Lines
+    );
+
+VOID
+SortRunWorkItems (
+    PSORT_WORK_ITEM Items,
+    UINTN Count
+    );
+
+VOID
+SortWorkItemThread (
+    PVOID Parameter
+    );
+
+VOID
+SortMergeSortLines (
+    PVOID *Lines,
+    PVOID *Scratch,
+    UINTN Count
+    );
+
+VOID
+SortMergeLineRanges (
+    PVOID *Left,
+    UINTN LeftCount,
+    PVOID *Right,
+    UINTN RightCount,
+    PVOID *Destination
+    );
+
+UINTN
+SortFindMergeSplit (
+    PVOID *Left,
+    UINTN LeftCount,
+    PVOID *Right,
+    UINTN RightCount,
+    UINTN Diagonal
+    );
+
+INT
+SortCreateTemporaryInput (
+    PSORT_CONTEXT Context,
+    PSORT_INPUT *NewInput
+    );
+
+INT
+SortWriteLine (
+    FILE *Output,
+    PSORT_STRING Line
+    );
+
 INT
 SortCompareLines (
     const VOID *LeftPointer,
@@ -330,10 +589,18 @@ INT
 SortReadLine (
     PSORT_CONTEXT Context,
     PSORT_INPUT Input,
+    PSWISS_ARENA Arena,
     PSORT_STRING Holding,
     PSORT_STRING *String
     );
 
+INT
+SortComputeLineKeys (
+    PSORT_CONTEXT Context,
+    PSWISS_ARENA Arena,
+    PSORT_STRING Line
+    );
+
 INT
 SortAddInputFile (
     PSORT_CONTEXT Context,
@@ -366,6 +633,7 @@ SortStringAddCharacter (
 
 PSORT_STRING
 SortCreateString (
+    PSWISS_ARENA Arena,
     PSTR InitialData,
     UINTN InitialDataSize
     );
@@ -426,6 +694,9 @@ struct option SortLongOptions[] = {
     {"ignore-leading-blanks", no_argument, 0, 'b'},
     {"key", required_argument, 0, 'k'},
     {"field-separator", required_argument, 0, 't'},
+    {"buffer-size", required_argument, 0, 'S'},
+    {"temporary-directory", required_argument, 0, 'T'},
+    {"parallel", required_argument, 0, 'P'},
     {"help", no_argument, 0, 'h'},
     {"version", no_argument, 0, 'V'},
     {NULL, 0, 0, 0}
@@ -462,6 +733,7 @@ Return Value:
 
 {
 
+    PSTR AfterScan;
     PSTR Argument;
     ULONG ArgumentIndex;
     SORT_CONTEXT Context;
@@ -476,14 +748,18 @@ Return Value:
     INT Option;
     FILE *Output;
     PSORT_STRING PreviousLine;
+    SORT_ARRAY Runs;
     INT Status;
+    LONG ThreadCount;
 
     Input = NULL;
     InputLine = NULL;
     memset(&Context, 0, sizeof(SORT_CONTEXT));
     memset(&InputString, 0, sizeof(SORT_STRING));
     memset(&InputLines, 0, sizeof(SORT_ARRAY));
+    memset(&Runs, 0, sizeof(SORT_ARRAY));
     Context.Separator = -1;
+    Context.BufferSize = SORT_DEFAULT_BUFFER_SIZE;
     Output = NULL;
 
     //
@@ -629,6 +905,68 @@ Return Value:
 
             break;
 
+        case 'S':
+            Argument = optarg;
+
+            assert(Argument != NULL);
+
+            //
+            // Don't let strtoull quietly wrap a negative size around.
+            //
+
+            if (!isdigit(*Argument)) {
+                SwPrintError(0, Argument, "Invalid buffer size");
+                return 2;
+            }
+
+            Context.BufferSize = SwParseFileSize(Argument);
+            if ((Context.BufferSize == -1ULL) || (Context.BufferSize == 0)) {
+                SwPrintError(0, Argument, "Invalid buffer size");
+                return 2;
+            }
+
+            //
+            // A plain number is in kilobytes.
+            //
+
+            if (isdigit(Argument[strlen(Argument) - 1])) {
+                if (Context.BufferSize > (-1ULL / 1024ULL)) {
+                    SwPrintError(0, Argument, "Invalid buffer size");
+                    return 2;
+                }
+
+                Context.BufferSize *= 1024ULL;
+            }
+
+            break;
+
+        case 'T':
+            Context.TemporaryDirectory = optarg;
+
+            assert(Context.TemporaryDirectory != NULL);
+
+            break;
+
+        case 'P':
+            Argument = optarg;
+
+            assert(Argument != NULL);
+
+            ThreadCount = strtol(Argument, &AfterScan, 10);
+            if ((AfterScan == Argument) || (*AfterScan != '\0') ||
+                (ThreadCount <= 0)) {
+
+                SwPrintError(0, Argument, "Invalid thread count");
+                return 2;
+            }
+
+            if (ThreadCount > SORT_MAXIMUM_THREADS) {
+                ThreadCount = SORT_MAXIMUM_THREADS;
+            }
+
+            Context.ThreadCount = ThreadCount;
+            break;
+
         case 'V':
             SwPrintVersion(SORT_VERSION_MAJOR, SORT_VERSION_MINOR);
             return 1;
@@ -686,6 +1024,27 @@ Return Value:
         }
     }
 
+    if (Context.TemporaryDirectory == NULL) {
+        Context.TemporaryDirectory = getenv(SORT_TEMPORARY_DIRECTORY_VARIABLE);
+        if ((Context.TemporaryDirectory == NULL) ||
+            (*(Context.TemporaryDirectory) == '\0')) {
+
+            Context.TemporaryDirectory = SORT_DEFAULT_TEMPORARY_DIRECTORY;
+        }
+    }
+
+    if (Context.ThreadCount == 0) {
+        ThreadCount = SwGetProcessorCount(TRUE);
+        if (ThreadCount <= 0) {
+            ThreadCount = 1;
+
+        } else if (ThreadCount > SORT_MAXIMUM_THREADS) {
+            ThreadCount = SORT_MAXIMUM_THREADS;
+        }
+
+        Context.ThreadCount = ThreadCount;
+    }
+
     //
     // Copy in the global flags to the key flags to avoid extra work during
     // compares.
@@ -729,12 +1088,20 @@ Return Value:
         goto MainEnd;
 
     } else if ((Context.Options & SORT_OPTION_MERGE_ONLY) != 0) {
-        Status = SortMergeSortedFiles(&Context, Output);
+        Status = SortMergeSortedFiles(&Context, &(Context.Input), Output);
+        goto MainEnd;
+    }
+
+    Context.LineArena = SwCreateArena(SORT_ARENA_BLOCK_SIZE);
+    if (Context.LineArena == NULL) {
+        Status = ENOMEM;
         goto MainEnd;
     }
 
     //
-    // This is the real sort, not merge or check. Read in all inputs.
+    // This is the real sort, not merge or check. Read in all inputs. If the
+    // lines fill up the buffer, sort what's there so far and write it out to
+    // a temporary file.
     //
 
     for (InputIndex = 0; InputIndex < Context.Input.Size; InputIndex += 1) {
@@ -742,6 +1109,7 @@ Return Value:
         while (TRUE) {
             Status = SortReadLine(&Context,
                                   Input,
+                                  Context.LineArena,
                                   &InputString,
                                   &InputLine);
 
@@ -756,12 +1124,43 @@ Return Value:
 
             Status = SortArrayAddElement(&InputLines, InputLine);
             if (Status != 0) {
-                SortDestroyString(InputLine);
                 goto MainEnd;
             }
 
+            //
+            // Charge for the string, its data, its keys, and its pointer in
+            // both the line array and the scratch array used while sorting.
+            //
+
+            Context.BufferUsed += sizeof(SORT_STRING) + (sizeof(PVOID) * 2) +
+                                  InputLine->Capacity +
+                                  (Context.Key.Size * sizeof(SORT_LINE_KEY));
+
             InputLine = NULL;
+            if (Context.BufferUsed >= Context.BufferSize) {
+                Status = SortWriteRun(&Context, &InputLines, &Runs);
+                if (Status != 0) {
+                    goto MainEnd;
+                }
+            }
+        }
+    }
+
+    //
+    // If some runs went out to temporary files, write out the remainder and
+    // merge them all together.
+    //
+
+    if (Runs.Size != 0) {
+        if (InputLines.Size != 0) {
+            Status = SortWriteRun(&Context, &InputLines, &Runs);
+            if (Status != 0) {
+                goto MainEnd;
+            }
         }
+
+        Status = SortMergeRuns(&Context, &Runs, Output);
+        goto MainEnd;
     }
 
     if (InputLines.Size == 0) {
@@ -773,7 +1172,11 @@ Return Value:
     // Do it, sort the arrays.
     //
 
-    qsort(InputLines.Data, InputLines.Size, sizeof(PVOID), SortCompareLines);
+    Status = SortSortLines(&Context, &InputLines);
+    if (Status != 0) {
+        SwPrintError(Status, NULL, "Failed to sort");
+        goto MainEnd;
+    }
 
     //
     // Write all the lines to the output.
@@ -792,7 +1195,11 @@ Return Value:
             (PreviousLine == NULL) ||
             (SortCompareLines(&PreviousLine, &InputLine) != 0)) {
 
-            fprintf(Output, "%s\n", InputLine->Data);
+            Status = SortWriteLine(Output, InputLine);
+            if (Status != 0) {
+                SwPrintError(Status, NULL, "Failed to write output");
+                goto MainEnd;
+            }
         }
 
         PreviousLine = InputLine;
@@ -814,8 +1221,13 @@ Return Value:
         free(InputString.Data);
     }
 
-    SortDestroyArray(&InputLines,
-                     (PSORT_DESTROY_ARRAY_ELEMENT_ROUTINE)SortDestroyString);
+    SortDestroyArray(&InputLines, NULL);
+    if (Context.LineArena != NULL) {
+        SwDestroyArena(Context.LineArena);
+    }
+
+    SortDestroyArray(&Runs,
+                     (PSORT_DESTROY_ARRAY_ELEMENT_ROUTINE)SortDestroyInput);
 
     if ((Status != 0) && (Status != 1)) {
         SwPrintError(Status, NULL, "Sort exiting abnormally");
@@ -870,6 +1282,7 @@ Return Value:
     while (TRUE) {
         Status = SortReadLine(Context,
                               Input,
+                              NULL,
                               &WorkingBuffer,
                               &Line);
 
@@ -903,166 +1316,1209 @@ Return Value:
         Line = NULL;
     }
 
-    Status = 0;
+    Status = 0;
+
+CheckFileEnd:
+    if (WorkingBuffer.Data != NULL) {
+        free(WorkingBuffer.Data);
+    }
+
+    if (Line != NULL) {
+        SortDestroyString(Line);
+    }
+
+    if (PreviousLine != NULL) {
+        SortDestroyString(PreviousLine);
+    }
+
+    return Status;
+}
+
+INT
+SortMergeSortedFiles (
+    PSORT_CONTEXT Context,
+    PSORT_ARRAY Inputs,
+    FILE *Output
+    )
+
+/*++
+
+Routine Description:
+
+    This routine merges several files that are already in order. The inputs
+    are kept in a heap ordered by their current line, so each output line
+    costs a logarithmic number of comparisons. Equal lines come out in input
+    order.
+
+Arguments:
+
+    Context - Supplies a pointer to the application context.
+
+    Inputs - Supplies a pointer to the array of inputs to merge.
+
+    Output - Supplies a pointer to the output file to write to.
+
+Return Value:
+
+    0 on success.
+
+    Non-zero on failure.
+
+--*/
+
+{
+
+    PUINTN Heap;
+    UINTN HeapIndex;
+    UINTN HeapSize;
+    PSORT_INPUT Input;
+    UINTN InputIndex;
+    PSORT_STRING PreviousWinner;
+    INT Status;
+    PSORT_INPUT Winner;
+    SORT_STRING WorkingBuffer;
+
+    PreviousWinner = NULL;
+    memset(&WorkingBuffer, 0, sizeof(SORT_STRING));
+    Heap = malloc((Inputs->Size + 1) * sizeof(UINTN));
+    if (Heap == NULL) {
+        Status = ENOMEM;
+        goto MergeSortedFilesEnd;
+    }
+
+    //
+    // Prime all the inputs by reading their first lines.
+    //
+
+    HeapSize = 0;
+    for (InputIndex = 0; InputIndex < Inputs->Size; InputIndex += 1) {
+        Input = Inputs->Data[InputIndex];
+        Status = SortReadLine(Context,
+                              Input,
+                              NULL,
+                              &WorkingBuffer,
+                              &(Input->Line));
+
+        if (Status != 0) {
+            SwPrintError(Status, NULL, "Failed to read file");
+            goto MergeSortedFilesEnd;
+        }
+
+        if (Input->Line != NULL) {
+            Heap[HeapSize] = InputIndex;
+            HeapSize += 1;
+        }
+    }
+
+    HeapIndex = HeapSize / 2;
+    while (HeapIndex != 0) {
+        HeapIndex -= 1;
+        SortSiftDown(Inputs, Heap, HeapSize, HeapIndex);
+    }
+
+    //
+    // Loop getting the winning line until all files are drained.
+    //
+
+    while (HeapSize != 0) {
+        Winner = Inputs->Data[Heap[0]];
+
+        //
+        // Print the line.
+        //
+
+        if (((Context->Options & SORT_OPTION_UNIQUE) == 0) ||
+            (PreviousWinner == NULL) ||
+            (SortCompareLines(&(Winner->Line), &PreviousWinner) != 0)) {
+
+            Status = SortWriteLine(Output, Winner->Line);
+            if (Status != 0) {
+                SwPrintError(Status, NULL, "Failed to write output");
+                goto MergeSortedFilesEnd;
+            }
+        }
+
+        //
+        // Set the new previous winner, and read a new line from that winning
+        // file. If the file is drained, pull it out of the heap.
+        //
+
+        if (PreviousWinner != NULL) {
+            SortDestroyString(PreviousWinner);
+        }
+
+        PreviousWinner = Winner->Line;
+        Status = SortReadLine(Context,
+                              Winner,
+                              NULL,
+                              &WorkingBuffer,
+                              &(Winner->Line));
+
+        if (Status != 0) {
+            SwPrintError(Status, NULL, "Failed to read file");
+            goto MergeSortedFilesEnd;
+        }
+
+        if (Winner->Line == NULL) {
+            HeapSize -= 1;
+            Heap[0] = Heap[HeapSize];
+        }
+
+        SortSiftDown(Inputs, Heap, HeapSize, 0);
+    }
+
+    Status = 0;
+
+MergeSortedFilesEnd:
+    if (Heap != NULL) {
+        free(Heap);
+    }
+
+    if (PreviousWinner != NULL) {
+        SortDestroyString(PreviousWinner);
+    }
+
+    if (WorkingBuffer.Data != NULL) {
+        free(WorkingBuffer.Data);
+    }
+
+    return Status;
+}
+
+VOID
+SortSiftDown (
+    PSORT_ARRAY Inputs,
+    PUINTN Heap,
+    UINTN HeapSize,
+    UINTN Index
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves an element of the merge heap down until neither of its
+    children is smaller than it. Inputs with equal lines are ordered by their
+    index in the input array.
+
+Arguments:
+
+    Inputs - Supplies a pointer to the array of inputs being merged.
+
+    Heap - Supplies the heap, an array of indices into the input array.
+
+    HeapSize - Supplies the number of elements in the heap.
+
+    Index - Supplies the index of the heap element to sift down.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN Child;
+    INT Comparison;
+    PSORT_INPUT Left;
+    PSORT_INPUT Right;
+    UINTN Swap;
+
+    while (TRUE) {
+        Child = (Index * 2) + 1;
+        if (Child >= HeapSize) {
+            break;
+        }
+
+        //
+        // Pick the smaller of the two children.
+        //
+
+        if (Child + 1 < HeapSize) {
+            Left = Inputs->Data[Heap[Child]];
+            Right = Inputs->Data[Heap[Child + 1]];
+            Comparison = SortCompareLines(&(Right->Line), &(Left->Line));
+            if ((Comparison < 0) ||
+                ((Comparison == 0) && (Heap[Child + 1] < Heap[Child]))) {
+
+                Child += 1;
+            }
+        }
+
+        Left = Inputs->Data[Heap[Index]];
+        Right = Inputs->Data[Heap[Child]];
+        Comparison = SortCompareLines(&(Left->Line), &(Right->Line));
+        if ((Comparison < 0) ||
+            ((Comparison == 0) && (Heap[Index] < Heap[Child]))) {
+
+            break;
+        }
+
+        Swap = Heap[Index];
+        Heap[Index] = Heap[Child];
+        Heap[Child] = Swap;
+        Index = Child;
+    }
+
+    return;
+}
+
+INT
+SortWriteRun (
+    PSORT_CONTEXT Context,
+    PSORT_ARRAY Lines,
+    PSORT_ARRAY Runs
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sorts the lines currently in memory and writes them out to a
+    new temporary file, then frees them.
+
+Arguments:
+
+    Context - Supplies a pointer to the application context.
+
+    Lines - Supplies a pointer to the array of lines to sort. This array will
+        be empty when this routine returns.
+
+    Runs - Supplies a pointer to the array of sorted runs, where the new run
+        will be added.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    PSORT_STRING Line;
+    UINTN LineIndex;
+    PSORT_STRING PreviousLine;
+    PSORT_INPUT Run;
+    INT Status;
+
+    Status = SortSortLines(Context, Lines);
+    if (Status != 0) {
+        SwPrintError(Status, NULL, "Failed to sort");
+        goto WriteRunEnd;
+    }
+
+    Status = SortCreateTemporaryInput(Context, &Run);
+    if (Status != 0) {
+        goto WriteRunEnd;
+    }
+
+    PreviousLine = NULL;
+    for (LineIndex = 0; LineIndex < Lines->Size; LineIndex += 1) {
+        Line = Lines->Data[LineIndex];
+        if (((Context->Options & SORT_OPTION_UNIQUE) == 0) ||
+            (PreviousLine == NULL) ||
+            (SortCompareLines(&PreviousLine, &Line) != 0)) {
+
+            Status = SortWriteLine(Run->File, Line);
+            if (Status != 0) {
+                break;
+            }
+        }
+
+        PreviousLine = Line;
+    }
+
+    //
+    // Close the run until it is merged so that the number of open
+    // descriptors does not grow with the number of runs.
+    //
+
+    if ((Status == 0) && (fflush(Run->File) != 0)) {
+        Status = errno;
+    }
+
+    if ((fclose(Run->File) != 0) && (Status == 0)) {
+        Status = errno;
+    }
+
+    Run->File = NULL;
+    if (Status != 0) {
+        SwPrintError(Status, Run->TemporaryPath, "Failed to write");
+        SortDestroyInput(Run);
+        goto WriteRunEnd;
+    }
+
+    Status = SortArrayAddElement(Runs, Run);
+    if (Status != 0) {
+        SortDestroyInput(Run);
+        goto WriteRunEnd;
+    }
+
+WriteRunEnd:
+    SwResetArena(Context->LineArena);
+    Lines->Size = 0;
+    Context->BufferUsed = 0;
+    return Status;
+}
+
+INT
+SortMergeRuns (
+    PSORT_CONTEXT Context,
+    PSORT_ARRAY Runs,
+    FILE *Output
+    )
+
+/*++
+
+Routine Description:
+
+    This routine merges sorted runs in temporary files to the final output.
+    Runs are kept closed until they are merged, and at most
+    SORT_MAXIMUM_MERGE_INPUTS of them are open at once. If there are more
+    runs than that, neighboring groups of runs are first merged into larger
+    runs.
+
+Arguments:
+
+    Context - Supplies a pointer to the application context.
+
+    Runs - Supplies a pointer to the array of sorted runs, in input order.
+        Runs are destroyed as they are merged.
+
+    Output - Supplies a pointer to the output file to write to.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    SORT_ARRAY Batch;
+    UINTN Count;
+    UINTN Index;
+    PSORT_INPUT Merged;
+    UINTN NewSize;
+    UINTN Start;
+    INT Status;
+
+    Start = 0;
+    NewSize = 0;
+    Status = 0;
+    while (Runs->Size > SORT_MAXIMUM_MERGE_INPUTS) {
+
+        //
+        // Merge each group of neighboring runs into one, keeping the runs in
+        // order so that equal lines stay in input order.
+        //
+
+        NewSize = 0;
+        for (Start = 0; Start < Runs->Size; Start += Count) {
+            Count = Runs->Size - Start;
+            if (Count > SORT_MAXIMUM_MERGE_INPUTS) {
+                Count = SORT_MAXIMUM_MERGE_INPUTS;
+            }
+
+            if (Count == 1) {
+                Runs->Data[NewSize] = Runs->Data[Start];
+                NewSize += 1;
+                continue;
+            }
+
+            Status = SortCreateTemporaryInput(Context, &Merged);
+            if (Status != 0) {
+                goto MergeRunsEnd;
+            }
+
+            Batch.Data = &(Runs->Data[Start]);
+            Batch.Size = Count;
+            Batch.Capacity = Count;
+            Status = SortOpenRuns(&Batch);
+            if (Status == 0) {
+                Status = SortMergeSortedFiles(Context, &Batch, Merged->File);
+            }
+
+            if ((Status == 0) && (fflush(Merged->File) != 0)) {
+                Status = errno;
+                SwPrintError(Status, Merged->TemporaryPath, "Failed to write");
+            }
+
+            if ((fclose(Merged->File) != 0) && (Status == 0)) {
+                Status = errno;
+                SwPrintError(Status, Merged->TemporaryPath, "Failed to write");
+            }
+
+            Merged->File = NULL;
+            if (Status != 0) {
+                SortDestroyInput(Merged);
+                goto MergeRunsEnd;
+            }
+
+            for (Index = Start; Index < Start + Count; Index += 1) {
+                SortDestroyInput(Runs->Data[Index]);
+            }
+
+            Runs->Data[NewSize] = Merged;
+            NewSize += 1;
+        }
+
+        Runs->Size = NewSize;
+    }
+
+    Status = SortOpenRuns(Runs);
+    if (Status != 0) {
+        goto MergeRunsEnd;
+    }
+
+    Status = SortMergeSortedFiles(Context, Runs, Output);
+
+MergeRunsEnd:
+
+    //
+    // On failure partway through a pass, slide the unmerged runs down next
+    // to the merged ones so the array only holds live runs.
+    //
+
+    if ((Status != 0) && (NewSize != 0) && (Start < Runs->Size)) {
+        memmove(&(Runs->Data[NewSize]),
+                &(Runs->Data[Start]),
+                (Runs->Size - Start) * sizeof(PVOID));
+
+        Runs->Size = NewSize + (Runs->Size - Start);
+    }
+
+    return Status;
+}
+
+INT
+SortOpenRuns (
+    PSORT_ARRAY Runs
+    )
+
+/*++
+
+Routine Description:
+
+    This routine opens the temporary files of a set of closed runs for
+    reading.
+
+Arguments:
+
+    Runs - Supplies a pointer to the array of runs to open. On failure, any
+        runs that were opened stay open, and are closed when they are
+        destroyed.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    UINTN Index;
+    PSORT_INPUT Run;
+    INT Status;
+
+    for (Index = 0; Index < Runs->Size; Index += 1) {
+        Run = Runs->Data[Index];
+        if (Run->File != NULL) {
+            continue;
+        }
+
+        Run->File = fopen(Run->TemporaryPath, "rb");
+        if (Run->File == NULL) {
+            Status = errno;
+            SwPrintError(Status, Run->TemporaryPath, "Failed to open");
+            return Status;
+        }
+    }
+
+    return 0;
+}
+
+INT
+SortSortLines (
+    PSORT_CONTEXT Context,
+    PSORT_ARRAY Lines
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sorts an array of lines. The sort is stable, so lines that
+    compare equal stay in the order they were read in. Large arrays are split
+    into partitions that are sorted on separate threads and then merged
+    together, also in parallel. The result is the same regardless of the
+    number of threads used.
+
+Arguments:
+
+    Context - Supplies a pointer to the application context.
+
+    Lines - Supplies a pointer to the array of lines to sort. The array's
+        buffer may be replaced.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    UINTN Begin;
+    PVOID *Destination;
+    UINTN End;
+    PSORT_WORK_ITEM Item;
+    UINTN ItemCount;
+    UINTN ItemIndex;
+    PSORT_WORK_ITEM Items;
+    UINTN LeftEnd;
+    UINTN LeftStart;
+    PVOID *Merged;
+    UINTN Middle;
+    UINTN Pair;
+    UINTN PairCount;
+    UINTN Piece;
+    UINTN PieceCount;
+    UINTN PieceEnd;
+    UINTN PieceStart;
+    UINTN RunCount;
+    PUINTN Runs;
+    PVOID *Scratch;
+    PVOID *Source;
+    INT Status;
+    UINTN ThreadCount;
+
+    Items = NULL;
+    Runs = NULL;
+    Scratch = NULL;
+    if (Lines->Size < 2) {
+        Status = 0;
+        goto SortLinesEnd;
+    }
+
+    Scratch = malloc(Lines->Size * sizeof(PVOID));
+    if (Scratch == NULL) {
+        Status = ENOMEM;
+        goto SortLinesEnd;
+    }
+
+    ThreadCount = Context->ThreadCount;
+    if (ThreadCount > Lines->Size / SORT_MINIMUM_THREAD_LINES) {
+        ThreadCount = Lines->Size / SORT_MINIMUM_THREAD_LINES;
+    }
+
+    if (ThreadCount <= 1) {
+        SortMergeSortLines(Lines->Data, Scratch, Lines->Size);
+        Status = 0;
+        goto SortLinesEnd;
+    }
+
+    Items = malloc(ThreadCount * sizeof(SORT_WORK_ITEM));
+    Runs = malloc((ThreadCount + 1) * sizeof(UINTN));
+    if ((Items == NULL) || (Runs == NULL)) {
+        Status = ENOMEM;
+        goto SortLinesEnd;
+    }
+
+    //
+    // Split the lines into contiguous partitions and sort each one on its own
+    // thread.
+    //
+
+    for (ItemIndex = 0; ItemIndex < ThreadCount; ItemIndex += 1) {
+        Runs[ItemIndex] = (Lines->Size * ItemIndex) / ThreadCount;
+    }
+
+    Runs[ThreadCount] = Lines->Size;
+    for (ItemIndex = 0; ItemIndex < ThreadCount; ItemIndex += 1) {
+        Item = &(Items[ItemIndex]);
+        Item->Sort = TRUE;
+        Item->Left = Lines->Data + Runs[ItemIndex];
+        Item->LeftCount = Runs[ItemIndex + 1] - Runs[ItemIndex];
+        Item->Right = NULL;
+        Item->RightCount = 0;
+        Item->Destination = Scratch + Runs[ItemIndex];
+    }
+
+    SortRunWorkItems(Items, ThreadCount);
+
+    //
+    // Merge neighboring runs together, bouncing between the line array and
+    // the scratch array. Each merge is cut into pieces along the output so
+    // that all the threads stay busy even when only a few runs are left. An
+    // odd run out at the end is "merged" with nothing, which just copies it.
+    //
+
+    Source = Lines->Data;
+    Destination = Scratch;
+    RunCount = ThreadCount;
+    while (RunCount > 1) {
+        PairCount = (RunCount + 1) / 2;
+        PieceCount = ThreadCount / PairCount;
+        ItemCount = 0;
+        for (Pair = 0; Pair < PairCount; Pair += 1) {
+            Begin = Runs[Pair * 2];
+            Middle = Runs[Pair * 2 + 1];
+            End = Middle;
+            if (Pair * 2 + 2 <= RunCount) {
+                End = Runs[Pair * 2 + 2];
+            }
+
+            for (Piece = 0; Piece < PieceCount; Piece += 1) {
+                PieceStart = ((End - Begin) * Piece) / PieceCount;
+                PieceEnd = ((End - Begin) * (Piece + 1)) / PieceCount;
+                LeftStart = SortFindMergeSplit(Source + Begin,
+                                               Middle - Begin,
+                                               Source + Middle,
+                                               End - Middle,
+                                               PieceStart);
+
+                LeftEnd = SortFindMergeSplit(Source + Begin,
+                                             Middle - Begin,
+                                             Source + Middle,
+                                             End - Middle,
+                                             PieceEnd);
+
+                Item = &(Items[ItemCount]);
+                ItemCount += 1;
+                Item->Sort = FALSE;
+                Item->Left = Source + Begin + LeftStart;
+                Item->LeftCount = LeftEnd - LeftStart;
+                Item->Right = Source + Middle + (PieceStart - LeftStart);
+                Item->RightCount = (PieceEnd - LeftEnd) -
+                                   (PieceStart - LeftStart);
+
+                Item->Destination = Destination + Begin + PieceStart;
+            }
+
+            //
+            // The merged run starts where the pair started. Later pairs only
+            // read boundaries further along, so it's safe to compact here.
+            //
+
+            Runs[Pair] = Begin;
+        }
+
+        Runs[PairCount] = Lines->Size;
+
+        assert(ItemCount <= ThreadCount);
+
+        SortRunWorkItems(Items, ItemCount);
+        RunCount = PairCount;
+        Merged = Destination;
+        Destination = Source;
+        Source = Merged;
+    }
+
+    //
+    // If the sorted lines ended up in the scratch buffer, just swap the
+    // buffers rather than copying everything back.
+    //
+
+    if (Source != Lines->Data) {
+        Scratch = Lines->Data;
+        Lines->Data = Source;
+        Lines->Capacity = Lines->Size;
+    }
+
+    Status = 0;
+
+SortLinesEnd:
+    if (Scratch != NULL) {
+        free(Scratch);
+    }
+
+    if (Items != NULL) {
+        free(Items);
+    }
+
+    if (Runs != NULL) {
+        free(Runs);
+    }
+
+    return Status;
+}
+
+VOID
+SortRunWorkItems (
+    PSORT_WORK_ITEM Items,
+    UINTN Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine runs a set of sort work items in parallel, and waits for
+    them all to finish. The first item runs on the calling thread. If a thread
+    cannot be created, its item runs on the calling thread instead.
+
+Arguments:
+
+    Items - Supplies a pointer to the array of work items.
+
+    Count - Supplies the number of work items in the array.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN Index;
+    INT Status;
+
+    for (Index = 1; Index < Count; Index += 1) {
+        Status = SwCreateThread(SortWorkItemThread,
+                                &(Items[Index]),
+                                &(Items[Index].Thread));
+
+        if (Status != 0) {
+            Items[Index].Thread = NULL;
+            SortWorkItemThread(&(Items[Index]));
+        }
+    }
+
+    if (Count != 0) {
+        SortWorkItemThread(&(Items[0]));
+    }
+
+    for (Index = 1; Index < Count; Index += 1) {
+        if (Items[Index].Thread != NULL) {
+            SwJoinThread(Items[Index].Thread);
+            Items[Index].Thread = NULL;
+        }
+    }
+
+    return;
+}
+
+VOID
+SortWorkItemThread (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs a single sort work item.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the work item.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSORT_WORK_ITEM Item;
+
+    Item = Parameter;
+    if (Item->Sort != FALSE) {
+        SortMergeSortLines(Item->Left, Item->Destination, Item->LeftCount);
+
+    } else {
+        SortMergeLineRanges(Item->Left,
+                            Item->LeftCount,
+                            Item->Right,
+                            Item->RightCount,
+                            Item->Destination);
+    }
+
+    return;
+}
+
+VOID
+SortMergeSortLines (
+    PVOID *Lines,
+    PVOID *Scratch,
+    UINTN Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs a stable merge sort of an array of lines in place.
+
+Arguments:
+
+    Lines - Supplies a pointer to the array of line pointers to sort.
+
+    Scratch - Supplies a pointer to scratch space for at least half as many
+        line pointers.
+
+    Count - Supplies the number of lines in the array.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN Half;
+    UINTN Index;
+    PVOID Line;
+    UINTN Slot;
+
+    if (Count <= SORT_INSERTION_SORT_SIZE) {
+        for (Index = 1; Index < Count; Index += 1) {
+            Line = Lines[Index];
+            Slot = Index;
+            while ((Slot != 0) &&
+                   (SortCompareLines(&(Lines[Slot - 1]), &Line) > 0)) {
+
+                Lines[Slot] = Lines[Slot - 1];
+                Slot -= 1;
+            }
+
+            Lines[Slot] = Line;
+        }
+
+        return;
+    }
+
+    Half = Count / 2;
+    SortMergeSortLines(Lines, Scratch, Half);
+    SortMergeSortLines(Lines + Half, Scratch, Count - Half);
+
+    //
+    // Skip the merge if the halves are already in order, which is common for
+    // partially sorted input.
+    //
+
+    if (SortCompareLines(&(Lines[Half - 1]), &(Lines[Half])) <= 0) {
+        return;
+    }
+
+    //
+    // Move the left half out of the way and merge back into the array. The
+    // output never catches up to the unread part of the right half.
+    //
+
+    memcpy(Scratch, Lines, Half * sizeof(PVOID));
+    SortMergeLineRanges(Scratch, Half, Lines + Half, Count - Half, Lines);
+    return;
+}
+
+VOID
+SortMergeLineRanges (
+    PVOID *Left,
+    UINTN LeftCount,
+    PVOID *Right,
+    UINTN RightCount,
+    PVOID *Destination
+    )
+
+/*++
+
+Routine Description:
+
+    This routine merges two sorted ranges of lines. Lines from the left range
+    win ties, keeping the merge stable.
+
+Arguments:
+
+    Left - Supplies a pointer to the first sorted range.
+
+    LeftCount - Supplies the number of lines in the first range.
+
+    Right - Supplies a pointer to the second sorted range.
+
+    RightCount - Supplies the number of lines in the second range.
+
+    Destination - Supplies a pointer where the merged lines are written.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN LeftIndex;
+    UINTN RightIndex;
+
+    LeftIndex = 0;
+    RightIndex = 0;
+    while ((LeftIndex < LeftCount) && (RightIndex < RightCount)) {
+        if (SortCompareLines(&(Right[RightIndex]), &(Left[LeftIndex])) < 0) {
+            *Destination = Right[RightIndex];
+            RightIndex += 1;
+
+        } else {
+            *Destination = Left[LeftIndex];
+            LeftIndex += 1;
+        }
+
+        Destination += 1;
+    }
+
+    while (LeftIndex < LeftCount) {
+        *Destination = Left[LeftIndex];
+        Destination += 1;
+        LeftIndex += 1;
+    }
+
+    while (RightIndex < RightCount) {
+        *Destination = Right[RightIndex];
+        Destination += 1;
+        RightIndex += 1;
+    }
+
+    return;
+}
+
+UINTN
+SortFindMergeSplit (
+    PVOID *Left,
+    UINTN LeftCount,
+    PVOID *Right,
+    UINTN RightCount,
+    UINTN Diagonal
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines how many lines of the left range are among the
+    first lines output when merging two sorted ranges. This allows a single
+    merge to be cut into independent pieces.
+
+Arguments:
+
+    Left - Supplies a pointer to the first sorted range.
+
+    LeftCount - Supplies the number of lines in the first range.
+
+    Right - Supplies a pointer to the second sorted range.
+
+    RightCount - Supplies the number of lines in the second range.
+
+    Diagonal - Supplies the number of merged lines being considered.
+
+Return Value:
+
+    Returns the number of lines from the left range in the first Diagonal
+    lines of the merge. The rest come from the right range.
+
+--*/
+
+{
+
+    UINTN High;
+    UINTN Low;
+    UINTN Middle;
 
-CheckFileEnd:
-    if (WorkingBuffer.Data != NULL) {
-        free(WorkingBuffer.Data);
+    Low = 0;
+    if (Diagonal > RightCount) {
+        Low = Diagonal - RightCount;
     }
 
-    if (Line != NULL) {
-        SortDestroyString(Line);
+    High = Diagonal;
+    if (High > LeftCount) {
+        High = LeftCount;
     }
 
-    if (PreviousLine != NULL) {
-        SortDestroyString(PreviousLine);
+    //
+    // A left line is in the output so far if it sorts before or equal to the
+    // right line it would otherwise be displacing.
+    //
+
+    while (Low < High) {
+        Middle = Low + ((High - Low) / 2);
+        if (SortCompareLines(&(Left[Middle]),
+                             &(Right[Diagonal - Middle - 1])) <= 0) {
+
+            Low = Middle + 1;
+
+        } else {
+            High = Middle;
+        }
     }
 
-    return Status;
+    return Low;
 }
 
 INT
-SortMergeSortedFiles (
+SortCreateTemporaryInput (
     PSORT_CONTEXT Context,
-    FILE *Output
+    PSORT_INPUT *NewInput
     )
 
 /*++
 
 Routine Description:
 
-    This routine merges several files that are already in order.
+    This routine creates a new empty temporary file, opened for reading and
+    writing, and wraps it in an input structure.
 
 Arguments:
 
     Context - Supplies a pointer to the application context.
 
-    Output - Supplies a pointer to the output file to write to.
+    NewInput - Supplies a pointer where a pointer to the new input will be
+        returned on success. Destroying the input deletes the file.
 
 Return Value:
 
     0 on success.
 
-    Non-zero on failure.
+    Returns an error number on failure.
 
 --*/
 
 {
 
-    INT Comparison;
+    INT Descriptor;
     PSORT_INPUT Input;
-    UINTN InputIndex;
-    PSORT_STRING PreviousWinner;
+    size_t PathSize;
     INT Status;
-    PSORT_INPUT Winner;
-    SORT_STRING WorkingBuffer;
+    ULONG Try;
 
-    PreviousWinner = NULL;
-    memset(&WorkingBuffer, 0, sizeof(SORT_STRING));
+    Descriptor = -1;
+    Input = malloc(sizeof(SORT_INPUT));
+    if (Input == NULL) {
+        Status = ENOMEM;
+        goto CreateTemporaryInputEnd;
+    }
 
-    //
-    // Prime all the inputs by reading their first lines.
-    //
+    memset(Input, 0, sizeof(SORT_INPUT));
+    PathSize = strlen(Context->TemporaryDirectory) + 32;
+    Input->TemporaryPath = malloc(PathSize);
+    if (Input->TemporaryPath == NULL) {
+        Status = ENOMEM;
+        goto CreateTemporaryInputEnd;
+    }
 
-    for (InputIndex = 0; InputIndex < Context->Input.Size; InputIndex += 1) {
-        Input = Context->Input.Data[InputIndex];
-        Status = SortReadLine(Context,
-                              Input,
-                              &WorkingBuffer,
-                              &(Input->Line));
+    Status = EEXIST;
+    for (Try = 0; Try < SORT_TEMPORARY_TRY_COUNT; Try += 1) {
+        snprintf(Input->TemporaryPath,
+                 PathSize,
+                 "%s/sort%u.%u",
+                 Context->TemporaryDirectory,
+                 (unsigned int)getpid(),
+                 (unsigned int)(Context->TemporaryCount));
+
+        Context->TemporaryCount += 1;
+        Descriptor = open(Input->TemporaryPath,
+                          O_RDWR | O_CREAT | O_EXCL | O_BINARY,
+                          S_IRUSR | S_IWUSR);
+
+        if (Descriptor >= 0) {
+            Status = 0;
+            break;
+        }
 
-        if (Status != 0) {
-            SwPrintError(Status, NULL, "Failed to read file");
-            goto MergeSortedFilesEnd;
+        Status = errno;
+        if (Status != EEXIST) {
+            break;
         }
     }
 
-    //
-    // Loop getting the winning line until all files are drained.
-    //
+    if (Status != 0) {
+        SwPrintError(Status,
+                     Context->TemporaryDirectory,
+                     "Failed to create temporary file in");
 
-    while (TRUE) {
-        Winner = NULL;
-        for (InputIndex = 0;
-             InputIndex < Context->Input.Size;
-             InputIndex += 1) {
+        goto CreateTemporaryInputEnd;
+    }
 
-            Input = Context->Input.Data[InputIndex];
-            if (Input->Line == NULL) {
-                continue;
+    Input->File = fdopen(Descriptor, "w+b");
+    if (Input->File == NULL) {
+        Status = errno;
+        close(Descriptor);
+        unlink(Input->TemporaryPath);
+        goto CreateTemporaryInputEnd;
+    }
+
+    Status = 0;
+
+CreateTemporaryInputEnd:
+    if (Status != 0) {
+        if (Input != NULL) {
+            if (Input->TemporaryPath != NULL) {
+                free(Input->TemporaryPath);
             }
 
-            if (Winner == NULL) {
-                Winner = Input;
+            free(Input);
+            Input = NULL;
+        }
+    }
 
-            } else {
+    *NewInput = Input;
+    return Status;
+}
 
-                //
-                // If this input's line is less than the current winner, set it
-                // to the new winner.
-                //
+INT
+SortWriteLine (
+    FILE *Output,
+    PSORT_STRING Line
+    )
 
-                Comparison = SortCompareLines(&(Input->Line), &(Winner->Line));
-                if (Comparison < 0) {
-                    Winner = Input;
-                }
-            }
-        }
+/*++
 
-        //
-        // If there is no winner, then all files must be drained. Stop.
-        //
+Routine Description:
 
-        if (Winner == NULL) {
-            break;
-        }
+    This routine writes a line and its newline to the given output.
 
-        //
-        // Print the line.
-        //
+Arguments:
 
-        if (((Context->Options & SORT_OPTION_UNIQUE) == 0) ||
-            (PreviousWinner == NULL) ||
-            (SortCompareLines(&(Winner->Line), &PreviousWinner) != 0)) {
+    Output - Supplies a pointer to the file to write to.
 
-            fprintf(Output, "%s\n", Winner->Line->Data);
-        }
+    Line - Supplies a pointer to the line to write.
 
-        //
-        // Set the new previous winner, and read a new line from that winning
-        // file.
-        //
+Return Value:
 
-        if (PreviousWinner != NULL) {
-            SortDestroyString(PreviousWinner);
-        }
+    0 on success.
 
-        PreviousWinner = Winner->Line;
-        if (Winner->Line != NULL) {
-            Status = SortReadLine(Context,
-                                  Winner,
-                                  &WorkingBuffer,
-                                  &(Winner->Line));
+    Returns an error number on failure.
 
-            if (Status != 0) {
-                SwPrintError(Status, NULL, "Failed to read file");
-                goto MergeSortedFilesEnd;
-            }
-        }
-    }
+--*/
 
-    Status = 0;
+{
 
-MergeSortedFilesEnd:
-    if (PreviousWinner != NULL) {
-        SortDestroyString(PreviousWinner);
-    }
+    UINTN Length;
 
-    if (WorkingBuffer.Data != NULL) {
-        free(WorkingBuffer.Data);
+    assert(Line->Size != 0);
+
+    Length = Line->Size - 1;
+    if ((fwrite(Line->Data, 1, Length, Output) != Length) ||
+        (fputc('\n', Output) == EOF)) {
+
+        if (errno == 0) {
+            return EIO;
+        }
+
+        return errno;
     }
 
-    return Status;
+    return 0;
 }
 
 INT
@@ -1075,7 +2531,8 @@ SortCompareLines (
 
 Routine Description:
 
-    This routine compares two sort string elements.
+    This routine compares two sort string elements using their precomputed
+    keys.
 
 Arguments:
 
@@ -1103,72 +2560,44 @@ Return Value:
     PSORT_STRING Left;
     CHAR LeftCharacter;
     ULONG LeftEndIndex;
+    PSORT_LINE_KEY LeftKey;
     ULONG LeftStartIndex;
-    LONG LeftValue;
     ULONG Options;
     INT Result;
     PSORT_STRING Right;
     CHAR RightCharacter;
     ULONG RightEndIndex;
+    PSORT_LINE_KEY RightKey;
     ULONG RightStartIndex;
-    LONG RightValue;
 
     Context = SortContext;
     Left = *(PSORT_STRING *)LeftPointer;
     Right = *(PSORT_STRING *)RightPointer;
-    for (KeyIndex = 0; KeyIndex < Context->Key.Size; KeyIndex += 1) {
-        Key = Context->Key.Data[KeyIndex];
-        Options = Key->StartOptions | Key->EndOptions;
-        SortGetFieldOffset(Left,
-                           Context->Separator,
-                           Key->StartField,
-                           Key->StartCharacter,
-                           &LeftStartIndex);
-
-        SortGetFieldOffset(Left,
-                           Context->Separator,
-                           Key->EndField,
-                           Key->EndCharacter,
-                           &LeftEndIndex);
-
-        SortGetFieldOffset(Right,
-                           Context->Separator,
-                           Key->StartField,
-                           Key->StartCharacter,
-                           &RightStartIndex);
 
-        SortGetFieldOffset(Right,
-                           Context->Separator,
-                           Key->EndField,
-                           Key->EndCharacter,
-                           &RightEndIndex);
-
-        //
-        // Strip leading blanks if requested.
-        //
-
-        if ((Options & SORT_OPTION_IGNORE_LEADING_BLANKS) != 0) {
-            while ((LeftStartIndex < LeftEndIndex) &&
-                   (isblank(Left->Data[LeftStartIndex]))) {
+    //
+    // Most lines are told apart by the packed prefix of the first key.
+    //
 
-                LeftStartIndex += 1;
-            }
+    if (Left->Prefix != Right->Prefix) {
+        if (Left->Prefix < Right->Prefix) {
+            return -1;
+        }
 
-            while ((RightStartIndex < RightEndIndex) &&
-                   (isblank(Right->Data[RightStartIndex]))) {
+        return 1;
+    }
 
-                RightStartIndex += 1;
-            }
-        }
+    for (KeyIndex = 0; KeyIndex < Context->Key.Size; KeyIndex += 1) {
+        Key = Context->Key.Data[KeyIndex];
+        Options = Key->StartOptions | Key->EndOptions;
+        LeftKey = &(Left->Keys[KeyIndex]);
+        RightKey = &(Right->Keys[KeyIndex]);
 
         //
-        // Scan and compare the numbers if sorting numerically.
+        // Compare the numbers if sorting numerically.
         //
 
         if ((Options & SORT_OPTION_COMPARE_NUMERICALLY) != 0) {
-            LeftValue = SortStringToLong(Left, Options, LeftStartIndex);
-            RightValue = SortStringToLong(Right, Options, RightStartIndex);
-            if (LeftValue < RightValue) {
+            if (LeftKey->Value < RightKey->Value) {
                 Result = -1;
                 if ((Options & SORT_OPTION_REVERSE) != 0) {
                     Result = -Result;
@@ -1176,7 +2605,7 @@ Return Value:
 
                 goto CompareLinesEnd;
 
-            } else if (LeftValue > RightValue) {
+            } else if (LeftKey->Value > RightKey->Value) {
                 Result = 1;
                 if ((Options & SORT_OPTION_REVERSE) != 0) {
                     Result = -Result;
@@ -1190,6 +2619,10 @@ Return Value:
         //
 
         } else {
+            LeftStartIndex = LeftKey->Start;
+            LeftEndIndex = LeftKey->End;
+            RightStartIndex = RightKey->Start;
+            RightEndIndex = RightKey->End;
             while ((LeftStartIndex < LeftEndIndex) ||
                    (RightStartIndex < RightEndIndex)) {
 
@@ -1287,6 +2720,7 @@ INT
 SortReadLine (
     PSORT_CONTEXT Context,
     PSORT_INPUT Input,
+    PSWISS_ARENA Arena,
     PSORT_STRING Holding,
     PSORT_STRING *String
     )
@@ -1303,6 +2737,10 @@ Routine Description:
 
     Input - Supplies a pointer to the input.
 
+    Arena - Supplies an optional pointer to an arena to allocate the line
+        from. If supplied, the line must not be destroyed individually. If
+        not supplied, the caller must destroy the line.
+
     Holding - Supplies a pointer to a transitory buffer to use to hold the
         string while it's being read.
 
@@ -1343,6 +2781,7 @@ Return Value:
             //
 
             if ((Character == '\n') &&
+                (Input->TemporaryPath == NULL) &&
                 (Holding->Size != 0) &&
                 (Holding->Data[Holding->Size - 1] == '\r')) {
 
@@ -1373,19 +2812,171 @@ Return Value:
     // Create a new string that's well sized.
     //
 
-    NewString = SortCreateString(Holding->Data, Holding->Size);
+    NewString = SortCreateString(Arena, Holding->Data, Holding->Size);
     if (NewString == NULL) {
         Result = ENOMEM;
         goto ReadLineEnd;
     }
 
-    Result = 0;
+    Result = SortComputeLineKeys(Context, Arena, NewString);
+    if (Result != 0) {
+        if (Arena == NULL) {
+            SortDestroyString(NewString);
+        }
+
+        NewString = NULL;
+        goto ReadLineEnd;
+    }
 
 ReadLineEnd:
     *String = NewString;
     return Result;
 }
 
+INT
+SortComputeLineKeys (
+    PSORT_CONTEXT Context,
+    PSWISS_ARENA Arena,
+    PSORT_STRING Line
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the span of each sort key within a line, parses any
+    numeric keys, and packs the comparison prefix. This is done once per line
+    so that comparisons don't have to rescan the fields each time.
+
+Arguments:
+
+    Context - Supplies a pointer to the application context.
+
+    Arena - Supplies an optional pointer to the arena to allocate the key
+        array from. If NULL, the key array is allocated from the heap.
+
+    Line - Supplies a pointer to the line to compute keys for.
+
+Return Value:
+
+    0 on success.
+
+    ENOMEM on allocation failure.
+
+--*/
+
+{
+
+    CHAR Character;
+    UINTN Count;
+    ULONG Index;
+    PSORT_KEY Key;
+    UINTN KeyIndex;
+    PSORT_LINE_KEY LineKey;
+    ULONG Options;
+    ULONGLONG Prefix;
+
+    if (Arena != NULL) {
+        Line->Keys = SwArenaAllocate(Arena,
+                                     Context->Key.Size * sizeof(SORT_LINE_KEY));
+
+    } else {
+        Line->Keys = malloc(Context->Key.Size * sizeof(SORT_LINE_KEY));
+    }
+
+    if (Line->Keys == NULL) {
+        return ENOMEM;
+    }
+
+    for (KeyIndex = 0; KeyIndex < Context->Key.Size; KeyIndex += 1) {
+        Key = Context->Key.Data[KeyIndex];
+        LineKey = &(Line->Keys[KeyIndex]);
+        Options = Key->StartOptions | Key->EndOptions;
+        SortGetFieldOffset(Line,
+                           Context->Separator,
+                           Key->StartField,
+                           Key->StartCharacter,
+                           &(LineKey->Start));
+
+        SortGetFieldOffset(Line,
+                           Context->Separator,
+                           Key->EndField,
+                           Key->EndCharacter,
+                           &(LineKey->End));
+
+        //
+        // Strip leading blanks if requested.
+        //
+
+        if ((Options & SORT_OPTION_IGNORE_LEADING_BLANKS) != 0) {
+            while ((LineKey->Start < LineKey->End) &&
+                   (isblank(Line->Data[LineKey->Start]))) {
+
+                LineKey->Start += 1;
+            }
+        }
+
+        LineKey->Value = 0;
+        if ((Options & SORT_OPTION_COMPARE_NUMERICALLY) != 0) {
+            LineKey->Value = SortStringToLong(Line, Options, LineKey->Start);
+        }
+    }
+
+    //
+    // Pack the prefix from the first key. Numeric keys use the value with the
+    // sign flipped so negative numbers sort first. Other keys use the first
+    // few characters that would be compared, with the end of the key reading
+    // as zeros just like it does in the comparison.
+    //
+
+    Key = Context->Key.Data[0];
+    LineKey = &(Line->Keys[0]);
+    Options = Key->StartOptions | Key->EndOptions;
+    if ((Options & SORT_OPTION_COMPARE_NUMERICALLY) != 0) {
+        Prefix = (ULONGLONG)(LONGLONG)(LineKey->Value) ^ SORT_PREFIX_SIGN_BIT;
+
+    } else {
+        Prefix = 0;
+        Index = LineKey->Start;
+        Count = 0;
+        while (Count < sizeof(ULONGLONG)) {
+            Character = 0;
+            if (Index < LineKey->End) {
+                Character = Line->Data[Index];
+                Index += 1;
+                if (((Options & SORT_OPTION_IGNORE_NONPRINTABLE) != 0) &&
+                    (!isprint(Character))) {
+
+                    continue;
+                }
+
+                if (((Options & SORT_OPTION_ONLY_ALPHANUMERICS) != 0) &&
+                    (!isalnum(Character)) &&
+                    (!isspace(Character))) {
+
+                    continue;
+                }
+
+                if ((Options & SORT_OPTION_UPPERCASE_EVERYTHING) != 0) {
+                    Character = toupper(Character);
+                }
+            }
+
+            Prefix = (Prefix << BITS_PER_BYTE) |
+                     (UCHAR)(Character ^ SORT_PREFIX_CHARACTER_BIAS);
+
+            Count += 1;
+        }
+    }
+
+    if ((Options & SORT_OPTION_REVERSE) != 0) {
+        Prefix = ~Prefix;
+    }
+
+    Line->Prefix = Prefix;
+    return 0;
+}
+
 INT
 SortAddInputFile (
     PSORT_CONTEXT Context,
@@ -1769,6 +3360,7 @@ Return Value:
 
 PSORT_STRING
 SortCreateString (
+    PSWISS_ARENA Arena,
     PSTR InitialData,
     UINTN InitialDataSize
     )
@@ -1781,6 +3373,10 @@ Routine Description:
 
 Arguments:
 
+    Arena - Supplies an optional pointer to an arena to allocate the string
+        from. If supplied, the string header and data are allocated together
+        from the arena, and the string must not be destroyed individually.
+
     InitialData - Supplies an optional pointer to an initial buffer to fill it
         with.
 
@@ -1788,8 +3384,8 @@ Routine Description:
 
 Return Value:
 
-    Returns a pointer to the new string on success. The caller is responsible
-    for destroying this string.
+    Returns a pointer to the new string on success. If no arena was supplied,
+    the caller is responsible for destroying this string.
 
     NULL on allocation failure.
 
@@ -1800,6 +3396,31 @@ Return Value:
     INT Status;
     PSORT_STRING String;
 
+    //
+    // Arena strings are never grown or freed individually, so the data can
+    // sit right after the header.
+    //
+
+    if (Arena != NULL) {
+        String = SwArenaAllocate(Arena, sizeof(SORT_STRING) + InitialDataSize);
+        if (String == NULL) {
+            return NULL;
+        }
+
+        memset(String, 0, sizeof(SORT_STRING));
+        if (InitialDataSize != 0) {
+            String->Data = (PSTR)(String + 1);
+            if (InitialData != NULL) {
+                memcpy(String->Data, InitialData, InitialDataSize);
+            }
+
+            String->Size = InitialDataSize;
+            String->Capacity = InitialDataSize;
+        }
+
+        return String;
+    }
+
     Status = ENOMEM;
     String = malloc(sizeof(SORT_STRING));
     if (String == NULL) {
@@ -1867,6 +3488,10 @@ Return Value:
         free(String->Data);
     }
 
+    if (String->Keys != NULL) {
+        free(String->Keys);
+    }
+
     free(String);
     return;
 }
@@ -1888,9 +3513,9 @@ Routine Description:
 
     Array - Supplies a pointer to the array to destroy.
 
-    DestroyElementRoutine - Supplies a pointer to the routine that gets called
-        on each element to perform any necessary cleanup on the elements in the
-        array.
+    DestroyElementRoutine - Supplies an optional pointer to the routine that
+        gets called on each element to perform any necessary cleanup on the
+        elements in the array.
 
 Return Value:
 
@@ -1902,8 +3527,10 @@ Return Value:
 
     UINTN ElementIndex;
 
-    for (ElementIndex = 0; ElementIndex < Array->Size; ElementIndex += 1) {
-        DestroyElementRoutine(Array->Data[ElementIndex]);
+    if (DestroyElementRoutine != NULL) {
+        for (ElementIndex = 0; ElementIndex < Array->Size; ElementIndex += 1) {
+            DestroyElementRoutine(Array->Data[ElementIndex]);
+        }
     }
 
     if (Array->Data != NULL) {
@@ -1947,6 +3574,11 @@ Return Value:
         SortDestroyString(Input->Line);
     }
 
+    if (Input->TemporaryPath != NULL) {
+        unlink(Input->TemporaryPath);
+        free(Input->TemporaryPath);
+    }
+
     free(Input);
     return;
 }
@@ -34,6 +34,8 @@ Module Name:
 
 #include <assert.h>
 #include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "swiss.h"
@@ -47,6 +49,14 @@ Module Name:
 #define SWISS_VERSION_MAJOR 1
 #define SWISS_VERSION_MINOR 0
 
+//
+// Define the number of slots in the command lookup hash table. This must be
+// a power of two, and should be comfortably more than twice the number of
+// commands.
+//
+
+#define SWISS_COMMAND_HASH_SIZE 512
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -60,6 +70,11 @@ SwisspFindCommand (
     PSTR Command
     );
 
+VOID
+SwisspBuildCommandHash (
+    VOID
+    );
+
 BOOL
 SwisspRunCommand (
     PSWISS_COMMAND_ENTRY Command,
@@ -70,10 +85,27 @@ SwisspRunCommand (
     PINT ReturnValue
     );
 
+VOID
+SwisspRunCommandInProcess (
+    PSWISS_COMMAND_ENTRY Command,
+    CHAR **Arguments,
+    ULONG ArgumentCount,
+    PINT ReturnValue
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
 
+//
+// Store the hash table used to find commands by name. Each slot holds one
+// more than the index of a command in the command table, or zero if the slot
+// is empty. The table is built the first time a command is looked up.
+//
+
+static USHORT SwisspCommandHash[SWISS_COMMAND_HASH_SIZE];
+static BOOL SwisspCommandHashBuilt;
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -291,6 +323,7 @@ SwissRunCommand (
     ULONG ArgumentCount,
     BOOL SeparateProcess,
     BOOL Wait,
+    BOOL AllowNoFork,
     PINT ReturnValue
     )
 
@@ -315,8 +348,15 @@ Routine Description:
     Wait - Supplies a boolean indicating if this routine should not return
         until the command has completed.
 
+    AllowNoFork - Supplies a boolean indicating if commands marked safe to
+        run inside the caller may do so even though a separate process was
+        requested. This only applies if the caller is also going to wait.
+        A call to exit from the command returns here rather than ending the
+        caller.
+
     ReturnValue - Supplies a pointer where the return value of the command
-        will be returned on success.
+        will be returned on success. If a separate process was requested,
+        this is a wait status, even if the command actually ran in process.
 
 Return Value:
 
@@ -349,14 +389,39 @@ Return Value:
         }
     }
 
-    Result = SwisspRunCommand(CommandEntry,
+    //
+    // Skip the fork entirely for simple commands that are safe to run inside
+    // the caller, if the caller allows it. The caller has already set up any
+    // redirections on the real descriptors, so the command sees the same
+    // thing it would in a child.
+    //
+
+    if ((AllowNoFork == FALSE) || (SeparateProcess == FALSE) ||
+        (Wait == FALSE) ||
+        ((CommandEntry->Flags & SWISS_APP_NOFORK) == 0)) {
+
+        Result = SwisspRunCommand(CommandEntry,
+                                  Arguments,
+                                  ArgumentCount,
+                                  SeparateProcess,
+                                  Wait,
+                                  ReturnValue);
+
+        return Result;
+    }
+
+    SwisspRunCommandInProcess(CommandEntry,
                               Arguments,
                               ArgumentCount,
-                              SeparateProcess,
-                              Wait,
                               ReturnValue);
 
-    return Result;
+    //
+    // The caller asked for a separate process, so it expects a wait status
+    // rather than the command's plain return value.
+    //
+
+    *ReturnValue = SwMakeExitStatus(*ReturnValue);
+    return TRUE;
 }
 
 //
@@ -388,7 +453,8 @@ Return Value:
 
 {
 
-    ULONG CommandIndex;
+    PSWISS_COMMAND_ENTRY Entry;
+    ULONG Slot;
 
     //
     // Skip the dash which indicates a login process.
@@ -398,16 +464,80 @@ Return Value:
         Command += 1;
     }
 
+    if (SwisspCommandHashBuilt == FALSE) {
+        SwisspBuildCommandHash();
+    }
+
+    Slot = SwHashString(Command, strlen(Command) + 1);
+    Slot &= SWISS_COMMAND_HASH_SIZE - 1;
+    while (SwisspCommandHash[Slot] != 0) {
+        Entry = &(SwissCommands[SwisspCommandHash[Slot] - 1]);
+        if (strcmp(Command, Entry->CommandName) == 0) {
+            return Entry;
+        }
+
+        Slot = (Slot + 1) & (SWISS_COMMAND_HASH_SIZE - 1);
+    }
+
+    return NULL;
+}
+
+VOID
+SwisspBuildCommandHash (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine builds the hash table used to look up commands by name. If a
+    name appears more than once in the command table, the first entry wins.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG CommandIndex;
+    PSTR Name;
+    ULONG Slot;
+
     CommandIndex = 0;
     while (SwissCommands[CommandIndex].CommandName != NULL) {
-        if (strcmp(Command, SwissCommands[CommandIndex].CommandName) == 0) {
-            return &(SwissCommands[CommandIndex]);
+
+        assert(CommandIndex < SWISS_COMMAND_HASH_SIZE / 2);
+
+        Name = SwissCommands[CommandIndex].CommandName;
+        Slot = SwHashString(Name, strlen(Name) + 1);
+        Slot &= SWISS_COMMAND_HASH_SIZE - 1;
+        while (SwisspCommandHash[Slot] != 0) {
+            if (strcmp(Name,
+                       SwissCommands[SwisspCommandHash[Slot] - 1].CommandName) ==
+                0) {
+
+                break;
+            }
+
+            Slot = (Slot + 1) & (SWISS_COMMAND_HASH_SIZE - 1);
+        }
+
+        if (SwisspCommandHash[Slot] == 0) {
+            SwisspCommandHash[Slot] = CommandIndex + 1;
         }
 
         CommandIndex += 1;
     }
 
-    return NULL;
+    SwisspCommandHashBuilt = TRUE;
+    return;
 }
 
 BOOL
@@ -536,3 +666,88 @@ Return Value:
     return TRUE;
 }
 
+VOID
+SwisspRunCommandInProcess (
+    PSWISS_COMMAND_ENTRY Command,
+    CHAR **Arguments,
+    ULONG ArgumentCount,
+    PINT ReturnValue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine runs a builtin command inside the calling process on behalf
+    of a caller that wanted a separate one. The command starts with the
+    process state a new process would have, and a call to exit comes back
+    here rather than ending the caller.
+
+Arguments:
+
+    Command - Supplies the command entry to run.
+
+    Arguments - Supplies an array of pointers to strings representing the
+        arguments.
+
+    ArgumentCount - Supplies the number of arguments on the command line.
+
+    ReturnValue - Supplies a pointer where the return value of the command
+        will be returned.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    SWISS_EXIT_TARGET ExitTarget;
+    PSTR OriginalApplication;
+    PSWISS_EXIT_TARGET OriginalExitTarget;
+    PSTR OriginalOptionArgument;
+    INT OriginalOptionError;
+    INT OriginalOptionIndex;
+    INT OriginalOptionOption;
+
+    //
+    // Start the command with fresh getopt state, as a new process would,
+    // and put the caller's state back afterwards. Setting the index to zero
+    // also resets the scanning state hidden inside getopt.
+    //
+
+    OriginalOptionArgument = optarg;
+    OriginalOptionError = opterr;
+    OriginalOptionIndex = optind;
+    OriginalOptionOption = optopt;
+    optind = 0;
+    opterr = 1;
+    OriginalApplication = SwSetCurrentApplicationName(Command->CommandName);
+    OriginalExitTarget = SwSetExitTarget(&ExitTarget);
+    if (setjmp(ExitTarget.JumpBuffer) == 0) {
+        *ReturnValue = Command->MainFunction(ArgumentCount, Arguments);
+
+    } else {
+        *ReturnValue = ExitTarget.Status;
+    }
+
+    SwSetExitTarget(OriginalExitTarget);
+    SwSetCurrentApplicationName(OriginalApplication);
+    optarg = OriginalOptionArgument;
+    opterr = OriginalOptionError;
+    optind = OriginalOptionIndex;
+    optopt = OriginalOptionOption;
+
+    //
+    // Push out anything the command buffered while its redirections are
+    // still in place, and don't let a failed write (like to a closed pipe)
+    // stick to the caller's standard out.
+    //
+
+    fflush(stdout);
+    clearerr(stdout);
+    fflush(NULL);
+    return;
+}
+
@@ -48,6 +48,7 @@ SwissRunCommand (
     ULONG ArgumentCount,
     BOOL SeparateProcess,
     BOOL Wait,
+    BOOL AllowNoFork,
     PINT ReturnValue
     );
 
@@ -72,8 +73,15 @@ Routine Description:
     Wait - Supplies a boolean indicating if this routine should not return
         until the command has completed.
 
+    AllowNoFork - Supplies a boolean indicating if commands marked safe to
+        run inside the caller may do so even though a separate process was
+        requested. This only applies if the caller is also going to wait.
+        A call to exit from the command returns here rather than ending the
+        caller.
+
     ReturnValue - Supplies a pointer where the return value of the command
-        will be returned on success.
+        will be returned on success. If a separate process was requested,
+        this is a wait status, even if the command actually ran in process.
 
 Return Value:
 
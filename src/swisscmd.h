@@ -41,6 +41,15 @@ Module Name:
 
 #define SWISS_APP_HIDDEN 0x00000002
 
+//
+// Set this flag if the app is safe to run directly inside a process that
+// invokes it, like the shell, rather than in a new process. Such an app must
+// not keep global state between runs, leak memory or descriptors, read
+// standard in through stdio, or call exit.
+//
+
+#define SWISS_APP_NOFORK 0x00000004
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -26,8 +26,10 @@ Module Name:
 //
 
 #include <dirent.h>
+#include <setjmp.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include "swlibos.h"
@@ -36,6 +38,13 @@ Module Name:
 // ---------------------------------------------------------------- Definitions
 //
 
+//
+// Route exit through swlib. A command running inside the shell's process
+// returns to the shell when it exits, rather than ending the shell too.
+//
+
+#define exit(_Status) SwExit(_Status)
+
 //
 // Define some default values.
 //
@@ -211,6 +220,105 @@ typedef struct _CHOWN_CONTEXT {
     gid_t FromGroup;
 } CHOWN_CONTEXT, *PCHOWN_CONTEXT;
 
+/*++
+
+Structure Description:
+
+    This structure stores the state for a block buffered line reader.
+
+Members:
+
+    Descriptor - Stores the file descriptor being read from.
+
+    Buffer - Stores a pointer to the data buffer. The allocation is always one
+        byte larger than the capacity to make room for a terminator.
+
+    Capacity - Stores the usable size of the buffer in bytes.
+
+    Offset - Stores the offset of the first unconsumed byte in the buffer.
+
+    Size - Stores the number of valid bytes in the buffer.
+
+    Scanned - Stores the number of bytes after the offset that are already
+        known not to contain a newline.
+
+    EndOfFile - Stores a boolean indicating if a read returned end of file.
+
+--*/
+
+typedef struct _SWISS_LINE_READER {
+    INT Descriptor;
+    PSTR Buffer;
+    size_t Capacity;
+    size_t Offset;
+    size_t Size;
+    size_t Scanned;
+    BOOL EndOfFile;
+} SWISS_LINE_READER, *PSWISS_LINE_READER;
+
+/*++
+
+Structure Description:
+
+    This structure stores the header of one block of memory in an arena. The
+    allocations follow the header directly.
+
+Members:
+
+    Next - Stores a pointer to the next block in the arena.
+
+    Size - Stores the number of bytes available after the header.
+
+    Used - Stores the number of bytes already handed out.
+
+--*/
+
+typedef struct _SWISS_ARENA_BLOCK {
+    struct _SWISS_ARENA_BLOCK *Next;
+    UINTN Size;
+    UINTN Used;
+} SWISS_ARENA_BLOCK, *PSWISS_ARENA_BLOCK;
+
+/*++
+
+Structure Description:
+
+    This structure stores the state for an arena allocator.
+
+Members:
+
+    Blocks - Stores a pointer to the list of blocks. The first block is the
+        one currently being allocated from.
+
+    BlockSize - Stores the size of each regular block.
+
+--*/
+
+typedef struct _SWISS_ARENA {
+    PSWISS_ARENA_BLOCK Blocks;
+    UINTN BlockSize;
+} SWISS_ARENA, *PSWISS_ARENA;
+
+/*++
+
+Structure Description:
+
+    This structure stores where a call to exit returns to while a command is
+    running inside another process.
+
+Members:
+
+    JumpBuffer - Stores the context to jump back to.
+
+    Status - Stores the status the command passed to exit.
+
+--*/
+
+typedef struct _SWISS_EXIT_TARGET {
+    jmp_buf JumpBuffer;
+    INT Status;
+} SWISS_EXIT_TARGET, *PSWISS_EXIT_TARGET;
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -270,6 +378,53 @@ Return Value:
 
 --*/
 
+PSWISS_EXIT_TARGET
+SwSetExitTarget (
+    PSWISS_EXIT_TARGET Target
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sets where calls to exit go. The target's jump buffer must
+    have been set with setjmp by a routine that is still running.
+
+Arguments:
+
+    Target - Supplies an optional pointer to the new exit target. Supply NULL
+        to make exit end the process again.
+
+Return Value:
+
+    Returns a pointer to the original exit target, which the caller should
+    restore when finished.
+
+--*/
+
+VOID
+SwExit (
+    INT Status
+    );
+
+/*++
+
+Routine Description:
+
+    This routine exits the current command. If an exit target is set, it
+    records the status and jumps back to the target. Otherwise it ends the
+    process.
+
+Arguments:
+
+    Status - Supplies the exit status.
+
+Return Value:
+
+    This routine does not return.
+
+--*/
+
 VOID
 SwPrintError (
     INT ErrorNumber,
@@ -636,6 +791,222 @@ Return Value:
 
 --*/
 
+//
+// Arena allocator functionality.
+//
+
+PSWISS_ARENA
+SwCreateArena (
+    UINTN BlockSize
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates an arena allocator. No memory is allocated from the
+    system until the first allocation is made.
+
+Arguments:
+
+    BlockSize - Supplies the size of each block the arena allocates from the
+        system.
+
+Return Value:
+
+    Returns a pointer to the new arena on success.
+
+    NULL on allocation failure.
+
+--*/
+
+VOID
+SwDestroyArena (
+    PSWISS_ARENA Arena
+    );
+
+/*++
+
+Routine Description:
+
+    This routine destroys an arena allocator, freeing every allocation made
+    from it.
+
+Arguments:
+
+    Arena - Supplies a pointer to the arena to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+SwResetArena (
+    PSWISS_ARENA Arena
+    );
+
+/*++
+
+Routine Description:
+
+    This routine frees every allocation made from an arena at once. One block
+    is kept around so that refilling the arena doesn't have to go straight
+    back to the system.
+
+Arguments:
+
+    Arena - Supplies a pointer to the arena to reset.
+
+Return Value:
+
+    None.
+
+--*/
+
+PVOID
+SwArenaAllocate (
+    PSWISS_ARENA Arena,
+    UINTN Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine allocates memory from an arena. The memory is suitably
+    aligned for any of the basic types, and lives until the arena is reset or
+    destroyed.
+
+Arguments:
+
+    Arena - Supplies a pointer to the arena.
+
+    Size - Supplies the number of bytes to allocate.
+
+Return Value:
+
+    Returns a pointer to the allocation on success.
+
+    NULL on allocation failure.
+
+--*/
+
+//
+// Line reader functionality.
+//
+
+PSWISS_LINE_READER
+SwCreateLineReader (
+    INT Descriptor
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates a block buffered line reader.
+
+Arguments:
+
+    Descriptor - Supplies the open file descriptor to read from. The reader
+        does not take ownership of the descriptor.
+
+Return Value:
+
+    Returns a pointer to the new line reader on success.
+
+    NULL on allocation failure.
+
+--*/
+
+VOID
+SwDestroyLineReader (
+    PSWISS_LINE_READER Reader
+    );
+
+/*++
+
+Routine Description:
+
+    This routine destroys a line reader. The underlying descriptor is not
+    closed.
+
+Arguments:
+
+    Reader - Supplies a pointer to the line reader to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+SwResetLineReader (
+    PSWISS_LINE_READER Reader,
+    INT Descriptor
+    );
+
+/*++
+
+Routine Description:
+
+    This routine points an existing line reader at a new descriptor, throwing
+    away any buffered data. This allows one buffer to be reused across many
+    inputs.
+
+Arguments:
+
+    Reader - Supplies a pointer to the line reader.
+
+    Descriptor - Supplies the new descriptor to read from.
+
+Return Value:
+
+    None.
+
+--*/
+
+INT
+SwReadLineSlice (
+    PSWISS_LINE_READER Reader,
+    PSTR *Line,
+    size_t *Length
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the next line from the given line reader. The line
+    is not copied: the returned pointer points directly into the reader's
+    buffer, and the newline is replaced with a null terminator in place.
+
+Arguments:
+
+    Reader - Supplies a pointer to the line reader.
+
+    Line - Supplies a pointer where a pointer to the line will be returned on
+        success. The line does not include the newline and is null terminated.
+        The line is only valid until the next call to read from or reset the
+        reader. The caller may modify the line contents in place.
+
+    Length - Supplies a pointer where the length of the line in bytes, not
+        including the null terminator, will be returned on success. The line
+        may contain embedded null characters.
+
+Return Value:
+
+    0 on success.
+
+    EOF if the end of the input was reached and no characters were seen.
+
+    Returns an error number on failure.
+
+--*/
+
 //
 // Copy file functionality.
 //
@@ -908,6 +1279,33 @@ Return Value:
 
 --*/
 
+ULONG
+SwHashString (
+    PSTR String,
+    UINTN StringSize
+    );
+
+/*++
+
+Routine Description:
+
+    This routine hashes a string. For those paying close attention, this
+    happens to be same hash function as the ELF image format. The shell uses
+    it for variable and function names, and swiss uses it to look up commands.
+
+Arguments:
+
+    String - Supplies a pointer to the string to hash.
+
+    StringSize - Supplies the size of the string in bytes including the null
+        terminator, which is not hashed.
+
+Return Value:
+
+    Returns the hash of the string.
+
+--*/
+
 BOOL
 SwRotatePointerArray (
     PVOID *Array,
@@ -0,0 +1,294 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+This project is dual licensed. You are receiving it under the terms of the
+GNU General Public License version 3 (GPLv3). Alternative licensing terms are
+available. Contact info@minocacorp.com for details. See the LICENSE file at the
+root of this project for complete licensing information.
+
+Module Name:
+
+    arena.c
+
+Abstract:
+
+    This module implements a simple arena allocator for the Swiss common
+    library. Allocations are carved sequentially out of large blocks and are
+    never freed individually; the whole arena is reset or destroyed at once.
+    This suits utilities that hold many small records with the same lifetime,
+    like the lines of a file.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    POSIX
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/lib/types.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../swlib.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the alignment of every arena allocation. This is 16 so that long
+// double and 16 byte vector types are safe to store in the arena.
+//
+
+#define SWISS_ARENA_ALIGNMENT 16
+
+//
+// Define the size of the header at the start of each block. Allocations
+// start after it, so it is rounded up to keep them aligned.
+//
+
+#define SWISS_ARENA_HEADER_SIZE \
+    ALIGN_RANGE_UP(sizeof(SWISS_ARENA_BLOCK), SWISS_ARENA_ALIGNMENT)
+
+//
+// Allocations bigger than this fraction of the block size get a block of
+// their own rather than wasting the rest of the current block.
+//
+
+#define SWISS_ARENA_LARGE_ALLOCATION_SHIFT 2
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+PSWISS_ARENA
+SwCreateArena (
+    UINTN BlockSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates an arena allocator. No memory is allocated from the
+    system until the first allocation is made.
+
+Arguments:
+
+    BlockSize - Supplies the size of each block the arena allocates from the
+        system.
+
+Return Value:
+
+    Returns a pointer to the new arena on success.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    PSWISS_ARENA Arena;
+
+    Arena = malloc(sizeof(SWISS_ARENA));
+    if (Arena == NULL) {
+        return NULL;
+    }
+
+    memset(Arena, 0, sizeof(SWISS_ARENA));
+    Arena->BlockSize = ALIGN_RANGE_UP(BlockSize, SWISS_ARENA_ALIGNMENT);
+    return Arena;
+}
+
+VOID
+SwDestroyArena (
+    PSWISS_ARENA Arena
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys an arena allocator, freeing every allocation made
+    from it.
+
+Arguments:
+
+    Arena - Supplies a pointer to the arena to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSWISS_ARENA_BLOCK Block;
+    PSWISS_ARENA_BLOCK Next;
+
+    Block = Arena->Blocks;
+    while (Block != NULL) {
+        Next = Block->Next;
+        free(Block);
+        Block = Next;
+    }
+
+    free(Arena);
+    return;
+}
+
+VOID
+SwResetArena (
+    PSWISS_ARENA Arena
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees every allocation made from an arena at once. One block
+    is kept around so that refilling the arena doesn't have to go straight
+    back to the system.
+
+Arguments:
+
+    Arena - Supplies a pointer to the arena to reset.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSWISS_ARENA_BLOCK Block;
+    PSWISS_ARENA_BLOCK Kept;
+    PSWISS_ARENA_BLOCK Next;
+
+    Kept = NULL;
+    Block = Arena->Blocks;
+    while (Block != NULL) {
+        Next = Block->Next;
+        if ((Kept == NULL) && (Block->Size == Arena->BlockSize)) {
+            Kept = Block;
+            Kept->Next = NULL;
+            Kept->Used = 0;
+
+        } else {
+            free(Block);
+        }
+
+        Block = Next;
+    }
+
+    Arena->Blocks = Kept;
+    return;
+}
+
+PVOID
+SwArenaAllocate (
+    PSWISS_ARENA Arena,
+    UINTN Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates memory from an arena. The memory is aligned to 16
+    bytes within blocks that come from malloc, so it is at least as aligned
+    as memory from malloc. It lives until the arena is reset or destroyed.
+
+Arguments:
+
+    Arena - Supplies a pointer to the arena.
+
+    Size - Supplies the number of bytes to allocate.
+
+Return Value:
+
+    Returns a pointer to the allocation on success.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    PSWISS_ARENA_BLOCK Block;
+    PVOID Buffer;
+    PSWISS_ARENA_BLOCK NewBlock;
+
+    Size = ALIGN_RANGE_UP(Size, SWISS_ARENA_ALIGNMENT);
+    Block = Arena->Blocks;
+    if ((Block != NULL) && (Block->Size - Block->Used >= Size)) {
+        Buffer = (PUCHAR)Block + SWISS_ARENA_HEADER_SIZE + Block->Used;
+        Block->Used += Size;
+        return Buffer;
+    }
+
+    //
+    // Big allocations get their own exactly sized block. It goes behind the
+    // current block so that small allocations can keep filling that one.
+    //
+
+    if (Size > (Arena->BlockSize >> SWISS_ARENA_LARGE_ALLOCATION_SHIFT)) {
+        NewBlock = malloc(SWISS_ARENA_HEADER_SIZE + Size);
+        if (NewBlock == NULL) {
+            return NULL;
+        }
+
+        NewBlock->Size = Size;
+        NewBlock->Used = Size;
+        if (Block != NULL) {
+            NewBlock->Next = Block->Next;
+            Block->Next = NewBlock;
+
+        } else {
+            NewBlock->Next = NULL;
+            Arena->Blocks = NewBlock;
+        }
+
+        return (PUCHAR)NewBlock + SWISS_ARENA_HEADER_SIZE;
+    }
+
+    NewBlock = malloc(SWISS_ARENA_HEADER_SIZE + Arena->BlockSize);
+    if (NewBlock == NULL) {
+        return NULL;
+    }
+
+    NewBlock->Next = Block;
+    NewBlock->Size = Arena->BlockSize;
+    NewBlock->Used = Size;
+    Arena->Blocks = NewBlock;
+    return (PUCHAR)NewBlock + SWISS_ARENA_HEADER_SIZE;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
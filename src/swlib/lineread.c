@@ -0,0 +1,382 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+This project is dual licensed. You are receiving it under the terms of the
+GNU General Public License version 3 (GPLv3). Alternative licensing terms are
+available. Contact info@minocacorp.com for details. See the LICENSE file at the
+root of this project for complete licensing information.
+
+Module Name:
+
+    lineread.c
+
+Abstract:
+
+    This module implements a block buffered line reader for the Swiss common
+    library. Input is read in large blocks and lines are handed out as slices
+    of the block buffer rather than being copied out a character at a time.
+
+Author:
+
+    agent 16-Oct-2026
+
+Environment:
+
+    POSIX
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/lib/types.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../swlib.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the size of each read the line reader makes.
+//
+
+#define SWISS_LINE_READER_BLOCK_SIZE (128 * 1024)
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+INT
+SwpFillLineReader (
+    PSWISS_LINE_READER Reader
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+PSWISS_LINE_READER
+SwCreateLineReader (
+    INT Descriptor
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a block buffered line reader.
+
+Arguments:
+
+    Descriptor - Supplies the open file descriptor to read from. The reader
+        does not take ownership of the descriptor.
+
+Return Value:
+
+    Returns a pointer to the new line reader on success.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    PSWISS_LINE_READER Reader;
+
+    Reader = malloc(sizeof(SWISS_LINE_READER));
+    if (Reader == NULL) {
+        return NULL;
+    }
+
+    memset(Reader, 0, sizeof(SWISS_LINE_READER));
+    Reader->Capacity = SWISS_LINE_READER_BLOCK_SIZE;
+
+    //
+    // Allocate one extra byte so that even a final unterminated line that
+    // fills the buffer can be null terminated in place.
+    //
+
+    Reader->Buffer = malloc(Reader->Capacity + 1);
+    if (Reader->Buffer == NULL) {
+        free(Reader);
+        return NULL;
+    }
+
+    SwResetLineReader(Reader, Descriptor);
+    return Reader;
+}
+
+VOID
+SwDestroyLineReader (
+    PSWISS_LINE_READER Reader
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys a line reader. The underlying descriptor is not
+    closed.
+
+Arguments:
+
+    Reader - Supplies a pointer to the line reader to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    free(Reader->Buffer);
+    free(Reader);
+    return;
+}
+
+VOID
+SwResetLineReader (
+    PSWISS_LINE_READER Reader,
+    INT Descriptor
+    )
+
+/*++
+
+Routine Description:
+
+    This routine points an existing line reader at a new descriptor, throwing
+    away any buffered data. This allows one buffer to be reused across many
+    inputs.
+
+Arguments:
+
+    Reader - Supplies a pointer to the line reader.
+
+    Descriptor - Supplies the new descriptor to read from.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    Reader->Descriptor = Descriptor;
+    Reader->Offset = 0;
+    Reader->Size = 0;
+    Reader->Scanned = 0;
+    Reader->EndOfFile = FALSE;
+    return;
+}
+
+INT
+SwReadLineSlice (
+    PSWISS_LINE_READER Reader,
+    PSTR *Line,
+    size_t *Length
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the next line from the given line reader. The line
+    is not copied: the returned pointer points directly into the reader's
+    buffer, and the newline is replaced with a null terminator in place.
+
+Arguments:
+
+    Reader - Supplies a pointer to the line reader.
+
+    Line - Supplies a pointer where a pointer to the line will be returned on
+        success. The line does not include the newline and is null terminated.
+        The line is only valid until the next call to read from or reset the
+        reader. The caller may modify the line contents in place.
+
+    Length - Supplies a pointer where the length of the line in bytes, not
+        including the null terminator, will be returned on success. The line
+        may contain embedded null characters.
+
+Return Value:
+
+    0 on success.
+
+    EOF if the end of the input was reached and no characters were seen.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    PSTR End;
+    size_t Remaining;
+    PSTR Start;
+    INT Status;
+
+    while (TRUE) {
+        Start = Reader->Buffer + Reader->Offset;
+        Remaining = Reader->Size - Reader->Offset;
+
+        assert(Reader->Scanned <= Remaining);
+
+        //
+        // Search only the portion that has not already been scanned, so that
+        // long lines spanning many reads are not searched repeatedly.
+        //
+
+        End = memchr(Start + Reader->Scanned,
+                     '\n',
+                     Remaining - Reader->Scanned);
+
+        if (End != NULL) {
+            *End = '\0';
+            *Line = Start;
+            *Length = End - Start;
+            Reader->Offset += *Length + 1;
+            Reader->Scanned = 0;
+            return 0;
+        }
+
+        Reader->Scanned = Remaining;
+        if (Reader->EndOfFile != FALSE) {
+            if (Remaining == 0) {
+                return EOF;
+            }
+
+            //
+            // The buffer always has space for one more byte beyond its
+            // capacity, so the final unterminated line can be terminated.
+            //
+
+            Start[Remaining] = '\0';
+            *Line = Start;
+            *Length = Remaining;
+            Reader->Offset = Reader->Size;
+            Reader->Scanned = 0;
+            return 0;
+        }
+
+        Status = SwpFillLineReader(Reader);
+        if (Status != 0) {
+            return Status;
+        }
+    }
+
+    //
+    // Execution never gets here.
+    //
+
+    assert(FALSE);
+
+    return EINVAL;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+INT
+SwpFillLineReader (
+    PSWISS_LINE_READER Reader
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads another block into the line reader, shifting the
+    partial line at the end of the buffer to the front and expanding the
+    buffer if a single line does not fit.
+
+Arguments:
+
+    Reader - Supplies a pointer to the line reader.
+
+Return Value:
+
+    0 on success, including when the end of the file is hit.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    ssize_t BytesRead;
+    size_t NewCapacity;
+    PSTR NewBuffer;
+    size_t Remaining;
+
+    //
+    // Move the remaining partial line to the start of the buffer.
+    //
+
+    Remaining = Reader->Size - Reader->Offset;
+    if (Reader->Offset != 0) {
+        if (Remaining != 0) {
+            memmove(Reader->Buffer,
+                    Reader->Buffer + Reader->Offset,
+                    Remaining);
+        }
+
+        Reader->Offset = 0;
+        Reader->Size = Remaining;
+    }
+
+    //
+    // If there's not at least half a block of free space, double the buffer.
+    // This only happens for lines longer than the block size.
+    //
+
+    if (Reader->Capacity - Reader->Size < SWISS_LINE_READER_BLOCK_SIZE / 2) {
+        NewCapacity = Reader->Capacity * 2;
+        NewBuffer = realloc(Reader->Buffer, NewCapacity + 1);
+        if (NewBuffer == NULL) {
+            return ENOMEM;
+        }
+
+        Reader->Buffer = NewBuffer;
+        Reader->Capacity = NewCapacity;
+    }
+
+    do {
+        BytesRead = read(Reader->Descriptor,
+                         Reader->Buffer + Reader->Size,
+                         Reader->Capacity - Reader->Size);
+
+    } while ((BytesRead < 0) && (errno == EINTR));
+
+    if (BytesRead < 0) {
+        return errno;
+    }
+
+    if (BytesRead == 0) {
+        Reader->EndOfFile = TRUE;
+
+    } else {
+        Reader->Size += BytesRead;
+    }
+
+    return 0;
+}
+
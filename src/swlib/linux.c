@@ -33,8 +33,10 @@ Module Name:
 
 #include <errno.h>
 #include <dirent.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/inotify.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include "../swlib.h"
@@ -43,6 +45,12 @@ Module Name:
 // ---------------------------------------------------------------- Definitions
 //
 
+//
+// Define the size of the buffer used to drain file watch notifications.
+//
+
+#define SWISS_FILE_WATCH_EVENT_BUFFER_SIZE 4096
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -265,6 +273,168 @@ Return Value:
     return 0;
 }
 
+int
+SwCreateFileWatch (
+    void
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates an object used to wait for changes to files.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns a descriptor for the file watch on success.
+
+    -1 on failure, and errno will be set to contain more information. This
+    is ENOSYS if the operating system has no way to watch files.
+
+--*/
+
+{
+
+    return inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+}
+
+int
+SwAddFileWatch (
+    int Watch,
+    const char *Path,
+    int Flags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts watching a file for changes. The watch follows the
+    file itself, so it keeps reporting changes after the file is renamed.
+
+Arguments:
+
+    Watch - Supplies the file watch descriptor.
+
+    Path - Supplies a pointer to the path of the file or directory to watch.
+
+    Flags - Supplies a bitfield of flags. See SW_FILE_WATCH_* definitions.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    uint32_t Mask;
+
+    Mask = IN_MODIFY | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF;
+    if ((Flags & SW_FILE_WATCH_DIRECTORY) != 0) {
+        Mask = IN_CREATE | IN_MOVED_TO | IN_ONLYDIR;
+    }
+
+    if (inotify_add_watch(Watch, Path, Mask) < 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int
+SwWaitForFileWatch (
+    int Watch,
+    int Timeout
+    )
+
+/*++
+
+Routine Description:
+
+    This routine waits for a change to any of the files being watched. All
+    pending notifications are consumed.
+
+Arguments:
+
+    Watch - Supplies the file watch descriptor.
+
+    Timeout - Supplies the maximum number of milliseconds to wait, or -1 to
+        wait indefinitely.
+
+Return Value:
+
+    1 if a change was seen.
+
+    0 if the timeout expired first.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    char Events[SWISS_FILE_WATCH_EVENT_BUFFER_SIZE];
+    struct pollfd Poll;
+    int Result;
+
+    Poll.fd = Watch;
+    Poll.events = POLLIN;
+    Poll.revents = 0;
+    do {
+        Result = poll(&Poll, 1, Timeout);
+
+    } while ((Result < 0) && (errno == EINTR));
+
+    if (Result <= 0) {
+        return Result;
+    }
+
+    //
+    // The caller rechecks everything it is watching, so the events themselves
+    // don't matter. Just drain them so the next wait blocks again.
+    //
+
+    while (read(Watch, Events, sizeof(Events)) > 0) {
+        continue;
+    }
+
+    return 1;
+}
+
+void
+SwDestroyFileWatch (
+    int Watch
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys a file watch.
+
+Arguments:
+
+    Watch - Supplies the file watch descriptor.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    close(Watch);
+    return;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
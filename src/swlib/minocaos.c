@@ -337,6 +337,134 @@ Return Value:
     return 0;
 }
 
+int
+SwCreateFileWatch (
+    void
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates an object used to wait for changes to files.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns a descriptor for the file watch on success.
+
+    -1 on failure, and errno will be set to contain more information. This
+    is ENOSYS if the operating system has no way to watch files.
+
+--*/
+
+{
+
+    errno = ENOSYS;
+    return -1;
+}
+
+int
+SwAddFileWatch (
+    int Watch,
+    const char *Path,
+    int Flags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts watching a file for changes. The watch follows the
+    file itself, so it keeps reporting changes after the file is renamed.
+
+Arguments:
+
+    Watch - Supplies the file watch descriptor.
+
+    Path - Supplies a pointer to the path of the file or directory to watch.
+
+    Flags - Supplies a bitfield of flags. See SW_FILE_WATCH_* definitions.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    errno = ENOSYS;
+    return -1;
+}
+
+int
+SwWaitForFileWatch (
+    int Watch,
+    int Timeout
+    )
+
+/*++
+
+Routine Description:
+
+    This routine waits for a change to any of the files being watched. All
+    pending notifications are consumed.
+
+Arguments:
+
+    Watch - Supplies the file watch descriptor.
+
+    Timeout - Supplies the maximum number of milliseconds to wait, or -1 to
+        wait indefinitely.
+
+Return Value:
+
+    1 if a change was seen.
+
+    0 if the timeout expired first.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    errno = ENOSYS;
+    return -1;
+}
+
+void
+SwDestroyFileWatch (
+    int Watch
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys a file watch.
+
+Arguments:
+
+    Watch - Supplies the file watch descriptor.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
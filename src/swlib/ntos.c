@@ -40,6 +40,7 @@ Module Name:
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <process.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -83,6 +84,28 @@ Module Name:
 // ------------------------------------------------------ Data Type Definitions
 //
 
+/*++
+
+Structure Description:
+
+    This structure defines a thread created by the swiss library.
+
+Members:
+
+    Handle - Stores the Windows thread handle.
+
+    Routine - Stores the routine the thread runs.
+
+    Parameter - Stores the parameter to pass to the routine.
+
+--*/
+
+typedef struct _SWISS_THREAD {
+    HANDLE Handle;
+    PSWISS_THREAD_ROUTINE Routine;
+    void *Parameter;
+} SWISS_THREAD, *PSWISS_THREAD;
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
@@ -124,6 +147,12 @@ SwpReadSheBang (
     char **NewArgument
     );
 
+unsigned
+__stdcall
+SwpThreadStart (
+    void *Parameter
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -1574,6 +1603,38 @@ Return Value:
     return -1;
 }
 
+int
+SwMakeExitStatus (
+    int ExitCode
+    )
+
+/*++
+
+Routine Description:
+
+    This routine builds the status SwWaitPid would return for a child that
+    exited normally with the given code. It lets a command run in the
+    current process report its result the same way as one run in a child.
+
+Arguments:
+
+    ExitCode - Supplies the exit code the command returned.
+
+Return Value:
+
+    Returns the wait status for the given exit code.
+
+--*/
+
+{
+
+    //
+    // Windows reports plain exit codes, so there's nothing to convert.
+    //
+
+    return ExitCode;
+}
+
 int
 SwKill (
     pid_t ProcessId,
@@ -3743,6 +3804,97 @@ Return Value:
     return Count;
 }
 
+int
+SwCreateThread (
+    PSWISS_THREAD_ROUTINE ThreadRoutine,
+    void *Parameter,
+    void **Thread
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new thread in the current process.
+
+Arguments:
+
+    ThreadRoutine - Supplies a pointer to the routine the thread runs.
+
+    Parameter - Supplies the parameter to pass to the thread routine.
+
+    Thread - Supplies a pointer where a handle to the thread will be returned
+        on success. The caller must pass this handle to SwJoinThread.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    PSWISS_THREAD NewThread;
+
+    *Thread = NULL;
+    NewThread = malloc(sizeof(SWISS_THREAD));
+    if (NewThread == NULL) {
+        return ENOMEM;
+    }
+
+    NewThread->Routine = ThreadRoutine;
+    NewThread->Parameter = Parameter;
+    NewThread->Handle = (HANDLE)_beginthreadex(NULL,
+                                               0,
+                                               SwpThreadStart,
+                                               NewThread,
+                                               0,
+                                               NULL);
+
+    if (NewThread->Handle == NULL) {
+        free(NewThread);
+        return errno;
+    }
+
+    *Thread = NewThread;
+    return 0;
+}
+
+void
+SwJoinThread (
+    void *Thread
+    )
+
+/*++
+
+Routine Description:
+
+    This routine waits for a thread created with SwCreateThread to finish, and
+    releases its resources.
+
+Arguments:
+
+    Thread - Supplies the handle returned when the thread was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSWISS_THREAD SwissThread;
+
+    SwissThread = Thread;
+    WaitForSingleObject(SwissThread->Handle, INFINITE);
+    CloseHandle(SwissThread->Handle);
+    free(SwissThread);
+    return;
+}
+
 int
 sigaction (
     int SignalNumber,
@@ -3791,6 +3943,134 @@ Return Value:
     return 0;
 }
 
+int
+SwCreateFileWatch (
+    void
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates an object used to wait for changes to files.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns a descriptor for the file watch on success.
+
+    -1 on failure, and errno will be set to contain more information. This
+    is ENOSYS if the operating system has no way to watch files.
+
+--*/
+
+{
+
+    errno = ENOSYS;
+    return -1;
+}
+
+int
+SwAddFileWatch (
+    int Watch,
+    const char *Path,
+    int Flags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts watching a file for changes. The watch follows the
+    file itself, so it keeps reporting changes after the file is renamed.
+
+Arguments:
+
+    Watch - Supplies the file watch descriptor.
+
+    Path - Supplies a pointer to the path of the file or directory to watch.
+
+    Flags - Supplies a bitfield of flags. See SW_FILE_WATCH_* definitions.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    errno = ENOSYS;
+    return -1;
+}
+
+int
+SwWaitForFileWatch (
+    int Watch,
+    int Timeout
+    )
+
+/*++
+
+Routine Description:
+
+    This routine waits for a change to any of the files being watched. All
+    pending notifications are consumed.
+
+Arguments:
+
+    Watch - Supplies the file watch descriptor.
+
+    Timeout - Supplies the maximum number of milliseconds to wait, or -1 to
+        wait indefinitely.
+
+Return Value:
+
+    1 if a change was seen.
+
+    0 if the timeout expired first.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    errno = ENOSYS;
+    return -1;
+}
+
+void
+SwDestroyFileWatch (
+    int Watch
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys a file watch.
+
+Arguments:
+
+    Watch - Supplies the file watch descriptor.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -4282,3 +4562,35 @@ Return Value:
     return Status;
 }
 
+unsigned
+__stdcall
+SwpThreadStart (
+    void *Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is the Windows thread entry point for threads created by the
+    swiss library. It calls the real thread routine.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the swiss thread structure.
+
+Return Value:
+
+    0 always.
+
+--*/
+
+{
+
+    PSWISS_THREAD Thread;
+
+    Thread = Parameter;
+    Thread->Routine(Thread->Parameter);
+    return 0;
+}
+
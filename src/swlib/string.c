@@ -517,6 +517,57 @@ Return Value:
     return;
 }
 
+ULONG
+SwHashString (
+    PSTR String,
+    UINTN StringSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine hashes a string. For those paying close attention, this
+    happens to be same hash function as the ELF image format. The shell uses
+    it for variable and function names, and swiss uses it to look up commands.
+
+Arguments:
+
+    String - Supplies a pointer to the string to hash.
+
+    StringSize - Supplies the size of the string in bytes including the null
+        terminator, which is not hashed.
+
+Return Value:
+
+    Returns the hash of the string.
+
+--*/
+
+{
+
+    ULONG Hash;
+    ULONG Temporary;
+
+    assert(StringSize != 0);
+
+    StringSize -= 1;
+    Hash = 0;
+    while (StringSize != 0) {
+        Hash = (Hash << 4) + (UCHAR)*String;
+        Temporary = Hash & 0xF0000000;
+        if (Temporary != 0) {
+            Hash ^= Temporary >> 24;
+        }
+
+        Hash &= ~Temporary;
+        String += 1;
+        StringSize -= 1;
+    }
+
+    return Hash;
+}
+
 BOOL
 SwRotatePointerArray (
     PVOID *Array,
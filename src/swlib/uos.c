@@ -83,6 +83,28 @@ Module Name:
 // ------------------------------------------------------ Data Type Definitions
 //
 
+/*++
+
+Structure Description:
+
+    This structure defines a thread created by the swiss library.
+
+Members:
+
+    Thread - Stores the pthread identifier.
+
+    Routine - Stores the routine the thread runs.
+
+    Parameter - Stores the parameter to pass to the routine.
+
+--*/
+
+typedef struct _SWISS_THREAD {
+    pthread_t Thread;
+    PSWISS_THREAD_ROUTINE Routine;
+    void *Parameter;
+} SWISS_THREAD, *PSWISS_THREAD;
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
@@ -108,6 +130,11 @@ SwpSetColors (
     CONSOLE_COLOR Foreground
     );
 
+void *
+SwpThreadStart (
+    void *Parameter
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -1764,6 +1791,39 @@ Return Value:
     return Result;
 }
 
+int
+SwMakeExitStatus (
+    int ExitCode
+    )
+
+/*++
+
+Routine Description:
+
+    This routine builds the status SwWaitPid would return for a child that
+    exited normally with the given code. It lets a command run in the
+    current process report its result the same way as one run in a child.
+
+Arguments:
+
+    ExitCode - Supplies the exit code the command returned.
+
+Return Value:
+
+    Returns the wait status for the given exit code.
+
+--*/
+
+{
+
+    //
+    // This is the traditional layout, which WIFEXITED and WEXITSTATUS
+    // decode.
+    //
+
+    return (ExitCode & 0xFF) << 8;
+}
+
 int
 SwKill (
     pid_t ProcessId,
@@ -3228,6 +3288,95 @@ Return Value:
     return Result;
 }
 
+int
+SwCreateThread (
+    PSWISS_THREAD_ROUTINE ThreadRoutine,
+    void *Parameter,
+    void **Thread
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new thread in the current process.
+
+Arguments:
+
+    ThreadRoutine - Supplies a pointer to the routine the thread runs.
+
+    Parameter - Supplies the parameter to pass to the thread routine.
+
+    Thread - Supplies a pointer where a handle to the thread will be returned
+        on success. The caller must pass this handle to SwJoinThread.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    PSWISS_THREAD NewThread;
+    int Status;
+
+    *Thread = NULL;
+    NewThread = malloc(sizeof(SWISS_THREAD));
+    if (NewThread == NULL) {
+        return ENOMEM;
+    }
+
+    NewThread->Routine = ThreadRoutine;
+    NewThread->Parameter = Parameter;
+    Status = pthread_create(&(NewThread->Thread),
+                            NULL,
+                            SwpThreadStart,
+                            NewThread);
+
+    if (Status != 0) {
+        free(NewThread);
+        return Status;
+    }
+
+    *Thread = NewThread;
+    return 0;
+}
+
+void
+SwJoinThread (
+    void *Thread
+    )
+
+/*++
+
+Routine Description:
+
+    This routine waits for a thread created with SwCreateThread to finish, and
+    releases its resources.
+
+Arguments:
+
+    Thread - Supplies the handle returned when the thread was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSWISS_THREAD SwissThread;
+
+    SwissThread = Thread;
+    pthread_join(SwissThread->Thread, NULL);
+    free(SwissThread);
+    return;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -3558,3 +3707,34 @@ Return Value:
     return 0;
 }
 
+void *
+SwpThreadStart (
+    void *Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is the pthread entry point for threads created by the swiss
+    library. It calls the real thread routine.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the swiss thread structure.
+
+Return Value:
+
+    NULL always.
+
+--*/
+
+{
+
+    PSWISS_THREAD Thread;
+
+    Thread = Parameter;
+    Thread->Routine(Thread->Parameter);
+    return NULL;
+}
+
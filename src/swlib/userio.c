@@ -92,6 +92,13 @@ SwpPrintDirectoryMessage (
 
 PSTR SwCurrentApplication;
 
+//
+// Store a pointer to where exit jumps back to, if a command is running inside
+// another one's process.
+//
+
+PSWISS_EXIT_TARGET SwExitTarget;
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -157,6 +164,80 @@ Return Value:
     return OriginalName;
 }
 
+PSWISS_EXIT_TARGET
+SwSetExitTarget (
+    PSWISS_EXIT_TARGET Target
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets where calls to exit go. The target's jump buffer must
+    have been set with setjmp by a routine that is still running.
+
+Arguments:
+
+    Target - Supplies an optional pointer to the new exit target. Supply NULL
+        to make exit end the process again.
+
+Return Value:
+
+    Returns a pointer to the original exit target, which the caller should
+    restore when finished.
+
+--*/
+
+{
+
+    PSWISS_EXIT_TARGET OriginalTarget;
+
+    OriginalTarget = SwExitTarget;
+    SwExitTarget = Target;
+    return OriginalTarget;
+}
+
+VOID
+SwExit (
+    INT Status
+    )
+
+/*++
+
+Routine Description:
+
+    This routine exits the current command. If an exit target is set, it
+    records the status and jumps back to the target. Otherwise it ends the
+    process.
+
+Arguments:
+
+    Status - Supplies the exit status.
+
+Return Value:
+
+    This routine does not return.
+
+--*/
+
+{
+
+    PSWISS_EXIT_TARGET Target;
+
+    Target = SwExitTarget;
+    if (Target != NULL) {
+        SwExitTarget = NULL;
+        Target->Status = Status;
+        longjmp(Target->JumpBuffer, 1);
+    }
+
+    //
+    // The parentheses keep this from being the exit macro.
+    //
+
+    (exit)(Status);
+}
+
 VOID
 SwPrintError (
     INT ErrorNumber,
@@ -708,8 +789,9 @@ Return Value:
     CHAR Suffix;
     CHAR Suffix2;
 
+    errno = 0;
     Size = strtoull(String, &AfterScan, 10);
-    if (String == AfterScan) {
+    if ((String == AfterScan) || (errno == ERANGE)) {
         return -1ULL;
     }
 
@@ -755,6 +837,10 @@ Return Value:
         return -1ULL;
     }
 
+    if (Size > (-1ULL / Multiplier)) {
+        return -1ULL;
+    }
+
     return Size * Multiplier;
 }
 
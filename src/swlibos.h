@@ -53,6 +53,14 @@ Module Name:
 
 #define SYSTEM_NAME_STRING_SIZE 80
 
+//
+// Set this flag when adding a file watch on a directory to be notified of
+// entries being created or moved into it, rather than of changes to the
+// directory itself.
+//
+
+#define SW_FILE_WATCH_DIRECTORY 0x00000001
+
 //
 // Define some constants that may not be defined in some environments.
 //
@@ -654,6 +662,29 @@ typedef struct _SWISS_SIGNAL_NAME {
     char *SignalName;
 } SWISS_SIGNAL_NAME, *PSWISS_SIGNAL_NAME;
 
+typedef
+void
+(*PSWISS_THREAD_ROUTINE) (
+    void *Parameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine is the entry point for a thread created with
+    SwCreateThread.
+
+Arguments:
+
+    Parameter - Supplies the parameter passed when the thread was created.
+
+Return Value:
+
+    None.
+
+--*/
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -1487,6 +1518,29 @@ Return Value:
 
 --*/
 
+int
+SwMakeExitStatus (
+    int ExitCode
+    );
+
+/*++
+
+Routine Description:
+
+    This routine builds the status SwWaitPid would return for a child that
+    exited normally with the given code. It lets a command run in the
+    current process report its result the same way as one run in a child.
+
+Arguments:
+
+    ExitCode - Supplies the exit code the command returned.
+
+Return Value:
+
+    Returns the wait status for the given exit code.
+
+--*/
+
 int
 SwKill (
     pid_t ProcessId,
@@ -2571,3 +2625,160 @@ Return Value:
 
 --*/
 
+int
+SwCreateThread (
+    PSWISS_THREAD_ROUTINE ThreadRoutine,
+    void *Parameter,
+    void **Thread
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates a new thread in the current process.
+
+Arguments:
+
+    ThreadRoutine - Supplies a pointer to the routine the thread runs.
+
+    Parameter - Supplies the parameter to pass to the thread routine.
+
+    Thread - Supplies a pointer where a handle to the thread will be returned
+        on success. The caller must pass this handle to SwJoinThread.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+void
+SwJoinThread (
+    void *Thread
+    );
+
+/*++
+
+Routine Description:
+
+    This routine waits for a thread created with SwCreateThread to finish, and
+    releases its resources.
+
+Arguments:
+
+    Thread - Supplies the handle returned when the thread was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+int
+SwCreateFileWatch (
+    void
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates an object used to wait for changes to files.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns a descriptor for the file watch on success.
+
+    -1 on failure, and errno will be set to contain more information. This
+    is ENOSYS if the operating system has no way to watch files.
+
+--*/
+
+int
+SwAddFileWatch (
+    int Watch,
+    const char *Path,
+    int Flags
+    );
+
+/*++
+
+Routine Description:
+
+    This routine starts watching a file for changes. The watch follows the
+    file itself, so it keeps reporting changes after the file is renamed.
+
+Arguments:
+
+    Watch - Supplies the file watch descriptor.
+
+    Path - Supplies a pointer to the path of the file or directory to watch.
+
+    Flags - Supplies a bitfield of flags. See SW_FILE_WATCH_* definitions.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+int
+SwWaitForFileWatch (
+    int Watch,
+    int Timeout
+    );
+
+/*++
+
+Routine Description:
+
+    This routine waits for a change to any of the files being watched. All
+    pending notifications are consumed.
+
+Arguments:
+
+    Watch - Supplies the file watch descriptor.
+
+    Timeout - Supplies the maximum number of milliseconds to wait, or -1 to
+        wait indefinitely.
+
+Return Value:
+
+    1 if a change was seen.
+
+    0 if the timeout expired first.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+void
+SwDestroyFileWatch (
+    int Watch
+    );
+
+/*++
+
+Routine Description:
+
+    This routine destroys a file watch.
+
+Arguments:
+
+    Watch - Supplies the file watch descriptor.
+
+Return Value:
+
+    None.
+
+--*/
+
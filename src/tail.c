@@ -42,6 +42,12 @@ Module Name:
 
 #include "swlib.h"
 
+#if defined(__SSE2__)
+
+#include <emmintrin.h>
+
+#endif
+
 //
 // ---------------------------------------------------------------- Definitions
 //
@@ -50,7 +56,7 @@ Module Name:
 #define TAIL_VERSION_MINOR 0
 
 #define TAIL_USAGE                                                             \
-    "usage: tail [-f] [-c number | -n number] [file]\n"                        \
+    "usage: tail [-fFqv] [-c number | -n number] [file...]\n"                  \
     "The tail command copies its input to standard output starting at the \n"  \
     "given position. Positions start with + to specify an offset from the \n"  \
     "beginning of the file, or - for offsets from the end of the file. \n"     \
@@ -61,13 +67,18 @@ Module Name:
     "        input has been copied. Read and copy further bytes as they \n"    \
     "        become available. If no file operand is specified and standard \n"\
     "        in is a pipe, this option is ignored.\n"                          \
+    "  -F -- Like -f, but follow the file name rather than the open file. \n"  \
+    "        If the file is replaced, as when a log is rotated, or does not \n"\
+    "        exist yet, keep trying to open it.\n"                             \
     "  -c, --bytes=number -- Output the first or last number of bytes, \n"     \
     "        depending on whether a + or - is prepended to the number.\n"      \
     "  -n, --lines=number -- Output the first or last number of lines.\n"      \
+    "  -q, --quiet, --silent -- Never print headers with file names.\n"        \
+    "  -v, --verbose -- Always print headers with file names.\n"               \
     "  --help -- Show this help text and exit.\n"                              \
     "  --version - Show the application version information and exit.\n"
 
-#define TAIL_OPTIONS_STRING "fc:n:"
+#define TAIL_OPTIONS_STRING "fFc:n:qv"
 
 //
 // Define tail options.
@@ -91,6 +102,25 @@ Module Name:
 
 #define TAIL_OPTION_FROM_END 0x00000004
 
+//
+// This option is set to follow files by name, reopening them if they are
+// replaced.
+//
+
+#define TAIL_OPTION_FOLLOW_NAME 0x00000008
+
+//
+// This option is set to print a header with the file name before its output.
+//
+
+#define TAIL_OPTION_PRINT_NAMES 0x00000010
+
+//
+// This option is set to never print file name headers.
+//
+
+#define TAIL_OPTION_QUIET 0x00000020
+
 //
 // Define the default offset.
 //
@@ -98,19 +128,170 @@ Module Name:
 #define TAIL_DEFAULT_OFFSET 10
 
 //
-// Define the maximum size of a "line" as far as keeping a buffer for it goes.
+// Define the size of the blocks the input is read in.
+//
+
+#define TAIL_BLOCK_SIZE 0x10000
+
+//
+// Define how often files are checked for changes when following without a
+// way to be notified of them, in milliseconds.
 //
 
-#define TAIL_MAX_LINE 2048
+#define TAIL_FOLLOW_INTERVAL 1000
 
 //
 // ------------------------------------------------------ Data Type Definitions
 //
 
+/*++
+
+Structure Description:
+
+    This structure stores the state of one file being printed by tail.
+
+Members:
+
+    Name - Stores a pointer to the name of the file.
+
+    Input - Stores a pointer to the open file, or NULL if it isn't open.
+
+    Regular - Stores a boolean indicating if the input is a regular file that
+        can be seeked on.
+
+    Inaccessible - Stores a boolean indicating that a failure to open the file
+        has already been reported.
+
+    StandardInput - Stores a boolean indicating that this is standard in,
+        which has no name to watch or reopen.
+
+    Device - Stores the device the open file lives on. Along with the inode
+        this is used to notice when the name refers to a different file.
+
+    Inode - Stores the file serial number of the open file.
+
+--*/
+
+typedef struct _TAIL_FILE {
+    PSTR Name;
+    FILE *Input;
+    BOOL Regular;
+    BOOL Inaccessible;
+    BOOL StandardInput;
+    dev_t Device;
+    ino_t Inode;
+} TAIL_FILE, *PTAIL_FILE;
+
+/*++
+
+Structure Description:
+
+    This structure stores the state of the tail utility.
+
+Members:
+
+    Options - Stores the bitfield of application options. See TAIL_OPTION_*
+        definitions.
+
+    Offset - Stores the number of lines or bytes to print or skip.
+
+    Files - Stores the array of files to print.
+
+    FileCount - Stores the number of elements in the files array.
+
+    LastFile - Stores a pointer to the file whose header was printed most
+        recently.
+
+    HeaderPrinted - Stores a boolean indicating if any header has been
+        printed yet. Headers after the first are separated by a blank line.
+
+    Buffer - Stores a pointer to the buffer used to copy file contents.
+
+    Watch - Stores the descriptor used to wait for file changes, or -1 if
+        the files are polled instead.
+
+    WatchTimeout - Stores the number of milliseconds to wait for a change
+        before checking all the files anyway, or -1 to wait indefinitely.
+
+--*/
+
+typedef struct _TAIL_CONTEXT {
+    ULONG Options;
+    ULONGLONG Offset;
+    PTAIL_FILE Files;
+    ULONG FileCount;
+    PTAIL_FILE LastFile;
+    BOOL HeaderPrinted;
+    PUCHAR Buffer;
+    int Watch;
+    int WatchTimeout;
+} TAIL_CONTEXT, *PTAIL_CONTEXT;
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
 
+INT
+TailOpenFile (
+    PTAIL_FILE File
+    );
+
+INT
+TailPrintFile (
+    PTAIL_CONTEXT Context,
+    PTAIL_FILE File
+    );
+
+INT
+TailFollow (
+    PTAIL_CONTEXT Context
+    );
+
+VOID
+TailWatchFile (
+    PTAIL_CONTEXT Context,
+    PTAIL_FILE File
+    );
+
+VOID
+TailCheckFileName (
+    PTAIL_CONTEXT Context,
+    PTAIL_FILE File
+    );
+
+INT
+TailCopyNewData (
+    PTAIL_CONTEXT Context,
+    PTAIL_FILE File
+    );
+
+VOID
+TailPrintHeader (
+    PTAIL_CONTEXT Context,
+    PTAIL_FILE File
+    );
+
+INT
+TailSeekLastLines (
+    FILE *Input,
+    ULONGLONG FileSize,
+    ULONGLONG LineCount
+    );
+
+INT
+TailPrintLastLines (
+    FILE *Input,
+    ULONGLONG LineCount
+    );
+
+BOOL
+TailFindLinesStart (
+    PUCHAR Buffer,
+    UINTN Size,
+    PULONGLONG LineCount,
+    PUINTN Start
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -119,6 +300,9 @@ struct option TailLongOptions[] = {
     {"follow", no_argument, 0, 'f'},
     {"bytes", required_argument, 0, 'c'},
     {"lines", required_argument, 0, 'n'},
+    {"quiet", no_argument, 0, 'q'},
+    {"silent", no_argument, 0, 'q'},
+    {"verbose", no_argument, 0, 'v'},
     {"help", no_argument, 0, 'h'},
     {"version", no_argument, 0, 'V'},
     {NULL, 0, 0, 0},
@@ -157,27 +341,21 @@ Return Value:
 
     PSTR Argument;
     ULONG ArgumentIndex;
-    UINTN BackupCount;
-    PUCHAR Buffer;
-    UINTN BufferNextIndex;
-    UINTN BufferSize;
-    UINTN BufferValidSize;
-    INT Character;
-    PSTR FileName;
-    FILE *Input;
+    TAIL_CONTEXT Context;
+    PTAIL_FILE File;
+    ULONG FileIndex;
+    BOOL Follow;
     ULONGLONG Multiplier;
-    ULONGLONG Offset;
     INT Option;
-    ULONG Options;
-    UINTN StartIndex;
-    struct stat Stat;
     int Status;
+    int TotalStatus;
 
-    Buffer = NULL;
-    Input = NULL;
+    memset(&Context, 0, sizeof(TAIL_CONTEXT));
+    Context.Watch = -1;
     Multiplier = 1;
-    Offset = TAIL_DEFAULT_OFFSET;
-    Options = TAIL_OPTION_FROM_END | TAIL_OPTION_LINES;
+    Context.Offset = TAIL_DEFAULT_OFFSET;
+    Context.Options = TAIL_OPTION_FROM_END | TAIL_OPTION_LINES;
+    TotalStatus = 0;
 
     //
     // Handle something like tail -40 myfile or tail -4.
@@ -186,8 +364,8 @@ Return Value:
     if (((ArgumentCount == 2) || (ArgumentCount == 3)) &&
         (Arguments[1][0] == '-') && (isdigit(Arguments[1][1]))) {
 
-        Offset = strtoull(Arguments[1] + 1, NULL, 10);
-        Options |= TAIL_OPTION_FROM_END;
+        Context.Offset = strtoull(Arguments[1] + 1, NULL, 10);
+        Context.Options |= TAIL_OPTION_FROM_END;
         ArgumentIndex = 2;
 
     } else {
@@ -214,16 +392,22 @@ Return Value:
 
             switch (Option) {
             case 'f':
-                Options |= TAIL_OPTION_FOLLOW;
+                Context.Options |= TAIL_OPTION_FOLLOW;
+                break;
+
+            case 'F':
+                Context.Options |= TAIL_OPTION_FOLLOW |
+                                   TAIL_OPTION_FOLLOW_NAME;
+
                 break;
 
             case 'c':
             case 'n':
                 if (Option == 'c') {
-                    Options &= ~TAIL_OPTION_LINES;
+                    Context.Options &= ~TAIL_OPTION_LINES;
 
                 } else {
-                    Options |= TAIL_OPTION_LINES;
+                    Context.Options |= TAIL_OPTION_LINES;
                 }
 
                 Argument = optarg;
@@ -231,18 +415,18 @@ Return Value:
                 assert(Argument != NULL);
 
                 if (*Argument == '+') {
-                    Options &= ~TAIL_OPTION_FROM_END;
+                    Context.Options &= ~TAIL_OPTION_FROM_END;
                     Argument += 1;
 
                 } else {
-                    Options |= TAIL_OPTION_FROM_END;
+                    Context.Options |= TAIL_OPTION_FROM_END;
                     if (*Argument == '-') {
                         Argument += 1;
                     }
                 }
 
-                Offset = SwParseFileSize(Argument);
-                if (Offset == -1ULL) {
+                Context.Offset = SwParseFileSize(Argument);
+                if (Context.Offset == -1ULL) {
                     SwPrintError(0, Argument, "Invalid size");
                     Status = EINVAL;
                     goto MainEnd;
@@ -250,6 +434,16 @@ Return Value:
 
                 break;
 
+            case 'q':
+                Context.Options |= TAIL_OPTION_QUIET;
+                Context.Options &= ~TAIL_OPTION_PRINT_NAMES;
+                break;
+
+            case 'v':
+                Context.Options |= TAIL_OPTION_PRINT_NAMES;
+                Context.Options &= ~TAIL_OPTION_QUIET;
+                break;
+
             case 'V':
                 SwPrintVersion(TAIL_VERSION_MAJOR, TAIL_VERSION_MINOR);
                 return 1;
@@ -274,261 +468,1086 @@ Return Value:
         ArgumentIndex = ArgumentCount;
     }
 
-    FileName = NULL;
-    if (ArgumentIndex < ArgumentCount) {
-        FileName = Arguments[ArgumentIndex];
-        ArgumentIndex += 1;
+    //
+    // Use standard in if no files were specified.
+    //
+
+    Context.FileCount = ArgumentCount - ArgumentIndex;
+    if (Context.FileCount == 0) {
+        Context.FileCount = 1;
     }
 
-    if (ArgumentIndex < ArgumentCount) {
-        SwPrintError(0, Arguments[ArgumentIndex], "Unexpected operand");
-        Status = EINVAL;
+    Context.Files = malloc(Context.FileCount * sizeof(TAIL_FILE));
+    Context.Buffer = malloc(TAIL_BLOCK_SIZE);
+    if ((Context.Files == NULL) || (Context.Buffer == NULL)) {
+        Status = ENOMEM;
         goto MainEnd;
     }
 
-    //
-    // Open up the file if one was specified, or use standard in (in which case
-    // the follow option is ignored).
-    //
-
-    if (FileName != NULL) {
-        Input = fopen(FileName, "r");
-        if (Input == NULL) {
-            Status = errno;
-            SwPrintError(Status, FileName, "Unable to open");
-            goto MainEnd;
+    memset(Context.Files, 0, Context.FileCount * sizeof(TAIL_FILE));
+    for (FileIndex = 0; FileIndex < Context.FileCount; FileIndex += 1) {
+        File = &(Context.Files[FileIndex]);
+        File->Name = "-";
+        if (ArgumentIndex + FileIndex < ArgumentCount) {
+            File->Name = Arguments[ArgumentIndex + FileIndex];
         }
+    }
 
-    } else {
-        FileName = "(stdin)";
-        Input = stdin;
-        Options &= ~TAIL_OPTION_FOLLOW;
+    if ((Context.FileCount > 1) &&
+        ((Context.Options & TAIL_OPTION_QUIET) == 0)) {
+
+        Context.Options |= TAIL_OPTION_PRINT_NAMES;
     }
 
-    assert(Offset != 0);
+    //
+    // Starting from line or byte zero is the same as starting from the first.
+    //
 
-    if ((Options & TAIL_OPTION_FROM_END) == 0) {
-        Offset -= 1;
+    if (((Context.Options & TAIL_OPTION_FROM_END) == 0) &&
+        (Context.Offset != 0)) {
+
+        Context.Offset -= 1;
     }
 
-    Offset *= Multiplier;
+    Context.Offset *= Multiplier;
 
     //
-    // If it's a regular file in byte mode, use seek.
+    // Print the requested portion of each file. Files that can't be opened
+    // are skipped, though when following by name they are tried again later.
     //
 
-    if ((Input != stdin) & ((Options & TAIL_OPTION_LINES) == 0)) {
-        Status = SwOsStat(FileName, TRUE, &Stat);
-        if ((Status == 0) && (S_ISREG(Stat.st_mode))) {
-            if ((Options & TAIL_OPTION_FROM_END) != 0) {
-                if (Offset > Stat.st_size) {
-                    Offset = Stat.st_size;
-                }
+    Follow = FALSE;
+    for (FileIndex = 0; FileIndex < Context.FileCount; FileIndex += 1) {
+        File = &(Context.Files[FileIndex]);
+        Status = TailOpenFile(File);
+        if (Status == 0) {
+            Status = TailPrintFile(&Context, File);
+        }
 
-                Status = fseek(Input, Stat.st_size - Offset, SEEK_SET);
+        if (Status != 0) {
+            TotalStatus = Status;
+        }
 
-            } else {
-                Status = fseek(Input, Offset, SEEK_SET);
-            }
+        //
+        // Standard in is only followed if it's a regular file.
+        //
 
-            if (Status == 0) {
-                Offset = 0;
+        if (File->StandardInput != FALSE) {
+            if (File->Regular != FALSE) {
+                Follow = TRUE;
             }
+
+        } else if ((File->Input != NULL) ||
+                   ((Context.Options & TAIL_OPTION_FOLLOW_NAME) != 0)) {
+
+            Follow = TRUE;
         }
     }
 
-    //
-    // If there's still an offset, go to it.
-    //
+    Status = 0;
+    if (((Context.Options & TAIL_OPTION_FOLLOW) != 0) && (Follow != FALSE)) {
+        Status = TailFollow(&Context);
+    }
 
-    if (Offset != 0) {
-        if ((Options & TAIL_OPTION_FROM_END) != 0) {
-            BufferSize = Offset;
-            if ((Options & TAIL_OPTION_LINES) != 0) {
-                BufferSize *= TAIL_MAX_LINE;
+MainEnd:
+    if (Context.Files != NULL) {
+        for (FileIndex = 0; FileIndex < Context.FileCount; FileIndex += 1) {
+            File = &(Context.Files[FileIndex]);
+            if ((File->Input != NULL) && (File->Input != stdin)) {
+                fclose(File->Input);
             }
+        }
 
-            Buffer = malloc(BufferSize);
-            if (Buffer == NULL) {
-                Status = ENOMEM;
-                goto MainEnd;
-            }
+        free(Context.Files);
+    }
 
-            BufferNextIndex = 0;
-            BufferValidSize = 0;
+    if (Context.Buffer != NULL) {
+        free(Context.Buffer);
+    }
 
-            //
-            // Get to the end of the file.
-            //
+    if (Context.Watch >= 0) {
+        SwDestroyFileWatch(Context.Watch);
+    }
 
-            while (TRUE) {
-                Character = fgetc(Input);
-                if (Character == EOF) {
-                    break;
-                }
+    if ((Status != 0) && (TotalStatus == 0)) {
+        TotalStatus = Status;
+    }
 
-                Buffer[BufferNextIndex] = Character;
-                BufferNextIndex += 1;
-                if (BufferNextIndex == BufferSize) {
-                    BufferNextIndex = 0;
-                }
+    return TotalStatus;
+}
 
-                if (BufferValidSize < BufferSize) {
-                    BufferValidSize += 1;
-                }
-            }
+//
+// --------------------------------------------------------- Internal Functions
+//
 
-            //
-            // Back up by the requested number of bytes or lines.
-            //
+INT
+TailOpenFile (
+    PTAIL_FILE File
+    )
 
-            if ((Options & TAIL_OPTION_LINES) != 0) {
-                BackupCount = 0;
+/*++
 
-                //
-                // Start from the character before the very last character,
-                // in order to skip a newline at the very end.
-                //
+Routine Description:
 
-                StartIndex = BufferNextIndex;
-                if (StartIndex == 0) {
-                    StartIndex = BufferSize - 1;
+    This routine opens a file for the tail utility, and records what kind of
+    file it is.
 
-                } else {
-                    StartIndex -= 1;
-                }
+Arguments:
 
-                while (BackupCount < BufferValidSize) {
-                    if (StartIndex == 0) {
-                        StartIndex = BufferSize - 1;
+    File - Supplies a pointer to the file to open. The name "-" opens standard
+        in.
 
-                    } else {
-                        StartIndex -= 1;
-                    }
+Return Value:
 
-                    if (Buffer[StartIndex] == '\n') {
-                        Offset -= 1;
+    0 on success.
 
-                        //
-                        // Go forward by one character at the end so everything
-                        // doesn't begin with that newline.
-                        //
+    Returns an error number on failure.
 
-                        if (Offset == 0) {
-                            StartIndex += 1;
-                            if (StartIndex == BufferSize) {
-                                StartIndex = 0;
-                            }
+--*/
 
-                            break;
-                        }
-                    }
+{
 
-                    BackupCount += 1;
-                }
+    struct stat Stat;
+    INT Status;
 
-                //
-                // Account for that last character that was skipped.
-                //
+    assert(File->Input == NULL);
 
-                BackupCount += 1;
+    if (strcmp(File->Name, "-") == 0) {
+        File->Input = stdin;
+        File->Name = "standard input";
+        File->StandardInput = TRUE;
 
-            } else {
+    } else {
+        File->Input = fopen(File->Name, "r");
+        if (File->Input == NULL) {
+            Status = errno;
+            if (File->Inaccessible == FALSE) {
+                SwPrintError(Status, File->Name, "Unable to open");
+                File->Inaccessible = TRUE;
+            }
 
-                assert(BufferSize == Offset);
+            return Status;
+        }
+    }
 
-                if (BufferNextIndex < BufferValidSize) {
-                    StartIndex = BufferNextIndex - BufferValidSize + BufferSize;
+    File->Inaccessible = FALSE;
+    File->Regular = FALSE;
+    if (fstat(fileno(File->Input), &Stat) == 0) {
+        if (S_ISREG(Stat.st_mode)) {
+            File->Regular = TRUE;
+        }
 
-                } else {
-                    StartIndex = BufferNextIndex - BufferValidSize;
-                }
+        File->Device = Stat.st_dev;
+        File->Inode = Stat.st_ino;
+    }
 
-                BackupCount = BufferValidSize;
-            }
+    return 0;
+}
 
-            //
-            // Print out the buffered contents.
-            //
+INT
+TailPrintFile (
+    PTAIL_CONTEXT Context,
+    PTAIL_FILE File
+    )
 
-            while (BackupCount != 0) {
-                fputc(Buffer[StartIndex], stdout);
-                if (StartIndex == BufferSize - 1) {
-                    StartIndex = 0;
+/*++
 
-                } else {
-                    StartIndex += 1;
-                }
+Routine Description:
 
-                BackupCount -= 1;
-            }
+    This routine prints the requested portion of a newly opened file, up to
+    its current end.
 
-        //
-        // Seek from the beginning.
-        //
+Arguments:
 
-        } else {
-            while (Offset != 0) {
-                Character = fgetc(Input);
-                if (Character == EOF) {
-                    break;
-                }
+    Context - Supplies a pointer to the application context.
 
-                if (((Options & TAIL_OPTION_LINES) == 0) ||
-                    (Character == '\n')) {
+    File - Supplies a pointer to the open file.
 
-                    Offset -= 1;
-                }
-            }
-        }
-    }
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    PUCHAR Buffer;
+    UINTN BufferNextIndex;
+    UINTN BufferSize;
+    UINTN BufferValidSize;
+    size_t BytesRead;
+    INT Character;
+    FILE *Input;
+    ULONGLONG Offset;
+    ULONG Options;
+    UINTN StartIndex;
+    struct stat Stat;
+    int Status;
+
+    Buffer = NULL;
+    Input = File->Input;
+    Offset = Context->Offset;
+    Options = Context->Options;
 
     //
-    // Now the easy part, just print the contents.
+    // Every file gets its header up front, even if it turns out to be empty.
     //
 
-    Status = 0;
-    while (TRUE) {
-        Character = fgetc(Input);
-        if (Character == EOF) {
-            if (ferror(Input) != 0) {
+    Context->LastFile = NULL;
+    TailPrintHeader(Context, File);
+
+    //
+    // Nothing is printed for zero lines or bytes from the end. If the file
+    // is going to be followed, skip to its end so only new data shows up.
+    //
+
+    if (((Options & TAIL_OPTION_FROM_END) != 0) && (Offset == 0)) {
+        Status = 0;
+        if (File->Regular != FALSE) {
+            if (fseek(Input, 0, SEEK_END) != 0) {
                 Status = errno;
-                break;
+                SwPrintError(Status, File->Name, "Unable to seek");
             }
 
-            //
-            // If following and this is just the end of the file, sleep for a
-            // second and try again.
-            //
-
-            if ((Options & TAIL_OPTION_FOLLOW)) {
-                SwSleep(1000000);
+        } else if ((Options & TAIL_OPTION_FOLLOW) != 0) {
+            while (fread(Context->Buffer, 1, TAIL_BLOCK_SIZE, Input) != 0) {
                 continue;
             }
 
-            //
-            // Otherwise, stop.
-            //
-
-            break;
+            if (ferror(Input) != 0) {
+                Status = errno;
+                SwPrintError(Status, File->Name, "Unable to read");
+            }
         }
 
-        fputc(Character, stdout);
+        goto PrintFileEnd;
     }
 
-MainEnd:
-    if (Buffer != NULL) {
-        free(Buffer);
-    }
+    //
+    // If it's a regular file, use seek. In line mode from the end, scan
+    // backwards from the end of the file for the start of the last lines, so
+    // that only what gets printed is ever read.
+    //
 
-    if ((Input != NULL) && (Input != stdin)) {
-        fclose(Input);
-    }
+    if (File->Regular != FALSE) {
+        Status = fstat(fileno(Input), &Stat);
+        if (Status == 0) {
+            if ((Options & TAIL_OPTION_LINES) == 0) {
+                if ((Options & TAIL_OPTION_FROM_END) != 0) {
+                    if (Offset > Stat.st_size) {
+                        Offset = Stat.st_size;
+                    }
 
-    return Status;
-}
+                    Status = fseek(Input, Stat.st_size - Offset, SEEK_SET);
 
-//
-// --------------------------------------------------------- Internal Functions
-//
+                } else {
+                    Status = fseek(Input, Offset, SEEK_SET);
+                }
+
+                if (Status == 0) {
+                    Offset = 0;
+                }
+
+            } else if ((Options & TAIL_OPTION_FROM_END) != 0) {
+                Status = TailSeekLastLines(Input, Stat.st_size, Offset);
+                if (Status != 0) {
+                    SwPrintError(Status, File->Name, "Unable to read");
+                    goto PrintFileEnd;
+                }
+
+                Offset = 0;
+            }
+        }
+    }
+
+    //
+    // If there's still an offset, go to it.
+    //
+
+    if (Offset != 0) {
+        if ((Options & TAIL_OPTION_FROM_END) != 0) {
+
+            //
+            // Lines from the end of something that can't seek are collected
+            // as the input streams by.
+            //
+
+            if ((Options & TAIL_OPTION_LINES) != 0) {
+                Status = TailPrintLastLines(Input, Offset);
+                if (Status != 0) {
+                    SwPrintError(Status, File->Name, "Unable to read");
+                    goto PrintFileEnd;
+                }
+
+            } else {
+                BufferSize = Offset;
+                Buffer = malloc(BufferSize);
+                if (Buffer == NULL) {
+                    Status = ENOMEM;
+                    goto PrintFileEnd;
+                }
+
+                BufferNextIndex = 0;
+                BufferValidSize = 0;
+
+                //
+                // Get to the end of the file, keeping the last bytes in a
+                // ring buffer.
+                //
+
+                while (TRUE) {
+                    Character = fgetc(Input);
+                    if (Character == EOF) {
+                        break;
+                    }
+
+                    Buffer[BufferNextIndex] = Character;
+                    BufferNextIndex += 1;
+                    if (BufferNextIndex == BufferSize) {
+                        BufferNextIndex = 0;
+                    }
+
+                    if (BufferValidSize < BufferSize) {
+                        BufferValidSize += 1;
+                    }
+                }
+
+                //
+                // Print out the buffered contents, which may wrap around the
+                // end of the ring.
+                //
+
+                if (BufferNextIndex < BufferValidSize) {
+                    StartIndex = BufferNextIndex - BufferValidSize + BufferSize;
+                    fwrite(Buffer + StartIndex,
+                           1,
+                           BufferSize - StartIndex,
+                           stdout);
+
+                    fwrite(Buffer, 1, BufferNextIndex, stdout);
+
+                } else {
+                    StartIndex = BufferNextIndex - BufferValidSize;
+                    fwrite(Buffer + StartIndex, 1, BufferValidSize, stdout);
+                }
+            }
+
+        //
+        // Seek from the beginning.
+        //
+
+        } else {
+            while (Offset != 0) {
+                Character = fgetc(Input);
+                if (Character == EOF) {
+                    break;
+                }
+
+                if (((Options & TAIL_OPTION_LINES) == 0) ||
+                    (Character == '\n')) {
+
+                    Offset -= 1;
+                }
+            }
+        }
+    }
+
+    //
+    // Now the easy part, just print the contents. Regular files are copied in
+    // big blocks. Other inputs go a character at a time so that reading
+    // never waits on more than is available.
+    //
+
+    Status = 0;
+    while (TRUE) {
+        if (File->Regular != FALSE) {
+            BytesRead = fread(Context->Buffer, 1, TAIL_BLOCK_SIZE, Input);
+
+        } else {
+            BytesRead = 0;
+            Character = fgetc(Input);
+            if (Character != EOF) {
+                Context->Buffer[0] = Character;
+                BytesRead = 1;
+            }
+        }
+
+        if (BytesRead == 0) {
+            if (ferror(Input) != 0) {
+                Status = errno;
+                SwPrintError(Status, File->Name, "Unable to read");
+            }
+
+            break;
+        }
+
+        if (fwrite(Context->Buffer, 1, BytesRead, stdout) != BytesRead) {
+            Status = errno;
+            break;
+        }
+    }
+
+PrintFileEnd:
+    if (Buffer != NULL) {
+        free(Buffer);
+    }
+
+    return Status;
+}
+
+INT
+TailFollow (
+    PTAIL_CONTEXT Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prints data as it is added to the files, forever. Where the
+    operating system supports it, this sleeps until a file changes. Otherwise
+    the files are checked every so often.
+
+Arguments:
+
+    Context - Supplies a pointer to the application context.
+
+Return Value:
+
+    Returns an error number if output could not be written. This routine
+    does not otherwise return.
+
+--*/
+
+{
+
+    PTAIL_FILE File;
+    ULONG FileIndex;
+    INT Result;
+    INT Status;
+
+    Context->Watch = SwCreateFileWatch();
+    Context->WatchTimeout = -1;
+    if (Context->Watch >= 0) {
+        for (FileIndex = 0; FileIndex < Context->FileCount; FileIndex += 1) {
+            File = &(Context->Files[FileIndex]);
+            if (File->StandardInput != FALSE) {
+                Context->WatchTimeout = TAIL_FOLLOW_INTERVAL;
+
+            } else {
+                TailWatchFile(Context, File);
+            }
+        }
+    }
+
+    while (TRUE) {
+        for (FileIndex = 0; FileIndex < Context->FileCount; FileIndex += 1) {
+            File = &(Context->Files[FileIndex]);
+            if (File->StandardInput != FALSE) {
+                if (File->Regular == FALSE) {
+                    continue;
+                }
+
+            } else if ((Context->Options & TAIL_OPTION_FOLLOW_NAME) != 0) {
+                TailCheckFileName(Context, File);
+            }
+
+            if (File->Input != NULL) {
+                Status = TailCopyNewData(Context, File);
+                if (Status != 0) {
+                    return Status;
+                }
+            }
+        }
+
+        if (fflush(stdout) != 0) {
+            return errno;
+        }
+
+        //
+        // Wait for something to change. If waiting fails, fall back to
+        // checking periodically.
+        //
+
+        if (Context->Watch >= 0) {
+            Result = SwWaitForFileWatch(Context->Watch, Context->WatchTimeout);
+            if (Result < 0) {
+                SwDestroyFileWatch(Context->Watch);
+                Context->Watch = -1;
+            }
+
+        } else {
+            SwSleep(TAIL_FOLLOW_INTERVAL * 1000ULL);
+        }
+    }
+
+    return 0;
+}
+
+VOID
+TailWatchFile (
+    PTAIL_CONTEXT Context,
+    PTAIL_FILE File
+    )
+
+/*++
+
+Routine Description:
+
+    This routine asks to be notified of changes to the given file. When
+    following by name, the directory containing the file is watched too, so
+    that a replacement file showing up is noticed. If anything can't be
+    watched, the wait for changes gets a timeout so the file is still checked
+    periodically.
+
+Arguments:
+
+    Context - Supplies a pointer to the application context.
+
+    File - Supplies a pointer to the file to watch.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSTR Directory;
+    PSTR NameCopy;
+    int Result;
+
+    assert(Context->Watch >= 0);
+
+    if (File->Input != NULL) {
+        Result = SwAddFileWatch(Context->Watch, File->Name, 0);
+        if (Result != 0) {
+            Context->WatchTimeout = TAIL_FOLLOW_INTERVAL;
+        }
+    }
+
+    if ((Context->Options & TAIL_OPTION_FOLLOW_NAME) != 0) {
+        Result = -1;
+        NameCopy = SwStringDuplicate(File->Name, strlen(File->Name) + 1);
+        if (NameCopy != NULL) {
+            Directory = dirname(NameCopy);
+            Result = SwAddFileWatch(Context->Watch,
+                                    Directory,
+                                    SW_FILE_WATCH_DIRECTORY);
+
+            free(NameCopy);
+        }
+
+        if (Result != 0) {
+            Context->WatchTimeout = TAIL_FOLLOW_INTERVAL;
+        }
+    }
+
+    return;
+}
+
+VOID
+TailCheckFileName (
+    PTAIL_CONTEXT Context,
+    PTAIL_FILE File
+    )
+
+/*++
+
+Routine Description:
+
+    This routine checks whether a file being followed by name now refers to a
+    different file, as happens when a log is rotated. If so, the rest of the
+    old file is printed and the new file is opened in its place.
+
+Arguments:
+
+    Context - Supplies a pointer to the application context.
+
+    File - Supplies a pointer to the file to check.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    struct stat Stat;
+    INT Status;
+
+    Status = SwOsStat(File->Name, TRUE, &Stat);
+    if (Status != 0) {
+        if (File->Inaccessible == FALSE) {
+            SwPrintError(Status, File->Name, "Lost access to");
+            File->Inaccessible = TRUE;
+        }
+
+        return;
+    }
+
+    if (File->Input != NULL) {
+        if ((Stat.st_dev == File->Device) && (Stat.st_ino == File->Inode)) {
+            File->Inaccessible = FALSE;
+            return;
+        }
+
+        //
+        // Print anything written to the old file before it was replaced.
+        //
+
+        TailCopyNewData(Context, File);
+        fclose(File->Input);
+        File->Input = NULL;
+    }
+
+    if (TailOpenFile(File) != 0) {
+        return;
+    }
+
+    SwPrintError(0, File->Name, "Following new file");
+    if (Context->Watch >= 0) {
+        TailWatchFile(Context, File);
+    }
+
+    return;
+}
+
+INT
+TailCopyNewData (
+    PTAIL_CONTEXT Context,
+    PTAIL_FILE File
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prints whatever has been added to a file since it was last
+    read, in large blocks. If a regular file has shrunk, it is assumed to
+    have been truncated and is printed again from the beginning.
+
+Arguments:
+
+    Context - Supplies a pointer to the application context.
+
+    File - Supplies a pointer to the file to copy from.
+
+Return Value:
+
+    0 on success, including if the file could not be read.
+
+    Returns an error number if the output could not be written.
+
+--*/
+
+{
+
+    ssize_t BytesRead;
+    int Descriptor;
+    off_t Position;
+    struct stat Stat;
+
+    //
+    // The file has already been read to its end through the stream, so the
+    // stream buffer is empty and the descriptor can be read directly.
+    //
+
+    Descriptor = fileno(File->Input);
+    if (File->Regular != FALSE) {
+        Position = lseek(Descriptor, 0, SEEK_CUR);
+        if ((Position > 0) &&
+            (fstat(Descriptor, &Stat) == 0) &&
+            (Stat.st_size < Position)) {
+
+            SwPrintError(0, File->Name, "Rewinding truncated file");
+            lseek(Descriptor, 0, SEEK_SET);
+        }
+    }
+
+    while (TRUE) {
+        BytesRead = read(Descriptor, Context->Buffer, TAIL_BLOCK_SIZE);
+        if (BytesRead <= 0) {
+            if ((BytesRead < 0) && (errno == EINTR)) {
+                continue;
+            }
+
+            break;
+        }
+
+        TailPrintHeader(Context, File);
+        if (fwrite(Context->Buffer, 1, BytesRead, stdout) != BytesRead) {
+            return errno;
+        }
+    }
+
+    return 0;
+}
+
+VOID
+TailPrintHeader (
+    PTAIL_CONTEXT Context,
+    PTAIL_FILE File
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prints the header naming a file if headers are enabled and
+    the last output came from some other file.
+
+Arguments:
+
+    Context - Supplies a pointer to the application context.
+
+    File - Supplies a pointer to the file about to be printed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (((Context->Options & TAIL_OPTION_PRINT_NAMES) == 0) ||
+        (Context->LastFile == File)) {
+
+        return;
+    }
+
+    if (Context->HeaderPrinted != FALSE) {
+        printf("\n");
+    }
+
+    printf("==> %s <==\n", File->Name);
+    Context->LastFile = File;
+    Context->HeaderPrinted = TRUE;
+    return;
+}
+
+INT
+TailSeekLastLines (
+    FILE *Input,
+    ULONGLONG FileSize,
+    ULONGLONG LineCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine positions a regular file at the start of its last lines. It
+    reads backwards from the end of the file in large blocks, so the amount
+    read depends only on the size of those lines, not the size of the file.
+
+Arguments:
+
+    Input - Supplies a pointer to the open file.
+
+    FileSize - Supplies the size of the file in bytes.
+
+    LineCount - Supplies the number of lines to back up over.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    PUCHAR Block;
+    UINTN BlockSize;
+    ULONGLONG Position;
+    UINTN Start;
+    ULONGLONG StartOffset;
+    INT Status;
+
+    Block = NULL;
+    StartOffset = 0;
+
+    //
+    // Start from the character before the very last character. A newline
+    // there ends the last line rather than starting a new one.
+    //
+
+    if (FileSize > 1) {
+        Block = malloc(TAIL_BLOCK_SIZE);
+        if (Block == NULL) {
+            Status = ENOMEM;
+            goto SeekLastLinesEnd;
+        }
+
+        Position = FileSize - 1;
+        while (Position != 0) {
+            BlockSize = TAIL_BLOCK_SIZE;
+            if (BlockSize > Position) {
+                BlockSize = Position;
+            }
+
+            Position -= BlockSize;
+            if ((fseek(Input, Position, SEEK_SET) != 0) ||
+                (fread(Block, 1, BlockSize, Input) != BlockSize)) {
+
+                Status = errno;
+                if (Status == 0) {
+                    Status = EIO;
+                }
+
+                goto SeekLastLinesEnd;
+            }
+
+            if (TailFindLinesStart(Block, BlockSize, &LineCount, &Start) !=
+                FALSE) {
+
+                StartOffset = Position + Start;
+                break;
+            }
+        }
+    }
+
+    Status = 0;
+    if (fseek(Input, StartOffset, SEEK_SET) != 0) {
+        Status = errno;
+    }
+
+SeekLastLinesEnd:
+    if (Block != NULL) {
+        free(Block);
+    }
+
+    return Status;
+}
+
+INT
+TailPrintLastLines (
+    FILE *Input,
+    ULONGLONG LineCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prints the last lines of an input that cannot seek. The input
+    is read in blocks to the end, periodically throwing out everything before
+    the last lines seen so far. Lines can be any length.
+
+Arguments:
+
+    Input - Supplies a pointer to the input stream.
+
+    LineCount - Supplies the number of lines to print.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    PUCHAR Buffer;
+    size_t BytesRead;
+    UINTN Capacity;
+    UINTN CompactSize;
+    PVOID NewBuffer;
+    ULONGLONG Remaining;
+    UINTN Size;
+    UINTN Start;
+    INT Status;
+
+    Capacity = TAIL_BLOCK_SIZE * 2;
+    Buffer = malloc(Capacity);
+    if (Buffer == NULL) {
+        Status = ENOMEM;
+        goto PrintLastLinesEnd;
+    }
+
+    CompactSize = Capacity;
+    Size = 0;
+    while (TRUE) {
+        if (Capacity - Size < TAIL_BLOCK_SIZE) {
+            NewBuffer = realloc(Buffer, Capacity * 2);
+            if (NewBuffer == NULL) {
+                Status = ENOMEM;
+                goto PrintLastLinesEnd;
+            }
+
+            Buffer = NewBuffer;
+            Capacity *= 2;
+        }
+
+        BytesRead = fread(Buffer + Size, 1, TAIL_BLOCK_SIZE, Input);
+        if (BytesRead == 0) {
+            if (ferror(Input) != 0) {
+                Status = errno;
+                goto PrintLastLinesEnd;
+            }
+
+            break;
+        }
+
+        Size += BytesRead;
+
+        //
+        // Once enough has piled up, discard everything before the last lines
+        // seen so far. Leaving the last byte out of the count means at worst
+        // an extra line is kept. Waiting for the data to double between
+        // passes keeps the total work proportional to the input.
+        //
+
+        if (Size >= CompactSize) {
+            Remaining = LineCount;
+            if (TailFindLinesStart(Buffer, Size - 1, &Remaining, &Start) !=
+                FALSE) {
+
+                Size -= Start;
+                memmove(Buffer, Buffer + Start, Size);
+            }
+
+            CompactSize = Size * 2;
+            if (CompactSize < TAIL_BLOCK_SIZE * 2) {
+                CompactSize = TAIL_BLOCK_SIZE * 2;
+            }
+        }
+    }
+
+    //
+    // Find the real start now that the end of the input is known.
+    //
+
+    Start = 0;
+    if (Size > 1) {
+        Remaining = LineCount;
+        if (TailFindLinesStart(Buffer, Size - 1, &Remaining, &Start) ==
+            FALSE) {
+
+            Start = 0;
+        }
+    }
+
+    Status = 0;
+    if (fwrite(Buffer + Start, 1, Size - Start, stdout) != Size - Start) {
+        Status = errno;
+    }
+
+PrintLastLinesEnd:
+    if (Buffer != NULL) {
+        free(Buffer);
+    }
+
+    return Status;
+}
+
+BOOL
+TailFindLinesStart (
+    PUCHAR Buffer,
+    UINTN Size,
+    PULONGLONG LineCount,
+    PUINTN Start
+    )
+
+/*++
+
+Routine Description:
+
+    This routine scans backwards through a buffer counting newlines.
+
+Arguments:
+
+    Buffer - Supplies a pointer to the buffer to scan.
+
+    Size - Supplies the number of bytes in the buffer.
+
+    LineCount - Supplies a pointer that on input contains the number of
+        newlines still to be found. On output, this is reduced by the number
+        of newlines found.
+
+    Start - Supplies a pointer where the index just after the newline that
+        brought the count to zero will be returned.
+
+Return Value:
+
+    TRUE if the count reached zero within the buffer.
+
+    FALSE if the whole buffer was scanned without finding enough newlines.
+
+--*/
+
+{
+
+    UINTN Index;
+
+#if defined(__SSE2__)
+
+    UINT Bit;
+    __m128i Block;
+    UINT Count;
+    UINT Mask;
+    __m128i Newline;
+
+#endif
+
+    Index = Size;
+
+#if defined(__SSE2__)
+
+    //
+    // Compare 16 bytes at a time. Blocks with fewer newlines than are still
+    // needed are skipped over with just a count.
+    //
+
+    Newline = _mm_set1_epi8('\n');
+    while (Index >= 16) {
+        Index -= 16;
+        Block = _mm_loadu_si128((__m128i *)(Buffer + Index));
+        Mask = _mm_movemask_epi8(_mm_cmpeq_epi8(Block, Newline));
+        if (Mask == 0) {
+            continue;
+        }
+
+        Count = __builtin_popcount(Mask);
+        if (Count < *LineCount) {
+            *LineCount -= Count;
+            continue;
+        }
+
+        while (TRUE) {
+            Bit = 31 - __builtin_clz(Mask);
+            *LineCount -= 1;
+            if (*LineCount == 0) {
+                *Start = Index + Bit + 1;
+                return TRUE;
+            }
+
+            Mask &= ~(1 << Bit);
+        }
+    }
+
+#endif
+
+    while (Index != 0) {
+        Index -= 1;
+        if (Buffer[Index] == '\n') {
+            *LineCount -= 1;
+            if (*LineCount == 0) {
+                *Start = Index + 1;
+                return TRUE;
+            }
+        }
+    }
+
+    return FALSE;
+}
 
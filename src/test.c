@@ -106,6 +106,13 @@ Module Name:
 #define TEST_UTILITY_TRUE 0
 #define TEST_UTILITY_ERROR 2
 
+//
+// Define how many parentheses can be open at once. This keeps a long run of
+// open parentheses from overflowing the stack.
+//
+
+#define TEST_MAX_NESTING 1024
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -153,20 +160,30 @@ typedef enum _TEST_UTILITY_TEST {
     TestIntegerMaxValue,
 } TEST_UTILITY_TEST, *PTEST_UTILITY_TEST;
 
-typedef enum _TEST_PARSE_ELEMENT_TYPE {
-    TestParseElementInvalid,
-    TestParseElementOperator,
-    TestParseElementToken,
-    TestParseElementResult,
-    TestParseElementEnd,
-} TEST_PARSE_ELEMENT_TYPE, *PTEST_PARSE_ELEMENT_TYPE;
-
-typedef struct _TEST_PARSE_ELEMENT {
-    TEST_PARSE_ELEMENT_TYPE Type;
-    PSTR Token;
-    TEST_UTILITY_TEST Operator;
-    INT Result;
-} TEST_PARSE_ELEMENT, *PTEST_PARSE_ELEMENT;
+/*++
+
+Structure Description:
+
+    This structure stores the state of the test expression parser.
+
+Members:
+
+    Arguments - Stores the array of arguments making up the expression.
+
+    ArgumentCount - Stores the number of elements in the argument array.
+
+    ArgumentIndex - Stores the index of the next argument to parse.
+
+    Depth - Stores the number of parentheses currently open.
+
+--*/
+
+typedef struct _TEST_PARSER {
+    CHAR **Arguments;
+    INT ArgumentCount;
+    INT ArgumentIndex;
+    ULONG Depth;
+} TEST_PARSER, *PTEST_PARSER;
 
 //
 // ----------------------------------------------- Internal Function Prototypes
@@ -178,18 +195,29 @@ TestEvaluateExpression (
     CHAR **Arguments
     );
 
-BOOL
-TestShiftOrReduce (
-    PTEST_PARSE_ELEMENT Stack,
-    ULONG StackSize,
-    PTEST_PARSE_ELEMENT NextElement,
-    PBOOL Shift
+INT
+TestParseOr (
+    PTEST_PARSER Parser
     );
 
-BOOL
-TestReduce (
-    PTEST_PARSE_ELEMENT Stack,
-    PULONG StackSize
+INT
+TestParseAnd (
+    PTEST_PARSER Parser
+    );
+
+INT
+TestParseNot (
+    PTEST_PARSER Parser
+    );
+
+INT
+TestParsePrimary (
+    PTEST_PARSER Parser
+    );
+
+TEST_UTILITY_TEST
+TestGetNextOperator (
+    PTEST_PARSER Parser
     );
 
 TEST_UTILITY_TEST
@@ -202,11 +230,6 @@ TestGetOperandCount (
     TEST_UTILITY_TEST Operator
     );
 
-ULONG
-TestGetOperatorPrecedence (
-    TEST_UTILITY_TEST Operator
-    );
-
 INT
 TestEvaluateUnaryOperator (
     TEST_UTILITY_TEST Operator,
@@ -241,11 +264,6 @@ TestEvaluateAndOr (
     INT Right
     );
 
-VOID
-TestConvertTokenToResult (
-    PTEST_PARSE_ELEMENT Element
-    );
-
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -421,16 +439,9 @@ Return Value:
 
 {
 
-    ULONG ArgumentIndex;
-    TEST_PARSE_ELEMENT NextElement;
     TEST_UTILITY_TEST Operator;
-    PTEST_PARSE_ELEMENT ParseStack;
-    BOOL Result;
+    TEST_PARSER Parser;
     INT ReturnValue;
-    BOOL Shift;
-    ULONG StackIndex;
-
-    ParseStack = NULL;
 
     //
     // Zero arguments represents an implicit test for a non-null string
@@ -563,474 +574,298 @@ Return Value:
     }
 
     //
-    // Allocate the space for a basic parse stack.
+    // Anything else goes through the full parser, which handles -o, then -a,
+    // then !, then single tests and parentheses.
     //
 
-    ParseStack = malloc(sizeof(TEST_PARSE_ELEMENT) * ArgumentCount);
-    if (ParseStack == NULL) {
-        SwPrintError(errno, NULL, "Failed to allocate");
-        return TEST_UTILITY_ERROR;
-    }
-
-    memset(ParseStack, 0, sizeof(TEST_PARSE_ELEMENT) * ArgumentCount);
-    ArgumentIndex = 0;
-    StackIndex = 0;
-    while (TRUE) {
-        if (ArgumentIndex == ArgumentCount) {
-            NextElement.Type = TestParseElementEnd;
-
-        } else {
-
-            //
-            // Get the next parse stack element.
-            //
-
-            Operator = TestGetOperator(Arguments[ArgumentIndex]);
-            if (Operator != TestUtilityInvalid) {
-                NextElement.Type = TestParseElementOperator;
-                NextElement.Operator = Operator;
-
-            } else {
-                NextElement.Type = TestParseElementToken;
-            }
-
-            NextElement.Token = Arguments[ArgumentIndex];
-        }
-
-        while (TRUE) {
-            Result = TestShiftOrReduce(ParseStack,
-                                       StackIndex,
-                                       &NextElement,
-                                       &Shift);
-
-            if (Result == FALSE) {
-                ReturnValue = TEST_UTILITY_ERROR;
-                goto EvaluateExpressionEnd;
-            }
-
-            if (Shift != FALSE) {
-                break;
-            }
+    Parser.Arguments = Arguments;
+    Parser.ArgumentCount = ArgumentCount;
+    Parser.ArgumentIndex = 0;
+    Parser.Depth = 0;
+    ReturnValue = TestParseOr(&Parser);
+    if ((ReturnValue <= TEST_UTILITY_FALSE) &&
+        (Parser.ArgumentIndex != ArgumentCount)) {
 
-            Result = TestReduce(ParseStack, &StackIndex);
-            if (Result == FALSE) {
-                ReturnValue = TEST_UTILITY_ERROR;
-                goto EvaluateExpressionEnd;
-            }
-
-            if ((NextElement.Type == TestParseElementEnd) &&
-                (StackIndex == 1) &&
-                (ParseStack[0].Type == TestParseElementResult)) {
-
-                ReturnValue = ParseStack[0].Result;
-                goto EvaluateExpressionEnd;
-            }
-        }
-
-        //
-        // Shift this next element onto the stack.
-        //
-
-        memcpy(&(ParseStack[StackIndex]),
-               &NextElement,
-               sizeof(TEST_PARSE_ELEMENT));
-
-        StackIndex += 1;
-        ArgumentIndex += 1;
-    }
+        SwPrintError(0,
+                     NULL,
+                     "%s: Unexpected argument",
+                     Arguments[Parser.ArgumentIndex]);
 
-EvaluateExpressionEnd:
-    if (ParseStack != NULL) {
-        free(ParseStack);
+        ReturnValue = TEST_UTILITY_ERROR;
     }
 
     return ReturnValue;
 }
 
-BOOL
-TestShiftOrReduce (
-    PTEST_PARSE_ELEMENT Stack,
-    ULONG StackSize,
-    PTEST_PARSE_ELEMENT NextElement,
-    PBOOL Shift
+INT
+TestParseOr (
+    PTEST_PARSER Parser
     )
 
 /*++
 
 Routine Description:
 
-    This routine determines whether the test parser should shift another
-    element onto the stack or reduce what it's got.
+    This routine parses and evaluates one or more expressions joined by -o.
 
 Arguments:
 
-    Stack - Supplies a pointer to the parse stack.
-
-    StackSize - Supplies the number of elements on the stack.
-
-    NextElement - Supplies a pointer to the next element that would be
-        shifted onto the stack.
-
-    Shift - Supplies a pointer where a boolean will be returned indicating
-        whether or not to shift (TRUE) or reduce (FALSE).
+    Parser - Supplies a pointer to the parser state.
 
 Return Value:
 
-    TRUE on success.
+    0 or 1 if the evaluation succeeds.
 
-    FALSE if there was a parsing error.
+    >1 on failure.
 
 --*/
 
 {
 
-    TEST_UTILITY_TEST NextOperator;
-    TEST_UTILITY_TEST Operator;
-
-    if (StackSize == 0) {
-        *Shift = TRUE;
-        return TRUE;
-    }
-
-    if (NextElement->Type == TestParseElementEnd) {
-        *Shift = FALSE;
-        return TRUE;
-    }
-
-    switch (Stack[StackSize - 1].Type) {
-    case TestParseElementOperator:
-        Operator = Stack[StackSize - 1].Operator;
-        if (Operator == TestUtilityOpenParentheses) {
-            *Shift = TRUE;
-            return TRUE;
-        }
-
-        if (Operator == TestUtilityCloseParentheses) {
-            *Shift = FALSE;
-            return TRUE;
-        }
-
-        //
-        // If it's an and, or, or bang, just shift.
-        //
+    INT Left;
+    INT Right;
 
-        if ((Operator == TestUtilityAnd) || (Operator == TestUtilityOr) ||
-            (Operator == TestUtilityBang)) {
+    Left = TestParseAnd(Parser);
+    while ((Left <= TEST_UTILITY_FALSE) &&
+           (TestGetNextOperator(Parser) == TestUtilityOr)) {
 
-            *Shift = TRUE;
-            return TRUE;
+        Parser->ArgumentIndex += 1;
+        Right = TestParseAnd(Parser);
+        if (Right > TEST_UTILITY_FALSE) {
+            return Right;
         }
 
-        //
-        // If it's an operator, then all other operators are turned off
-        // except for bang.
-        //
-
-        if ((NextElement->Type == TestParseElementOperator) &&
-            (NextElement->Operator == TestUtilityBang)) {
+        Left = TestEvaluateAndOr(TestUtilityOr, Left, Right);
+    }
 
-            *Shift = TRUE;
-            return TRUE;
-        }
+    return Left;
+}
 
-        NextElement->Type = TestParseElementToken;
-        *Shift = TRUE;
-        return TRUE;
+INT
+TestParseAnd (
+    PTEST_PARSER Parser
+    )
 
-    case TestParseElementToken:
+/*++
 
-        //
-        // If the next thing isn't an operator this is an error.
-        //
+Routine Description:
 
-        if (NextElement->Type != TestParseElementOperator) {
-            SwPrintError(0,
-                         NULL,
-                         "Expected an operator, got %s",
-                         NextElement->Token);
+    This routine parses and evaluates one or more expressions joined by -a,
+    which binds more tightly than -o.
 
-            return FALSE;
-        }
+Arguments:
 
-        //
-        // If there's only one element on the stack just shift. That next
-        // argument had better be a binary argument.
-        //
+    Parser - Supplies a pointer to the parser state.
 
-        NextOperator = NextElement->Operator;
-        if (StackSize == 1) {
-            if (TestGetOperandCount(NextOperator) != 2) {
-                SwPrintError(0, NULL, "Expected a binary operator");
-            }
+Return Value:
 
-            *Shift = TRUE;
-            return TRUE;
-        }
+    0 or 1 if the evaluation succeeds.
 
-        //
-        // There's more than one element on the stack, so get the operator
-        // back there and compare with this upcoming operator.
-        //
+    >1 on failure.
 
-        assert(Stack[StackSize - 2].Type == TestParseElementOperator);
+--*/
 
-        Operator = Stack[StackSize - 2].Operator;
-        if (Operator == TestUtilityOpenParentheses) {
-            *Shift = TRUE;
+{
 
-        } else if (TestGetOperatorPrecedence(Operator) >=
-                   TestGetOperatorPrecedence(NextOperator)) {
+    INT Left;
+    INT Right;
 
-            *Shift = FALSE;
+    Left = TestParseNot(Parser);
+    while ((Left <= TEST_UTILITY_FALSE) &&
+           (TestGetNextOperator(Parser) == TestUtilityAnd)) {
 
-        } else {
-            *Shift = TRUE;
+        Parser->ArgumentIndex += 1;
+        Right = TestParseNot(Parser);
+        if (Right > TEST_UTILITY_FALSE) {
+            return Right;
         }
 
-        return TRUE;
+        Left = TestEvaluateAndOr(TestUtilityAnd, Left, Right);
+    }
 
-    case TestParseElementResult:
+    return Left;
+}
 
-        //
-        // If the next thing isn't an operator this is an error.
-        //
+INT
+TestParseNot (
+    PTEST_PARSER Parser
+    )
 
-        if (NextElement->Type != TestParseElementOperator) {
-            SwPrintError(0,
-                         NULL,
-                         "Expected an operator, got %s",
-                         NextElement->Token);
+/*++
 
-            return FALSE;
-        }
+Routine Description:
 
-        //
-        // The upcoming operator had better be an and or an or.
-        //
+    This routine parses and evaluates a primary expression preceded by any
+    number of ! operators.
 
-        NextOperator = NextElement->Operator;
-        if ((NextOperator != TestUtilityAnd) &&
-            (NextOperator != TestUtilityOr) &&
-            (NextOperator != TestUtilityCloseParentheses)) {
+Arguments:
 
-            SwPrintError(0, NULL, "Expected end of expression");
-            return FALSE;
-        }
+    Parser - Supplies a pointer to the parser state.
 
-        if (StackSize == 1) {
-            *Shift = TRUE;
-            return TRUE;
-        }
+Return Value:
 
-        //
-        // The operator back there had better be an and, or, or bang.
-        //
+    0 or 1 if the evaluation succeeds.
 
-        Operator = Stack[StackSize - 2].Operator;
+    >1 on failure.
 
-        assert((Operator == TestUtilityAnd) || (Operator == TestUtilityOr) ||
-               (Operator == TestUtilityBang) ||
-               (Operator == TestUtilityOpenParentheses));
+--*/
 
-        //
-        // Figure out which is more important and shift or reduce.
-        //
+{
 
-        if (Operator == TestUtilityOpenParentheses) {
-            *Shift = TRUE;
+    BOOL Negate;
+    INT Result;
 
-        } else if (TestGetOperatorPrecedence(Operator) >=
-                   TestGetOperatorPrecedence(NextOperator)) {
+    Negate = FALSE;
+    while (TestGetNextOperator(Parser) == TestUtilityBang) {
+        Negate = !Negate;
+        Parser->ArgumentIndex += 1;
+    }
 
-            *Shift = FALSE;
+    Result = TestParsePrimary(Parser);
+    if (Negate != FALSE) {
+        if (Result == TEST_UTILITY_TRUE) {
+            Result = TEST_UTILITY_FALSE;
 
-        } else {
-            *Shift = TRUE;
+        } else if (Result == TEST_UTILITY_FALSE) {
+            Result = TEST_UTILITY_TRUE;
         }
-
-        return TRUE;
-
-    default:
-        break;
     }
 
-    assert(FALSE);
-
-    return FALSE;
+    return Result;
 }
 
-BOOL
-TestReduce (
-    PTEST_PARSE_ELEMENT Stack,
-    PULONG StackSize
+INT
+TestParsePrimary (
+    PTEST_PARSER Parser
     )
 
 /*++
 
 Routine Description:
 
-    This routine attempts to reduce the stack by performing the topmost
-    operation.
+    This routine parses and evaluates a single test: a binary or unary
+    operator with its operands, a parenthesized expression, or a lone string.
 
 Arguments:
 
-    Stack - Supplies a pointer to the parse stack.
-
-    StackSize - Supplies the number of elements on the stack.
+    Parser - Supplies a pointer to the parser state.
 
 Return Value:
 
-    TRUE on success.
+    0 or 1 if the evaluation succeeds.
 
-    FALSE on failure.
+    >1 on failure.
 
 --*/
 
 {
 
-    ULONG OperandCount;
+    PSTR Argument;
+    CHAR **Arguments;
+    INT Index;
     TEST_UTILITY_TEST Operator;
-    BOOL Result;
-    INT ReturnValue;
-
-    assert(*StackSize != 0);
-
-    //
-    // If there's a single element on the stack or the stack looks like
-    // ( something, then just evaluate the top item.
-    //
-
-    if ((*StackSize == 1) ||
-        ((Stack[*StackSize - 1].Type == TestParseElementToken) &&
-         (Stack[*StackSize - 2].Type == TestParseElementOperator) &&
-         (Stack[*StackSize - 2].Operator == TestUtilityOpenParentheses))) {
-
-        if (Stack[0].Type != TestParseElementToken) {
-            SwPrintError(0, NULL, "Expected token");
-            return FALSE;
-        }
+    INT Result;
 
-        TestConvertTokenToResult(&(Stack[0]));
+    Arguments = Parser->Arguments;
+    Index = Parser->ArgumentIndex;
+    if (Index == Parser->ArgumentCount) {
+        SwPrintError(0, NULL, "Argument expected");
+        return TEST_UTILITY_ERROR;
     }
 
     //
-    // If the topmost thing is a close parentheses, reduce until finding the
-    // corresponding open parentheses.
+    // A binary operator in the second position wins over anything in the
+    // first, so that "-n = -n" compares two strings.
     //
 
-    if (Stack[*StackSize - 1].Type == TestParseElementOperator) {
-
-        assert(Stack[*StackSize - 1].Operator == TestUtilityCloseParentheses);
-
-        *StackSize -= 1;
-        while (TRUE) {
-            if (*StackSize < 2) {
-                SwPrintError(0, NULL, "Unexpected close parentheses");
-                return FALSE;
-            }
+    Argument = Arguments[Index];
+    if (Index + 2 < Parser->ArgumentCount) {
+        Operator = TestGetOperator(Arguments[Index + 1]);
+        if ((Operator != TestUtilityAnd) && (Operator != TestUtilityOr) &&
+            (TestGetOperandCount(Operator) == 2)) {
 
-            if ((Stack[*StackSize - 1].Type == TestParseElementResult) &&
-                (Stack[*StackSize - 2].Type == TestParseElementOperator) &&
-                (Stack[*StackSize - 2].Operator ==
-                 TestUtilityOpenParentheses)) {
+            Parser->ArgumentIndex += 3;
+            Result = TestEvaluateBinaryOperator(Operator,
+                                                Argument,
+                                                Arguments[Index + 2]);
 
-                *StackSize -= 1;
-                Stack[*StackSize - 1].Type = TestParseElementResult;
-                Stack[*StackSize - 1].Result = Stack[*StackSize].Result;
-                return TRUE;
-            }
-
-            Result = TestReduce(Stack, StackSize);
-            if (Result == FALSE) {
-                return FALSE;
-            }
+            return Result;
         }
     }
 
-    assert(Stack[*StackSize - 2].Type == TestParseElementOperator);
-
-    //
-    // Handle the logical operators !, AND, and OR right here.
-    //
-
-    Operator = Stack[*StackSize - 2].Operator;
-    if (Operator == TestUtilityBang) {
-
-        assert(Stack[*StackSize - 1].Type == TestParseElementResult);
-
-        ReturnValue = Stack[*StackSize - 1].Result;
-        if (ReturnValue == TEST_UTILITY_TRUE) {
-            ReturnValue = TEST_UTILITY_FALSE;
-
-        } else if (ReturnValue == TEST_UTILITY_FALSE) {
-            ReturnValue = TEST_UTILITY_TRUE;
+    Operator = TestGetOperator(Argument);
+    if (Operator == TestUtilityOpenParentheses) {
+        if (Parser->Depth >= TEST_MAX_NESTING) {
+            SwPrintError(0, NULL, "Expression nested too deeply");
+            return TEST_UTILITY_ERROR;
         }
 
-        if (TestDebugPrintEvaluations != FALSE) {
-            SwPrintError(0,
-                         NULL,
-                         "%d <== [!] %d\n",
-                         ReturnValue,
-                         Stack[*StackSize - 1].Result);
+        Parser->ArgumentIndex += 1;
+        Parser->Depth += 1;
+        Result = TestParseOr(Parser);
+        Parser->Depth -= 1;
+        if (Result > TEST_UTILITY_FALSE) {
+            return Result;
         }
 
-        *StackSize -= 1;
-        Stack[*StackSize - 1].Result = ReturnValue;
-        Stack[*StackSize - 1].Type = TestParseElementResult;
-        return TRUE;
-
-    } else if ((Operator == TestUtilityAnd) || (Operator == TestUtilityOr)) {
-        TestConvertTokenToResult(&(Stack[*StackSize - 3]));
-        TestConvertTokenToResult(&(Stack[*StackSize - 1]));
+        if (TestGetNextOperator(Parser) != TestUtilityCloseParentheses) {
+            SwPrintError(0, NULL, "Expected ')'");
+            return TEST_UTILITY_ERROR;
+        }
 
-        assert(Stack[*StackSize - 3].Type == TestParseElementResult);
-        assert(Stack[*StackSize - 1].Type == TestParseElementResult);
+        Parser->ArgumentIndex += 1;
+        return Result;
+    }
 
-        ReturnValue = TestEvaluateAndOr(Operator,
-                                        Stack[*StackSize - 3].Result,
-                                        Stack[*StackSize - 1].Result);
+    if ((TestGetOperandCount(Operator) == 1) &&
+        (Index + 1 < Parser->ArgumentCount)) {
 
-        *StackSize -= 2;
-        Stack[*StackSize - 1].Result = ReturnValue;
-        Stack[*StackSize - 1].Type = TestParseElementResult;
-        return TRUE;
+        Parser->ArgumentIndex += 2;
+        return TestEvaluateUnaryOperator(Operator, Arguments[Index + 1]);
     }
 
     //
-    // It's not logical, it must be an expression with tokens.
+    // Anything else is a test for a non-empty string.
     //
 
-    assert(Stack[*StackSize - 1].Type == TestParseElementToken);
+    Parser->ArgumentIndex += 1;
+    if (*Argument != '\0') {
+        return TEST_UTILITY_TRUE;
+    }
 
-    //
-    // Try for a unary operator.
-    //
+    return TEST_UTILITY_FALSE;
+}
 
-    OperandCount = TestGetOperandCount(Operator);
-    if (OperandCount == 1) {
-        ReturnValue = TestEvaluateUnaryOperator(Operator,
-                                                Stack[*StackSize - 1].Token);
+TEST_UTILITY_TEST
+TestGetNextOperator (
+    PTEST_PARSER Parser
+    )
 
-        *StackSize -= 1;
+/*++
 
-    //
-    // Process a binary operator.
-    //
+Routine Description:
 
-    } else {
+    This routine returns the operator the next argument would be, without
+    consuming it.
+
+Arguments:
 
-        assert(OperandCount == 2);
+    Parser - Supplies a pointer to the parser state.
 
-        ReturnValue = TestEvaluateBinaryOperator(Operator,
-                                                 Stack[*StackSize - 3].Token,
-                                                 Stack[*StackSize - 1].Token);
+Return Value:
+
+    Returns the operator, or TestUtilityInvalid if the next argument is not an
+    operator or there are no more arguments.
+
+--*/
 
-        *StackSize -= 2;
+{
+
+    if (Parser->ArgumentIndex >= Parser->ArgumentCount) {
+        return TestUtilityInvalid;
     }
 
-    Stack[*StackSize - 1].Result = ReturnValue;
-    Stack[*StackSize - 1].Type = TestParseElementResult;
-    return TRUE;
+    return TestGetOperator(Parser->Arguments[Parser->ArgumentIndex]);
 }
 
 TEST_UTILITY_TEST
@@ -1261,65 +1096,9 @@ Return Value:
         return 1;
     }
 
-    assert(FALSE);
-
     return 0;
 }
 
-ULONG
-TestGetOperatorPrecedence (
-    TEST_UTILITY_TEST Operator
-    )
-
-/*++
-
-Routine Description:
-
-    This routine returns precedence of the given operator.
-
-Arguments:
-
-    Operator - Supplies the operator.
-
-Return Value:
-
-    Returns the precedence. Higher values are higher precedence.
-
---*/
-
-{
-
-    if (Operator == TestUtilityCloseParentheses) {
-        return 0;
-    }
-
-    if (Operator == TestUtilityOr) {
-        return 1;
-    }
-
-    if (Operator == TestUtilityAnd) {
-        return 2;
-    }
-
-    if (Operator == TestUtilityBang) {
-        return 3;
-    }
-
-    if ((Operator == TestStringEquals) || (Operator == TestStringNotEquals)) {
-        return 6;
-    }
-
-    if (Operator == TestUtilityOpenParentheses) {
-        return 7;
-    }
-
-    if (TestGetOperandCount(Operator) == 2) {
-        return 4;
-    }
-
-    return 5;
-}
-
 INT
 TestEvaluateUnaryOperator (
     TEST_UTILITY_TEST Operator,
@@ -1815,53 +1594,3 @@ Return Value:
     return ReturnValue;
 }
 
-VOID
-TestConvertTokenToResult (
-    PTEST_PARSE_ELEMENT Element
-    )
-
-/*++
-
-Routine Description:
-
-    This routine converts a token type parse element into a result element,
-    which is non-zero if the given token has a non-zero length.
-
-Arguments:
-
-    Element - Supplies a pointer to the token element to convert into a result.
-
-Return Value:
-
-    None.
-
---*/
-
-{
-
-    //
-    // Skip it if it's already a result.
-    //
-
-    if (Element->Type == TestParseElementResult) {
-        return;
-    }
-
-    //
-    // Only tokens are handled here, there's no converting an operator to a
-    // result.
-    //
-
-    assert(Element->Type == TestParseElementToken);
-
-    if (strlen(Element->Token) != 0) {
-        Element->Result = TEST_UTILITY_TRUE;
-
-    } else {
-        Element->Result = TEST_UTILITY_FALSE;
-    }
-
-    Element->Type = TestParseElementResult;
-    return;
-}
-
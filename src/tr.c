@@ -96,6 +96,28 @@ Module Name:
 
 #define TR_INITIAL_STRING_CAPACITY 32
 
+//
+// Define the size of the blocks input is processed in.
+//
+
+#define TR_BLOCK_SIZE 0x10000
+
+//
+// Define the size of a bitmap with one bit for every byte value.
+//
+
+#define TR_BITMAP_SIZE (256 / 8)
+
+//
+// These macros set and test the bit for a character in a bitmap.
+//
+
+#define TR_SET_BIT(_Bitmap, _Character) \
+    ((_Bitmap)[(_Character) >> 3] |= 1 << ((_Character) & 0x7))
+
+#define TR_TEST_BIT(_Bitmap, _Character) \
+    (((_Bitmap)[(_Character) >> 3] & (1 << ((_Character) & 0x7))) != 0)
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -125,6 +147,30 @@ Return Value:
 
 --*/
 
+/*++
+
+Structure Description:
+
+    This structure stores the tables tr uses to process each byte, which are
+    computed once from the character sets.
+
+Members:
+
+    Translate - Stores the byte each input byte is translated to.
+
+    Delete - Stores the bitmap of bytes to delete.
+
+    Squeeze - Stores the bitmap of bytes whose repeats are squeezed down to
+        one.
+
+--*/
+
+typedef struct _TR_MAPS {
+    UCHAR Translate[256];
+    UCHAR Delete[TR_BITMAP_SIZE];
+    UCHAR Squeeze[TR_BITMAP_SIZE];
+} TR_MAPS, *PTR_MAPS;
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
@@ -158,6 +204,33 @@ TrIsCharacterInSet (
     INT Character
     );
 
+VOID
+TrBuildMaps (
+    ULONG Options,
+    PSTR Set1,
+    ULONG Set1Size,
+    PSTR Set2,
+    ULONG Set2Size,
+    PSTR SqueezeSet,
+    ULONG SqueezeSetSize,
+    PTR_MAPS Maps
+    );
+
+UINTN
+TrFilterBuffer (
+    PTR_MAPS Maps,
+    ULONG Options,
+    PUCHAR Buffer,
+    UINTN Size,
+    PINT PreviousCharacter
+    );
+
+INT
+TrWriteBuffer (
+    PUCHAR Buffer,
+    UINTN Size
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -203,24 +276,28 @@ Return Value:
 {
 
     ULONG ArgumentIndex;
-    INT Character;
+    PUCHAR Buffer;
+    ssize_t BytesRead;
+    UINTN Index;
     FILE *Input;
+    TR_MAPS Maps;
     INT Option;
     ULONG Options;
+    UINTN OutputSize;
     INT PreviousCharacter;
     PSTR Set1;
     ULONG Set1Size;
     PSTR Set2;
     ULONG Set2Size;
-    INT SetIndex;
     PSTR SqueezeSet;
     ULONG SqueezeSetSize;
     int Status;
     PSTR String1;
     PSTR String2;
 
+    Buffer = NULL;
     Options = 0;
-    PreviousCharacter = 0;
+    PreviousCharacter = -1;
     Set1 = NULL;
     Set2 = NULL;
     String1 = NULL;
@@ -298,6 +375,13 @@ Return Value:
         return 1;
     }
 
+    if ((String2 == NULL) &&
+        ((Options & (TR_OPTION_DELETE | TR_OPTION_SQUEEZE)) == 0)) {
+
+        SwPrintError(0, NULL, "Two strings must be given when translating");
+        return 1;
+    }
+
     Status = TrCreateSet(String1, Options, 0, &Set1, &Set1Size);
     if (Status != 0) {
         SwPrintError(Status, String1, "Failed to create character set");
@@ -317,6 +401,17 @@ Return Value:
             goto MainEnd;
         }
 
+        //
+        // There is nothing to translate the first set to if the second is
+        // empty.
+        //
+
+        if ((Set2Size == 0) && ((Options & TR_OPTION_DELETE) == 0)) {
+            SwPrintError(0, NULL, "String2 must not be empty when translating");
+            Status = 1;
+            goto MainEnd;
+        }
+
         SqueezeSet = Set2;
         SqueezeSetSize = Set2Size;
     }
@@ -332,63 +427,73 @@ Return Value:
         goto MainEnd;
     }
 
+    TrBuildMaps(Options,
+                Set1,
+                Set1Size,
+                Set2,
+                Set2Size,
+                SqueezeSet,
+                SqueezeSetSize,
+                &Maps);
+
+    Buffer = malloc(TR_BLOCK_SIZE);
+    if (Buffer == NULL) {
+        Status = ENOMEM;
+        goto MainEnd;
+    }
+
     //
-    // Begin translation.
+    // Begin translation. Each block is processed in place.
     //
 
     while (TRUE) {
-        Character = fgetc(Input);
-        if (Character == EOF) {
-            break;
-        }
-
-        SetIndex = TrIsCharacterInSet(Set1, Set1Size, Character);
-        if ((Options & TR_OPTION_DELETE) != 0) {
-            if (SetIndex != -1) {
-                continue;
-            }
+        do {
+            BytesRead = read(fileno(Input), Buffer, TR_BLOCK_SIZE);
 
-        //
-        // Translate the character if there's a second set.
-        //
+        } while ((BytesRead < 0) && (errno == EINTR));
 
-        } else if ((SetIndex != -1) && (Set2 != NULL)) {
-            if (SetIndex >= Set2Size) {
-                SetIndex = Set2Size - 1;
-            }
+        if (BytesRead < 0) {
+            Status = errno;
+            SwPrintError(Status, NULL, "Failed to read input");
+            goto MainEnd;
+        }
 
-            Character = Set2[SetIndex];
+        if (BytesRead == 0) {
+            break;
         }
 
         //
-        // If squeeze is on, then omit repeated values.
+        // Without deletes or squeezes, every byte is output, so the block
+        // just gets run through the translation table.
         //
 
-        if ((Options & TR_OPTION_SQUEEZE) != 0) {
-            SetIndex = TrIsCharacterInSet(SqueezeSet,
-                                          SqueezeSetSize,
-                                          Character);
-
-            if ((SetIndex != -1) && (Character == PreviousCharacter)) {
-                continue;
+        if ((Options & (TR_OPTION_DELETE | TR_OPTION_SQUEEZE)) == 0) {
+            for (Index = 0; Index < BytesRead; Index += 1) {
+                Buffer[Index] = Maps.Translate[Buffer[Index]];
             }
-        }
 
-        //
-        // Write the translated character back out.
-        //
+            OutputSize = BytesRead;
 
-        fputc(Character, stdout);
-        PreviousCharacter = Character;
-    }
+        } else {
+            OutputSize = TrFilterBuffer(&Maps,
+                                        Options,
+                                        Buffer,
+                                        BytesRead,
+                                        &PreviousCharacter);
+        }
 
-    if (ferror(Input) != 0) {
-        Status = errno;
-        SwPrintError(Status, NULL, "Failed to read input");
-        goto MainEnd;
+        Status = TrWriteBuffer(Buffer, OutputSize);
+        if (Status != 0) {
+            SwPrintError(Status, NULL, "Failed to write output");
+            goto MainEnd;
+        }
     }
 
 MainEnd:
+    if (Buffer != NULL) {
+        free(Buffer);
+    }
+
     if (Set1 != NULL) {
         free(Set1);
     }
@@ -572,12 +677,15 @@ Return Value:
                     break;
 
                 //
-                // Otherwise, add everything between the range.
+                // Otherwise, add everything else in the range. The start was
+                // already added as the previous character, and adding it
+                // again would shift every later character out of line with
+                // the other set.
                 //
 
                 } else {
-                    for (Character = PreviousCharacter;
-                         Character <= EndRange;
+                    for (Character = (UCHAR)PreviousCharacter + 1;
+                         Character <= (UCHAR)EndRange;
                          Character += 1) {
 
                         Status = TrSetAddCharacter(&Set,
@@ -659,7 +767,7 @@ Return Value:
     //
 
     if ((Options & TR_OPTION_COMPLEMENT_STRING) != 0) {
-        for (Character = 0; Character < MAX_UCHAR; Character += 1) {
+        for (Character = 0; Character <= MAX_UCHAR; Character += 1) {
             if (TrIsCharacterInSet(Set, SetSize, Character) == -1) {
                 Status = TrSetAddCharacter(&Complement,
                                            Character,
@@ -900,7 +1008,8 @@ Routine Description:
 
     SetSize - Supplies the size of the set buffer in bytes.
 
-    Character - Supplies the character to check for.
+    Character - Supplies the character to check for, as an unsigned
+        character value.
 
 Return Value:
 
@@ -915,7 +1024,7 @@ Return Value:
     ULONG SetIndex;
 
     for (SetIndex = 0; SetIndex < SetSize; SetIndex += 1) {
-        if (Set[SetIndex] == Character) {
+        if ((UCHAR)(Set[SetIndex]) == Character) {
             return SetIndex;
         }
     }
@@ -923,3 +1032,221 @@ Return Value:
     return -1;
 }
 
+VOID
+TrBuildMaps (
+    ULONG Options,
+    PSTR Set1,
+    ULONG Set1Size,
+    PSTR Set2,
+    ULONG Set2Size,
+    PSTR SqueezeSet,
+    ULONG SqueezeSetSize,
+    PTR_MAPS Maps
+    )
+
+/*++
+
+Routine Description:
+
+    This routine computes the translation table and the delete and squeeze
+    bitmaps from the character sets.
+
+Arguments:
+
+    Options - Supplies the bitfield of application options. See TR_OPTION_*
+        definitions.
+
+    Set1 - Supplies a pointer to the first character set.
+
+    Set1Size - Supplies the size of the first set in bytes.
+
+    Set2 - Supplies an optional pointer to the second character set.
+
+    Set2Size - Supplies the size of the second set in bytes.
+
+    SqueezeSet - Supplies a pointer to the set of characters to squeeze.
+
+    SqueezeSetSize - Supplies the size of the squeeze set in bytes.
+
+    Maps - Supplies a pointer where the tables will be returned.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UCHAR Character;
+    UCHAR Mapped[TR_BITMAP_SIZE];
+    ULONG SetIndex;
+    ULONG TranslateIndex;
+
+    memset(Maps, 0, sizeof(TR_MAPS));
+    for (SetIndex = 0; SetIndex < 256; SetIndex += 1) {
+        Maps->Translate[SetIndex] = SetIndex;
+    }
+
+    //
+    // Characters in the first set are deleted, or translated to the
+    // character at the same position in the second set. The last character
+    // of the second set is used if it is shorter. If a character appears
+    // more than once in the first set, its first position wins.
+    //
+
+    if ((Options & TR_OPTION_DELETE) != 0) {
+        for (SetIndex = 0; SetIndex < Set1Size; SetIndex += 1) {
+            TR_SET_BIT(Maps->Delete, (UCHAR)(Set1[SetIndex]));
+        }
+
+    } else if ((Set2 != NULL) && (Set2Size != 0)) {
+        memset(Mapped, 0, sizeof(Mapped));
+        for (SetIndex = 0; SetIndex < Set1Size; SetIndex += 1) {
+            Character = Set1[SetIndex];
+            if (TR_TEST_BIT(Mapped, Character)) {
+                continue;
+            }
+
+            TR_SET_BIT(Mapped, Character);
+            TranslateIndex = SetIndex;
+            if (TranslateIndex >= Set2Size) {
+                TranslateIndex = Set2Size - 1;
+            }
+
+            Maps->Translate[Character] = Set2[TranslateIndex];
+        }
+    }
+
+    if ((Options & TR_OPTION_SQUEEZE) != 0) {
+        for (SetIndex = 0; SetIndex < SqueezeSetSize; SetIndex += 1) {
+            TR_SET_BIT(Maps->Squeeze, (UCHAR)(SqueezeSet[SetIndex]));
+        }
+    }
+
+    return;
+}
+
+UINTN
+TrFilterBuffer (
+    PTR_MAPS Maps,
+    ULONG Options,
+    PUCHAR Buffer,
+    UINTN Size,
+    PINT PreviousCharacter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine translates, deletes, and squeezes the characters in a
+    buffer, compacting the output into the front of the same buffer.
+
+Arguments:
+
+    Maps - Supplies a pointer to the translation tables.
+
+    Options - Supplies the bitfield of application options. See TR_OPTION_*
+        definitions.
+
+    Buffer - Supplies a pointer to the buffer to process.
+
+    Size - Supplies the number of bytes in the buffer.
+
+    PreviousCharacter - Supplies a pointer to the last character output,
+        which is carried between buffers so that squeezing works across them.
+        This is -1 if nothing has been output yet.
+
+Return Value:
+
+    Returns the number of bytes left in the buffer to output.
+
+--*/
+
+{
+
+    UCHAR Character;
+    UINTN InputIndex;
+    UINTN OutputIndex;
+    INT Previous;
+
+    OutputIndex = 0;
+    Previous = *PreviousCharacter;
+    for (InputIndex = 0; InputIndex < Size; InputIndex += 1) {
+        Character = Buffer[InputIndex];
+        if (TR_TEST_BIT(Maps->Delete, Character)) {
+            continue;
+        }
+
+        Character = Maps->Translate[Character];
+
+        //
+        // If squeeze is on, then omit repeated values.
+        //
+
+        if ((Character == Previous) &&
+            (TR_TEST_BIT(Maps->Squeeze, Character))) {
+
+            continue;
+        }
+
+        Buffer[OutputIndex] = Character;
+        OutputIndex += 1;
+        Previous = Character;
+    }
+
+    *PreviousCharacter = Previous;
+    return OutputIndex;
+}
+
+INT
+TrWriteBuffer (
+    PUCHAR Buffer,
+    UINTN Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine writes a buffer to standard out.
+
+Arguments:
+
+    Buffer - Supplies a pointer to the bytes to write.
+
+    Size - Supplies the number of bytes to write.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    ssize_t BytesWritten;
+    UINTN TotalBytesWritten;
+
+    TotalBytesWritten = 0;
+    while (TotalBytesWritten != Size) {
+        do {
+            BytesWritten = write(STDOUT_FILENO,
+                                 Buffer + TotalBytesWritten,
+                                 Size - TotalBytesWritten);
+
+        } while ((BytesWritten < 0) && (errno == EINTR));
+
+        if (BytesWritten <= 0) {
+            return errno;
+        }
+
+        TotalBytesWritten += BytesWritten;
+    }
+
+    return 0;
+}
+
@@ -32,15 +32,25 @@ Module Name:
 #include <minoca/lib/types.h>
 
 #include <assert.h>
-#include <ctype.h>
 #include <errno.h>
 #include <getopt.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "swlib.h"
 
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+#elif defined(__SSE2__)
+
+#include <emmintrin.h>
+
+#endif
+
 //
 // ---------------------------------------------------------------- Definitions
 //
@@ -105,35 +115,248 @@ Module Name:
 #define WC_DEFAULT_OPTIONS \
     (WC_OPTION_PRINT_BYTES | WC_OPTION_PRINT_WORDS | WC_OPTION_PRINT_LINES)
 
+//
+// Define the size of the blocks input is read in. This must be a multiple
+// of the widest vector the counting routine uses.
+//
+
+#define WC_BLOCK_SIZE 0x10000
+
+//
+// Define the maximum number of threads used to count files.
+//
+
+#define WC_MAXIMUM_THREADS 64
+
+//
+// Define the number of vectors whose per-byte counts can be accumulated
+// before they may overflow.
+//
+
+#define WC_VECTOR_ACCUMULATE_COUNT 255
+
+//
+// Define the SWAR constants, which repeat a byte value in every byte of a
+// 64-bit value.
+//
+
+#define WC_SWAR_ONES 0x0101010101010101ULL
+#define WC_SWAR_LOW_BITS 0x7F7F7F7F7F7F7F7FULL
+#define WC_SWAR_HIGH_BITS 0x8080808080808080ULL
+
+//
+// This macro determines whether the given character is whitespace in the C
+// locale, which is what separates words.
+//
+
+#define WC_IS_SPACE(_Character) \
+    (((_Character) == ' ') || ((UCHAR)((_Character) - '\t') < 5))
+
+//
+// Define the vector operations used to count lines and words, which are the
+// same for SSE2 and AVX2 apart from the width.
+//
+
+#if defined(__AVX2__)
+
+#define WC_VECTOR_SIZE 32
+#define WC_SET1 _mm256_set1_epi8
+#define WC_SETZERO _mm256_setzero_si256
+#define WC_LOAD(_Address) _mm256_loadu_si256((__m256i *)(_Address))
+#define WC_STORE(_Address, _Value) \
+    _mm256_storeu_si256((__m256i *)(_Address), (_Value))
+
+#define WC_EQUAL _mm256_cmpeq_epi8
+#define WC_OR _mm256_or_si256
+#define WC_AND_NOT _mm256_andnot_si256
+#define WC_SUBTRACT _mm256_sub_epi8
+#define WC_MINIMUM _mm256_min_epu8
+#define WC_ADD64 _mm256_add_epi64
+#define WC_SUM_BYTES(_Value) _mm256_sad_epu8((_Value), Zero)
+
+//
+// The previous macro shifts the whitespace mask up one byte, bringing in the
+// last byte of the previous vector. On AVX2 the shift has to cross the
+// 128-bit lanes.
+//
+
+#define WC_PREVIOUS(_Current, _Previous)                                       \
+    _mm256_alignr_epi8(                                                        \
+        (_Current),                                                            \
+        _mm256_permute2x128_si256((_Previous), (_Current), 0x21),              \
+        15)
+
+#elif defined(__SSE2__)
+
+#define WC_VECTOR_SIZE 16
+#define WC_SET1 _mm_set1_epi8
+#define WC_SETZERO _mm_setzero_si128
+#define WC_LOAD(_Address) _mm_loadu_si128((__m128i *)(_Address))
+#define WC_STORE(_Address, _Value) \
+    _mm_storeu_si128((__m128i *)(_Address), (_Value))
+
+#define WC_EQUAL _mm_cmpeq_epi8
+#define WC_OR _mm_or_si128
+#define WC_AND_NOT _mm_andnot_si128
+#define WC_SUBTRACT _mm_sub_epi8
+#define WC_MINIMUM _mm_min_epu8
+#define WC_ADD64 _mm_add_epi64
+#define WC_SUM_BYTES(_Value) _mm_sad_epu8((_Value), Zero)
+#define WC_PREVIOUS(_Current, _Previous) \
+    _mm_or_si128(_mm_slli_si128((_Current), 1), _mm_srli_si128((_Previous), 15))
+
+#endif
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
 
+/*++
+
+Structure Description:
+
+    This structure stores the counts gathered for an input.
+
+Members:
+
+    Bytes - Stores the number of bytes.
+
+    Characters - Stores the number of characters.
+
+    Lines - Stores the number of newline characters.
+
+    MaxLineLength - Stores the length of the longest line.
+
+    Words - Stores the number of words.
+
+--*/
+
+typedef struct _WC_COUNTS {
+    ULONGLONG Bytes;
+    ULONGLONG Characters;
+    ULONGLONG Lines;
+    ULONGLONG MaxLineLength;
+    ULONGLONG Words;
+} WC_COUNTS, *PWC_COUNTS;
+
+/*++
+
+Structure Description:
+
+    This structure stores the results for one file operand.
+
+Members:
+
+    Name - Stores a pointer to the name of the file.
+
+    Counts - Stores the counts for the file.
+
+    Status - Stores the error number that occurred processing the file, or 0
+        on success.
+
+    OpenFailed - Stores a boolean indicating whether the status came from
+        failing to open the file (TRUE) or from failing to read it (FALSE).
+
+--*/
+
+typedef struct _WC_FILE {
+    PSTR Name;
+    WC_COUNTS Counts;
+    INT Status;
+    BOOL OpenFailed;
+} WC_FILE, *PWC_FILE;
+
+/*++
+
+Structure Description:
+
+    This structure stores the work shared by the threads counting files.
+
+Members:
+
+    Options - Stores the bitfield of application options. See WC_OPTION_*
+        definitions.
+
+    Files - Stores the array of files to count.
+
+    FileCount - Stores the number of elements in the files array.
+
+    NextFile - Stores the index of the next file a thread should pick up.
+
+    Thread - Stores the handle of the thread, or NULL if this work runs on
+        the calling thread.
+
+--*/
+
+typedef struct _WC_WORK {
+    ULONG Options;
+    PWC_FILE Files;
+    ULONG FileCount;
+    volatile ULONG *NextFile;
+    PVOID Thread;
+} WC_WORK, *PWC_WORK;
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
 
+INT
+WcProcessFiles (
+    ULONG Options,
+    PWC_FILE Files,
+    ULONG FileCount,
+    PWC_COUNTS Total
+    );
+
+VOID
+WcWorkThread (
+    PVOID Parameter
+    );
+
+VOID
+WcCountFile (
+    ULONG Options,
+    PWC_FILE File,
+    PUCHAR Buffer
+    );
+
 INT
 WcProcessInput (
     ULONG Options,
     FILE *Input,
-    PSTR Name,
-    PULONGLONG TotalBytes,
-    PULONGLONG TotalCharacters,
-    PULONGLONG MaxLineLength,
-    PULONGLONG TotalLines,
-    PULONGLONG TotalWords
+    PUCHAR Buffer,
+    PWC_COUNTS Counts
+    );
+
+VOID
+WcCountLinesAndWords (
+    PUCHAR Buffer,
+    UINTN Size,
+    PULONGLONG Lines,
+    PULONGLONG Words,
+    PBOOL WasSpace
+    );
+
+VOID
+WcMeasureLines (
+    PUCHAR Buffer,
+    UINTN Size,
+    PULONGLONG LineLength,
+    PULONGLONG MaxLineLength
+    );
+
+VOID
+WcPrintFileResults (
+    ULONG Options,
+    PWC_FILE File,
+    PWC_COUNTS Total
     );
 
 VOID
 WcPrintResults (
     ULONG Options,
     PSTR Name,
-    ULONGLONG TotalBytes,
-    ULONGLONG TotalCharacters,
-    ULONGLONG MaxLineLength,
-    ULONGLONG TotalLines,
-    ULONGLONG TotalWords
+    PWC_COUNTS Counts
     );
 
 //
@@ -182,27 +405,20 @@ Return Value:
 
 {
 
-    PSTR Argument;
     ULONG ArgumentIndex;
-    FILE *Input;
-    ULONGLONG MaxLineLength;
+    WC_FILE File;
+    ULONG FileCount;
+    PWC_FILE Files;
+    ULONG FileIndex;
     INT Option;
     ULONG Options;
-    ULONG ProcessedCount;
     int Status;
-    ULONGLONG TotalBytes;
-    ULONGLONG TotalCharacters;
-    ULONGLONG TotalLines;
+    WC_COUNTS Total;
     INT TotalStatus;
-    ULONGLONG TotalWords;
 
-    MaxLineLength = 0;
-    ProcessedCount = 0;
-    TotalBytes = 0;
-    TotalCharacters = 0;
-    TotalLines = 0;
+    Files = NULL;
+    memset(&Total, 0, sizeof(WC_COUNTS));
     TotalStatus = 0;
-    TotalWords = 0;
     Options = 0;
     Status = 0;
 
@@ -280,93 +496,311 @@ Return Value:
     //
 
     if (ArgumentIndex == ArgumentCount) {
-        Status = WcProcessInput(Options,
-                                stdin,
-                                "",
-                                &TotalBytes,
-                                &TotalCharacters,
-                                &MaxLineLength,
-                                &TotalLines,
-                                &TotalWords);
+        memset(&File, 0, sizeof(WC_FILE));
+        File.Name = "";
+        WcCountFile(Options, &File, NULL);
+        WcPrintFileResults(Options, &File, &Total);
+        Status = File.Status;
+        goto MainEnd;
+    }
 
+    FileCount = ArgumentCount - ArgumentIndex;
+    Files = malloc(FileCount * sizeof(WC_FILE));
+    if (Files == NULL) {
+        Status = ENOMEM;
         goto MainEnd;
     }
 
+    memset(Files, 0, FileCount * sizeof(WC_FILE));
+    for (FileIndex = 0; FileIndex < FileCount; FileIndex += 1) {
+        Files[FileIndex].Name = Arguments[ArgumentIndex + FileIndex];
+    }
+
+    TotalStatus = WcProcessFiles(Options, Files, FileCount, &Total);
+
     //
-    // Loop through the arguments again and process the input.
+    // Finally, print the total if more than one file was processed.
     //
 
-    while (ArgumentIndex < ArgumentCount) {
-        Argument = Arguments[ArgumentIndex];
-        ArgumentIndex += 1;
-        if (strcmp(Argument, "-") == 0) {
-            Input = stdin;
+    if (FileCount > 1) {
+        WcPrintResults(Options, "total", &Total);
+    }
 
-        } else {
-            Input = fopen(Argument, "rb");
-            if (Input == NULL) {
-                TotalStatus = errno;
-                SwPrintError(TotalStatus, Argument, "Unable to open");
-                continue;
-            }
+MainEnd:
+    if (Files != NULL) {
+        free(Files);
+    }
+
+    if ((TotalStatus == 0) && (Status != 0)) {
+        TotalStatus = Status;
+    }
+
+    return TotalStatus;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+INT
+WcProcessFiles (
+    ULONG Options,
+    PWC_FILE Files,
+    ULONG FileCount,
+    PWC_COUNTS Total
+    )
+
+/*++
+
+Routine Description:
+
+    This routine counts and prints a set of file operands. When there are
+    several files and several processors, the files are counted on worker
+    threads and the results are printed in order once they're all done.
+    Otherwise each file is printed as soon as it is counted.
+
+Arguments:
+
+    Options - Supplies the bitfield of application options. See WC_OPTION_*
+        definitions.
+
+    Files - Supplies the array of files to count.
+
+    FileCount - Supplies the number of elements in the array.
+
+    Total - Supplies a pointer to the total counts, which are updated.
+
+Return Value:
+
+    0 on success.
+
+    Returns the last error number that occurred on failure.
+
+--*/
+
+{
+
+    PUCHAR Buffer;
+    ULONG FileIndex;
+    volatile ULONG NextFile;
+    INT Status;
+    INT ThreadCount;
+    ULONG ThreadIndex;
+    PWC_WORK Work;
+
+    Buffer = NULL;
+    Status = 0;
+    Work = NULL;
+    ThreadCount = 1;
+
+    //
+    // Standard in can only be read by one thread.
+    //
+
+    for (FileIndex = 0; FileIndex < FileCount; FileIndex += 1) {
+        if (strcmp(Files[FileIndex].Name, "-") == 0) {
+            break;
         }
+    }
 
-        Status = WcProcessInput(Options,
-                                Input,
-                                Argument,
-                                &TotalBytes,
-                                &TotalCharacters,
-                                &MaxLineLength,
-                                &TotalLines,
-                                &TotalWords);
-
-        if (Input != stdin) {
-            fclose(Input);
+    if ((FileCount > 1) && (FileIndex == FileCount)) {
+        ThreadCount = SwGetProcessorCount(TRUE);
+        if (ThreadCount > FileCount) {
+            ThreadCount = FileCount;
         }
 
-        if ((Status != 0) && (TotalStatus == 0)) {
-            TotalStatus = Status;
+        if (ThreadCount > WC_MAXIMUM_THREADS) {
+            ThreadCount = WC_MAXIMUM_THREADS;
         }
+    }
 
-        ProcessedCount += 1;
+    if (ThreadCount > 1) {
+        Work = malloc(ThreadCount * sizeof(WC_WORK));
     }
 
     //
-    // Finally, print the total if more than one file was processed.
+    // Count the files on several threads. The calling thread does its share
+    // too. If a thread can't be created, the others just pick up its files.
     //
 
-    if (ProcessedCount > 1) {
-        WcPrintResults(Options,
-                       "total",
-                       TotalBytes,
-                       TotalCharacters,
-                       MaxLineLength,
-                       TotalLines,
-                       TotalWords);
+    if (Work != NULL) {
+        NextFile = 0;
+        for (ThreadIndex = 0; ThreadIndex < ThreadCount; ThreadIndex += 1) {
+            Work[ThreadIndex].Options = Options;
+            Work[ThreadIndex].Files = Files;
+            Work[ThreadIndex].FileCount = FileCount;
+            Work[ThreadIndex].NextFile = &NextFile;
+            Work[ThreadIndex].Thread = NULL;
+            if (ThreadIndex != 0) {
+                SwCreateThread(WcWorkThread,
+                               &(Work[ThreadIndex]),
+                               &(Work[ThreadIndex].Thread));
+            }
+        }
+
+        WcWorkThread(&(Work[0]));
+        for (ThreadIndex = 1; ThreadIndex < ThreadCount; ThreadIndex += 1) {
+            if (Work[ThreadIndex].Thread != NULL) {
+                SwJoinThread(Work[ThreadIndex].Thread);
+            }
+        }
+
+        free(Work);
+        for (FileIndex = 0; FileIndex < FileCount; FileIndex += 1) {
+            WcPrintFileResults(Options, &(Files[FileIndex]), Total);
+            if (Files[FileIndex].Status != 0) {
+                Status = Files[FileIndex].Status;
+            }
+        }
+
+    //
+    // Count the files one at a time.
+    //
+
+    } else {
+        Buffer = malloc(WC_BLOCK_SIZE);
+        if (Buffer == NULL) {
+            return ENOMEM;
+        }
+
+        for (FileIndex = 0; FileIndex < FileCount; FileIndex += 1) {
+            WcCountFile(Options, &(Files[FileIndex]), Buffer);
+            WcPrintFileResults(Options, &(Files[FileIndex]), Total);
+            if (Files[FileIndex].Status != 0) {
+                Status = Files[FileIndex].Status;
+            }
+        }
+
+        free(Buffer);
     }
 
-MainEnd:
-    if ((TotalStatus == 0) && (Status != 0)) {
-        TotalStatus = Status;
+    return Status;
+}
+
+VOID
+WcWorkThread (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine counts files until there are none left to pick up.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the shared work.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PUCHAR Buffer;
+    ULONG FileIndex;
+    PWC_WORK Work;
+
+    Work = Parameter;
+    Buffer = malloc(WC_BLOCK_SIZE);
+    if (Buffer == NULL) {
+        return;
     }
 
-    return TotalStatus;
+    while (TRUE) {
+        FileIndex = __sync_fetch_and_add(Work->NextFile, 1);
+        if (FileIndex >= Work->FileCount) {
+            break;
+        }
+
+        WcCountFile(Work->Options, &(Work->Files[FileIndex]), Buffer);
+    }
+
+    free(Buffer);
+    return;
 }
 
-//
-// --------------------------------------------------------- Internal Functions
-//
+VOID
+WcCountFile (
+    ULONG Options,
+    PWC_FILE File,
+    PUCHAR Buffer
+    )
+
+/*++
+
+Routine Description:
+
+    This routine opens a file operand and gathers its counts. Errors are
+    recorded in the file structure rather than printed.
+
+Arguments:
+
+    Options - Supplies the bitfield of application options. See WC_OPTION_*
+        definitions.
+
+    File - Supplies a pointer to the file operand. An empty name or "-"
+        means standard in.
+
+    Buffer - Supplies an optional pointer to a buffer of WC_BLOCK_SIZE bytes
+        to read into. If NULL, one is allocated.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PUCHAR AllocatedBuffer;
+    FILE *Input;
+
+    AllocatedBuffer = NULL;
+    if (Buffer == NULL) {
+        AllocatedBuffer = malloc(WC_BLOCK_SIZE);
+        if (AllocatedBuffer == NULL) {
+            File->Status = ENOMEM;
+            return;
+        }
+
+        Buffer = AllocatedBuffer;
+    }
+
+    if ((*(File->Name) == '\0') || (strcmp(File->Name, "-") == 0)) {
+        Input = stdin;
+
+    } else {
+        Input = fopen(File->Name, "rb");
+        if (Input == NULL) {
+            File->Status = errno;
+            File->OpenFailed = TRUE;
+            goto CountFileEnd;
+        }
+    }
+
+    File->Status = WcProcessInput(Options, Input, Buffer, &(File->Counts));
+    if (Input != stdin) {
+        fclose(Input);
+    }
+
+CountFileEnd:
+    if (AllocatedBuffer != NULL) {
+        free(AllocatedBuffer);
+    }
+
+    return;
+}
 
 INT
 WcProcessInput (
     ULONG Options,
     FILE *Input,
-    PSTR Name,
-    PULONGLONG TotalBytes,
-    PULONGLONG TotalCharacters,
-    PULONGLONG MaxLineLength,
-    PULONGLONG TotalLines,
-    PULONGLONG TotalWords
+    PUCHAR Buffer,
+    PWC_COUNTS Counts
     )
 
 /*++
@@ -383,21 +817,10 @@ Routine Description:
 
     Input - Supplies a pointer to the input file to gather statistics on.
 
-    Name - Supplies a pointer to the string containing the name to use when
-        printing the results.
-
-    TotalBytes - Supplies a pointer where the total bytes will be updated.
-
-    TotalCharacters - Supplies a pointer where the total characters will be
-        updated.
-
-    MaxLineLength - Supplies a pointer where the maximum line length will be
-        updated.
-
-    TotalLines - Supplies a pointer where the total line count will be updated.
+    Buffer - Supplies a pointer to a buffer of WC_BLOCK_SIZE bytes to read
+        into.
 
-    TotalWords - Supplies a pointer where the total number of words will be
-        returned.
+    Counts - Supplies a pointer where the counts will be returned.
 
 Return Value:
 
@@ -407,98 +830,490 @@ Return Value:
 
 {
 
-    ULONGLONG BiggestLineLength;
-    ULONGLONG Bytes;
-    INT Character;
-    ULONGLONG Characters;
+    size_t BytesRead;
     ULONGLONG LineLength;
-    ULONGLONG Lines;
+    off_t Position;
+    struct stat Stat;
     INT Status;
     BOOL WasSpace;
-    ULONGLONG Words;
 
-    BiggestLineLength = 0;
-    Bytes = 0;
-    Characters = 0;
     LineLength = 0;
-    Lines = 0;
     Status = 0;
     WasSpace = TRUE;
-    Words = 0;
+    memset(Counts, 0, sizeof(WC_COUNTS));
+
+    //
+    // If only the byte count is needed, a regular file doesn't need to be
+    // read at all. Count from the current position, as standard in may have
+    // been partially consumed already.
+    //
+
+    if ((Options & ~WC_OPTION_PRINT_BYTES) == 0) {
+        if ((fstat(fileno(Input), &Stat) == 0) && (S_ISREG(Stat.st_mode))) {
+            Position = lseek(fileno(Input), 0, SEEK_CUR);
+            if (Position >= 0) {
+                if (Stat.st_size > Position) {
+                    Counts->Bytes = Stat.st_size - Position;
+                    Counts->Characters = Counts->Bytes;
+                }
+
+                return 0;
+            }
+        }
+    }
+
     while (TRUE) {
-        Character = fgetc(Input);
-        if (Character == EOF) {
+        BytesRead = fread(Buffer, 1, WC_BLOCK_SIZE, Input);
+        if (BytesRead == 0) {
             break;
         }
 
-        Bytes += 1;
-        Characters += 1;
+        Counts->Bytes += BytesRead;
 
         //
-        // Count words. A non-space preceded by a space marks a new word.
+        // Counting words finds the newlines along the way.
         //
 
-        if (isspace(Character)) {
-            WasSpace = TRUE;
+        if ((Options & WC_OPTION_PRINT_WORDS) != 0) {
+            WcCountLinesAndWords(Buffer,
+                                 BytesRead,
+                                 &(Counts->Lines),
+                                 &(Counts->Words),
+                                 &WasSpace);
+
+        } else if ((Options & WC_OPTION_PRINT_LINES) != 0) {
+            WcCountLinesAndWords(Buffer,
+                                 BytesRead,
+                                 &(Counts->Lines),
+                                 NULL,
+                                 NULL);
+        }
+
+        if ((Options & WC_OPTION_PRINT_MAX_LINE_LENGTH) != 0) {
+            WcMeasureLines(Buffer,
+                           BytesRead,
+                           &LineLength,
+                           &(Counts->MaxLineLength));
+        }
+    }
+
+    //
+    // Every byte is a character.
+    //
+
+    Counts->Characters = Counts->Bytes;
+    if (ferror(Input) != 0) {
+        Status = errno;
+    }
+
+    return Status;
+}
+
+VOID
+WcCountLinesAndWords (
+    PUCHAR Buffer,
+    UINTN Size,
+    PULONGLONG Lines,
+    PULONGLONG Words,
+    PBOOL WasSpace
+    )
+
+/*++
+
+Routine Description:
+
+    This routine counts the newlines and word beginnings in a buffer. A word
+    begins at each non-whitespace character that follows whitespace. Whole
+    vectors are compared at once, and the per-byte results are summed up in
+    vector registers.
+
+Arguments:
+
+    Buffer - Supplies a pointer to the buffer. This must be aligned to a
+        64-bit boundary.
+
+    Size - Supplies the number of bytes in the buffer.
+
+    Lines - Supplies a pointer where the number of newlines found will be
+        added.
+
+    Words - Supplies an optional pointer where the number of words begun in
+        the buffer will be added.
+
+    WasSpace - Supplies a pointer to a boolean that indicates whether the
+        previous character was whitespace. This is updated with the last
+        character of the buffer. This is required if words are counted.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UCHAR Character;
+    UINTN Index;
+    ULONGLONG LineCount;
+    ULONGLONG WordCount;
+
+#if defined(__AVX2__)
+
+    __m256i Block;
+    UINTN Count;
+    ULONG Iteration;
+    __m256i LineSums;
+    __m256i LineTotals;
+    __m256i Newline;
+    __m256i Previous;
+    __m256i PreviousSpace;
+    __m256i Space;
+    __m256i SpaceCharacter;
+    __m256i Tab;
+    __m256i TabRange;
+    __m256i Totals[2];
+    __m256i Value;
+    __m256i WordSums;
+    __m256i WordTotals;
+    __m256i Zero;
+
+#elif defined(__SSE2__)
+
+    __m128i Block;
+    UINTN Count;
+    ULONG Iteration;
+    __m128i LineSums;
+    __m128i LineTotals;
+    __m128i Newline;
+    __m128i Previous;
+    __m128i PreviousSpace;
+    __m128i Space;
+    __m128i SpaceCharacter;
+    __m128i Tab;
+    __m128i TabRange;
+    __m128i Totals[2];
+    __m128i Value;
+    __m128i WordSums;
+    __m128i WordTotals;
+    __m128i Zero;
+
+#else
+
+    ULONGLONG Carry;
+    ULONGLONG High;
+    ULONGLONG Low;
+    ULONGLONG Matches;
+    ULONGLONG Space;
+    ULONGLONG Starts;
+    ULONGLONG Value;
+
+#endif
+
+    Index = 0;
+    LineCount = 0;
+    WordCount = 0;
+
+    assert((Words == NULL) || (WasSpace != NULL));
+
+#if defined(__AVX2__) || defined(__SSE2__)
+
+    //
+    // Each byte of the sums counts up by one for every vector with a newline
+    // or word start in that byte. They're folded into the 64-bit totals
+    // before any byte can overflow.
+    //
+
+    Newline = WC_SET1('\n');
+    SpaceCharacter = WC_SET1(' ');
+    Tab = WC_SET1('\t');
+    TabRange = WC_SET1('\r' - '\t');
+    Zero = WC_SETZERO();
+    PreviousSpace = Zero;
+    if ((Words != NULL) && (*WasSpace != FALSE)) {
+        PreviousSpace = WC_SET1(-1);
+    }
+
+    LineTotals = Zero;
+    WordTotals = Zero;
+    while (Index + WC_VECTOR_SIZE <= Size) {
+        Count = (Size - Index) / WC_VECTOR_SIZE;
+        if (Count > WC_VECTOR_ACCUMULATE_COUNT) {
+            Count = WC_VECTOR_ACCUMULATE_COUNT;
+        }
+
+        LineSums = Zero;
+        WordSums = Zero;
+        if (Words == NULL) {
+            for (Iteration = 0; Iteration < Count; Iteration += 1) {
+                Block = WC_LOAD(Buffer + Index);
+                LineSums = WC_SUBTRACT(LineSums, WC_EQUAL(Block, Newline));
+                Index += WC_VECTOR_SIZE;
+            }
 
         } else {
-            if (WasSpace != FALSE) {
-                Words += 1;
+            for (Iteration = 0; Iteration < Count; Iteration += 1) {
+                Block = WC_LOAD(Buffer + Index);
+                LineSums = WC_SUBTRACT(LineSums, WC_EQUAL(Block, Newline));
+
+                //
+                // Whitespace is a space or anything from tab through carriage
+                // return, which is an unsigned compare after subtracting tab.
+                //
+
+                Value = WC_SUBTRACT(Block, Tab);
+                Space = WC_OR(WC_EQUAL(Block, SpaceCharacter),
+                              WC_EQUAL(WC_MINIMUM(Value, TabRange), Value));
+
+                Previous = WC_PREVIOUS(Space, PreviousSpace);
+                WordSums = WC_SUBTRACT(WordSums, WC_AND_NOT(Space, Previous));
+                PreviousSpace = Space;
+                Index += WC_VECTOR_SIZE;
             }
+        }
+
+        LineTotals = WC_ADD64(LineTotals, WC_SUM_BYTES(LineSums));
+        WordTotals = WC_ADD64(WordTotals, WC_SUM_BYTES(WordSums));
+    }
+
+    WC_STORE(&(Totals[0]), LineTotals);
+    WC_STORE(&(Totals[1]), WordTotals);
+    for (Iteration = 0;
+         Iteration < WC_VECTOR_SIZE / sizeof(ULONGLONG);
+         Iteration += 1) {
+
+        LineCount += ((PULONGLONG)&(Totals[0]))[Iteration];
+        WordCount += ((PULONGLONG)&(Totals[1]))[Iteration];
+    }
 
-            WasSpace = FALSE;
+#else
+
+    //
+    // Without vector instructions, work on 64 bits at a time. Each byte of a
+    // match mask has its high bit set if the byte matched. The low seven bits
+    // are added without carrying out of the byte to check the rest.
+    //
+
+    assert(((UINTN)Buffer & (sizeof(ULONGLONG) - 1)) == 0);
+
+    Carry = 0;
+    if ((Words != NULL) && (*WasSpace != FALSE)) {
+        Carry = WC_SWAR_HIGH_BITS;
+    }
+
+    while (Index + sizeof(ULONGLONG) <= Size) {
+        Value = *((PULONGLONG)(Buffer + Index));
+        Index += sizeof(ULONGLONG);
+
+        //
+        // Find the bytes that are exactly a newline.
+        //
+
+        Matches = Value ^ (WC_SWAR_ONES * '\n');
+        Matches = ~(((Matches & WC_SWAR_LOW_BITS) + WC_SWAR_LOW_BITS) |
+                    Matches | WC_SWAR_LOW_BITS);
+
+        LineCount += ((Matches >> 7) * WC_SWAR_ONES) >> 56;
+        if (Words == NULL) {
+            continue;
         }
 
         //
-        // Count newlines, and at the same time keep track of the longest line.
+        // Find the spaces, and the bytes from tab through carriage return.
+        //
+
+        Space = Value ^ (WC_SWAR_ONES * ' ');
+        Space = ~(((Space & WC_SWAR_LOW_BITS) + WC_SWAR_LOW_BITS) |
+                  Space | WC_SWAR_LOW_BITS);
+
+        Low = (Value & WC_SWAR_LOW_BITS) + (WC_SWAR_ONES * (0x80 - '\t'));
+        High = (Value & WC_SWAR_LOW_BITS) +
+               (WC_SWAR_ONES * (0x80 - ('\r' + 1)));
+
+        Space |= Low & ~High & ~Value & WC_SWAR_HIGH_BITS;
+
+        //
+        // A word starts at each non-space whose previous byte was a space.
         //
 
-        if (Character == '\n') {
-            Lines += 1;
-            if (LineLength > BiggestLineLength) {
-                BiggestLineLength = LineLength;
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+
+        Starts = ~Space & ((Space >> 8) | (Carry << 56)) & WC_SWAR_HIGH_BITS;
+        Carry = Space & 0x80;
+
+#else
+
+        Starts = ~Space & ((Space << 8) | (Carry >> 56)) & WC_SWAR_HIGH_BITS;
+        Carry = Space & (0x80ULL << 56);
+
+#endif
+
+        WordCount += ((Starts >> 7) * WC_SWAR_ONES) >> 56;
+    }
+
+#endif
+
+    //
+    // Count any remainder a byte at a time.
+    //
+
+    if (Words != NULL) {
+        if (Index != 0) {
+            *WasSpace = WC_IS_SPACE(Buffer[Index - 1]);
+        }
+
+        while (Index < Size) {
+            Character = Buffer[Index];
+            if (Character == '\n') {
+                LineCount += 1;
             }
 
-            LineLength = 0;
+            if (WC_IS_SPACE(Character)) {
+                *WasSpace = TRUE;
 
-        } else {
-            LineLength += 1;
+            } else {
+                if (*WasSpace != FALSE) {
+                    WordCount += 1;
+                }
+
+                *WasSpace = FALSE;
+            }
+
+            Index += 1;
+        }
+
+        *Words += WordCount;
+
+    } else {
+        while (Index < Size) {
+            if (Buffer[Index] == '\n') {
+                LineCount += 1;
+            }
+
+            Index += 1;
         }
     }
 
-    if (ferror(Input) != 0) {
-        Status = errno;
-        SwPrintError(Status, Name, "Failed to read");
+    *Lines += LineCount;
+    return;
+}
+
+VOID
+WcMeasureLines (
+    PUCHAR Buffer,
+    UINTN Size,
+    PULONGLONG LineLength,
+    PULONGLONG MaxLineLength
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the longest line ending in a buffer.
+
+Arguments:
+
+    Buffer - Supplies a pointer to the buffer.
+
+    Size - Supplies the number of bytes in the buffer.
+
+    LineLength - Supplies a pointer that on input contains the length of the
+        line so far, carried over from previous buffers. On output, contains
+        the length of the unfinished line at the end of this buffer.
+
+    MaxLineLength - Supplies a pointer to the longest line length, which is
+        updated.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PUCHAR End;
+    PUCHAR Line;
+    PUCHAR Newline;
+
+    End = Buffer + Size;
+    Line = Buffer;
+    while (Line < End) {
+        Newline = memchr(Line, '\n', End - Line);
+        if (Newline == NULL) {
+            *LineLength += End - Line;
+            break;
+        }
+
+        *LineLength += Newline - Line;
+        if (*LineLength > *MaxLineLength) {
+            *MaxLineLength = *LineLength;
+        }
+
+        *LineLength = 0;
+        Line = Newline + 1;
     }
 
-    *TotalBytes += Bytes;
-    *TotalCharacters += Characters;
-    if (BiggestLineLength > *MaxLineLength) {
-        *MaxLineLength = BiggestLineLength;
+    return;
+}
+
+VOID
+WcPrintFileResults (
+    ULONG Options,
+    PWC_FILE File,
+    PWC_COUNTS Total
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prints the results or error for a file operand, and adds its
+    counts to the total.
+
+Arguments:
+
+    Options - Supplies the bitfield of application options. See WC_OPTION_*
+        definitions.
+
+    File - Supplies a pointer to the file that was counted.
+
+    Total - Supplies a pointer to the total counts, which are updated.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (File->Status != 0) {
+        if (File->OpenFailed != FALSE) {
+            SwPrintError(File->Status, File->Name, "Unable to open");
+            return;
+        }
+
+        SwPrintError(File->Status, File->Name, "Failed to read");
     }
 
-    *TotalLines += Lines;
-    *TotalWords += Words;
-    WcPrintResults(Options,
-                   Name,
-                   Bytes,
-                   Characters,
-                   BiggestLineLength,
-                   Lines,
-                   Words);
+    Total->Bytes += File->Counts.Bytes;
+    Total->Characters += File->Counts.Characters;
+    if (File->Counts.MaxLineLength > Total->MaxLineLength) {
+        Total->MaxLineLength = File->Counts.MaxLineLength;
+    }
 
-    return Status;
+    Total->Lines += File->Counts.Lines;
+    Total->Words += File->Counts.Words;
+    WcPrintResults(Options, File->Name, &(File->Counts));
+    return;
 }
 
 VOID
 WcPrintResults (
     ULONG Options,
     PSTR Name,
-    ULONGLONG TotalBytes,
-    ULONGLONG TotalCharacters,
-    ULONGLONG MaxLineLength,
-    ULONGLONG TotalLines,
-    ULONGLONG TotalWords
+    PWC_COUNTS Counts
     )
 
 /*++
@@ -516,15 +1331,7 @@ Routine Description:
     Name - Supplies a pointer to the string containing the name to use when
         printing the results.
 
-    TotalBytes - Supplies the total number of bytes in the file.
-
-    TotalCharacters - Supplies the number of characters in the file.
-
-    MaxLineLength - Supplies the maximum line length in the file.
-
-    TotalLines - Supplies the total number of lines in the file.
-
-    TotalWords - Supplies the number of words in the file.
+    Counts - Supplies a pointer to the counts to print.
 
 Return Value:
 
@@ -538,27 +1345,27 @@ Return Value:
 
     Space = "";
     if ((Options & WC_OPTION_PRINT_LINES) != 0) {
-        printf("%7I64d", TotalLines);
+        printf("%7llu", Counts->Lines);
         Space = " ";
     }
 
     if ((Options & WC_OPTION_PRINT_WORDS) != 0) {
-        printf("%s%7I64d", Space, TotalWords);
+        printf("%s%7llu", Space, Counts->Words);
         Space = " ";
     }
 
     if ((Options & WC_OPTION_PRINT_BYTES) != 0) {
-        printf("%s%7I64d", Space, TotalBytes);
+        printf("%s%7llu", Space, Counts->Bytes);
         Space = " ";
     }
 
     if ((Options & WC_OPTION_PRINT_CHARACTERS) != 0) {
-        printf("%s%7I64d", Space, TotalCharacters);
+        printf("%s%7llu", Space, Counts->Characters);
         Space = " ";
     }
 
     if ((Options & WC_OPTION_PRINT_MAX_LINE_LENGTH) != 0) {
-        printf("%s%7I64d", Space, MaxLineLength);
+        printf("%s%7llu", Space, Counts->MaxLineLength);
         Space = " ";
     }
 
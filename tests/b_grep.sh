@@ -0,0 +1,44 @@
+#! /bin/sh
+################################################################################
+#
+#   Copyright (c) 2026 Minoca Corp. All Rights Reserved
+#
+#   Module Name:
+#
+#       b_grep.sh
+#
+#   Abstract:
+#
+#       This script times grep -c over a generated log file, once with a fixed
+#       string that never matches and once with a regular expression. Set
+#       BENCH_LINES to change the size of the log (4000000 lines is about
+#       400MB).
+#
+#   Author:
+#
+#       agent 16-Oct-2026
+#
+#   Environment:
+#
+#       POSIX
+#
+################################################################################
+
+lines=${BENCH_LINES:-1000000}
+awk -v lines=$lines 'BEGIN {
+    for (i = 0; i < lines; i += 1) {
+        level = (i % 17 == 0) ? "ERROR" : "INFO";
+        printf("2026-10-16 12:%02d:%02d %s request id=%08d path=/api/v1/" \
+               "items/%d took %d ms status=200 agent=bench-client/1.0\n",
+               (i / 60) % 60, i % 60, level, i, i % 1000, i % 997);
+    }
+}' > log.txt
+
+measure () {
+    label=$1
+    shift
+    "$SWISS" time "$@" 2>&1 >/dev/null | sed -n "s/^real /$label: /p"
+}
+
+measure "grep -c -F zzqq" "$SWISS" grep -c -F zzqq log.txt
+measure "grep -c 'ERROR.*took 9'" "$SWISS" grep -c 'ERROR.*took 9' log.txt
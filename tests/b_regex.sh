@@ -0,0 +1,66 @@
+#! /bin/sh
+################################################################################
+#
+#   Copyright (c) 2026 Minoca Corp. All Rights Reserved
+#
+#   Module Name:
+#
+#       b_regex.sh
+#   Abstract:
+#
+#       This script times regular expressions that make a backtracking
+#       matcher go exponential, plus a plain scan over a generated log. The
+#       regex library in libc/ is only linked into the Windows build, so this
+#       measures it only when run against a Windows swiss binary. Elsewhere it
+#       measures the system C library. Set BENCH_LINES to change the size of
+#       the log (1000000 lines is about 40MB).
+#
+#   Author:
+#
+#       agent 16-Oct-2026
+#
+#   Environment:
+#
+#       POSIX
+#
+################################################################################
+
+lines=${BENCH_LINES:-1000000}
+awk -v lines=$lines 'BEGIN {
+    for (i = 0; i < lines; i += 1) {
+        word = (i % 13 == 0) ? "error" : "info";
+        printf("2026-10-16 12:%02d:%02d %s %d in worker %d\n",
+               (i / 60) % 60, i % 60, word, i % 1000, i % 7);
+    }
+}' > log.txt
+
+awk 'BEGIN {
+    for (i = 0; i < 24; i += 1) {
+        printf("a");
+    }
+
+    printf("\n");
+}' > a24.txt
+
+awk 'BEGIN {
+    for (i = 0; i < 26; i += 1) {
+        printf("a");
+    }
+
+    printf("cb\n");
+}' > a26cb.txt
+
+measure () {
+    label=$1
+    shift
+    "$SWISS" time "$@" 2>&1 >/dev/null | sed -n "s/^real /$label: /p"
+}
+
+measure "grep -c -E '(a|aa)*b' (24 a's)" \
+    "$SWISS" grep -c -E '(a|aa)*b' a24.txt
+
+measure "expr : nested star (26 a's then cb)" \
+    "$SWISS" expr "$(cat a26cb.txt)" : '\(a*\)*b'
+
+measure "grep -c -E 'err[a-z]+ [0-9]+'" \
+    "$SWISS" grep -c -E 'err[a-z]+ [0-9]+' log.txt
@@ -0,0 +1,37 @@
+#! /bin/sh
+################################################################################
+#
+#   Copyright (c) 2026 Minoca Corp. All Rights Reserved
+#
+#   Module Name:
+#
+#       b_sh_lookup.sh
+#
+#   Abstract:
+#
+#       This script times a shell loop made mostly of simple commands, each of
+#       which the shell looks up in the swiss command table. Commands near
+#       the end of the table cost the most when lookup is a linear scan.
+#
+#   Author:
+#
+#       agent 16-Oct-2026
+#
+#   Environment:
+#
+#       POSIX
+#
+################################################################################
+
+measure () {
+    label=$1
+    shift
+    "$SWISS" time "$@" 2>&1 >/dev/null | sed -n "s/^real /$label: /p"
+}
+
+measure "100000 lookups" "$SWISS" sh -c '
+    i=0
+    while [ $i -lt 20000 ]; do
+        true; false; basename a; dirname a/b
+        i=$((i + 1))
+    done'
@@ -0,0 +1,52 @@
+#! /bin/sh
+################################################################################
+#
+#   Copyright (c) 2026 Minoca Corp. All Rights Reserved
+#
+#   Module Name:
+#
+#       b_sh_script.sh
+#
+#   Abstract:
+#
+#       This script times the shell reading large script files: one that is
+#       almost all comments, and one that parses a large block of commands
+#       without running them. Set BENCH_LINES to change the script size.
+#
+#   Author:
+#
+#       agent 16-Oct-2026
+#
+#   Environment:
+#
+#       POSIX
+#
+################################################################################
+
+lines=${BENCH_LINES:-1000000}
+awk -v lines=$lines 'BEGIN {
+    for (i = 0; i < lines; i += 1) {
+        printf("# comment line %d of the generated benchmark script\n", i);
+    }
+
+    print "echo done";
+}' > comments.sh
+
+awk -v lines=$lines 'BEGIN {
+    print "if false; then";
+    for (i = 0; i < lines / 2; i += 1) {
+        printf("install -m 644 \"src/file_%d.c\" \"$DESTDIR/share/%d\"\n",
+               i, i % 100);
+    }
+
+    print "fi";
+}' > install.sh
+
+measure () {
+    label=$1
+    shift
+    "$SWISS" time "$@" 2>&1 >/dev/null | sed -n "s/^real /$label: /p"
+}
+
+measure "comment script" "$SWISS" sh comments.sh
+measure "unexecuted install script" "$SWISS" sh install.sh
@@ -0,0 +1,43 @@
+#! /bin/sh
+################################################################################
+#
+#   Copyright (c) 2026 Minoca Corp. All Rights Reserved
+#
+#   Module Name:
+#
+#       b_sh_subshell.sh
+#
+#   Abstract:
+#
+#       This script times command substitutions in a shell that has exported
+#       a few hundred variables, which is the cost of creating and tearing
+#       down a subshell.
+#
+#   Author:
+#
+#       agent 16-Oct-2026
+#
+#   Environment:
+#
+#       POSIX
+#
+################################################################################
+
+measure () {
+    label=$1
+    shift
+    "$SWISS" time "$@" 2>&1 >/dev/null | sed -n "s/^real /$label: /p"
+}
+
+measure "10000 \$(...) with 300 exports" "$SWISS" sh -c '
+    i=0
+    while [ $i -lt 300 ]; do
+        export "BENCH_VAR_$i=value_$i"
+        i=$((i + 1))
+    done
+
+    i=0
+    while [ $i -lt 10000 ]; do
+        x=$(echo hi)
+        i=$((i + 1))
+    done'
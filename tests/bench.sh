@@ -0,0 +1,52 @@
+#! /bin/sh
+################################################################################
+#
+#   Copyright (c) 2026 Minoca Corp. All Rights Reserved
+#
+#   Module Name:
+#
+#       bench.sh
+#
+#   Abstract:
+#
+#       This script runs every benchmark script in this directory against one
+#       or more swiss binaries. Each benchmark generates its own input in a
+#       scratch directory, then prints one "label: seconds" line per timed
+#       step. Giving a second binary runs the same benchmarks against it, so
+#       a build can be compared with a baseline on the same machine.
+#
+#   Author:
+#
+#       agent 16-Oct-2026
+#
+#   Environment:
+#
+#       POSIX
+#
+################################################################################
+
+if [ $# -lt 1 ]; then
+    echo "Usage: $0 <swiss-binary> [<baseline-swiss-binary>...]" >&2
+    exit 2
+fi
+
+TESTDIR=$(cd "$(dirname "$0")" && pwd)
+for binary in "$@"; do
+    case "$binary" in
+        /*) SWISS=$binary ;;
+        *) SWISS="$PWD/$binary" ;;
+    esac
+
+    export SWISS
+    echo "== $SWISS"
+    for bench in "$TESTDIR"/b_*.sh; do
+        name=${bench##*/}
+        scratch=$(mktemp -d)
+        echo "-- $name"
+        if ! (cd "$scratch" && sh "$bench"); then
+            echo "FAIL: $name"
+        fi
+
+        rm -rf "$scratch"
+    done
+done
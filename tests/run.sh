@@ -0,0 +1,57 @@
+#! /bin/sh
+################################################################################
+#
+#   Copyright (c) 2026 Minoca Corp. All Rights Reserved
+#
+#   Module Name:
+#
+#       run.sh
+#
+#   Abstract:
+#
+#       This script runs every test script in this directory against a swiss
+#       binary. Each test is run with SWISS set to the binary, and fails by
+#       exiting non-zero.
+#
+#   Author:
+#
+#       agent 16-Oct-2026
+#
+#   Environment:
+#
+#       POSIX
+#
+################################################################################
+
+if [ $# -ne 1 ]; then
+    echo "Usage: $0 <swiss-binary>" >&2
+    exit 2
+fi
+
+SWISS=$1
+case "$SWISS" in
+    /*) ;;
+    *) SWISS="$PWD/$SWISS" ;;
+esac
+
+export SWISS
+TESTDIR=$(cd "$(dirname "$0")" && pwd)
+failures=0
+count=0
+for test in "$TESTDIR"/t_*.sh; do
+    count=$((count + 1))
+    name=${test##*/}
+    scratch=$(mktemp -d)
+    if (cd "$scratch" && sh "$test"); then
+        echo "PASS: $name"
+
+    else
+        echo "FAIL: $name"
+        failures=$((failures + 1))
+    fi
+
+    rm -rf "$scratch"
+done
+
+echo "$((count - failures)) of $count tests passed."
+[ $failures -eq 0 ]
@@ -0,0 +1,63 @@
+#! /bin/sh
+################################################################################
+#
+#   Copyright (c) 2026 Minoca Corp. All Rights Reserved
+#
+#   Module Name:
+#
+#       t_basename.sh
+#   Abstract:
+#
+#       This script tests the basename and dirname applets, run from inside
+#       the shell. It covers ordinary paths, suffix removal and bad usage.
+#
+#
+#   Author:
+#
+#       agent 16-Oct-2026
+#
+#   Environment:
+#
+#       POSIX
+#
+################################################################################
+
+status=0
+
+check () {
+    expected=$1
+    shift
+    actual=$("$SWISS" sh -c "$*; echo \"status \$?\"; echo alive" 2>/dev/null)
+    actual=$(echo $actual)
+    if [ "$actual" != "$expected alive" ]; then
+        echo "sh -c '$*': expected '$expected alive', got '$actual'" >&2
+        status=1
+    fi
+}
+
+#
+# Ordinary paths and suffixes.
+#
+
+check 'b status 0' 'basename /a/b'
+check 'b status 0' 'basename /a/b/'
+check 'b status 0' 'basename /a/b.c .c'
+check 'b.c status 0' 'basename b.c b.c'
+check '/ status 0' 'basename /'
+check '. status 0' 'basename "" ""'
+check '/a status 0' 'dirname /a/b'
+check '/a status 0' 'dirname /a/b/'
+check '. status 0' 'dirname a'
+check '/ status 0' 'dirname /'
+
+#
+# Bad usage exits 1 without stopping the shell.
+#
+
+check 'status 1' 'basename'
+check 'status 1' 'basename --bogus'
+check 'status 1' 'basename a b c'
+check 'status 1' 'dirname'
+check 'status 1' 'dirname --bogus'
+check 'status 1' 'dirname a b'
+exit $status
@@ -0,0 +1,100 @@
+#! /bin/sh
+################################################################################
+#
+#   Copyright (c) 2026 Minoca Corp. All Rights Reserved
+#
+#   Module Name:
+#
+#       t_expr.sh
+#
+#   Abstract:
+#
+#       This script tests the expr applet, run from inside the shell. It
+#       covers operator precedence, parentheses, arithmetic errors and
+#       malformed expressions. Results and exit statuses follow GNU expr.
+#
+#   Author:
+#
+#       agent 16-Oct-2026
+#
+#   Environment:
+#
+#       POSIX
+#
+################################################################################
+
+status=0
+
+check () {
+    expected=$1
+    shift
+    actual=$("$SWISS" sh -c "$*; echo \"status \$?\"; echo alive" 2>/dev/null)
+    actual=$(echo $actual)
+    if [ "$actual" != "$expected alive" ]; then
+        echo "sh -c '$*': expected '$expected alive', got '$actual'" >&2
+        status=1
+    fi
+}
+
+#
+# Values and precedence.
+#
+
+check '1 status 0' 'expr 1'
+check 'a status 0' 'expr a'
+check '- status 0' 'expr -'
+check '0 status 1' 'expr 0'
+check '3 status 0' 'expr 2 - 3 "*" 1 + 4'
+check '14 status 0' 'expr 2 + 3 "*" 4'
+check '20 status 0' 'expr "(" 2 + 3 ")" "*" 4'
+check '-3 status 0' 'expr 7 / -2'
+check '1 status 0' 'expr 7 % -2'
+check '1 status 0' 'expr 1 "|" 0'
+check '0 status 1' 'expr 1 "&" 0'
+check '0 status 1' 'expr -0 "|" 00'
+check 'a status 0' 'expr a "&" b'
+check '1 status 0' 'expr 10 ">" 9'
+check '0 status 1' 'expr 10 "<" 9'
+check '1 status 0' 'expr b ">" a'
+check '3 status 0' 'expr abc : "a.*"'
+check 'b status 0' 'expr abc : "a\\(.\\)"'
+check '0 status 1' 'expr abc : "b"'
+check 'status 1' 'expr abc : "\\(b\\)"'
+
+#
+# A plus sign takes the next argument as a plain string.
+#
+
+check '+ status 0' 'expr + +'
+check '3 status 0' 'expr 1 + + 2'
+check 'status 2' 'expr +'
+
+#
+# Arithmetic that can't be computed.
+#
+
+check 'status 2' 'expr 1 / 0'
+check 'status 2' 'expr 1 % 0'
+check 'status 2' 'expr -2147483648 / -1'
+check '0 status 1' 'expr -2147483648 % -1'
+check 'status 2' 'expr 2147483647 + 1'
+check 'status 2' 'expr -2147483648 - 1'
+check 'status 2' 'expr 65536 "*" 65536'
+check 'status 2' 'expr 2147483648 + 0'
+check 'status 2' 'expr a + 1'
+check 'status 2' 'expr 1 + a'
+
+#
+# Malformed expressions.
+#
+
+check 'status 2' 'expr'
+check 'status 2' 'expr ")"'
+check 'status 2' 'expr "(" ")"'
+check 'status 2' 'expr 1 ")"'
+check 'status 2' 'expr 1 +'
+check 'status 2' 'expr "(" 1'
+check 'status 2' 'expr "(" "(" "*"'
+check 'status 2' 'expr 1 2'
+check 'status 3' 'expr a : "\\("'
+exit $status
@@ -0,0 +1,61 @@
+#! /bin/sh
+################################################################################
+#
+#   Copyright (c) 2026 Minoca Corp. All Rights Reserved
+#
+#   Module Name:
+#
+#       t_printf.sh
+#   Abstract:
+#
+#       This script tests the printf applet, run from inside the shell. It
+#       covers missing arguments, invalid numbers and formats that end in
+#       the middle of a conversion.
+#
+#
+#   Author:
+#
+#       agent 16-Oct-2026
+#
+#   Environment:
+#
+#       POSIX
+#
+################################################################################
+
+status=0
+
+check () {
+    expected=$1
+    shift
+    actual=$("$SWISS" sh -c "$*; echo \"status \$?\"; echo alive" 2>/dev/null)
+    actual=$(echo $actual)
+    if [ "$actual" != "$expected alive" ]; then
+        echo "sh -c '$*': expected '$expected alive', got '$actual'" >&2
+        status=1
+    fi
+}
+
+#
+# Ordinary conversions, and the format reused for extra arguments.
+#
+
+check 'a-3 b-0 status 0' 'printf "%s-%d\\n" a 3 b'
+check '0x1f status 0' 'printf "%#x\\n" 31'
+
+#
+# A missing numeric argument is zero.
+#
+
+check '0 status 0' 'printf "%d\\n"'
+check '0 status 0' 'printf "%o\\n"'
+
+#
+# Errors set the status to 1 without stopping the shell.
+#
+
+check 'status 1' 'printf %'
+check 'status 1' 'printf "%5"'
+check '0 status 1' 'printf "%d\\n" abc'
+check '12 status 1' 'printf "%d\\n" 12abc'
+exit $status
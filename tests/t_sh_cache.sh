@@ -0,0 +1,75 @@
+#! /bin/sh
+################################################################################
+#
+#   Copyright (c) 2026 Minoca Corp. All Rights Reserved
+#
+#   Module Name:
+#
+#       t_sh_cache.sh
+#
+#   Abstract:
+#
+#       This script tests that eval strings and command substitutions parsed
+#       ahead of time still see alias changes made while they run, including
+#       changes made from inside a function they call.
+#
+#   Author:
+#
+#       agent 16-Oct-2026
+#
+#   Environment:
+#
+#       POSIX
+#
+################################################################################
+
+status=0
+
+check () {
+    expected=$1
+    shift
+    actual=$("$SWISS" sh -c "$*" 2>&1)
+    if [ "$actual" != "$expected" ]; then
+        echo "sh -c '$*'" >&2
+        echo "  expected: $expected" >&2
+        echo "  actual:   $actual" >&2
+        status=1
+    fi
+}
+
+nl='
+'
+
+check "X hi${nl}X ho" 'f() { alias foo="echo X"; }
+eval "f
+foo hi
+foo ho"'
+
+check "X 1${nl}X 2${nl}X 3" 'f() { unalias foo 2>/dev/null; alias foo="echo X"; }
+for i in 1 2 3; do eval "f
+foo \$i"; done'
+
+check "A${nl}B${nl}A${nl}B" 'f() { alias foo="echo A"; }
+g() { alias foo="echo B"; }
+for i in 1 2; do eval "f
+foo
+g
+foo"; done'
+
+check "X sub${nl}X sub" 'f() { alias foo="echo X"; }
+for i in 1 2; do x=$(f
+foo sub); echo "$x"; done'
+
+check "X bq${nl}X bq" 'f() { alias foo="echo X"; }
+for i in 1 2; do x=`f
+foo bq`; echo "$x"; done'
+
+check "Y 1${nl}Y 2" 'alias foo="echo Y"
+for i in 1 2; do eval "alias foo=\"echo Y\"
+foo \$i"; done'
+
+check "M 1${nl}M 1${nl}alias" 'alias myalias="echo M"; aliasfile=1
+for i in 1 2; do eval "myalias \$aliasfile"; done
+eval "echo alias"'
+
+exit $status
@@ -0,0 +1,46 @@
+#! /bin/sh
+################################################################################
+#
+#   Copyright (c) 2026 Minoca Corp. All Rights Reserved
+#
+#   Module Name:
+#
+#       t_sh_glob.sh
+#
+#   Abstract:
+#
+#       This script tests which words the shell treats as path patterns. A [
+#       only starts a bracket expression if a ] follows it, so a word with a
+#       lone [ stays as it is.
+#
+#   Author:
+#
+#       agent 16-Oct-2026
+#
+#   Environment:
+#
+#       POSIX
+#
+################################################################################
+
+status=0
+
+check () {
+    expected=$1
+    shift
+    actual=$("$SWISS" sh -c "$*" 2>&1)
+    if [ "$actual" != "$expected" ]; then
+        echo "sh -c '$*': expected '$expected', got '$actual'" >&2
+        status=1
+    fi
+}
+
+touch a b '[a' 'x['
+check '[' 'echo ['
+check '[a' 'echo [a'
+check 'x[' 'echo x['
+check 'a b' 'echo [ab]'
+check '[ab]' 'echo \[ab]'
+check 'ok' 'if [ 1 -lt 2 ]; then echo ok; fi'
+check '3' 'i=0; while [ $i -lt 3 ]; do i=$((i+1)); done; echo $i'
+exit $status
@@ -0,0 +1,51 @@
+#! /bin/sh
+################################################################################
+#
+#   Copyright (c) 2026 Minoca Corp. All Rights Reserved
+#
+#   Module Name:
+#
+#       t_sh_nofork.sh
+#
+#   Abstract:
+#
+#       This script runs the applets the shell executes in its own process
+#       through their failure paths. The shell has to survive each one and
+#       report the same exit status a separate process would have. Each
+#       applet's own tests cover more of its behavior.
+#
+#   Author:
+#
+#       agent 16-Oct-2026
+#
+#   Environment:
+#
+#       POSIX
+#
+################################################################################
+
+status=0
+
+check () {
+    expected=$1
+    shift
+    actual=$("$SWISS" sh -c "$*; echo \"status \$?\"; echo alive" 2>/dev/null)
+    actual=$(echo $actual)
+    if [ "$actual" != "$expected alive" ]; then
+        echo "sh -c '$*': expected '$expected alive', got '$actual'" >&2
+        status=1
+    fi
+}
+
+check 'status 1' 'false'
+check 'status 0' 'true --help'
+check 'status 0' 'echo -e "\\c" x'
+
+#
+# The shell's own ways of exiting still end the shell or subshell.
+#
+
+check 'status 3' '(exit 3)'
+check 'status 4' 'x=$(exit 4)'
+check 'status 5' '"$SWISS" sh -c "exit 5"'
+exit $status
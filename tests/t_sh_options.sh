@@ -0,0 +1,51 @@
+#! /bin/sh
+################################################################################
+#
+#   Copyright (c) 2026 Minoca Corp. All Rights Reserved
+#
+#   Module Name:
+#
+#       t_sh_options.sh
+#
+#   Abstract:
+#
+#       This script tests setting and clearing shell options by their long
+#       names, with -o and +o, both on the command line and with set.
+#
+#   Author:
+#
+#       agent 16-Oct-2026
+#
+#   Environment:
+#
+#       POSIX
+#
+################################################################################
+
+status=0
+
+check () {
+    expected=$1
+    shift
+    actual=$("$SWISS" sh "$@" 2>&1)
+    if [ "$actual" != "$expected" ]; then
+        echo "sh $*: expected '$expected', got '$actual'" >&2
+        status=1
+    fi
+}
+
+touch a b
+check 'a b' -c 'echo *'
+check '*' -c 'set -o noglob; echo *'
+check '*' -c 'set -o noglob'"
+"'echo *'
+check 'a b' -c 'set -o noglob; set +o noglob; echo *'
+check '*' -o noglob -c 'echo *'
+check 'a b' -f +o noglob -c 'echo *'
+check 'noglob' -c 'set -o noglob; case $- in *f*) echo noglob;; esac'
+if "$SWISS" sh -c 'set -o nosuchoption' 2>/dev/null; then
+    echo "set -o nosuchoption succeeded" >&2
+    status=1
+fi
+
+exit $status
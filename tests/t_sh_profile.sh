@@ -0,0 +1,59 @@
+#! /bin/sh
+################################################################################
+#
+#   Copyright (c) 2026 Minoca Corp. All Rights Reserved
+#
+#   Module Name:
+#
+#       t_sh_profile.sh
+#
+#   Abstract:
+#
+#       This script tests turning the shell profiler on and off. A report is
+#       written at exit only if the profile option is still set.
+#
+#   Author:
+#
+#       agent 16-Oct-2026
+#
+#   Environment:
+#
+#       POSIX
+#
+################################################################################
+
+status=0
+
+SHPROFILE="$PWD/on.txt" "$SWISS" sh -c 'f() { true; }; f' \
+    2>/dev/null
+
+if ! grep -q '^Profile of ' on.txt 2>/dev/null; then
+    echo "SHPROFILE did not produce a report" >&2
+    status=1
+fi
+
+SHPROFILE="$PWD/off.txt" "$SWISS" sh -c 'set +o profile; f() { true; }; f'
+if [ -s off.txt ]; then
+    echo "set +o profile still wrote a report" >&2
+    status=1
+fi
+
+SHPROFILE="$PWD/late.txt" "$SWISS" sh -c 'true; set +o profile; true'
+if [ -s late.txt ]; then
+    echo "clearing profile part way through still wrote a report" >&2
+    status=1
+fi
+
+"$SWISS" sh -c 'set -o profile; true; set +o profile' 2>stderr.txt
+if [ -s stderr.txt ]; then
+    echo "set -o profile then +o profile wrote a report" >&2
+    status=1
+fi
+
+"$SWISS" sh -c 'set -o profile; true' 2>stderr.txt
+if ! grep -q '^Profile of ' stderr.txt; then
+    echo "set -o profile did not write a report to standard error" >&2
+    status=1
+fi
+
+exit $status
@@ -0,0 +1,73 @@
+#! /bin/sh
+################################################################################
+#
+#   Copyright (c) 2026 Minoca Corp. All Rights Reserved
+#
+#   Module Name:
+#
+#       t_test.sh
+#
+#   Abstract:
+#
+#       This script tests the test and [ applets, run from inside the shell.
+#       It covers operator precedence, parentheses and malformed expressions,
+#       which must fail with status 2 without taking the shell down.
+#
+#   Author:
+#
+#       agent 16-Oct-2026
+#
+#   Environment:
+#
+#       POSIX
+#
+################################################################################
+
+status=0
+
+check () {
+    expected=$1
+    shift
+    actual=$("$SWISS" sh -c "$*; echo \"status \$?\"; echo alive" 2>/dev/null)
+    actual=$(echo $actual)
+    if [ "$actual" != "$expected alive" ]; then
+        echo "sh -c '$*': expected '$expected alive', got '$actual'" >&2
+        status=1
+    fi
+}
+
+#
+# Well formed expressions.
+#
+
+check 'status 1' '[ a = b ]'
+check 'status 0' '[ a != b ]'
+check 'status 0' 'test -z'
+check 'status 0' 'test -n -a'
+check 'status 0' 'test = = ='
+check 'status 1' 'test "(" = ")"'
+check 'status 1' 'test ! -z ""'
+check 'status 0' 'test 1 -lt 2 -o 1 -gt 2'
+check 'status 1' 'test "" -o a -a ""'
+check 'status 0' 'test a -o b -a ""'
+check 'status 0' 'test ! "" -a a'
+check 'status 0' 'test ! "(" a = b ")"'
+check 'status 0' 'test "(" a = a ")" -a "(" b != c ")"'
+check 'status 0' '[ a -a "(" b ")" ]'
+check 'status 0' '[ "(" a ")" -a b ]'
+check 'status 1' 'test ! ! ! "("'
+
+#
+# Malformed expressions.
+#
+
+check 'status 2' 'test 1 -eq'
+check 'status 2' 'test a -lt 1'
+check 'status 2' 'test x -eq 1'
+check 'status 2' '[ "(" a ]'
+check 'status 2' '[ a = b'
+check 'status 2' 'test "" -nt != -a "" ! -nt'
+check 'status 2' 'test 1 -lt ! -nt -t'
+check 'status 2' 'test -a -t -t -a "" -o ""'
+check 'status 2' 'set -- $(i=0; while [ $i -lt 2000 ]; do echo "("; i=$((i+1)); done); test "$@"'
+exit $status